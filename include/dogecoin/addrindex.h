@@ -0,0 +1,110 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef __LIBDOGECOIN_ADDRINDEX_H__
+#define __LIBDOGECOIN_ADDRINDEX_H__
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#include <dogecoin/block.h>
+#include <dogecoin/blockfile.h>
+#include <dogecoin/chainparams.h>
+#include <dogecoin/cstr.h>
+#include <dogecoin/vector.h>
+
+/* rows buffered in memory before they are written as a segment */
+#define DOGECOIN_ADDRINDEX_SEGMENT_ROWS (1 << 18)
+/* bloom filter bits per row of a segment */
+#define DOGECOIN_ADDRINDEX_BLOOM_BITS 10
+
+/* One row of the index. Funding rows are keyed by the script hash of
+ * an output (key_n 0), spending rows by the outpoint they spend. */
+typedef struct dogecoin_addrindex_row_ {
+    uint256 key;
+    uint32_t key_n;
+    uint32_t height;
+    uint32_t tx_pos; /* position of the transaction in its block */
+    uint256 txid;    /* funding or spending transaction */
+    uint32_t n;      /* output or input index */
+    int64_t amount;  /* value of a funding row, 0 for spends */
+} dogecoin_addrindex_row;
+
+typedef struct dogecoin_addrindex_table_ dogecoin_addrindex_table;
+
+/* append-only index over two tables of sorted, columnar segment files */
+typedef struct dogecoin_addrindex_ {
+    const dogecoin_chainparams* chain;
+    cstring* dir;
+    dogecoin_addrindex_table* funding;
+    dogecoin_addrindex_table* spending;
+    int64_t height; /* last block added, -1 for none */
+    uint256 hash;
+    uint32_t next_id;
+} dogecoin_addrindex;
+
+/* a transaction touching a script, delta is the net amount it received */
+typedef struct dogecoin_addrindex_history_item_ {
+    uint256 txid;
+    uint32_t height;
+    uint32_t tx_pos; /* position of the transaction in its block */
+    int64_t delta;
+} dogecoin_addrindex_history_item;
+
+typedef struct dogecoin_addrindex_unspent_item_ {
+    uint256 txid;
+    uint32_t vout;
+    uint32_t height;
+    int64_t amount;
+} dogecoin_addrindex_unspent_item;
+
+/* Opens the index stored in dir, the directory is created if missing. Returns NULL if it belongs to another chain. */
+LIBDOGECOIN_API dogecoin_addrindex* dogecoin_addrindex_open(const dogecoin_chainparams* chain, const char* dir);
+/* Frees the index, rows added since the last flush are dropped. */
+LIBDOGECOIN_API void dogecoin_addrindex_free(dogecoin_addrindex* idx);
+/* Adds the rows of the next block, segments are written once enough rows are buffered. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrindex_add_block(dogecoin_addrindex* idx, dogecoin_block_view* view, uint32_t height, const uint256 hash);
+/* dogecoin_blockfile_scan callback, ctx is the index. Blocks up to the height of the index are skipped. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrindex_blockfile_cb(dogecoin_blockfile_block* block, void* ctx);
+/* Writes the buffered rows as new segments and records the height in the manifest. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrindex_flush(dogecoin_addrindex* idx);
+/* Flushes and merges all segments of each table into one. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrindex_compact(dogecoin_addrindex* idx);
+
+/* The key of an output script, the Electrum script hash: sha256 of the script. */
+LIBDOGECOIN_API void dogecoin_addrindex_script_hash(const unsigned char* script, size_t len, uint256 hash);
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrindex_address_hash(const dogecoin_chainparams* chain, const char* address, uint256 hash);
+
+/* Queries by script hash, results are appended to items as malloc'ed items in chain order. */
+LIBDOGECOIN_API size_t dogecoin_addrindex_history(dogecoin_addrindex* idx, const uint256 script_hash, vector* items);
+LIBDOGECOIN_API size_t dogecoin_addrindex_unspent(dogecoin_addrindex* idx, const uint256 script_hash, vector* items);
+LIBDOGECOIN_API int64_t dogecoin_addrindex_balance(dogecoin_addrindex* idx, const uint256 script_hash);
+
+LIBDOGECOIN_END_DECL
+
+#endif // __LIBDOGECOIN_ADDRINDEX_H__
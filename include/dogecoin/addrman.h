@@ -0,0 +1,93 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef __LIBDOGECOIN_ADDRMAN_H__
+#define __LIBDOGECOIN_ADDRMAN_H__
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#include <dogecoin/chainparams.h>
+#include <dogecoin/cstr.h>
+#include <dogecoin/protocol.h>
+
+/* addresses kept at most, a full store evicts its worst untried address */
+#define DOGECOIN_ADDRMAN_MAX_ENTRIES 4096
+/* addresses kept at most from one announcing peer */
+#define DOGECOIN_ADDRMAN_MAX_PER_SOURCE 256
+/* most addresses accepted from one addr message */
+#define DOGECOIN_ADDRMAN_MAX_ADDR_SZ 1000
+
+/* what is known about one peer address */
+typedef struct dogecoin_addrman_entry_ {
+    dogecoin_p2p_address addr; /* time is when the address was last announced */
+    uint64_t last_try;         /* last connection attempt */
+    uint64_t last_success;     /* last completed handshake */
+    uint32_t attempts;         /* attempts since the last completed handshake */
+    uint32_t successes;
+    uint32_t failures;
+    uint32_t handshake_ms;     /* smoothed time from connecting to the verack, 0 if unknown */
+    uint32_t ping_ms;          /* smoothed ping round trip, 0 if unknown */
+} dogecoin_addrman_entry;
+
+/* A peer store that learns addresses from addr messages, dns seeds and
+ * users and records how connections to them went. It may be shared by
+ * the threads of a threaded node group. */
+typedef struct dogecoin_addrman_ dogecoin_addrman;
+
+LIBDOGECOIN_API dogecoin_addrman* dogecoin_addrman_new(const dogecoin_chainparams* chain);
+LIBDOGECOIN_API void dogecoin_addrman_free(dogecoin_addrman* addrman);
+
+LIBDOGECOIN_API size_t dogecoin_addrman_size(dogecoin_addrman* addrman);
+
+/* learn an address, refreshing its time if it is known. false if it is known, unroutable or the store is full */
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrman_add(dogecoin_addrman* addrman, const dogecoin_p2p_address* addr);
+/* learn an address announced by the peer source, clamping future times and limiting the peer's share of the store */
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrman_add_from(dogecoin_addrman* addrman, const dogecoin_p2p_address* addr, const struct sockaddr* source, uint64_t now);
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrman_add_sockaddr(dogecoin_addrman* addrman, const struct sockaddr* addr, uint64_t services, uint64_t now);
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrman_get(dogecoin_addrman* addrman, const struct sockaddr* addr, dogecoin_addrman_entry* entry_out);
+
+/* connection results, addresses that are not known are ignored */
+LIBDOGECOIN_API void dogecoin_addrman_attempt(dogecoin_addrman* addrman, const struct sockaddr* addr, uint64_t now);
+LIBDOGECOIN_API void dogecoin_addrman_good(dogecoin_addrman* addrman, const struct sockaddr* addr, uint32_t handshake_ms, uint64_t now);
+LIBDOGECOIN_API void dogecoin_addrman_failed(dogecoin_addrman* addrman, const struct sockaddr* addr);
+LIBDOGECOIN_API void dogecoin_addrman_ping(dogecoin_addrman* addrman, const struct sockaddr* addr, uint32_t rtt_ms);
+
+/* copy up to max addresses worth connecting to now into entries_out, fast and reliable peers first.
+ * addresses that failed recently are left out until their backoff passed */
+LIBDOGECOIN_API size_t dogecoin_addrman_select(dogecoin_addrman* addrman, uint64_t now, dogecoin_addrman_entry* entries_out, size_t max);
+
+/* persist to / merge from a compact checksummed file */
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrman_save(dogecoin_addrman* addrman, const char* path);
+LIBDOGECOIN_API dogecoin_bool dogecoin_addrman_load(dogecoin_addrman* addrman, const char* path);
+
+/* appends the path of the chain's peer file in the default datadir to path_out */
+LIBDOGECOIN_API void dogecoin_addrman_default_path(const dogecoin_chainparams* chain, cstring* path_out);
+
+LIBDOGECOIN_END_DECL
+
+#endif /* __LIBDOGECOIN_ADDRMAN_H__ */
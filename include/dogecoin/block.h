@@ -37,8 +37,19 @@ LIBDOGECOIN_BEGIN_DECL
 #include <dogecoin/buffer.h>
 #include <dogecoin/cstr.h>
 #include <dogecoin/hash.h>
+#include <dogecoin/serialize.h>
 #include <dogecoin/tx.h>
 
+#define DOGECOIN_BLOCK_HEADER_SIZE 80
+
+/* merged mining: bit 8 of the version flags an auxpow payload after the
+ * header, the upper 16 bits carry the chain id (0x62 for dogecoin) */
+#define DOGECOIN_BLOCK_VERSION_AUXPOW (1 << 8)
+#define DOGECOIN_BLOCK_VERSION_CHAIN_START (1 << 16)
+#define DOGECOIN_AUXPOW_CHAIN_ID 0x0062
+/* longest chain merkle branch accepted in an auxpow */
+#define DOGECOIN_AUXPOW_MAX_CHAIN_BRANCH 30
+
 typedef struct dogecoin_block_header_ {
     int32_t version;
     uint256 prev_block;
@@ -48,6 +59,49 @@ typedef struct dogecoin_block_header_ {
     uint32_t nonce;
 } dogecoin_block_header;
 
+/* proof that the block was merge mined in a parent chain block */
+typedef struct dogecoin_auxpow_ {
+    dogecoin_tx* coinbase_tx;     /* parent chain coinbase committing to this block */
+    uint256 parent_hash;          /* unused by consensus */
+    vector* coinbase_branch;      /* uint256*, coinbase -> parent merkle root */
+    int32_t coinbase_index;
+    vector* chain_branch;         /* uint256*, this block -> merged mining root */
+    int32_t chain_index;
+    dogecoin_block_header parent_header;
+} dogecoin_auxpow;
+
+/* fully materialized block */
+typedef struct dogecoin_block_ {
+    dogecoin_block_header header;
+    dogecoin_auxpow* auxpow; /* NULL unless the header has the auxpow flag */
+    vector* txs;             /* dogecoin_tx* */
+} dogecoin_block;
+
+/* auxpow fields pointing into the parsed buffer */
+typedef struct dogecoin_auxpow_view_ {
+    struct const_buffer coinbase_tx;     /* serialized parent coinbase */
+    const unsigned char* parent_hash;
+    const unsigned char* coinbase_branch; /* coinbase_branch_len * 32 bytes */
+    uint32_t coinbase_branch_len;
+    int32_t coinbase_index;
+    const unsigned char* chain_branch;    /* chain_branch_len * 32 bytes */
+    uint32_t chain_branch_len;
+    int32_t chain_index;
+    const unsigned char* parent_header;   /* serialized 80 byte parent header */
+} dogecoin_auxpow_view;
+
+/* zero-copy view over a serialized block. Parsing only decodes the
+ * header and the auxpow, transactions are located on first access and
+ * decoded one at a time. The buffer must outlive the view. */
+typedef struct dogecoin_block_view_ {
+    dogecoin_block_header header;
+    dogecoin_bool has_auxpow;
+    dogecoin_auxpow_view auxpow;
+    uint32_t tx_count;
+    struct const_buffer txs; /* everything after the transaction count */
+    size_t* tx_offsets;      /* tx_count + 1 offsets into txs, built lazily */
+} dogecoin_block_view;
+
 /* Creating a new block header object. */
 LIBDOGECOIN_API dogecoin_block_header* dogecoin_block_header_new();
 /* A macro that is used to free the memory allocated for the `dogecoin_block_header` struct. */
@@ -56,10 +110,46 @@ LIBDOGECOIN_API void dogecoin_block_header_free(dogecoin_block_header* header);
 LIBDOGECOIN_API int dogecoin_block_header_deserialize(dogecoin_block_header* header, struct const_buffer* buf);
 /* A function that serializes a block header into a cstring. */
 LIBDOGECOIN_API void dogecoin_block_header_serialize(cstring* s, const dogecoin_block_header* header);
+/* Serializes a block header into a writer. */
+LIBDOGECOIN_API void dogecoin_block_header_serialize_writer(ser_writer* w, const dogecoin_block_header* header);
 /* A macro that is used to copy the contents of the `src` block header into the `dest` block header. */
 LIBDOGECOIN_API void dogecoin_block_header_copy(dogecoin_block_header* dest, const dogecoin_block_header* src);
 /* This is a macro that is used to hash the contents of the `dogecoin_block_header` struct. */
 LIBDOGECOIN_API dogecoin_bool dogecoin_block_header_hash(dogecoin_block_header* header, uint256 hash);
+/* Checks the version for the auxpow flag and returns the chain id. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_header_is_auxpow(const dogecoin_block_header* header);
+LIBDOGECOIN_API int32_t dogecoin_block_header_chain_id(const dogecoin_block_header* header);
+
+/* Allocating, freeing and deserializing an auxpow. */
+LIBDOGECOIN_API dogecoin_auxpow* dogecoin_auxpow_new();
+LIBDOGECOIN_API void dogecoin_auxpow_free(dogecoin_auxpow* auxpow);
+LIBDOGECOIN_API dogecoin_bool dogecoin_auxpow_deserialize(dogecoin_auxpow* auxpow, struct const_buffer* buf);
+
+/* Allocating, freeing and deserializing a full block including all transactions. */
+LIBDOGECOIN_API dogecoin_block* dogecoin_block_new();
+LIBDOGECOIN_API void dogecoin_block_free(dogecoin_block* block);
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_deserialize(dogecoin_block* block, struct const_buffer* buf);
+
+/* Parsing a header and the auxpow following it, as in blocks and merkleblock messages. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_header_view_parse(dogecoin_block_header* header, dogecoin_bool* has_auxpow, dogecoin_auxpow_view* auxpow, struct const_buffer* buf);
+/* Parsing a serialized block into a view, advances buf past header, auxpow and tx count. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_view_parse(dogecoin_block_view* view, struct const_buffer* buf);
+LIBDOGECOIN_API void dogecoin_block_view_free(dogecoin_block_view* view);
+/* Locating all transactions, returns the size of the whole transaction list. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_view_index(dogecoin_block_view* view, size_t* txs_size);
+/* Accessing a single transaction: raw bytes, its hash, or the decoded transaction. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_view_tx_raw(dogecoin_block_view* view, uint32_t idx, struct const_buffer* raw);
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_view_tx_hash(dogecoin_block_view* view, uint32_t idx, uint256 hash);
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_view_tx(dogecoin_block_view* view, uint32_t idx, dogecoin_tx* tx);
+
+/* Merkle root over the txids, mutated (may be NULL) flags a duplicated subtree. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_merkle_root(const dogecoin_block* block, uint256 root, dogecoin_bool* mutated);
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_view_merkle_root(dogecoin_block_view* view, uint256 root, dogecoin_bool* mutated);
+/* Checks that an auxpow commits to aux_block_hash: the coinbase branch leads to the parent
+ * merkle root and the coinbase script holds the chain merkle root at the expected slot.
+ * The parent header's proof of work is not checked. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_auxpow_view_check(const dogecoin_auxpow_view* auxpow, const uint256 aux_block_hash, int32_t chain_id);
+LIBDOGECOIN_API dogecoin_bool dogecoin_auxpow_check(const dogecoin_auxpow* auxpow, const uint256 aux_block_hash, int32_t chain_id);
 
 LIBDOGECOIN_END_DECL
 
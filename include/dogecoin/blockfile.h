@@ -0,0 +1,72 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef __LIBDOGECOIN_BLOCKFILE_H__
+#define __LIBDOGECOIN_BLOCKFILE_H__
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#include <dogecoin/block.h>
+#include <dogecoin/chainparams.h>
+#include <dogecoin/cstr.h>
+
+/* a block of the best chain as handed to the scan callback */
+typedef struct dogecoin_blockfile_block_ {
+    uint32_t height;
+    uint256 hash;
+    const unsigned char* data; /* serialized block inside the mapped file */
+    size_t len;
+    uint32_t file;             /* n of blkNNNNN.dat */
+    size_t offset;             /* offset of the serialized block in the file */
+    dogecoin_block_view view;  /* parsed, transactions already indexed */
+    dogecoin_block* block;     /* fully decoded block if requested, else NULL */
+} dogecoin_blockfile_block;
+
+/* called in chain order, return false to stop the scan */
+typedef dogecoin_bool (*dogecoin_blockfile_block_cb)(dogecoin_blockfile_block* block, void* ctx);
+
+typedef struct dogecoin_blockfile_scan_params_ {
+    const dogecoin_chainparams* chain;
+    const char* blocks_dir;    /* NULL for the chain's directory in the default datadir */
+    unsigned int threads;      /* 0 for one per online cpu, 1 decodes on the calling thread */
+    unsigned int window;       /* blocks decoded ahead of the callback */
+    dogecoin_bool decode_txs;  /* fill dogecoin_blockfile_block.block */
+    dogecoin_blockfile_block_cb cb;
+    void* ctx;
+} dogecoin_blockfile_scan_params;
+
+/* Appends the blocks directory of the chain in the default datadir to path_out. */
+LIBDOGECOIN_API void dogecoin_blockfile_default_dir(const dogecoin_chainparams* chain, cstring* path_out);
+/* Sets the defaults for a scan of the given chain. */
+LIBDOGECOIN_API void dogecoin_blockfile_scan_params_init(dogecoin_blockfile_scan_params* params, const dogecoin_chainparams* chain);
+/* Maps all blk*.dat files, links the records to the best chain and delivers its blocks in order. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_blockfile_scan(const dogecoin_blockfile_scan_params* params, uint32_t* delivered);
+
+LIBDOGECOIN_END_DECL
+
+#endif // __LIBDOGECOIN_BLOCKFILE_H__
@@ -0,0 +1,87 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#ifndef __LIBDOGECOIN_BLOCKFILTER_H__
+#define __LIBDOGECOIN_BLOCKFILTER_H__
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#include <dogecoin/block.h>
+#include <dogecoin/buffer.h>
+#include <dogecoin/cstr.h>
+#include <dogecoin/serialize.h>
+
+/* BIP158 filter types and basic filter parameters */
+#define DOGECOIN_BLOCKFILTER_BASIC 0
+#define DOGECOIN_BLOCKFILTER_BASIC_P 19
+#define DOGECOIN_BLOCKFILTER_BASIC_M 784931
+
+/* golomb coded set of a block, keyed by the block hash */
+typedef struct dogecoin_blockfilter_ {
+    uint8_t type;
+    uint256 block_hash;
+    uint32_t n;       /* number of elements */
+    cstring* encoded; /* compact size n followed by the golomb-rice coded deltas */
+    size_t data_offset; /* start of the coded deltas in encoded */
+} dogecoin_blockfilter;
+
+/* looks up the output script spent by an input, script is appended to */
+typedef dogecoin_bool (*dogecoin_blockfilter_prevout_cb)(const uint256 txid, uint32_t vout, cstring* script, void* ctx);
+
+/* SipHash-2-4 with the 128 bit key k0, k1 */
+LIBDOGECOIN_API uint64_t dogecoin_siphash(uint64_t k0, uint64_t k1, const unsigned char* data, size_t len);
+
+LIBDOGECOIN_API dogecoin_blockfilter* dogecoin_blockfilter_new();
+LIBDOGECOIN_API void dogecoin_blockfilter_free(dogecoin_blockfilter* filter);
+
+/* Builds a basic filter from a set of elements, duplicates are counted once. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_blockfilter_build(dogecoin_blockfilter* filter, const uint256 block_hash, const struct const_buffer* elements, size_t count);
+/* Builds the basic filter of a block: its output scripts (but OP_RETURN) and the scripts its inputs spend.
+ * Outputs spent within the block are found in the block, all others through prevout_cb. Without a
+ * prevout_cb the filter holds the output scripts only, which is not the filter peers serve. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_blockfilter_build_basic(dogecoin_blockfilter* filter, dogecoin_block_view* view, const uint256 block_hash, dogecoin_blockfilter_prevout_cb prevout_cb, void* ctx);
+/* dogecoin_blockfilter_prevout_cb reading a dogecoin_utxo_set passed as ctx, call it before the block is added to the set. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_blockfilter_utxo_prevout_cb(const uint256 txid, uint32_t vout, cstring* script, void* ctx);
+
+/* Tests a set of elements against a filter in one pass. matched (may be NULL) receives a flag per element,
+ * without it the scan stops at the first match. Returns the number of matched elements. */
+LIBDOGECOIN_API size_t dogecoin_blockfilter_match(const dogecoin_blockfilter* filter, const struct const_buffer* elements, size_t count, uint8_t* matched);
+
+/* Hash of the encoded filter and the filter header chaining it to the previous header. */
+LIBDOGECOIN_API void dogecoin_blockfilter_hash(const dogecoin_blockfilter* filter, uint256 hash);
+LIBDOGECOIN_API void dogecoin_blockfilter_header(const dogecoin_blockfilter* filter, const uint256 prev_header, uint256 header);
+
+/* cfilter payload: filter type, block hash and the encoded filter */
+LIBDOGECOIN_API void dogecoin_blockfilter_serialize(cstring* s, const dogecoin_blockfilter* filter);
+LIBDOGECOIN_API dogecoin_bool dogecoin_blockfilter_deserialize(dogecoin_blockfilter* filter, struct const_buffer* buf);
+
+LIBDOGECOIN_END_DECL
+
+#endif // __LIBDOGECOIN_BLOCKFILTER_H__
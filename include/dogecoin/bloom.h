@@ -0,0 +1,115 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#ifndef __LIBDOGECOIN_BLOOM_H__
+#define __LIBDOGECOIN_BLOOM_H__
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#include <dogecoin/block.h>
+#include <dogecoin/buffer.h>
+#include <dogecoin/cstr.h>
+#include <dogecoin/key.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/tx.h>
+
+/* BIP37 limits of a filterload message */
+#define DOGECOIN_BLOOM_MAX_SIZE 36000
+#define DOGECOIN_BLOOM_MAX_HASH_FUNCS 50
+/* largest element of a filteradd message */
+#define DOGECOIN_BLOOM_MAX_ELEMENT_SIZE 520
+
+/* how a peer updates the filter when an output matches */
+enum dogecoin_bloom_update {
+    DOGECOIN_BLOOM_UPDATE_NONE = 0,
+    DOGECOIN_BLOOM_UPDATE_ALL = 1,
+    /* only outputs paying to a pubkey or a bare multisig */
+    DOGECOIN_BLOOM_UPDATE_P2PUBKEY_ONLY = 2,
+    DOGECOIN_BLOOM_UPDATE_MASK = 3,
+};
+
+typedef struct dogecoin_bloom_ {
+    uint8_t* data;
+    uint32_t size; /* bytes */
+    uint32_t hash_funcs;
+    uint32_t tweak;
+    uint8_t flags;
+    uint32_t seeds[DOGECOIN_BLOOM_MAX_HASH_FUNCS]; /* murmur seed of each hash function */
+} dogecoin_bloom;
+
+/* merkleblock message, the hashes and flags point into the parsed buffer */
+typedef struct dogecoin_merkleblock_ {
+    dogecoin_block_header header;
+    dogecoin_bool has_auxpow;
+    dogecoin_auxpow_view auxpow;
+    uint32_t total_txs;
+    const unsigned char* hashes; /* hash_count * 32 bytes */
+    uint32_t hash_count;
+    const unsigned char* flags;
+    uint32_t flag_bytes;
+} dogecoin_merkleblock;
+
+/* MurmurHash3 (x86_32) of data, as used by BIP37 */
+LIBDOGECOIN_API uint32_t dogecoin_murmurhash3(uint32_t seed, const unsigned char* data, size_t len);
+/* MurmurHash3 of the same data under count seeds in one pass over the data */
+LIBDOGECOIN_API void dogecoin_murmurhash3_multi(const uint32_t* seeds, size_t count, const unsigned char* data, size_t len, uint32_t* hashes);
+
+/* Creates a filter for elements items with false positive rate fp_rate, sized within the BIP37 limits. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_bloom_init(dogecoin_bloom* filter, uint32_t elements, double fp_rate, uint32_t tweak, uint8_t flags);
+LIBDOGECOIN_API dogecoin_bloom* dogecoin_bloom_new(uint32_t elements, double fp_rate, uint32_t tweak, uint8_t flags);
+LIBDOGECOIN_API void dogecoin_bloom_free(dogecoin_bloom* filter);
+/* Releases the bit field of a filter set up with dogecoin_bloom_init or dogecoin_bloom_deserialize. */
+LIBDOGECOIN_API void dogecoin_bloom_cleanup(dogecoin_bloom* filter);
+
+LIBDOGECOIN_API void dogecoin_bloom_insert(dogecoin_bloom* filter, const unsigned char* data, size_t len);
+LIBDOGECOIN_API dogecoin_bool dogecoin_bloom_contains(const dogecoin_bloom* filter, const unsigned char* data, size_t len);
+LIBDOGECOIN_API void dogecoin_bloom_insert_outpoint(dogecoin_bloom* filter, const dogecoin_tx_outpoint* outpoint);
+LIBDOGECOIN_API dogecoin_bool dogecoin_bloom_contains_outpoint(const dogecoin_bloom* filter, const dogecoin_tx_outpoint* outpoint);
+/* Inserts the serialized pubkey and its hash160, matching P2PK and P2PKH outputs and their spends. */
+LIBDOGECOIN_API void dogecoin_bloom_insert_pubkey(dogecoin_bloom* filter, const dogecoin_pubkey* pubkey);
+/* Checks a transaction the way a BIP37 peer does: txid, output pushes, spent outpoints and input pushes.
+ * Outpoints of matched outputs are inserted as the update flags ask for. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_bloom_match_tx(dogecoin_bloom* filter, const dogecoin_tx* tx, const uint256 txid);
+
+/* filterload payload */
+LIBDOGECOIN_API void dogecoin_bloom_serialize(cstring* s, const dogecoin_bloom* filter);
+LIBDOGECOIN_API void dogecoin_bloom_serialize_writer(ser_writer* w, const dogecoin_bloom* filter);
+/* Reads a filterload payload into filter, fails if it exceeds the BIP37 limits. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_bloom_deserialize(dogecoin_bloom* filter, struct const_buffer* buf);
+
+/* Parses a merkleblock message, the buffer must outlive the result. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_merkleblock_parse(dogecoin_merkleblock* mb, struct const_buffer* buf);
+/* Checks the partial merkle tree against the header's merkle root. matches and indexes (both may be NULL)
+ * need room for hash_count entries, match_count is set to the number of matched transactions. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_merkleblock_verify(const dogecoin_merkleblock* mb, uint256* matches, uint32_t* indexes, size_t* match_count);
+
+LIBDOGECOIN_END_DECL
+
+#endif // __LIBDOGECOIN_BLOOM_H__
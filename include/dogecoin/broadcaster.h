@@ -0,0 +1,93 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef __LIBDOGECOIN_BROADCASTER_H__
+#define __LIBDOGECOIN_BROADCASTER_H__
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#include <dogecoin/chainparams.h>
+#include <dogecoin/net.h>
+#include <dogecoin/tx.h>
+
+enum dogecoin_broadcast_state {
+    DOGECOIN_BROADCAST_QUEUED = 0, /* waiting for the next INV batch */
+    DOGECOIN_BROADCAST_ANNOUNCED,  /* sent to the connected peers in an INV */
+    DOGECOIN_BROADCAST_REQUESTED,  /* a peer fetched the transaction with GETDATA */
+    DOGECOIN_BROADCAST_SEEN,       /* a peer that never fetched it from us announced it */
+    DOGECOIN_BROADCAST_EXPIRED,    /* no longer tracked, reported once */
+};
+
+typedef struct dogecoin_broadcast_status_ {
+    uint256 txid;
+    enum dogecoin_broadcast_state state;
+    uint32_t announced; /* INVs sent for the transaction */
+    uint32_t requested; /* peers that fetched it */
+    uint32_t seen;      /* peers that announced it back */
+    uint64_t queued_time;
+} dogecoin_broadcast_status;
+
+typedef struct dogecoin_broadcaster_state_ dogecoin_broadcaster_state;
+
+/* A long-lived transaction broadcaster. It keeps a node group connected,
+ * announces queued transactions in batched INVs and serves them from
+ * memory when peers ask for them. */
+typedef struct dogecoin_broadcaster_ {
+    dogecoin_node_group* group;
+    unsigned int inv_interval_ms; /* how long submitted transactions gather before an INV goes out */
+    unsigned int expiry_s;        /* how long a transaction is tracked and served */
+    unsigned int reconnect_s;     /* pause before peers are retried once all connections are lost */
+    /* called on every state change, from the broadcaster's threads and without its lock held */
+    void (*status_cb)(struct dogecoin_broadcaster_* broadcaster, const dogecoin_broadcast_status* status);
+    void* ctx;
+    dogecoin_broadcaster_state* state;
+} dogecoin_broadcaster;
+
+/* create a broadcaster for comma separated ips (the chain's dns seed if NULL) keeping up to maxpeers connections */
+LIBDOGECOIN_API dogecoin_broadcaster* dogecoin_broadcaster_new(const dogecoin_chainparams* chain, const char* ips, int maxpeers);
+/* stops the broadcaster if it is running */
+LIBDOGECOIN_API void dogecoin_broadcaster_free(dogecoin_broadcaster* broadcaster);
+
+/* connect and start announcing in background threads */
+LIBDOGECOIN_API dogecoin_bool dogecoin_broadcaster_start(dogecoin_broadcaster* broadcaster);
+LIBDOGECOIN_API void dogecoin_broadcaster_stop(dogecoin_broadcaster* broadcaster);
+
+/* queue a transaction, may be called from any thread. false if it is already tracked (or can't be parsed) */
+LIBDOGECOIN_API dogecoin_bool dogecoin_broadcaster_add_tx(dogecoin_broadcaster* broadcaster, const dogecoin_tx* tx, uint256 txid_out);
+LIBDOGECOIN_API dogecoin_bool dogecoin_broadcaster_add_raw(dogecoin_broadcaster* broadcaster, const unsigned char* data, size_t len, uint256 txid_out);
+
+/* announce the queued transactions now instead of at the next interval, returns how many were announced */
+LIBDOGECOIN_API size_t dogecoin_broadcaster_flush(dogecoin_broadcaster* broadcaster);
+
+/* false if the transaction is not tracked (any more) */
+LIBDOGECOIN_API dogecoin_bool dogecoin_broadcaster_get_status(dogecoin_broadcaster* broadcaster, const uint256 txid, dogecoin_broadcast_status* status_out);
+
+LIBDOGECOIN_END_DECL
+
+#endif /* __LIBDOGECOIN_BROADCASTER_H__ */
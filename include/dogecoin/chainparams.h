@@ -49,6 +49,13 @@ typedef struct dogecoin_chainparams_ {
     uint256 genesisblockhash;
     int default_port;
     dogecoin_dns_seed dnsseeds[8];
+    uint32_t pow_limit; // easiest allowed target in compact form
+    uint32_t pow_target_spacing;  // seconds between blocks
+    uint32_t pow_target_timespan; // retarget period before digishield
+    uint32_t digishield_height;   // first height retargeting every block
+    uint32_t min_difficulty_height; // parent height from which a late block may use pow_limit under digishield
+    dogecoin_bool pow_allow_min_difficulty;
+    dogecoin_bool pow_no_retargeting;
 } dogecoin_chainparams;
 
 typedef struct dogecoin_checkpoint_ {
@@ -66,6 +73,9 @@ extern const dogecoin_chainparams dogecoin_chainparams_regtest;
 extern const dogecoin_checkpoint dogecoin_mainnet_checkpoint_array[21];
 extern const dogecoin_checkpoint dogecoin_testnet_checkpoint_array[17];
 
+/* Returns the checkpoints of a chain ordered by height, count_out receives their number. */
+LIBDOGECOIN_API const dogecoin_checkpoint* dogecoin_chainparams_checkpoints(const dogecoin_chainparams* chain, size_t* count_out);
+
 LIBDOGECOIN_API const dogecoin_chainparams* chain_from_b58_prefix(const char* address);
 LIBDOGECOIN_API int chain_from_b58_prefix_bool(char* address);
 
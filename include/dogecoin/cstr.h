@@ -34,6 +34,8 @@
 
 LIBDOGECOIN_BEGIN_DECL
 
+/* small buffers are stored inline, right behind the struct, and
+ * transparently move to the heap once they outgrow that space */
 typedef struct cstring {
     char* str;    /* string data, incl. NUL */
     size_t len;   /* length of string, not including NUL */
@@ -0,0 +1,116 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef __LIBDOGECOIN_HEADERCHAIN_H__
+#define __LIBDOGECOIN_HEADERCHAIN_H__
+
+#include <stdio.h>
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#include <dogecoin/block.h>
+#include <dogecoin/chainparams.h>
+#include <dogecoin/pow.h>
+#include <dogecoin/vector.h>
+
+/* a stored record is the block hash followed by the serialized header */
+#define DOGECOIN_HEADERCHAIN_RECORD_SIZE (DOGECOIN_HASH_LENGTH + DOGECOIN_BLOCK_HEADER_SIZE)
+
+/* one header of the tree, the record lives in the mapped file or in memory */
+typedef struct dogecoin_headerchain_entry_ {
+    const uint8_t* record;
+    struct dogecoin_headerchain_entry_* prev;
+    uint32_t height;
+    uint256 chainwork; /* little endian, total work up to and including this header */
+} dogecoin_headerchain_entry;
+
+typedef struct dogecoin_headerchain_arena_ dogecoin_headerchain_arena;
+
+typedef struct dogecoin_headerchain_ {
+    const dogecoin_chainparams* chain;
+    const dogecoin_checkpoint* checkpoints;
+    uint256* checkpoint_hashes;
+    size_t checkpoint_count;
+    dogecoin_headerchain_entry* root;    /* the checkpoint the tree is anchored at */
+    dogecoin_headerchain_entry* tip;     /* tip of the chain with the most work */
+    dogecoin_headerchain_entry* anchor;  /* highest checkpoint on the best chain, no forks below it */
+    dogecoin_headerchain_entry* last;    /* most recently linked, usually the parent of the next header */
+
+    /* hash -> entry, open addressing */
+    dogecoin_headerchain_entry** table;
+    size_t table_size;
+    size_t count;
+
+    /* the best chain by height - root->height */
+    dogecoin_headerchain_entry** best;
+    size_t best_len;
+    size_t best_alloc;
+
+    dogecoin_headerchain_arena* entries;
+    dogecoin_headerchain_arena* records;
+
+    /* persistence */
+    const uint8_t* map;
+    size_t map_len;
+    FILE* file;
+    dogecoin_bool file_failed; /* a write failed, the file was closed */
+} dogecoin_headerchain;
+
+/* Creates a header tree anchored at the checkpoint of the given height (0 for the genesis block). */
+LIBDOGECOIN_API dogecoin_headerchain* dogecoin_headerchain_new(const dogecoin_chainparams* chain, uint32_t start_height);
+LIBDOGECOIN_API void dogecoin_headerchain_free(dogecoin_headerchain* hc);
+/* Maps the file at path and appends all further headers to it, the file is created if missing. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_headerchain_load(dogecoin_headerchain* hc, const char* path);
+/* Returns false once a write to the file failed, the tree then keeps further headers in memory only. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_headerchain_flush(dogecoin_headerchain* hc);
+/* Adds a header whose parent is known, returns its entry or NULL if it is an orphan or conflicts with a checkpoint. */
+LIBDOGECOIN_API dogecoin_headerchain_entry* dogecoin_headerchain_connect(dogecoin_headerchain* hc, const dogecoin_block_header* header, dogecoin_bool* reorg);
+/* Validates a headers message (see dogecoin_pow_context_connect_headers) on top of the known parent of the first
+ * header and adds the valid ones, returns how many were added. */
+LIBDOGECOIN_API size_t dogecoin_headerchain_connect_headers(dogecoin_headerchain* hc, const dogecoin_block_header* headers, const dogecoin_block_header* const* pow_headers, size_t count, dogecoin_bool* reorg);
+/* Seeds a validation context with the ancestors of entry, entry being the last header. */
+LIBDOGECOIN_API void dogecoin_headerchain_pow_context(const dogecoin_headerchain* hc, const dogecoin_headerchain_entry* entry, dogecoin_pow_context* ctx);
+LIBDOGECOIN_API dogecoin_headerchain_entry* dogecoin_headerchain_find(const dogecoin_headerchain* hc, const uint256 hash);
+/* Returns the entry of the best chain at height or NULL. */
+LIBDOGECOIN_API dogecoin_headerchain_entry* dogecoin_headerchain_at_height(const dogecoin_headerchain* hc, uint32_t height);
+LIBDOGECOIN_API dogecoin_headerchain_entry* dogecoin_headerchain_tip(const dogecoin_headerchain* hc);
+/* Returns whether the entry is part of the best chain. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_headerchain_is_best(const dogecoin_headerchain* hc, const dogecoin_headerchain_entry* entry);
+/* Fills blocklocators with uint256* hashes of the best chain for a getheaders message. */
+LIBDOGECOIN_API void dogecoin_headerchain_locator(const dogecoin_headerchain* hc, vector* blocklocators);
+
+/* Accessors for the stored header. */
+LIBDOGECOIN_API const uint8_t* dogecoin_headerchain_entry_hash(const dogecoin_headerchain_entry* entry);
+LIBDOGECOIN_API void dogecoin_headerchain_entry_header(const dogecoin_headerchain_entry* entry, dogecoin_block_header* header);
+LIBDOGECOIN_API uint32_t dogecoin_headerchain_entry_time(const dogecoin_headerchain_entry* entry);
+LIBDOGECOIN_API uint32_t dogecoin_headerchain_entry_bits(const dogecoin_headerchain_entry* entry);
+
+LIBDOGECOIN_END_DECL
+
+#endif // __LIBDOGECOIN_HEADERCHAIN_H__
@@ -51,6 +51,49 @@ typedef struct dogecoin_mem_mapper {
 LIBDOGECOIN_API void dogecoin_mem_set_mapper(const dogecoin_mem_mapper mapper);
 LIBDOGECOIN_API void dogecoin_mem_set_mapper_default();
 
+/* allocation instrumentation (heap profiling) */
+#define DOGECOIN_MEM_SIZE_CLASSES 20 /* power-of-two buckets: <=16, <=32, ..., <=4MB, larger */
+#define DOGECOIN_MEM_MAX_SITES 64    /* distinct call-site tags tracked, slot 0 is "untagged" */
+
+/**
+ * Per call-site counters, keyed by the tag set with dogecoin_mem_set_tag().
+ */
+typedef struct dogecoin_mem_site_stats {
+    const char* tag;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+} dogecoin_mem_site_stats;
+
+/**
+ * A point-in-time copy of the allocator statistics.
+ */
+typedef struct dogecoin_mem_stats {
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+    uint64_t live_allocs;
+    uint64_t total_allocs;
+    uint64_t total_reallocs;
+    uint64_t total_frees;
+    uint64_t size_classes[DOGECOIN_MEM_SIZE_CLASSES];
+    size_t site_count;
+    dogecoin_mem_site_stats sites[DOGECOIN_MEM_MAX_SITES];
+} dogecoin_mem_stats;
+
+// wraps the current mapper with an instrumented one that tracks live/peak bytes,
+// a size-class histogram and per-tag counters; the uninstrumented path stays untouched.
+// like dogecoin_mem_set_mapper() it must be installed before any allocation and the
+// mapper must not be switched while blocks allocated through it are still alive
+LIBDOGECOIN_API void dogecoin_mem_set_mapper_instrumented();
+LIBDOGECOIN_API dogecoin_bool dogecoin_mem_instrumented();
+// sets the (thread local) call-site tag attributed to following allocations, returns the previous one
+// tags must be string literals or otherwise outlive the statistics
+LIBDOGECOIN_API const char* dogecoin_mem_set_tag(const char* tag);
+LIBDOGECOIN_API void dogecoin_mem_stats_snapshot(dogecoin_mem_stats* stats);
+LIBDOGECOIN_API void dogecoin_mem_stats_reset();
+LIBDOGECOIN_API void dogecoin_mem_stats_print(FILE* stream, const dogecoin_mem_stats* stats);
+
 LIBDOGECOIN_API void* dogecoin_malloc(size_t size);
 LIBDOGECOIN_API void* dogecoin_calloc(size_t count, size_t size);
 LIBDOGECOIN_API void* dogecoin_realloc(void* ptr, size_t size);
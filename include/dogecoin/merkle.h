@@ -0,0 +1,61 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef __LIBDOGECOIN_MERKLE_H__
+#define __LIBDOGECOIN_MERKLE_H__
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#include <dogecoin/cstr.h>
+
+/* deepest tree a branch is generated for, 2^32 leaves */
+#define DOGECOIN_MERKLE_MAX_DEPTH 32
+/* most leaves of a partial tree, no 1MB block holds more 60 byte transactions */
+#define DOGECOIN_MERKLE_MAX_PARTIAL_LEAVES (1000000 / 60)
+
+/* Computes the merkle root of count leaves (e.g. txids), mutated (may be NULL) is set if two identical
+ * nodes were paired, which makes another leaf list with the same root (CVE-2012-2459). */
+LIBDOGECOIN_API dogecoin_bool dogecoin_merkle_root(const uint256* leaves, size_t count, uint256 root, dogecoin_bool* mutated);
+/* Fills branch with the siblings proving leaf index, returns the branch length. */
+LIBDOGECOIN_API size_t dogecoin_merkle_branch(const uint256* leaves, size_t count, uint32_t index, uint256 branch[DOGECOIN_MERKLE_MAX_DEPTH]);
+/* Folds a leaf with its branch into the root, a negative index gives a zero root. */
+LIBDOGECOIN_API void dogecoin_merkle_root_from_branch(const uint256 leaf, const uint256* branch, size_t len, int64_t index, uint256 root);
+/* Checks that a branch proves leaf at index under root. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_merkle_verify_branch(const uint256 leaf, const uint256* branch, size_t len, uint32_t index, const uint256 root);
+
+/* Builds the BIP37 partial merkle tree proving the leaves flagged in match: hashes receives the
+ * 32 byte node hashes, flags the bits walking the tree depth first, least significant bit first. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_merkle_partial_build(const uint256* leaves, size_t count, const dogecoin_bool* match, cstring* hashes, cstring* flags);
+/* Checks a BIP37 partial merkle tree over total leaves and computes its root. matches and indexes
+ * (both may be NULL) need room for hash_count entries, match_count is set to the matched leaves. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_merkle_partial_extract(uint32_t total, const unsigned char* hashes, size_t hash_count, const unsigned char* flags, size_t flag_bytes, uint256 root, uint256* matches, uint32_t* indexes, size_t* match_count);
+
+LIBDOGECOIN_END_DECL
+
+#endif // __LIBDOGECOIN_MERKLE_H__
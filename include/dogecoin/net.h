@@ -31,6 +31,9 @@
 
 #include <stdarg.h>
 
+#include <dogecoin/addrman.h>
+#include <dogecoin/blockfilter.h>
+#include <dogecoin/bloom.h>
 #include <dogecoin/dogecoin.h>
 #include <dogecoin/protocol.h>
 #include <dogecoin/tx.h>
@@ -51,8 +54,65 @@ enum NODE_STATE {
     NODE_DISCONNECTED_FROM_REMOTE_PEER = (1 << 8),
 };
 
+#define DOGECOIN_NODE_MAX_HANDLERS 64 /* slots in a group's command dispatch table, a power of two */
+
+#define DOGECOIN_NODE_MAX_CMD_STATS 32 /* commands counted separately per node, others only add to the totals */
+
+/* traffic of one command, bytes include the message header */
+typedef struct dogecoin_node_cmd_stats_ {
+    char command[12];
+    uint64_t msgs_in;
+    uint64_t bytes_in;
+    uint64_t msgs_out;
+    uint64_t bytes_out;
+} dogecoin_node_cmd_stats;
+
+/* see dogecoin_node_get_stats */
+typedef struct dogecoin_node_stats_ {
+    int nodeid;
+    uint32_t state;
+    uint64_t handshake_ms; /* from connecting to the verack */
+    uint64_t ping_ms;      /* round trip of the last answered ping */
+    uint64_t ping_min_ms;
+    uint64_t pongs;        /* answered pings, ping_ms and ping_min_ms are meaningless without */
+    uint64_t msgs_in;
+    uint64_t bytes_in;
+    uint64_t msgs_out;
+    uint64_t bytes_out;
+    size_t send_queue; /* bytes waiting to be written to the socket */
+    size_t recv_queue; /* bytes read from the socket but not parsed yet */
+    size_t cmd_count;
+    dogecoin_node_cmd_stats cmds[DOGECOIN_NODE_MAX_CMD_STATS];
+} dogecoin_node_stats;
+
+/* see dogecoin_node_group_get_stats, traffic sums include disconnected nodes */
+typedef struct dogecoin_node_group_stats_ {
+    int connected;
+    int connecting;
+    uint64_t ping_avg_ms; /* over the connected nodes that answered a ping */
+    uint64_t msgs_in;
+    uint64_t bytes_in;
+    uint64_t msgs_out;
+    uint64_t bytes_out;
+    size_t send_queue;
+    size_t recv_queue;
+    size_t worker_queue; /* messages waiting for the workers of a threaded group */
+} dogecoin_node_group_stats;
+
 /* basic group-of-nodes structure */
 struct dogecoin_node_;
+struct dogecoin_node_group_;
+
+/* handles the payload of one command, returning false marks the peer as misbehaving */
+typedef dogecoin_bool (*dogecoin_node_msg_handler)(struct dogecoin_node_* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf);
+
+/* the 12 byte command as integers, an all zero command marks a free slot */
+typedef struct dogecoin_node_msg_handler_entry_ {
+    uint64_t cmd_lo;
+    uint32_t cmd_hi;
+    dogecoin_node_msg_handler handler;
+} dogecoin_node_msg_handler_entry;
+
 typedef struct dogecoin_node_group_ {
     void* ctx; /* flexible context usefull in conjunction with the callbacks */
     struct event_base* event_base;
@@ -60,6 +120,18 @@ typedef struct dogecoin_node_group_ {
     char clientstr[1024];
     int desired_amount_connected_nodes;
     const dogecoin_chainparams* chainparams;
+    dogecoin_bloom* bloom_filter; /* loaded into every peer after the handshake (not owned), NULL for none */
+    dogecoin_bool trust_local_peers; /* skip payload checksums for loopback peers */
+    dogecoin_node_msg_handler_entry handlers[DOGECOIN_NODE_MAX_HANDLERS]; /* see dogecoin_node_group_register_handler */
+    struct dogecoin_node_threads_* threads; /* see dogecoin_node_group_set_threads, NULL runs everything on event_base */
+    dogecoin_addrman* addrman; /* learns from addr messages and connection results and picks the seed peers (not owned), NULL for none */
+    const char* dns_nameserver; /* "ip[:port]" asked for the dns seeds instead of the system's resolvers, NULL for those */
+    struct dogecoin_dns_seeding_* seeding; /* see dogecoin_node_group_seed_async */
+    unsigned int stats_interval_s; /* report the group's stats this often from the nodes' timers, 0 never */
+    uint64_t stats_last_time;
+    size_t send_limit;          /* bytes a node may have queued for sending, dogecoin_node_send drops messages beyond */
+    size_t send_high_watermark; /* a node's sending pauses once this many bytes are queued... */
+    size_t send_low_watermark;  /* ...and resumes below this many, bulk messages enter the socket's buffer only below it */
 
     /* callbacks */
     int (*log_write_cb)(const char* format, ...); /* log callback, default=printf */
@@ -69,6 +141,17 @@ typedef struct dogecoin_node_group_ {
     dogecoin_bool (*should_connect_to_more_nodes_cb)(struct dogecoin_node_* node);
     void (*handshake_done_cb)(struct dogecoin_node_* node);
     dogecoin_bool (*periodic_timer_cb)(struct dogecoin_node_* node, uint64_t* time); // return false will cancle the internal logic
+    /* a merkleblock whose partial merkle tree matches its header, matches are the txids proven by it */
+    void (*merkleblock_cb)(struct dogecoin_node_* node, const dogecoin_merkleblock* merkleblock, const uint256* matches, size_t match_count);
+    /* serving compact filters: add the filters of the requested range to filters_out (dogecoin_blockfilter*),
+     * returning false rejects the request. Setting it advertises DOGECOIN_NODE_COMPACT_FILTERS. */
+    dogecoin_bool (*getcfilters_cb)(struct dogecoin_node_* node, uint8_t filter_type, uint32_t start_height, const uint256 stop_hash, vector* filters_out);
+    /* a cfilter received in response to dogecoin_node_send_getcfilters */
+    void (*cfilter_cb)(struct dogecoin_node_* node, const dogecoin_blockfilter* filter);
+    /* a paused node drained its send queue below the low watermark and takes more messages */
+    void (*send_resumed_cb)(struct dogecoin_node_* node);
+    /* every stats_interval_s, NULL writes a summary to the log instead */
+    void (*stats_cb)(struct dogecoin_node_group_* group, const dogecoin_node_group_stats* stats);
 } dogecoin_node_group;
 
 enum {
@@ -81,24 +164,33 @@ enum {
 
 /* basic node structure */
 typedef struct dogecoin_node_ {
-    struct sockaddr addr;
+    struct sockaddr_storage addr; /* ipv4 or ipv6 */
     struct bufferevent* event_bev;
     struct event* timer_event;
     dogecoin_node_group* nodegroup;
     int nodeid;
     uint64_t lastping;
+    uint64_t ping_nonce;
+    uint64_t ping_sent_ms; /* 0 once the pong arrived */
     uint64_t time_started_con;
+    uint64_t time_started_con_ms;
     uint64_t time_last_request;
     uint256 last_requested_inv;
 
-    cstring* recvBuffer;
+    cstring* recvBuffer; /* reused for messages that span several evbuffer chains */
     uint64_t nonce;
     uint64_t services;
-    uint32_t state;
+    uint32_t state; /* written under the group lock and the shard's lock in threaded groups */
+    uint32_t generation; /* counts the connection attempts, guarded like state */
     int missbehavescore;
     dogecoin_bool version_handshake;
 
     unsigned int bestknownheight;
+    dogecoin_bloom* peer_filter; /* filter the peer loaded with filterload, NULL if none */
+    struct dogecoin_node_shard_* shard; /* event-base thread serving the node in threaded groups, NULL otherwise */
+    dogecoin_node_stats stats; /* guarded by the shard's lock in threaded groups, see dogecoin_node_get_stats */
+    struct evbuffer* send_bulk; /* whole messages waiting behind control messages, guarded like stats */
+    dogecoin_bool send_paused;  /* see dogecoin_node_send_paused */
 
     uint32_t hints; /* can be use for user defined state */
 } dogecoin_node;
@@ -123,6 +215,12 @@ LIBDOGECOIN_API void dogecoin_node_disconnect(dogecoin_node* node);
 /* mark a node missbehave and disconnect */
 LIBDOGECOIN_API dogecoin_bool dogecoin_node_misbehave(dogecoin_node* node);
 
+/* send a ping whose pong measures the round trip */
+LIBDOGECOIN_API void dogecoin_node_send_ping(dogecoin_node* node);
+
+/* consistent snapshots of a node's or all of a group's counters, callable from any thread */
+LIBDOGECOIN_API void dogecoin_node_get_stats(dogecoin_node* node, dogecoin_node_stats* stats_out);
+
 /* =================================== */
 /* NODE GROUPS */
 /* =================================== */
@@ -133,10 +231,24 @@ LIBDOGECOIN_API void dogecoin_node_group_free(dogecoin_node_group* group);
 
 /* disconnect all peers */
 LIBDOGECOIN_API void dogecoin_node_group_shutdown(dogecoin_node_group* group);
+/* let disconnected and errored (not misbehaving) peers be connected again, the group's loop must not run */
+LIBDOGECOIN_API void dogecoin_node_group_rearm_nodes(dogecoin_node_group* group);
 
 /* add a node to a node group */
 LIBDOGECOIN_API void dogecoin_node_group_add_node(dogecoin_node_group* group, dogecoin_node* node);
 
+/* spread the group's connections over shards event-base threads and process their messages
+ * (checksums, handlers, callbacks) on workers threads, or on the shard threads with 0 workers.
+ * must be called before any node connects. callbacks then run concurrently for different nodes
+ * while each node's messages stay in order; dogecoin_node_send, dogecoin_node_disconnect and
+ * dogecoin_node_misbehave may be called from any thread */
+LIBDOGECOIN_API dogecoin_bool dogecoin_node_group_set_threads(dogecoin_node_group* group, size_t shards, size_t workers);
+
+/* route a command (at most 12 chars) to handler, replacing any previous one including the built-in
+ * handlers, NULL leaves the command unhandled. returns false if the command is invalid or the table is full */
+LIBDOGECOIN_API dogecoin_bool dogecoin_node_group_register_handler(dogecoin_node_group* group, const char* command, dogecoin_node_msg_handler handler);
+LIBDOGECOIN_API dogecoin_node_msg_handler dogecoin_node_group_get_handler(const dogecoin_node_group* group, const char command[12]);
+
 /* start node groups event loop */
 LIBDOGECOIN_API void dogecoin_node_group_event_loop(dogecoin_node_group* group);
 
@@ -146,11 +258,33 @@ LIBDOGECOIN_API dogecoin_bool dogecoin_node_group_connect_next_nodes(dogecoin_no
 /* get the amount of connected nodes */
 LIBDOGECOIN_API int dogecoin_node_group_amount_of_connected_nodes(dogecoin_node_group* group, enum NODE_STATE state);
 
+LIBDOGECOIN_API void dogecoin_node_group_get_stats(dogecoin_node_group* group, dogecoin_node_group_stats* stats_out);
+
 /* sends version command to node */
 LIBDOGECOIN_API void dogecoin_node_send_version(dogecoin_node* node);
 
-/* send arbitrary data to node */
-LIBDOGECOIN_API void dogecoin_node_send(dogecoin_node* node, cstring* data);
+/* send a complete message to node. control messages (version, verack, ping, pong, inv, getdata, notfound,
+ * getaddr, getheaders) overtake queued bulk data. returns false if the node isn't connected or its send
+ * queue is full */
+LIBDOGECOIN_API dogecoin_bool dogecoin_node_send(dogecoin_node* node, cstring* data);
+/* finish a message serialized through a dogecoin_p2p_msg_writer and send it like dogecoin_node_send */
+LIBDOGECOIN_API dogecoin_bool dogecoin_node_send_message(dogecoin_node* node, dogecoin_p2p_msg_writer* mw, const char* command);
+
+/* whether the node's send queue passed the group's high watermark, producers should hold back
+ * bulk messages until send_resumed_cb */
+LIBDOGECOIN_API dogecoin_bool dogecoin_node_send_paused(dogecoin_node* node);
+
+/* BIP37: load a filter into the peer, add an element to it or remove it */
+LIBDOGECOIN_API void dogecoin_node_send_filterload(dogecoin_node* node, const dogecoin_bloom* filter);
+LIBDOGECOIN_API void dogecoin_node_send_filteradd(dogecoin_node* node, const unsigned char* data, size_t len);
+LIBDOGECOIN_API void dogecoin_node_send_filterclear(dogecoin_node* node);
+
+/* BIP157: request the basic filters from start_height up to the block stop_hash */
+LIBDOGECOIN_API void dogecoin_node_send_getcfilters(dogecoin_node* node, uint32_t start_height, const uint256 stop_hash);
+LIBDOGECOIN_API void dogecoin_node_send_cfilter(dogecoin_node* node, const dogecoin_blockfilter* filter);
+
+/* insert an element into the groups filter and send it to all peers which finished the handshake */
+LIBDOGECOIN_API dogecoin_bool dogecoin_node_group_filteradd(dogecoin_node_group* group, const unsigned char* data, size_t len);
 
 LIBDOGECOIN_API int dogecoin_node_parse_message(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf);
 LIBDOGECOIN_API void dogecoin_node_connection_state_changed(dogecoin_node* node);
@@ -159,11 +293,18 @@ LIBDOGECOIN_API void dogecoin_node_connection_state_changed(dogecoin_node* node)
 /* DNS */
 /* =================================== */
 
+/* add comma separated ips, or without ips the group's best known addresses and, if there are too few of them, the dns seed's */
 LIBDOGECOIN_API dogecoin_bool dogecoin_node_group_add_peers_by_ip_or_seed(dogecoin_node_group *group, const char *ips);
+/* add nodes for the best addresses of the group's addrman, returns how many were added */
+LIBDOGECOIN_API size_t dogecoin_node_group_add_peers_from_addrman(dogecoin_node_group *group);
 LIBDOGECOIN_API size_t dogecoin_get_peers_from_dns(const char* seed, vector* ips_out, int port, int family);
+/* query all dns seeds of the chain for ipv4 and ipv6 addresses at once from the group's event loop,
+ * answers are added (and connected to) as they arrive and queries give up after timeout_s seconds */
+LIBDOGECOIN_API dogecoin_bool dogecoin_node_group_seed_async(dogecoin_node_group* group, unsigned int timeout_s);
 
 struct broadcast_ctx {
     const dogecoin_tx* tx;
+    uint256 txhash;
     unsigned int timeout;
     int debuglevel;
     int connected_to_peers;
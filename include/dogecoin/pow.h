@@ -0,0 +1,91 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef __LIBDOGECOIN_POW_H__
+#define __LIBDOGECOIN_POW_H__
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#include <dogecoin/block.h>
+#include <dogecoin/chainparams.h>
+
+/* timestamps the median time past is taken over */
+#define DOGECOIN_POW_MEDIAN_TIME_SPAN 11
+/* timestamps kept by a validation context, the pre-digishield retarget looks back 240 headers */
+#define DOGECOIN_POW_TIME_WINDOW 241
+
+/* what the header following the last validated one depends on, advanced header by header */
+typedef struct dogecoin_pow_context_ {
+    const dogecoin_chainparams* chain;
+    uint256 hash;         /* hash of the last header */
+    uint32_t height;      /* height of the last header */
+    uint32_t bits;        /* bits of the last header */
+    uint32_t normal_bits; /* bits of the last header not using the testnet minimum difficulty */
+    uint32_t times[DOGECOIN_POW_TIME_WINDOW]; /* ring of the latest timestamps */
+    uint32_t time_pos;    /* slot of the last header's timestamp */
+    uint32_t time_count;  /* known timestamps, at most the window */
+    int64_t max_time;     /* headers newer than this are rejected, 0 disables the check */
+} dogecoin_pow_context;
+
+/* Expands compact bits into a little endian 256 bit target, fails on negative, zero or overflowing targets. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_pow_compact_to_target(uint32_t bits, uint256 target);
+/* Computes the expected work of a block, 2^256 / (target + 1), as a little endian 256 bit number. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_pow_block_work(uint32_t bits, uint256 work);
+/* Adds b to the little endian 256 bit accumulator a. */
+LIBDOGECOIN_API void dogecoin_pow_work_add(uint256 a, const uint256 b);
+/* Compares two little endian 256 bit numbers, returns -1, 0 or 1. */
+LIBDOGECOIN_API int dogecoin_pow_work_cmp(const uint256 a, const uint256 b);
+/* Checks a proof of work hash against the compact target and the chain's limit. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_pow_check(const uint256 hash, uint32_t bits, const dogecoin_chainparams* chain);
+/* Computes the scrypt proof of work hash of a header. */
+LIBDOGECOIN_API void dogecoin_block_header_pow_hash(const dogecoin_block_header* header, uint256 hash);
+/* Checks the proof of work of a header, for merge mined blocks pass the auxpow parent header as pow_header. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_header_check_pow(const dogecoin_block_header* header, const dogecoin_block_header* pow_header, const dogecoin_chainparams* chain);
+/* Checks count proof of work headers against their bits with the batched scrypt, valid_out may be NULL. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_block_headers_check_pow(const dogecoin_block_header* const* pow_headers, const uint32_t* bits, size_t count, const dogecoin_chainparams* chain, dogecoin_bool* valid_out);
+/* Converts a little endian target into compact bits. */
+LIBDOGECOIN_API uint32_t dogecoin_pow_target_to_compact(const uint256 target);
+/* Retargets the last bits for the observed timespan, with the digishield rules from the chain's digishield height on. */
+LIBDOGECOIN_API uint32_t dogecoin_pow_calculate_next_bits(uint32_t last_bits, uint32_t next_height, int64_t actual_timespan, const dogecoin_chainparams* chain);
+
+/* Starts an empty context, feed it the ancestors oldest first with dogecoin_pow_context_add. */
+LIBDOGECOIN_API void dogecoin_pow_context_init(dogecoin_pow_context* ctx, const dogecoin_chainparams* chain);
+/* Makes a header the last one of the context. */
+LIBDOGECOIN_API void dogecoin_pow_context_add(dogecoin_pow_context* ctx, const uint256 hash, uint32_t height, uint32_t bits, uint32_t time);
+LIBDOGECOIN_API uint32_t dogecoin_pow_context_median_time_past(const dogecoin_pow_context* ctx);
+/* Computes the bits required for the next header, fails if the context lacks the history (or the chain doesn't retarget). */
+LIBDOGECOIN_API dogecoin_bool dogecoin_pow_context_next_bits(const dogecoin_pow_context* ctx, uint32_t time, uint32_t* bits_out);
+/* Checks a header following the context: parent, median time past, difficulty and checkpoints, but not its proof of work. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_pow_context_check(const dogecoin_pow_context* ctx, const dogecoin_block_header* header, const uint256 hash);
+/* Validates up to count consecutive headers including their proof of work (pow_headers may be NULL, or hold
+ * the auxpow parent header per merge mined header), advances the context and returns the number of valid headers. */
+LIBDOGECOIN_API size_t dogecoin_pow_context_connect_headers(dogecoin_pow_context* ctx, const dogecoin_block_header* headers, const dogecoin_block_header* const* pow_headers, size_t count);
+
+LIBDOGECOIN_END_DECL
+
+#endif // __LIBDOGECOIN_POW_H__
@@ -32,6 +32,7 @@
 #include <dogecoin/buffer.h>
 #include <dogecoin/cstr.h>
 #include <dogecoin/dogecoin.h>
+#include <dogecoin/serialize.h>
 #include <dogecoin/vector.h>
 
 LIBDOGECOIN_BEGIN_DECL
@@ -52,6 +53,8 @@ static const unsigned int DOGECOIN_MAX_P2P_MSG_SIZE = 0x003D0900; // 4 * 1000 *
 
 static const unsigned int DOGECOIN_P2P_HDRSZ = 24; //(4 + 12 + 4 + 4)  magic, command, length, checksum
 
+static const unsigned int DOGECOIN_MAX_INV_SZ = 50000; // most items in one INV, GETDATA or NOTFOUND
+
 DISABLE_WARNING_PUSH
 DISABLE_WARNING(-Wunused-variable)
 static uint256 NULLHASH = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
@@ -81,13 +84,22 @@ static const char* DOGECOIN_MSG_VERSION = "version";
 static const char* DOGECOIN_MSG_VERACK = "verack";
 static const char* DOGECOIN_MSG_PING = "ping";
 static const char* DOGECOIN_MSG_PONG = "pong";
+static const char* DOGECOIN_MSG_ADDR = "addr";
+static const char* DOGECOIN_MSG_GETADDR = "getaddr";
 static const char* DOGECOIN_MSG_GETDATA = "getdata";
+static const char* DOGECOIN_MSG_NOTFOUND = "notfound";
 static const char* DOGECOIN_MSG_GETHEADERS = "getheaders";
 static const char* DOGECOIN_MSG_HEADERS = "headers";
 static const char* DOGECOIN_MSG_GETBLOCKS = "getblocks";
 static const char* DOGECOIN_MSG_BLOCK = "block";
 static const char* DOGECOIN_MSG_INV = "inv";
 static const char* DOGECOIN_MSG_TX = "tx";
+static const char* DOGECOIN_MSG_FILTERLOAD = "filterload";
+static const char* DOGECOIN_MSG_FILTERADD = "filteradd";
+static const char* DOGECOIN_MSG_FILTERCLEAR = "filterclear";
+static const char* DOGECOIN_MSG_MERKLEBLOCK = "merkleblock";
+static const char* DOGECOIN_MSG_GETCFILTERS = "getcfilters";
+static const char* DOGECOIN_MSG_CFILTER = "cfilter";
 DISABLE_WARNING_POP
 
 enum DOGECOIN_INV_TYPE {
@@ -99,6 +111,7 @@ enum DOGECOIN_INV_TYPE {
 };
 
 static const unsigned int MAX_HEADERS_RESULTS = 2000;
+static const unsigned int MAX_GETCFILTERS_SIZE = 1000;
 static const int DOGECOIN_PROTOCOL_VERSION = 70015;
 
 typedef struct dogecoin_p2p_msg_hdr_ {
@@ -157,6 +170,7 @@ LIBDOGECOIN_API void dogecoin_p2p_msg_version_init(dogecoin_p2p_version_msg* msg
 
 /* serialize a p2p "version" message to an existing cstring */
 LIBDOGECOIN_API void dogecoin_p2p_msg_version_ser(dogecoin_p2p_version_msg* msg, cstring* buf);
+LIBDOGECOIN_API void dogecoin_p2p_msg_version_ser_writer(dogecoin_p2p_version_msg* msg, ser_writer* w);
 
 /* deserialize a p2p "version" message */
 LIBDOGECOIN_API dogecoin_bool dogecoin_p2p_msg_version_deser(dogecoin_p2p_version_msg* msg, struct const_buffer* buf);
@@ -170,6 +184,7 @@ LIBDOGECOIN_API void dogecoin_p2p_msg_inv_init(dogecoin_p2p_inv_msg* msg, uint32
 
 /* serialize a p2p "inv" message to an existing cstring */
 LIBDOGECOIN_API void dogecoin_p2p_msg_inv_ser(dogecoin_p2p_inv_msg* msg, cstring* buf);
+LIBDOGECOIN_API void dogecoin_p2p_msg_inv_ser_writer(dogecoin_p2p_inv_msg* msg, ser_writer* w);
 
 /* deserialize a p2p "inv" message-element */
 LIBDOGECOIN_API dogecoin_bool dogecoin_p2p_msg_inv_deser(dogecoin_p2p_inv_msg* msg, struct const_buffer* buf);
@@ -190,6 +205,7 @@ LIBDOGECOIN_API dogecoin_bool dogecoin_p2p_deser_addr(unsigned int protocol_vers
 
 /* serialize a p2p addr */
 LIBDOGECOIN_API void dogecoin_p2p_ser_addr(unsigned int protover, const dogecoin_p2p_address* addr, cstring* str_out);
+LIBDOGECOIN_API void dogecoin_p2p_ser_addr_writer(unsigned int protover, const dogecoin_p2p_address* addr, ser_writer* w);
 
 /* copy over a p2p addr to a sockaddr object */
 LIBDOGECOIN_API void dogecoin_p2paddr_to_addr(dogecoin_p2p_address* p2p_addr, struct sockaddr* addr_out);
@@ -205,6 +221,27 @@ LIBDOGECOIN_API void dogecoin_p2p_deser_msghdr(dogecoin_p2p_msg_hdr* hdr, struct
 /* dogecoin_p2p_message_new does malloc a cstring, needs cleanup afterwards! */
 LIBDOGECOIN_API cstring* dogecoin_p2p_message_new(const unsigned char netmagic[4], const char* command, const void* data, uint32_t data_len);
 
+/* writes the DOGECOIN_P2P_HDRSZ byte header for a payload with the given (double sha256) hash */
+LIBDOGECOIN_API void dogecoin_p2p_message_header(const unsigned char netmagic[4], const char* command, uint32_t data_len, const uint256 payload_hash, unsigned char* hdr_out);
+
+/* reserve a header in a writer, serialize the payload behind it, then let
+ * dogecoin_p2p_message_finish fill in length and checksum without copying the payload */
+LIBDOGECOIN_API dogecoin_bool dogecoin_p2p_message_begin(ser_writer* w, ser_writer_pos* hdr_pos);
+LIBDOGECOIN_API dogecoin_bool dogecoin_p2p_message_finish(ser_writer* w, const ser_writer_pos* hdr_pos, const unsigned char netmagic[4], const char* command);
+
+/* a complete p2p message serialized into one cstring, the payload is written
+ * through w right behind the reserved header */
+typedef struct dogecoin_p2p_msg_writer_ {
+    cstring* msg;
+    ser_writer w;
+    ser_writer_pos hdr_pos;
+} dogecoin_p2p_msg_writer;
+
+/* dogecoin_p2p_msg_writer_finish returns the message (to be freed with cstr_free) or NULL
+ * if the payload didn't fit into payload_len */
+LIBDOGECOIN_API void dogecoin_p2p_msg_writer_init(dogecoin_p2p_msg_writer* mw, size_t payload_len);
+LIBDOGECOIN_API cstring* dogecoin_p2p_msg_writer_finish(dogecoin_p2p_msg_writer* mw, const unsigned char netmagic[4], const char* command);
+
 
 /* =================================== */
 /* GETHEADER MESSAGE */
@@ -212,10 +249,21 @@ LIBDOGECOIN_API cstring* dogecoin_p2p_message_new(const unsigned char netmagic[4
 
 /* creates a getheader message */
 LIBDOGECOIN_API void dogecoin_p2p_msg_getheaders(vector* blocklocators, uint256 hashstop, cstring* str_out);
+LIBDOGECOIN_API void dogecoin_p2p_msg_getheaders_writer(vector* blocklocators, uint256 hashstop, ser_writer* w);
 
 /* directly deserialize a getheaders message to blocklocators, hashstop */
 LIBDOGECOIN_API dogecoin_bool dogecoin_p2p_deser_msg_getheaders(vector* blocklocators, uint256 hashstop, struct const_buffer* buf);
 
+/* =================================== */
+/* GETCFILTERS MESSAGE */
+/* =================================== */
+
+/* creates a getcfilters message (BIP157) for the filters from start_height up to the block stop_hash */
+LIBDOGECOIN_API void dogecoin_p2p_msg_getcfilters(uint8_t filter_type, uint32_t start_height, const uint256 stop_hash, cstring* str_out);
+
+/* deserialize a getcfilters message */
+LIBDOGECOIN_API dogecoin_bool dogecoin_p2p_deser_msg_getcfilters(uint8_t* filter_type, uint32_t* start_height, uint256 stop_hash, struct const_buffer* buf);
+
 LIBDOGECOIN_END_DECL
 
 #endif // __LIBDOGECOIN_PROTOCOL_H__
@@ -42,6 +42,9 @@ typedef struct dogecoin_rnd_mapper_ {
 // this function is NOT thread safe and should be called before anything else
 LIBDOGECOIN_API void dogecoin_rnd_set_mapper(const dogecoin_rnd_mapper mapper);
 LIBDOGECOIN_API void dogecoin_rnd_set_mapper_default();
+// uses a per-thread ChaCha20 generator seeded (and periodically reseeded)
+// from the default source, for callers that need many random bytes
+LIBDOGECOIN_API void dogecoin_rnd_set_mapper_drbg();
 
 LIBDOGECOIN_API void dogecoin_random_init(void);
 LIBDOGECOIN_API dogecoin_bool dogecoin_random_bytes(uint8_t* buf, uint32_t len, const uint8_t update_seed);
@@ -210,6 +210,26 @@ typedef struct dogecoin_script_op_ {
     size_t datalen;
 } dogecoin_script_op;
 
+/* cursor walking the operations of a script in place */
+typedef struct dogecoin_script_iter_ {
+    const unsigned char* script;
+    size_t len;
+    size_t pos;         /* offset of the next operation */
+    dogecoin_bool error; /* set if the script ended inside an operation */
+} dogecoin_script_iter;
+
+/* result of matching a script against the standard templates, all
+ * pointers point into the classified script, nothing is allocated */
+typedef struct dogecoin_script_template_ {
+    enum dogecoin_tx_out_type type;
+    const unsigned char* data; /* hash160 (p2pkh, p2sh) or pubkey (p2pk) */
+    size_t datalen;
+    unsigned int required_sigs;                /* multisig: m */
+    unsigned int pubkey_count;                 /* multisig: number of pubkeys */
+    const unsigned char* pubkeys[16];          /* multisig: the pubkeys */
+    size_t pubkey_lens[16];
+} dogecoin_script_template;
+
 // Maximum script length in bytes
 static const int MAX_SCRIPT_SIZE = 10000;
 
@@ -221,8 +241,12 @@ LIBDOGECOIN_API void dogecoin_script_op_free(dogecoin_script_op* script_op);
 void dogecoin_script_op_free_cb(void* data);
 dogecoin_bool dogecoin_script_get_ops(const cstring* script_in, vector* ops_out);
 
+LIBDOGECOIN_API void dogecoin_script_iter_init(dogecoin_script_iter* iter, const unsigned char* script, size_t len);
+LIBDOGECOIN_API dogecoin_bool dogecoin_script_iter_next(dogecoin_script_iter* iter, enum opcodetype* op, const unsigned char** data, size_t* datalen);
+
 LIBDOGECOIN_API enum dogecoin_tx_out_type dogecoin_script_classify_ops(const vector* ops);
 LIBDOGECOIN_API enum dogecoin_tx_out_type dogecoin_script_classify(const cstring* script, vector* data_out);
+LIBDOGECOIN_API enum dogecoin_tx_out_type dogecoin_script_classify_buf(const unsigned char* script, size_t len, dogecoin_script_template* tmpl);
 
 LIBDOGECOIN_API enum opcodetype dogecoin_encode_op_n(const int n);
 LIBDOGECOIN_API void dogecoin_script_append_op(cstring* script_in, enum opcodetype op);
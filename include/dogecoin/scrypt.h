@@ -0,0 +1,46 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef __LIBDOGECOIN_SCRYPT_H__
+#define __LIBDOGECOIN_SCRYPT_H__
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#define DOGECOIN_SCRYPT_INPUT_LENGTH 80
+
+/* scrypt(N=1024, r=1, p=1) of an 80 byte header, the proof of work hash */
+LIBDOGECOIN_API void dogecoin_scrypt_1024_1_1_256(const uint8_t input[DOGECOIN_SCRYPT_INPUT_LENGTH], uint8_t output[32]);
+/* hashes count consecutive 80 byte inputs into count consecutive 32 byte outputs,
+ * several at a time using SSE2/AVX2 lanes where available */
+LIBDOGECOIN_API void dogecoin_scrypt_1024_1_1_256_batch(const uint8_t* inputs, size_t count, uint8_t* outputs);
+/* number of inputs hashed in parallel by the batch function on this cpu */
+LIBDOGECOIN_API unsigned int dogecoin_scrypt_lanes(void);
+
+LIBDOGECOIN_END_DECL
+
+#endif // __LIBDOGECOIN_SCRYPT_H__
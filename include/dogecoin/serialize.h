@@ -51,6 +51,53 @@ LIBDOGECOIN_API void ser_varstr(cstring* s, cstring* s_in);
 LIBDOGECOIN_API void ser_s32(cstring* s, int32_t v_);
 LIBDOGECOIN_API void ser_s64(cstring* s, int64_t v_);
 
+/* a single segment of a scatter-gather list */
+typedef struct dogecoin_iovec_ {
+    void* base;
+    size_t len;
+} dogecoin_iovec;
+
+/* a position inside a writer, used to fill reserved space later on */
+typedef struct ser_writer_pos_ {
+    size_t idx;
+    size_t off;
+} ser_writer_pos;
+
+/* serializes into caller provided memory, either one buffer or a list of
+ * segments, without any reallocation. A writer without segments only counts
+ * the bytes, which allows sizing a buffer before the actual serialization. */
+typedef struct ser_writer_ {
+    dogecoin_iovec* iov;
+    size_t iovcnt;
+    ser_writer_pos pos;    /* current write position */
+    size_t written;        /* bytes written (or counted) so far */
+    dogecoin_bool counting;
+    dogecoin_bool overflow; /* set once a write didn't fit, all following writes are ignored */
+    dogecoin_iovec single; /* backing segment for ser_writer_init_buf */
+} ser_writer;
+
+LIBDOGECOIN_API void ser_writer_init_buf(ser_writer* w, void* buf, size_t len);
+LIBDOGECOIN_API void ser_writer_init_iov(ser_writer* w, dogecoin_iovec* iov, size_t iovcnt);
+LIBDOGECOIN_API void ser_writer_init_counter(ser_writer* w);
+LIBDOGECOIN_API dogecoin_bool ser_writer_ok(const ser_writer* w);
+
+/* reserve then fill: skip len bytes now, write them once their content is known */
+LIBDOGECOIN_API dogecoin_bool ser_writer_reserve(ser_writer* w, size_t len, ser_writer_pos* pos_out);
+LIBDOGECOIN_API dogecoin_bool ser_writer_fill(ser_writer* w, const ser_writer_pos* pos, const void* p, size_t len);
+/* collects the segments written since pos (without copying), returns the number of segments */
+LIBDOGECOIN_API size_t ser_writer_segments(const ser_writer* w, const ser_writer_pos* pos, dogecoin_iovec* out, size_t outcnt);
+
+LIBDOGECOIN_API void ser_writer_bytes(ser_writer* w, const void* p, size_t len);
+LIBDOGECOIN_API void ser_writer_u16(ser_writer* w, uint16_t v_);
+LIBDOGECOIN_API void ser_writer_u32(ser_writer* w, uint32_t v_);
+LIBDOGECOIN_API void ser_writer_s32(ser_writer* w, int32_t v_);
+LIBDOGECOIN_API void ser_writer_u64(ser_writer* w, uint64_t v_);
+LIBDOGECOIN_API void ser_writer_s64(ser_writer* w, int64_t v_);
+LIBDOGECOIN_API void ser_writer_u256(ser_writer* w, const unsigned char* v_);
+LIBDOGECOIN_API void ser_writer_varlen(ser_writer* w, uint32_t vlen);
+LIBDOGECOIN_API void ser_writer_str(ser_writer* w, const char* s_in, size_t maxlen);
+LIBDOGECOIN_API void ser_writer_varstr(ser_writer* w, const cstring* s_in);
+
 LIBDOGECOIN_API int deser_skip(struct const_buffer* buf, size_t len);
 LIBDOGECOIN_API int deser_bytes(void* po, struct const_buffer* buf, size_t len);
 LIBDOGECOIN_API int deser_u16(uint16_t* vo, struct const_buffer* buf);
@@ -62,6 +62,8 @@ LIBDOGECOIN_API void sha256_init(sha256_context*);
 LIBDOGECOIN_API void sha256_write(sha256_context*, const uint8_t*, size_t);
 LIBDOGECOIN_API void sha256_finalize(sha256_context*, uint8_t[SHA256_DIGEST_LENGTH]);
 LIBDOGECOIN_API void sha256_raw(const uint8_t*, size_t, uint8_t[SHA256_DIGEST_LENGTH]);
+/* double SHA-256 of blocks consecutive 64 byte inputs (merkle nodes), several at a time */
+LIBDOGECOIN_API void sha256d64(uint8_t* out, const uint8_t* in, size_t blocks);
 
 LIBDOGECOIN_API void sha512_init(sha512_context*);
 LIBDOGECOIN_API void sha512_write(sha512_context*, const uint8_t*, size_t);
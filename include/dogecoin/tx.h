@@ -36,6 +36,7 @@
 #include <dogecoin/dogecoin.h>
 #include <dogecoin/hash.h>
 #include <dogecoin/script.h>
+#include <dogecoin/serialize.h>
 #include <dogecoin/vector.h>
 
 LIBDOGECOIN_BEGIN_DECL
@@ -51,10 +52,11 @@ typedef struct dogecoin_tx_outpoint_ {
     uint32_t n;
 } dogecoin_tx_outpoint;
 
+/* fixed size fields first, so an input packs into 48 bytes */
 typedef struct dogecoin_tx_in_ {
     dogecoin_tx_outpoint prevout;
-    cstring* script_sig;
     uint32_t sequence;
+    cstring* script_sig;
 } dogecoin_tx_in;
 
 typedef struct dogecoin_tx_out_ {
@@ -62,13 +64,33 @@ typedef struct dogecoin_tx_out_ {
     cstring* script_pubkey;
 } dogecoin_tx_out;
 
+/* vin/vout hold pointers to the inputs and outputs. Deserialized and copied
+ * transactions keep the elements themselves in the contiguous vin_arr/vout_arr
+ * arrays; elements added later with vector_add() are allocated individually.
+ * Removing an element through the vector frees what it owns, dogecoin_tx_free()
+ * releases both kinds. */
 typedef struct dogecoin_tx_ {
     int32_t version;
     vector* vin;
     vector* vout;
     uint32_t locktime;
+    dogecoin_tx_in* vin_arr;
+    size_t vin_arr_len;
+    dogecoin_tx_out* vout_arr;
+    size_t vout_arr_len;
 } dogecoin_tx;
 
+//!typed access to the inputs and outputs of a transaction
+LIBDOGECOIN_API static inline dogecoin_tx_in* dogecoin_tx_vin(const dogecoin_tx* tx, size_t idx)
+{
+    return (dogecoin_tx_in*)vector_idx(tx->vin, idx);
+}
+
+LIBDOGECOIN_API static inline dogecoin_tx_out* dogecoin_tx_vout(const dogecoin_tx* tx, size_t idx)
+{
+    return (dogecoin_tx_out*)vector_idx(tx->vout, idx);
+}
+
 //!p2pkh utilities
 LIBDOGECOIN_API int dogecoin_script_hash_to_p2pkh(dogecoin_tx_out* txout, char* p2pkh, int is_testnet);
 LIBDOGECOIN_API char* dogecoin_p2pkh_to_script_hash(char* p2pkh);
@@ -80,6 +102,7 @@ LIBDOGECOIN_API void dogecoin_tx_in_free(dogecoin_tx_in* tx_in);
 LIBDOGECOIN_API void dogecoin_tx_in_copy(dogecoin_tx_in* dest, const dogecoin_tx_in* src);
 LIBDOGECOIN_API dogecoin_bool dogecoin_tx_in_deserialize(dogecoin_tx_in* tx_in, struct const_buffer* buf);
 LIBDOGECOIN_API void dogecoin_tx_in_serialize(cstring* s, const dogecoin_tx_in* tx_in);
+LIBDOGECOIN_API void dogecoin_tx_in_serialize_writer(ser_writer* w, const dogecoin_tx_in* tx_in);
 
 //!create a new tx output
 LIBDOGECOIN_API dogecoin_tx_out* dogecoin_tx_out_new();
@@ -87,6 +110,7 @@ LIBDOGECOIN_API void dogecoin_tx_out_free(dogecoin_tx_out* tx_out);
 LIBDOGECOIN_API void dogecoin_tx_out_copy(dogecoin_tx_out* dest, const dogecoin_tx_out* src);
 LIBDOGECOIN_API dogecoin_bool dogecoin_tx_out_deserialize(dogecoin_tx_out* tx_out, struct const_buffer* buf);
 LIBDOGECOIN_API void dogecoin_tx_out_serialize(cstring* s, const dogecoin_tx_out* tx_out);
+LIBDOGECOIN_API void dogecoin_tx_out_serialize_writer(ser_writer* w, const dogecoin_tx_out* tx_out);
 
 //!create a new tx input
 LIBDOGECOIN_API dogecoin_tx* dogecoin_tx_new();
@@ -95,9 +119,13 @@ LIBDOGECOIN_API void dogecoin_tx_copy(dogecoin_tx* dest, const dogecoin_tx* src)
 
 //!deserialize/parse a p2p serialized dogecoin transaction
 LIBDOGECOIN_API int dogecoin_tx_deserialize(const unsigned char* tx_serialized, size_t inlen, dogecoin_tx* tx, size_t* consumed_length);
+//!advances the buffer past a serialized transaction without decoding it
+LIBDOGECOIN_API dogecoin_bool dogecoin_tx_skip(struct const_buffer* buf);
 
 //!serialize a dogecoin data structure into a p2p serialized buffer
 LIBDOGECOIN_API void dogecoin_tx_serialize(cstring* s, const dogecoin_tx* tx);
+LIBDOGECOIN_API void dogecoin_tx_serialize_writer(ser_writer* w, const dogecoin_tx* tx);
+LIBDOGECOIN_API size_t dogecoin_tx_serialized_size(const dogecoin_tx* tx);
 
 LIBDOGECOIN_API void dogecoin_tx_hash(const dogecoin_tx* tx, uint256 hashout);
 
@@ -0,0 +1,103 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef __LIBDOGECOIN_UTXO_H__
+#define __LIBDOGECOIN_UTXO_H__
+
+#include <dogecoin/dogecoin.h>
+
+LIBDOGECOIN_BEGIN_DECL
+
+#include <dogecoin/block.h>
+#include <dogecoin/blockfile.h>
+#include <dogecoin/chainparams.h>
+#include <dogecoin/cstr.h>
+
+/* outputs are sharded by the first byte of their txid */
+#define DOGECOIN_UTXO_SHARDS 64
+/* transactions collected before a batch is applied by the worker threads */
+#define DOGECOIN_UTXO_BATCH_TXS 8192
+
+/* a decoded unspent output */
+typedef struct dogecoin_utxo_ {
+    int64_t amount;
+    uint32_t height;
+    dogecoin_bool coinbase;
+    cstring* script; /* filled if not NULL */
+} dogecoin_utxo;
+
+typedef struct dogecoin_utxo_shard_ dogecoin_utxo_shard;
+typedef struct dogecoin_utxo_batch_ dogecoin_utxo_batch;
+
+/* outpoint -> compact output (Core's coin encoding: varint height and coinbase
+ * flag, varint compressed amount, compressed script) */
+typedef struct dogecoin_utxo_set_ {
+    const dogecoin_chainparams* chain;
+    unsigned int threads;
+    dogecoin_utxo_shard* shards;      /* DOGECOIN_UTXO_SHARDS */
+    dogecoin_utxo_batch* batch;       /* blocks added but not applied yet */
+    int64_t height;                   /* last block added, -1 for none */
+    uint256 hash;
+    dogecoin_bool failed;             /* a block spent a missing output */
+
+    /* loaded snapshot, records are used in place */
+    const uint8_t* map;
+    size_t map_len;
+} dogecoin_utxo_set;
+
+typedef dogecoin_bool (*dogecoin_utxo_set_cb)(const uint8_t* txid, uint32_t vout, const dogecoin_utxo* utxo, void* ctx);
+
+/* Creates an empty set applying blocks on the given number of threads (0 for one per online cpu). */
+LIBDOGECOIN_API dogecoin_utxo_set* dogecoin_utxo_set_new(const dogecoin_chainparams* chain, unsigned int threads);
+LIBDOGECOIN_API void dogecoin_utxo_set_free(dogecoin_utxo_set* set);
+/* Adds the next block of the best chain, blocks are applied in batches (see dogecoin_utxo_set_flush). */
+LIBDOGECOIN_API dogecoin_bool dogecoin_utxo_set_add_block(dogecoin_utxo_set* set, dogecoin_block_view* view, uint32_t height, const uint256 hash);
+/* Applies all pending blocks, returns 0 if a block spent an output which is not in the set. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_utxo_set_flush(dogecoin_utxo_set* set);
+/* dogecoin_blockfile_scan callback, ctx is the set. Blocks up to the height of the set are skipped. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_utxo_set_blockfile_cb(dogecoin_blockfile_block* block, void* ctx);
+
+/* Looks up an output, utxo may be NULL. The set must not be changed concurrently. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_utxo_set_get(dogecoin_utxo_set* set, const uint256 txid, uint32_t vout, dogecoin_utxo* utxo);
+/* Calls cb for every output until it returns 0, returns the number of outputs visited. */
+LIBDOGECOIN_API size_t dogecoin_utxo_set_foreach(dogecoin_utxo_set* set, dogecoin_utxo_set_cb cb, void* ctx);
+/* Counts the outputs and sums their amounts, the supply in koinu exceeds INT64_MAX. */
+LIBDOGECOIN_API size_t dogecoin_utxo_set_stats(dogecoin_utxo_set* set, uint64_t* total_amount);
+
+/* Writes a snapshot of the set (atomically replacing path) and maps an existing one into an empty set. */
+LIBDOGECOIN_API dogecoin_bool dogecoin_utxo_set_save(dogecoin_utxo_set* set, const char* path);
+LIBDOGECOIN_API dogecoin_bool dogecoin_utxo_set_load(dogecoin_utxo_set* set, const char* path);
+
+/* The compact output encoding, usable on its own. */
+LIBDOGECOIN_API uint64_t dogecoin_utxo_compress_amount(uint64_t amount);
+LIBDOGECOIN_API uint64_t dogecoin_utxo_decompress_amount(uint64_t x);
+LIBDOGECOIN_API void dogecoin_utxo_serialize(cstring* s, int64_t amount, uint32_t height, dogecoin_bool coinbase, const unsigned char* script, size_t script_len);
+LIBDOGECOIN_API dogecoin_bool dogecoin_utxo_deserialize(const unsigned char* data, size_t len, dogecoin_utxo* utxo);
+
+LIBDOGECOIN_END_DECL
+
+#endif // __LIBDOGECOIN_UTXO_H__
@@ -39,6 +39,9 @@ typedef struct vector {
     size_t alloc; /* allocated array elements */
 
     void (*elem_free_f)(void*);
+    /* used instead of elem_free_f when set, receives elem_free_ctx along with the element */
+    void (*elem_free_ctx_f)(void* ctx, void* elem);
+    void* elem_free_ctx;
 } vector;
 
 #define vector_idx(vec, idx) vec->data[idx]
@@ -0,0 +1,1063 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <dogecoin/addrindex.h>
+#include <dogecoin/base58.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/script.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/sha2.h>
+
+/*
+ * Every table is a list of immutable segment files, oldest first, plus
+ * the rows buffered since the last flush. A segment holds its rows
+ * sorted by (key, key_n, height, tx_pos, n), one column after the other:
+ *
+ *   header: magic, version, row count, bloom bits, bloom hashes
+ *   key[32] * rows, key_n[4] * rows, height[4] * rows, tx_pos[4] * rows,
+ *   txid[32] * rows, n[4] * rows, amount[8] * rows, bloom filter over (key, key_n)
+ *
+ * so a lookup checks the bloom filter and binary searches the key
+ * column only. After every flush the newest segments are merged while
+ * the last one is at least half the size of the one before, which keeps
+ * the number of segments logarithmic in the number of rows.
+ *
+ * The manifest names the segments of both tables and the last block
+ * whose rows they hold, it is replaced atomically after every change.
+ */
+
+#define ADDRINDEX_SEGMENT_MAGIC "DOGEAIDX"
+#define ADDRINDEX_MANIFEST_MAGIC "DOGEAIDM"
+#define ADDRINDEX_FILE_VERSION 2
+#define ADDRINDEX_SEGMENT_HEADER_SIZE 32
+#define ADDRINDEX_ROW_SIZE (DOGECOIN_HASH_LENGTH + 4 + 4 + 4 + DOGECOIN_HASH_LENGTH + 4 + 8)
+#define ADDRINDEX_BLOOM_HASHES 7
+#define ADDRINDEX_WRITE_BUFFER (1 << 16)
+#define ADDRINDEX_COLUMNS 7
+
+typedef struct addrindex_segment_ {
+    char prefix; /* 'f' for funding, 's' for spending segment files */
+    uint32_t id;
+    const uint8_t* map;
+    size_t map_len;
+    uint64_t rows;
+    uint64_t bloom_bits;
+    const uint8_t* columns[ADDRINDEX_COLUMNS];
+    const uint8_t* bloom;
+} addrindex_segment;
+
+struct dogecoin_addrindex_table_ {
+    char prefix;
+    addrindex_segment* segments;
+    size_t count;
+    dogecoin_addrindex_row* pending;
+    size_t pending_count;
+    size_t pending_alloc;
+    dogecoin_bool pending_sorted;
+};
+
+static const size_t addrindex_column_width[ADDRINDEX_COLUMNS] = {DOGECOIN_HASH_LENGTH, 4, 4, 4, DOGECOIN_HASH_LENGTH, 4, 8};
+
+static uint32_t addrindex_read_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void addrindex_write_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint64_t addrindex_read_u64(const uint8_t* p)
+{
+    return (uint64_t)addrindex_read_u32(p) | ((uint64_t)addrindex_read_u32(p + 4) << 32);
+}
+
+static void addrindex_write_u64(uint8_t* p, uint64_t v)
+{
+    addrindex_write_u32(p, (uint32_t)v);
+    addrindex_write_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+
+static int addrindex_row_cmp(const void* a_, const void* b_)
+{
+    const dogecoin_addrindex_row* a = a_;
+    const dogecoin_addrindex_row* b = b_;
+    int r = memcmp(a->key, b->key, DOGECOIN_HASH_LENGTH);
+    if (r)
+        return r;
+    if (a->key_n != b->key_n)
+        return a->key_n < b->key_n ? -1 : 1;
+    if (a->height != b->height)
+        return a->height < b->height ? -1 : 1;
+    if (a->tx_pos != b->tx_pos)
+        return a->tx_pos < b->tx_pos ? -1 : 1;
+    if (a->n != b->n)
+        return a->n < b->n ? -1 : 1;
+    return 0;
+}
+
+
+/* keys are hashes already, two of their words seed the double hashing */
+static void addrindex_bloom_seeds(const uint8_t* key, uint32_t key_n, uint64_t* h1, uint64_t* h2)
+{
+    *h1 = addrindex_read_u64(key) ^ ((uint64_t)key_n * 0x9e3779b97f4a7c15ULL);
+    *h2 = addrindex_read_u64(key + 8) | 1;
+}
+
+static void addrindex_bloom_add(uint8_t* bloom, uint64_t bits, const uint8_t* key, uint32_t key_n)
+{
+    uint64_t h1, h2;
+    int i;
+    addrindex_bloom_seeds(key, key_n, &h1, &h2);
+    for (i = 0; i < ADDRINDEX_BLOOM_HASHES; i++) {
+        uint64_t bit = (h1 + (uint64_t)i * h2) % bits;
+        bloom[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+    }
+}
+
+static dogecoin_bool addrindex_bloom_check(const addrindex_segment* seg, const uint8_t* key, uint32_t key_n)
+{
+    uint64_t h1, h2;
+    int i;
+    addrindex_bloom_seeds(key, key_n, &h1, &h2);
+    for (i = 0; i < ADDRINDEX_BLOOM_HASHES; i++) {
+        uint64_t bit = (h1 + (uint64_t)i * h2) % seg->bloom_bits;
+        if (!(seg->bloom[bit >> 3] & (1 << (bit & 7))))
+            return false;
+    }
+    return true;
+}
+
+
+static void addrindex_segment_row(const addrindex_segment* seg, uint64_t i, dogecoin_addrindex_row* row)
+{
+    memcpy(row->key, seg->columns[0] + i * DOGECOIN_HASH_LENGTH, DOGECOIN_HASH_LENGTH);
+    row->key_n = addrindex_read_u32(seg->columns[1] + i * 4);
+    row->height = addrindex_read_u32(seg->columns[2] + i * 4);
+    row->tx_pos = addrindex_read_u32(seg->columns[3] + i * 4);
+    memcpy(row->txid, seg->columns[4] + i * DOGECOIN_HASH_LENGTH, DOGECOIN_HASH_LENGTH);
+    row->n = addrindex_read_u32(seg->columns[5] + i * 4);
+    row->amount = (int64_t)addrindex_read_u64(seg->columns[6] + i * 8);
+}
+
+/* compares row i of a segment with a (key, key_n) pair */
+static int addrindex_segment_key_cmp(const addrindex_segment* seg, uint64_t i, const uint8_t* key, uint32_t key_n)
+{
+    int r = memcmp(seg->columns[0] + i * DOGECOIN_HASH_LENGTH, key, DOGECOIN_HASH_LENGTH);
+    uint32_t n;
+    if (r)
+        return r;
+    n = addrindex_read_u32(seg->columns[1] + i * 4);
+    return n == key_n ? 0 : (n < key_n ? -1 : 1);
+}
+
+
+static void addrindex_segment_path(const dogecoin_addrindex* idx, char prefix, uint32_t id, char* path, size_t len)
+{
+    snprintf(path, len, "%s/%c%08u.seg", idx->dir->str, prefix, (unsigned int)id);
+}
+
+
+static void addrindex_unmap(const uint8_t* map, size_t len)
+{
+    if (!map)
+        return;
+#ifdef WIN32
+    (void)len;
+    dogecoin_free((void*)map);
+#else
+    munmap((void*)map, len);
+#endif
+}
+
+
+/**
+ * @brief This function maps a segment file and locates its
+ * columns and bloom filter.
+ *
+ * @param path The path of the segment.
+ * @param seg The segment to fill.
+ *
+ * @return 1 if the segment is complete, 0 otherwise.
+ */
+static dogecoin_bool addrindex_segment_map(const char* path, addrindex_segment* seg)
+{
+    FILE* file = fopen(path, "rb");
+    uint64_t offset = ADDRINDEX_SEGMENT_HEADER_SIZE;
+    long size;
+    int c;
+
+    if (!file)
+        return false;
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < ADDRINDEX_SEGMENT_HEADER_SIZE) {
+        fclose(file);
+        return false;
+    }
+    seg->map_len = (size_t)size;
+#ifdef WIN32
+    /* no mmap, read the file instead */
+    seg->map = dogecoin_malloc(seg->map_len);
+    fseek(file, 0, SEEK_SET);
+    if (fread((void*)seg->map, 1, seg->map_len, file) != seg->map_len) {
+        fclose(file);
+        addrindex_unmap(seg->map, seg->map_len);
+        seg->map = NULL;
+        return false;
+    }
+#else
+    void* p = mmap(NULL, seg->map_len, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (p == MAP_FAILED) {
+        fclose(file);
+        return false;
+    }
+    seg->map = p;
+#endif
+    fclose(file);
+
+    seg->rows = addrindex_read_u64(seg->map + 12);
+    seg->bloom_bits = addrindex_read_u64(seg->map + 20);
+    if (memcmp(seg->map, ADDRINDEX_SEGMENT_MAGIC, 8) != 0 || addrindex_read_u32(seg->map + 8) != ADDRINDEX_FILE_VERSION || seg->bloom_bits == 0 ||
+        seg->rows > (seg->map_len - ADDRINDEX_SEGMENT_HEADER_SIZE) / ADDRINDEX_ROW_SIZE ||
+        seg->map_len != ADDRINDEX_SEGMENT_HEADER_SIZE + seg->rows * ADDRINDEX_ROW_SIZE + (seg->bloom_bits + 7) / 8) {
+        addrindex_unmap(seg->map, seg->map_len);
+        seg->map = NULL;
+        return false;
+    }
+    for (c = 0; c < ADDRINDEX_COLUMNS; c++) {
+        seg->columns[c] = seg->map + offset;
+        offset += seg->rows * addrindex_column_width[c];
+    }
+    seg->bloom = seg->map + offset;
+    return true;
+}
+
+
+/* a sorted source of rows for writing a segment: a segment or the buffered rows */
+typedef struct addrindex_cursor_ {
+    const addrindex_segment* seg;
+    const dogecoin_addrindex_row* rows;
+    uint64_t pos;
+    uint64_t count;
+    dogecoin_addrindex_row row;
+} addrindex_cursor;
+
+static dogecoin_bool addrindex_cursor_load(addrindex_cursor* cursor)
+{
+    if (cursor->pos >= cursor->count)
+        return false;
+    if (cursor->seg)
+        addrindex_segment_row(cursor->seg, cursor->pos, &cursor->row);
+    else
+        cursor->row = cursor->rows[cursor->pos];
+    return true;
+}
+
+typedef struct addrindex_column_writer_ {
+    uint8_t buf[ADDRINDEX_WRITE_BUFFER];
+    size_t used;
+    uint64_t pos;
+} addrindex_column_writer;
+
+static dogecoin_bool addrindex_column_flush(FILE* file, addrindex_column_writer* w)
+{
+    if (!w->used)
+        return true;
+    if (fseek(file, (long)w->pos, SEEK_SET) != 0 || fwrite(w->buf, 1, w->used, file) != w->used)
+        return false;
+    w->pos += w->used;
+    w->used = 0;
+    return true;
+}
+
+static dogecoin_bool addrindex_column_put(FILE* file, addrindex_column_writer* w, const void* data, size_t len)
+{
+    if (w->used + len > sizeof(w->buf) && !addrindex_column_flush(file, w))
+        return false;
+    memcpy(w->buf + w->used, data, len);
+    w->used += len;
+    return true;
+}
+
+
+/**
+ * @brief This function merges sorted row sources into a new
+ * segment file. Every column is written through its own
+ * buffer, so the merge runs in a single pass with bounded
+ * memory besides the bloom filter.
+ *
+ * @param path The path of the new segment.
+ * @param cursors The sources, each sorted.
+ * @param count The number of sources.
+ * @param rows The total number of rows.
+ *
+ * @return 1 if the segment was written, 0 otherwise.
+ */
+static dogecoin_bool addrindex_segment_write(const char* path, addrindex_cursor* cursors, size_t count, uint64_t rows)
+{
+    addrindex_column_writer* writers = dogecoin_calloc(ADDRINDEX_COLUMNS, sizeof(addrindex_column_writer));
+    uint64_t bloom_bits = rows * DOGECOIN_ADDRINDEX_BLOOM_BITS, offset = ADDRINDEX_SEGMENT_HEADER_SIZE, written = 0;
+    uint8_t header[ADDRINDEX_SEGMENT_HEADER_SIZE], field[8];
+    uint8_t* bloom;
+    char tmp[1024];
+    dogecoin_bool ok = true;
+    FILE* file;
+    size_t i;
+    int c;
+
+    if (bloom_bits < 64)
+        bloom_bits = 64;
+    bloom = dogecoin_calloc(1, (size_t)(bloom_bits + 7) / 8);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    file = fopen(tmp, "wb");
+    if (!file) {
+        dogecoin_free(bloom);
+        dogecoin_free(writers);
+        return false;
+    }
+    for (c = 0; c < ADDRINDEX_COLUMNS; c++) {
+        writers[c].pos = offset;
+        offset += rows * addrindex_column_width[c];
+    }
+    for (i = 0; i < count; i++)
+        addrindex_cursor_load(&cursors[i]);
+
+    while (ok) {
+        addrindex_cursor* min = NULL;
+        const dogecoin_addrindex_row* row;
+        for (i = 0; i < count; i++) {
+            if (cursors[i].pos < cursors[i].count && (!min || addrindex_row_cmp(&cursors[i].row, &min->row) < 0))
+                min = &cursors[i];
+        }
+        if (!min)
+            break;
+        row = &min->row;
+        ok = addrindex_column_put(file, &writers[0], row->key, DOGECOIN_HASH_LENGTH);
+        addrindex_write_u32(field, row->key_n);
+        ok = ok && addrindex_column_put(file, &writers[1], field, 4);
+        addrindex_write_u32(field, row->height);
+        ok = ok && addrindex_column_put(file, &writers[2], field, 4);
+        addrindex_write_u32(field, row->tx_pos);
+        ok = ok && addrindex_column_put(file, &writers[3], field, 4);
+        ok = ok && addrindex_column_put(file, &writers[4], row->txid, DOGECOIN_HASH_LENGTH);
+        addrindex_write_u32(field, row->n);
+        ok = ok && addrindex_column_put(file, &writers[5], field, 4);
+        addrindex_write_u64(field, (uint64_t)row->amount);
+        ok = ok && addrindex_column_put(file, &writers[6], field, 8);
+        addrindex_bloom_add(bloom, bloom_bits, row->key, row->key_n);
+        written++;
+        min->pos++;
+        addrindex_cursor_load(min);
+    }
+    for (c = 0; c < ADDRINDEX_COLUMNS && ok; c++)
+        ok = addrindex_column_flush(file, &writers[c]);
+    ok = ok && written == rows;
+
+    memcpy(header, ADDRINDEX_SEGMENT_MAGIC, 8);
+    addrindex_write_u32(header + 8, ADDRINDEX_FILE_VERSION);
+    addrindex_write_u64(header + 12, rows);
+    addrindex_write_u64(header + 20, bloom_bits);
+    addrindex_write_u32(header + 28, ADDRINDEX_BLOOM_HASHES);
+    ok = ok && fseek(file, (long)offset, SEEK_SET) == 0 && fwrite(bloom, 1, (size_t)(bloom_bits + 7) / 8, file) == (bloom_bits + 7) / 8;
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    if (fclose(file) != 0)
+        ok = false;
+    if (ok) {
+#ifdef WIN32
+        remove(path);
+#endif
+        ok = rename(tmp, path) == 0;
+    }
+    if (!ok)
+        remove(tmp);
+    dogecoin_free(bloom);
+    dogecoin_free(writers);
+    return ok;
+}
+
+
+/**
+ * @brief This function replaces the manifest with the current
+ * segment lists and height.
+ *
+ * @param idx The index.
+ *
+ * @return 1 if the manifest was written, 0 otherwise.
+ */
+static dogecoin_bool addrindex_write_manifest(const dogecoin_addrindex* idx)
+{
+    char path[1024], tmp[1024];
+    uint8_t header[8 + 4 + 4 + 4 + DOGECOIN_HASH_LENGTH + 4 + 4 + 4], id[4];
+    dogecoin_bool ok;
+    FILE* file;
+    size_t i;
+
+    snprintf(path, sizeof(path), "%s/manifest", idx->dir->str);
+    snprintf(tmp, sizeof(tmp), "%s/manifest.tmp", idx->dir->str);
+    memcpy(header, ADDRINDEX_MANIFEST_MAGIC, 8);
+    addrindex_write_u32(header + 8, ADDRINDEX_FILE_VERSION);
+    memcpy(header + 12, idx->chain->netmagic, 4);
+    addrindex_write_u32(header + 16, idx->height < 0 ? UINT32_MAX : (uint32_t)idx->height);
+    memcpy(header + 20, idx->hash, DOGECOIN_HASH_LENGTH);
+    addrindex_write_u32(header + 52, idx->next_id);
+    addrindex_write_u32(header + 56, (uint32_t)idx->funding->count);
+    addrindex_write_u32(header + 60, (uint32_t)idx->spending->count);
+
+    file = fopen(tmp, "wb");
+    if (!file)
+        return false;
+    ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    for (i = 0; i < idx->funding->count && ok; i++) {
+        addrindex_write_u32(id, idx->funding->segments[i].id);
+        ok = fwrite(id, 1, 4, file) == 4;
+    }
+    for (i = 0; i < idx->spending->count && ok; i++) {
+        addrindex_write_u32(id, idx->spending->segments[i].id);
+        ok = fwrite(id, 1, 4, file) == 4;
+    }
+    if (fclose(file) != 0)
+        ok = false;
+    if (ok) {
+#ifdef WIN32
+        remove(path);
+#endif
+        ok = rename(tmp, path) == 0;
+    }
+    if (!ok)
+        remove(tmp);
+    return ok;
+}
+
+
+static dogecoin_addrindex_table* addrindex_table_new(char prefix)
+{
+    dogecoin_addrindex_table* table = dogecoin_calloc(1, sizeof(*table));
+    table->prefix = prefix;
+    table->pending_sorted = true;
+    return table;
+}
+
+static void addrindex_table_free(dogecoin_addrindex_table* table)
+{
+    size_t i;
+    for (i = 0; i < table->count; i++)
+        addrindex_unmap(table->segments[i].map, table->segments[i].map_len);
+    if (table->segments)
+        dogecoin_free(table->segments);
+    if (table->pending)
+        dogecoin_free(table->pending);
+    dogecoin_free(table);
+}
+
+static dogecoin_bool addrindex_table_add_segment(dogecoin_addrindex* idx, dogecoin_addrindex_table* table, uint32_t id)
+{
+    char path[1024];
+    addrindex_segment seg;
+    dogecoin_mem_zero(&seg, sizeof(seg));
+    seg.prefix = table->prefix;
+    seg.id = id;
+    addrindex_segment_path(idx, table->prefix, id, path, sizeof(path));
+    if (!addrindex_segment_map(path, &seg))
+        return false;
+    table->segments = dogecoin_realloc(table->segments, (table->count + 1) * sizeof(addrindex_segment));
+    table->segments[table->count++] = seg;
+    return true;
+}
+
+
+/**
+ * @brief This function opens an index directory, reading the
+ * manifest and mapping the segments it names.
+ *
+ * @param chain The chain of the indexed blocks.
+ * @param dir The directory of the index.
+ *
+ * @return The index, or NULL if the directory can't be used or belongs to another chain.
+ */
+dogecoin_addrindex* dogecoin_addrindex_open(const dogecoin_chainparams* chain, const char* dir)
+{
+    dogecoin_addrindex* idx;
+    uint8_t header[8 + 4 + 4 + 4 + DOGECOIN_HASH_LENGTH + 4 + 4 + 4], id[4];
+    char path[1024];
+    uint32_t counts[2], i;
+    int t;
+    FILE* file;
+
+#ifdef WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0755);
+#endif
+    idx = dogecoin_calloc(1, sizeof(*idx));
+    idx->chain = chain;
+    idx->dir = cstr_new(dir);
+    idx->funding = addrindex_table_new('f');
+    idx->spending = addrindex_table_new('s');
+    idx->height = -1;
+    idx->next_id = 1;
+
+    snprintf(path, sizeof(path), "%s/manifest", dir);
+    file = fopen(path, "rb");
+    if (!file) {
+        if (addrindex_write_manifest(idx))
+            return idx;
+        dogecoin_addrindex_free(idx);
+        return NULL;
+    }
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, ADDRINDEX_MANIFEST_MAGIC, 8) != 0 ||
+        addrindex_read_u32(header + 8) != ADDRINDEX_FILE_VERSION || memcmp(header + 12, chain->netmagic, 4) != 0) {
+        fclose(file);
+        dogecoin_addrindex_free(idx);
+        return NULL;
+    }
+    idx->height = addrindex_read_u32(header + 16) == UINT32_MAX ? -1 : (int64_t)addrindex_read_u32(header + 16);
+    memcpy(idx->hash, header + 20, DOGECOIN_HASH_LENGTH);
+    idx->next_id = addrindex_read_u32(header + 52);
+    counts[0] = addrindex_read_u32(header + 56);
+    counts[1] = addrindex_read_u32(header + 60);
+    for (t = 0; t < 2; t++) {
+        for (i = 0; i < counts[t]; i++) {
+            if (fread(id, 1, 4, file) != 4 || !addrindex_table_add_segment(idx, t == 0 ? idx->funding : idx->spending, addrindex_read_u32(id))) {
+                fclose(file);
+                dogecoin_addrindex_free(idx);
+                return NULL;
+            }
+        }
+    }
+    fclose(file);
+    return idx;
+}
+
+
+void dogecoin_addrindex_free(dogecoin_addrindex* idx)
+{
+    if (!idx)
+        return;
+    addrindex_table_free(idx->funding);
+    addrindex_table_free(idx->spending);
+    cstr_free(idx->dir, true);
+    dogecoin_free(idx);
+}
+
+
+static dogecoin_addrindex_row* addrindex_table_append(dogecoin_addrindex_table* table)
+{
+    if (table->pending_count == table->pending_alloc) {
+        table->pending_alloc = table->pending_alloc ? table->pending_alloc * 2 : 1024;
+        table->pending = dogecoin_realloc(table->pending, table->pending_alloc * sizeof(dogecoin_addrindex_row));
+    }
+    table->pending_sorted = false;
+    return &table->pending[table->pending_count++];
+}
+
+
+void dogecoin_addrindex_script_hash(const unsigned char* script, size_t len, uint256 hash)
+{
+    sha256_raw(script, len, hash);
+}
+
+
+/**
+ * @brief This function derives the script hash of a P2PKH or
+ * P2SH address.
+ *
+ * @param chain The chain the address belongs to.
+ * @param address The base58 address.
+ * @param hash The script hash.
+ *
+ * @return 1 if the address is valid for the chain, 0 otherwise.
+ */
+dogecoin_bool dogecoin_addrindex_address_hash(const dogecoin_chainparams* chain, const char* address, uint256 hash)
+{
+    uint8_t buf[64];
+    cstring* script;
+    size_t len = strlen(address);
+
+    if (len == 0 || len > 50 || dogecoin_base58_decode_check(address, buf, sizeof(buf)) != 1 + sizeof(uint160) + 4)
+        return false;
+    script = cstr_new_sz(25);
+    if (buf[0] == chain->b58prefix_pubkey_address) {
+        dogecoin_script_build_p2pkh(script, buf + 1);
+    } else if (buf[0] == chain->b58prefix_script_address) {
+        dogecoin_script_build_p2sh(script, buf + 1);
+    } else {
+        cstr_free(script, true);
+        return false;
+    }
+    dogecoin_addrindex_script_hash((const unsigned char*)script->str, script->len, hash);
+    cstr_free(script, true);
+    return true;
+}
+
+
+/**
+ * @brief This function buffers the funding and spending rows
+ * of the next block and writes segments once enough rows
+ * are buffered.
+ *
+ * @param idx The index.
+ * @param view The parsed block.
+ * @param height The height of the block.
+ * @param hash The hash of the block.
+ *
+ * @return 1 if the block was added, 0 if it is out of order or malformed.
+ */
+dogecoin_bool dogecoin_addrindex_add_block(dogecoin_addrindex* idx, dogecoin_block_view* view, uint32_t height, const uint256 hash)
+{
+    size_t funding_mark = idx->funding->pending_count, spending_mark = idx->spending->pending_count;
+    uint32_t i, n, count, slen;
+
+    if ((int64_t)height != idx->height + 1 || !dogecoin_block_view_index(view, NULL))
+        return false;
+
+    /* the genesis coinbase can't be spent */
+    for (i = 0; i < view->tx_count && height > 0; i++) {
+        struct const_buffer buf;
+        uint256 txid;
+        if (!dogecoin_block_view_tx_raw(view, i, &buf) || !dogecoin_block_view_tx_hash(view, i, txid))
+            goto fail;
+
+        if (!deser_skip(&buf, 4) || !deser_varlen(&count, &buf))
+            goto fail;
+        for (n = 0; n < count; n++) {
+            const uint8_t* prevout = (const uint8_t*)buf.p;
+            if (!deser_skip(&buf, 36) || !deser_varlen(&slen, &buf) || !deser_skip(&buf, (size_t)slen + 4))
+                goto fail;
+            if (i > 0) {
+                dogecoin_addrindex_row* row = addrindex_table_append(idx->spending);
+                memcpy(row->key, prevout, DOGECOIN_HASH_LENGTH);
+                row->key_n = addrindex_read_u32(prevout + DOGECOIN_HASH_LENGTH);
+                row->height = height;
+                row->tx_pos = i;
+                memcpy(row->txid, txid, DOGECOIN_HASH_LENGTH);
+                row->n = n;
+                row->amount = 0;
+            }
+        }
+        if (!deser_varlen(&count, &buf))
+            goto fail;
+        for (n = 0; n < count; n++) {
+            const uint8_t* value = (const uint8_t*)buf.p;
+            const uint8_t* script;
+            dogecoin_addrindex_row* row;
+            if (!deser_skip(&buf, 8) || !deser_varlen(&slen, &buf))
+                goto fail;
+            script = (const uint8_t*)buf.p;
+            if (!deser_skip(&buf, slen))
+                goto fail;
+            if (slen > MAX_SCRIPT_SIZE || (slen > 0 && script[0] == OP_RETURN))
+                continue;
+            row = addrindex_table_append(idx->funding);
+            dogecoin_addrindex_script_hash(script, slen, row->key);
+            row->key_n = 0;
+            row->height = height;
+            row->tx_pos = i;
+            memcpy(row->txid, txid, DOGECOIN_HASH_LENGTH);
+            row->n = n;
+            row->amount = (int64_t)addrindex_read_u64(value);
+        }
+    }
+    idx->height = height;
+    memcpy(idx->hash, hash, DOGECOIN_HASH_LENGTH);
+    if (idx->funding->pending_count + idx->spending->pending_count >= DOGECOIN_ADDRINDEX_SEGMENT_ROWS)
+        return dogecoin_addrindex_flush(idx);
+    return true;
+
+fail:
+    /* drop the rows of the partially parsed block */
+    idx->funding->pending_count = funding_mark;
+    idx->spending->pending_count = spending_mark;
+    return false;
+}
+
+
+dogecoin_bool dogecoin_addrindex_blockfile_cb(dogecoin_blockfile_block* block, void* ctx)
+{
+    dogecoin_addrindex* idx = ctx;
+    if ((int64_t)block->height <= idx->height)
+        return true;
+    return dogecoin_addrindex_add_block(idx, &block->view, block->height, block->hash);
+}
+
+
+static void addrindex_table_sort(dogecoin_addrindex_table* table)
+{
+    if (!table->pending_sorted) {
+        qsort(table->pending, table->pending_count, sizeof(dogecoin_addrindex_row), addrindex_row_cmp);
+        table->pending_sorted = true;
+    }
+}
+
+
+/**
+ * @brief This function merges a run of segments of a table
+ * into one new segment which takes the place of the first.
+ *
+ * @param idx The index.
+ * @param table The table.
+ * @param first The first segment of the run.
+ * @param count The length of the run.
+ * @param replaced Receives the replaced segments, to be dropped after the manifest is written.
+ *
+ * @return 1 if the segments were merged, 0 otherwise.
+ */
+static dogecoin_bool addrindex_merge(dogecoin_addrindex* idx, dogecoin_addrindex_table* table, size_t first, size_t count, vector* replaced)
+{
+    addrindex_cursor* cursors = dogecoin_calloc(count, sizeof(addrindex_cursor));
+    addrindex_segment merged;
+    uint64_t rows = 0;
+    char path[1024];
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        cursors[i].seg = &table->segments[first + i];
+        cursors[i].count = cursors[i].seg->rows;
+        rows += cursors[i].count;
+    }
+    dogecoin_mem_zero(&merged, sizeof(merged));
+    merged.prefix = table->prefix;
+    merged.id = idx->next_id++;
+    addrindex_segment_path(idx, table->prefix, merged.id, path, sizeof(path));
+    if (!addrindex_segment_write(path, cursors, count, rows) || !addrindex_segment_map(path, &merged)) {
+        dogecoin_free(cursors);
+        return false;
+    }
+    dogecoin_free(cursors);
+
+    for (i = 0; i < count; i++) {
+        addrindex_segment* old = dogecoin_malloc(sizeof(addrindex_segment));
+        *old = table->segments[first + i];
+        vector_add(replaced, old);
+    }
+    table->segments[first] = merged;
+    memmove(&table->segments[first + 1], &table->segments[first + count], (table->count - first - count) * sizeof(addrindex_segment));
+    table->count -= count - 1;
+    return true;
+}
+
+
+/**
+ * @brief This function writes the buffered rows of a table as
+ * a new segment and merges the newest segments while the last
+ * one is at least half as large as the one before it.
+ *
+ * @param idx The index.
+ * @param table The table.
+ * @param replaced Receives segments which were merged away.
+ *
+ * @return 1 if all segments were written, 0 otherwise.
+ */
+static dogecoin_bool addrindex_table_flush(dogecoin_addrindex* idx, dogecoin_addrindex_table* table, vector* replaced)
+{
+    if (table->pending_count) {
+        addrindex_cursor cursor;
+        char path[1024];
+        uint32_t id = idx->next_id++;
+        addrindex_table_sort(table);
+        dogecoin_mem_zero(&cursor, sizeof(cursor));
+        cursor.rows = table->pending;
+        cursor.count = table->pending_count;
+        addrindex_segment_path(idx, table->prefix, id, path, sizeof(path));
+        if (!addrindex_segment_write(path, &cursor, 1, table->pending_count) || !addrindex_table_add_segment(idx, table, id))
+            return false;
+        table->pending_count = 0;
+    }
+    while (table->count >= 2 && table->segments[table->count - 1].rows * 2 >= table->segments[table->count - 2].rows) {
+        if (!addrindex_merge(idx, table, table->count - 2, 2, replaced))
+            return false;
+    }
+    return true;
+}
+
+
+/* unmaps and deletes segments which are no longer named by the manifest */
+static void addrindex_drop_segments(const dogecoin_addrindex* idx, vector* replaced)
+{
+    char path[1024];
+    size_t i;
+    for (i = 0; i < replaced->len; i++) {
+        addrindex_segment* seg = vector_idx(replaced, i);
+        addrindex_unmap(seg->map, seg->map_len);
+        addrindex_segment_path(idx, seg->prefix, seg->id, path, sizeof(path));
+        remove(path);
+    }
+}
+
+
+/**
+ * @brief This function writes the rows buffered in both tables
+ * as segments, compacts the newest segments and records the
+ * height of the index in the manifest.
+ *
+ * @param idx The index.
+ *
+ * @return 1 if the index was written, 0 otherwise.
+ */
+dogecoin_bool dogecoin_addrindex_flush(dogecoin_addrindex* idx)
+{
+    vector* replaced = vector_new(8, dogecoin_free);
+    dogecoin_bool ok = addrindex_table_flush(idx, idx->funding, replaced) &&
+                       addrindex_table_flush(idx, idx->spending, replaced) &&
+                       addrindex_write_manifest(idx);
+    if (ok)
+        addrindex_drop_segments(idx, replaced);
+    vector_free(replaced, true);
+    return ok;
+}
+
+
+/**
+ * @brief This function flushes the index and merges the segments
+ * of each table into a single segment.
+ *
+ * @param idx The index.
+ *
+ * @return 1 if the index was compacted, 0 otherwise.
+ */
+dogecoin_bool dogecoin_addrindex_compact(dogecoin_addrindex* idx)
+{
+    vector* replaced;
+    dogecoin_bool ok;
+    if (!dogecoin_addrindex_flush(idx))
+        return false;
+    replaced = vector_new(8, dogecoin_free);
+    ok = (idx->funding->count < 2 || addrindex_merge(idx, idx->funding, 0, idx->funding->count, replaced)) &&
+         (idx->spending->count < 2 || addrindex_merge(idx, idx->spending, 0, idx->spending->count, replaced)) &&
+         addrindex_write_manifest(idx);
+    if (ok)
+        addrindex_drop_segments(idx, replaced);
+    vector_free(replaced, true);
+    return ok;
+}
+
+
+typedef struct addrindex_rows_ {
+    dogecoin_addrindex_row* rows;
+    size_t count;
+    size_t alloc;
+} addrindex_rows;
+
+static void addrindex_rows_push(addrindex_rows* result, const dogecoin_addrindex_row* row)
+{
+    if (result->count == result->alloc) {
+        result->alloc = result->alloc ? result->alloc * 2 : 16;
+        result->rows = dogecoin_realloc(result->rows, result->alloc * sizeof(dogecoin_addrindex_row));
+    }
+    result->rows[result->count++] = *row;
+}
+
+
+/**
+ * @brief This function collects the rows of a table matching
+ * a key. Segments whose bloom filter rules out the key are
+ * skipped, the others are binary searched on the key column.
+ *
+ * @param table The table.
+ * @param key The key.
+ * @param key_n The second part of the key.
+ * @param result The rows found are appended to this list.
+ */
+static void addrindex_table_find(dogecoin_addrindex_table* table, const uint8_t* key, uint32_t key_n, addrindex_rows* result)
+{
+    dogecoin_addrindex_row row;
+    size_t i, lo, hi;
+
+    for (i = 0; i < table->count; i++) {
+        const addrindex_segment* seg = &table->segments[i];
+        uint64_t first = 0, last = seg->rows, mid;
+        if (!seg->rows || !addrindex_bloom_check(seg, key, key_n))
+            continue;
+        while (first < last) {
+            mid = first + (last - first) / 2;
+            if (addrindex_segment_key_cmp(seg, mid, key, key_n) < 0)
+                first = mid + 1;
+            else
+                last = mid;
+        }
+        for (; first < seg->rows && addrindex_segment_key_cmp(seg, first, key, key_n) == 0; first++) {
+            addrindex_segment_row(seg, first, &row);
+            addrindex_rows_push(result, &row);
+        }
+    }
+
+    addrindex_table_sort(table);
+    memcpy(row.key, key, DOGECOIN_HASH_LENGTH);
+    row.key_n = key_n;
+    row.height = 0;
+    row.tx_pos = 0;
+    dogecoin_mem_zero(row.txid, DOGECOIN_HASH_LENGTH);
+    row.n = 0;
+    lo = 0;
+    hi = table->pending_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (addrindex_row_cmp(&table->pending[mid], &row) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (; lo < table->pending_count; lo++) {
+        const dogecoin_addrindex_row* pending = &table->pending[lo];
+        if (pending->key_n != key_n || memcmp(pending->key, key, DOGECOIN_HASH_LENGTH) != 0)
+            break;
+        addrindex_rows_push(result, pending);
+    }
+}
+
+
+static int addrindex_history_cmp(const void* a_, const void* b_)
+{
+    const dogecoin_addrindex_history_item* a = a_;
+    const dogecoin_addrindex_history_item* b = b_;
+    if (a->height != b->height)
+        return a->height < b->height ? -1 : 1;
+    return a->tx_pos == b->tx_pos ? 0 : (a->tx_pos < b->tx_pos ? -1 : 1);
+}
+
+
+/**
+ * @brief This function lists the transactions which funded or
+ * spent outputs of a script, with the net amount each one
+ * moved, in chain order: by height, then by the position of
+ * the transaction in its block.
+ *
+ * @param idx The index.
+ * @param script_hash The script hash.
+ * @param items The list the history items are appended to.
+ *
+ * @return The number of items appended.
+ */
+size_t dogecoin_addrindex_history(dogecoin_addrindex* idx, const uint256 script_hash, vector* items)
+{
+    addrindex_rows funding = {NULL, 0, 0}, spending = {NULL, 0, 0};
+    dogecoin_addrindex_history_item* history;
+    size_t i, count = 0, appended = 0;
+
+    addrindex_table_find(idx->funding, script_hash, 0, &funding);
+    history = dogecoin_malloc((funding.count * 2 + 1) * sizeof(*history));
+    for (i = 0; i < funding.count; i++) {
+        memcpy(history[count].txid, funding.rows[i].txid, DOGECOIN_HASH_LENGTH);
+        history[count].height = funding.rows[i].height;
+        history[count].tx_pos = funding.rows[i].tx_pos;
+        history[count].delta = funding.rows[i].amount;
+        count++;
+        /* an output is spent at most once, the spend moves its whole value */
+        spending.count = 0;
+        addrindex_table_find(idx->spending, funding.rows[i].txid, funding.rows[i].n, &spending);
+        if (spending.count) {
+            memcpy(history[count].txid, spending.rows[0].txid, DOGECOIN_HASH_LENGTH);
+            history[count].height = spending.rows[0].height;
+            history[count].tx_pos = spending.rows[0].tx_pos;
+            history[count].delta = -funding.rows[i].amount;
+            count++;
+        }
+    }
+    qsort(history, count, sizeof(*history), addrindex_history_cmp);
+
+    for (i = 0; i < count; i++) {
+        dogecoin_addrindex_history_item* item;
+        if (appended && memcmp(history[i].txid, ((dogecoin_addrindex_history_item*)vector_idx(items, items->len - 1))->txid, DOGECOIN_HASH_LENGTH) == 0) {
+            ((dogecoin_addrindex_history_item*)vector_idx(items, items->len - 1))->delta += history[i].delta;
+            continue;
+        }
+        item = dogecoin_malloc(sizeof(*item));
+        *item = history[i];
+        vector_add(items, item);
+        appended++;
+    }
+    dogecoin_free(history);
+    if (funding.rows)
+        dogecoin_free(funding.rows);
+    if (spending.rows)
+        dogecoin_free(spending.rows);
+    return appended;
+}
+
+
+/**
+ * @brief This function lists the outputs of a script which
+ * have not been spent up to the height of the index.
+ *
+ * @param idx The index.
+ * @param script_hash The script hash.
+ * @param items The list the unspent outputs are appended to.
+ *
+ * @return The number of items appended.
+ */
+size_t dogecoin_addrindex_unspent(dogecoin_addrindex* idx, const uint256 script_hash, vector* items)
+{
+    addrindex_rows funding = {NULL, 0, 0}, spending = {NULL, 0, 0};
+    size_t i, appended = 0;
+
+    addrindex_table_find(idx->funding, script_hash, 0, &funding);
+    for (i = 0; i < funding.count; i++) {
+        dogecoin_addrindex_unspent_item* item;
+        spending.count = 0;
+        addrindex_table_find(idx->spending, funding.rows[i].txid, funding.rows[i].n, &spending);
+        if (spending.count)
+            continue;
+        item = dogecoin_malloc(sizeof(*item));
+        memcpy(item->txid, funding.rows[i].txid, DOGECOIN_HASH_LENGTH);
+        item->vout = funding.rows[i].n;
+        item->height = funding.rows[i].height;
+        item->amount = funding.rows[i].amount;
+        vector_add(items, item);
+        appended++;
+    }
+    if (funding.rows)
+        dogecoin_free(funding.rows);
+    if (spending.rows)
+        dogecoin_free(spending.rows);
+    return appended;
+}
+
+
+int64_t dogecoin_addrindex_balance(dogecoin_addrindex* idx, const uint256 script_hash)
+{
+    vector* items = vector_new(16, dogecoin_free);
+    int64_t balance = 0;
+    size_t i;
+    dogecoin_addrindex_unspent(idx, script_hash, items);
+    for (i = 0; i < items->len; i++)
+        balance += ((dogecoin_addrindex_unspent_item*)vector_idx(items, i))->amount;
+    vector_free(items, true);
+    return balance;
+}
@@ -0,0 +1,628 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dogecoin/addrman.h>
+#include <dogecoin/hash.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/utils.h>
+
+#include <uthash/uthash.h>
+
+#define DOGECOIN_ADDRMAN_FILE_MAGIC 0x6d726461 /* "adrm" */
+#define DOGECOIN_ADDRMAN_FILE_VERSION 1
+
+/* assumed for peers that have not been measured yet */
+#define DOGECOIN_ADDRMAN_DEFAULT_HANDSHAKE_MS 1000
+#define DOGECOIN_ADDRMAN_DEFAULT_PING_MS 500
+
+/* the first retry waits a minute, every further failure doubles the wait up to about 17 hours */
+#define DOGECOIN_ADDRMAN_RETRY_S 60
+#define DOGECOIN_ADDRMAN_MAX_BACKOFF_SHIFT 10
+
+/* announced times further ahead than this are replaced by an age of five days */
+#define DOGECOIN_ADDRMAN_MAX_FUTURE_S (10 * 60)
+#define DOGECOIN_ADDRMAN_FUTURE_PENALTY_S (5 * 24 * 60 * 60)
+
+typedef struct dogecoin_addrman_item_ {
+    unsigned char key[18]; /* ip and port */
+    unsigned char source[18]; /* the announcing peer, zero for local sources */
+    dogecoin_addrman_entry entry;
+    UT_hash_handle hh;
+} dogecoin_addrman_item;
+
+/* how many of the stored addresses a peer announced */
+typedef struct dogecoin_addrman_source_ {
+    unsigned char key[18];
+    uint32_t count;
+    UT_hash_handle hh;
+} dogecoin_addrman_source;
+
+struct dogecoin_addrman_ {
+    const dogecoin_chainparams* chain;
+    pthread_mutex_t lock;
+    dogecoin_addrman_item* items;
+    dogecoin_addrman_source* sources;
+};
+
+static const unsigned char dogecoin_addrman_local_source[18] = {0};
+
+typedef struct dogecoin_addrman_candidate_ {
+    double score;
+    const dogecoin_addrman_item* item;
+} dogecoin_addrman_candidate;
+
+static void dogecoin_addrman_key(const dogecoin_p2p_address* addr, unsigned char key[18])
+{
+    memcpy(key, addr->ip, 16);
+    key[16] = (unsigned char)(addr->port >> 8);
+    key[17] = (unsigned char)(addr->port & 0xff);
+}
+
+static void dogecoin_addrman_sockaddr_key(const struct sockaddr* addr, unsigned char key[18])
+{
+    dogecoin_p2p_address p2p_addr;
+    dogecoin_p2p_address_init(&p2p_addr);
+    dogecoin_addr_to_p2paddr((struct sockaddr*)addr, &p2p_addr);
+    dogecoin_addrman_key(&p2p_addr, key);
+}
+
+static dogecoin_addrman_item* dogecoin_addrman_find(dogecoin_addrman* addrman, const struct sockaddr* addr)
+{
+    unsigned char key[18];
+    dogecoin_addrman_item* item = NULL;
+    dogecoin_addrman_sockaddr_key(addr, key);
+    HASH_FIND(hh, addrman->items, key, sizeof(key), item);
+    return item;
+}
+
+static dogecoin_addrman_source* dogecoin_addrman_find_source(dogecoin_addrman* addrman, const unsigned char key[18])
+{
+    dogecoin_addrman_source* source = NULL;
+    HASH_FIND(hh, addrman->sources, key, 18, source);
+    return source;
+}
+
+/* exponential moving average, 0 stays reserved for unknown */
+static uint32_t dogecoin_addrman_smooth(uint32_t current, uint32_t sample)
+{
+    if (sample == 0)
+        sample = 1;
+    if (current == 0)
+        return sample;
+    return (uint32_t)(((uint64_t)current * 3 + sample) / 4);
+}
+
+/**
+ * @brief This function rates an address, reliable peers with a fast
+ * handshake and ping rate highest. The success rate is smoothed so that
+ * untried addresses start at one half.
+ *
+ * @param entry The address to rate.
+ *
+ * @return The score, higher is better.
+ */
+static double dogecoin_addrman_score(const dogecoin_addrman_entry* entry)
+{
+    double reliability = (entry->successes + 1.0) / (entry->successes + entry->failures + 2.0);
+    double latency = (entry->handshake_ms ? entry->handshake_ms : DOGECOIN_ADDRMAN_DEFAULT_HANDSHAKE_MS) +
+                     (entry->ping_ms ? entry->ping_ms : DOGECOIN_ADDRMAN_DEFAULT_PING_MS);
+    return reliability * 1000.0 / (100.0 + latency);
+}
+
+static int dogecoin_addrman_candidate_cmp(const void* a, const void* b)
+{
+    const dogecoin_addrman_candidate* ca = a;
+    const dogecoin_addrman_candidate* cb = b;
+    if (ca->score != cb->score)
+        return ca->score > cb->score ? -1 : 1;
+    /* the most recently working peer first, then the most recently announced */
+    if (ca->item->entry.last_success != cb->item->entry.last_success)
+        return ca->item->entry.last_success > cb->item->entry.last_success ? -1 : 1;
+    if (ca->item->entry.addr.time != cb->item->entry.addr.time)
+        return ca->item->entry.addr.time > cb->item->entry.addr.time ? -1 : 1;
+    return memcmp(ca->item->key, cb->item->key, sizeof(ca->item->key));
+}
+
+
+/**
+ * @brief This function creates an empty peer store.
+ *
+ * @param chain The chain the addresses belong to, NULL for mainnet.
+ *
+ * @return The new store.
+ */
+dogecoin_addrman* dogecoin_addrman_new(const dogecoin_chainparams* chain)
+{
+    dogecoin_addrman* addrman = dogecoin_calloc(1, sizeof(*addrman));
+    addrman->chain = chain ? chain : &dogecoin_chainparams_main;
+    addrman->items = NULL;
+    pthread_mutex_init(&addrman->lock, NULL);
+    return addrman;
+}
+
+
+/**
+ * @brief This function frees the store and all its addresses.
+ *
+ * @param addrman The store, may be NULL.
+ *
+ * @return Nothing.
+ */
+void dogecoin_addrman_free(dogecoin_addrman* addrman)
+{
+    dogecoin_addrman_item *item, *tmp;
+    if (!addrman)
+        return;
+    dogecoin_addrman_source *source, *tmp_source;
+    HASH_ITER(hh, addrman->items, item, tmp) {
+        HASH_DEL(addrman->items, item);
+        dogecoin_free(item);
+    }
+    HASH_ITER(hh, addrman->sources, source, tmp_source) {
+        HASH_DEL(addrman->sources, source);
+        dogecoin_free(source);
+    }
+    pthread_mutex_destroy(&addrman->lock);
+    dogecoin_free(addrman);
+}
+
+
+size_t dogecoin_addrman_size(dogecoin_addrman* addrman)
+{
+    pthread_mutex_lock(&addrman->lock);
+    size_t size = HASH_COUNT(addrman->items);
+    pthread_mutex_unlock(&addrman->lock);
+    return size;
+}
+
+
+/**
+ * @brief This function removes an item and releases the slot it took
+ * from its source, the lock must be held.
+ *
+ * @return Nothing.
+ */
+static void dogecoin_addrman_remove(dogecoin_addrman* addrman, dogecoin_addrman_item* item)
+{
+    dogecoin_addrman_source* source = dogecoin_addrman_find_source(addrman, item->source);
+    if (source && --source->count == 0) {
+        HASH_DEL(addrman->sources, source);
+        dogecoin_free(source);
+    }
+    HASH_DEL(addrman->items, item);
+    dogecoin_free(item);
+}
+
+/**
+ * @brief This function frees a slot for a new address by evicting the
+ * worst address that never completed a handshake, the one announced
+ * longest ago among equally rated ones. Addresses that worked once are
+ * never evicted. The lock must be held.
+ *
+ * @return 1 if an address was evicted, 0 otherwise.
+ */
+static dogecoin_bool dogecoin_addrman_evict(dogecoin_addrman* addrman)
+{
+    dogecoin_addrman_item *item, *tmp, *worst = NULL;
+    double worst_score = 0;
+    HASH_ITER(hh, addrman->items, item, tmp) {
+        if (item->entry.successes > 0)
+            continue;
+        double score = dogecoin_addrman_score(&item->entry);
+        if (!worst || score < worst_score ||
+            (score == worst_score && item->entry.addr.time < worst->entry.addr.time)) {
+            worst = item;
+            worst_score = score;
+        }
+    }
+    if (!worst)
+        return false;
+    dogecoin_addrman_remove(addrman, worst);
+    return true;
+}
+
+/**
+ * @brief This function inserts an address, the lock must be held. A
+ * full store evicts its worst untried address, a peer may only fill
+ * DOGECOIN_ADDRMAN_MAX_PER_SOURCE slots.
+ *
+ * @param source The key of the announcing peer, the local source is
+ * not limited.
+ *
+ * @return The new item, NULL if the address is known, unroutable, its
+ * source used up its slots or the store is full of working addresses.
+ */
+static dogecoin_addrman_item* dogecoin_addrman_insert(dogecoin_addrman* addrman, const dogecoin_p2p_address* addr, const unsigned char source_key[18])
+{
+    static const unsigned char zero[16] = {0};
+    dogecoin_addrman_item* item = NULL;
+    dogecoin_addrman_source* source = NULL;
+    dogecoin_bool local = memcmp(source_key, dogecoin_addrman_local_source, 18) == 0;
+    unsigned char key[18];
+    if (addr->port == 0 || memcmp(addr->ip, zero, sizeof(zero)) == 0)
+        return NULL;
+    dogecoin_addrman_key(addr, key);
+    HASH_FIND(hh, addrman->items, key, sizeof(key), item);
+    if (item) {
+        if (addr->time > item->entry.addr.time)
+            item->entry.addr.time = addr->time;
+        item->entry.addr.services |= addr->services;
+        return NULL;
+    }
+    if (!local) {
+        source = dogecoin_addrman_find_source(addrman, source_key);
+        if (source && source->count >= DOGECOIN_ADDRMAN_MAX_PER_SOURCE)
+            return NULL;
+    }
+    if (HASH_COUNT(addrman->items) >= DOGECOIN_ADDRMAN_MAX_ENTRIES && !dogecoin_addrman_evict(addrman))
+        return NULL;
+    if (!local) {
+        /* eviction may have released the source */
+        source = dogecoin_addrman_find_source(addrman, source_key);
+        if (!source) {
+            source = dogecoin_calloc(1, sizeof(*source));
+            memcpy(source->key, source_key, sizeof(source->key));
+            HASH_ADD(hh, addrman->sources, key, sizeof(source->key), source);
+        }
+        source->count++;
+    }
+    item = dogecoin_calloc(1, sizeof(*item));
+    memcpy(item->key, key, sizeof(key));
+    memcpy(item->source, source_key, sizeof(item->source));
+    item->entry.addr = *addr;
+    HASH_ADD(hh, addrman->items, key, sizeof(item->key), item);
+    return item;
+}
+
+
+/**
+ * @brief This function learns an address announced by a peer, a known
+ * address takes over the newer time and the announced services.
+ *
+ * @param addrman The store.
+ * @param addr The address.
+ *
+ * @return 1 if the address is new, 0 otherwise.
+ */
+dogecoin_bool dogecoin_addrman_add(dogecoin_addrman* addrman, const dogecoin_p2p_address* addr)
+{
+    pthread_mutex_lock(&addrman->lock);
+    dogecoin_bool added = dogecoin_addrman_insert(addrman, addr, dogecoin_addrman_local_source) != NULL;
+    pthread_mutex_unlock(&addrman->lock);
+    return added;
+}
+
+
+/**
+ * @brief This function learns an address that a peer announced in an
+ * addr message. A time more than ten minutes ahead is taken as five days
+ * old, so future timestamps cannot move an address to the front, and
+ * each peer may only contribute DOGECOIN_ADDRMAN_MAX_PER_SOURCE addresses.
+ *
+ * @param addrman The store.
+ * @param addr The address.
+ * @param source The peer that announced it.
+ * @param now The current time in seconds.
+ *
+ * @return 1 if the address is new, 0 otherwise.
+ */
+dogecoin_bool dogecoin_addrman_add_from(dogecoin_addrman* addrman, const dogecoin_p2p_address* addr, const struct sockaddr* source, uint64_t now)
+{
+    dogecoin_p2p_address clamped = *addr;
+    unsigned char source_key[18];
+    if (clamped.time > now + DOGECOIN_ADDRMAN_MAX_FUTURE_S)
+        clamped.time = (uint32_t)(now - DOGECOIN_ADDRMAN_FUTURE_PENALTY_S);
+    dogecoin_addrman_sockaddr_key(source, source_key);
+    pthread_mutex_lock(&addrman->lock);
+    dogecoin_bool added = dogecoin_addrman_insert(addrman, &clamped, source_key) != NULL;
+    pthread_mutex_unlock(&addrman->lock);
+    return added;
+}
+
+
+dogecoin_bool dogecoin_addrman_add_sockaddr(dogecoin_addrman* addrman, const struct sockaddr* addr, uint64_t services, uint64_t now)
+{
+    dogecoin_p2p_address p2p_addr;
+    dogecoin_p2p_address_init(&p2p_addr);
+    dogecoin_addr_to_p2paddr((struct sockaddr*)addr, &p2p_addr);
+    p2p_addr.services = services;
+    p2p_addr.time = (uint32_t)now;
+    return dogecoin_addrman_add(addrman, &p2p_addr);
+}
+
+
+dogecoin_bool dogecoin_addrman_get(dogecoin_addrman* addrman, const struct sockaddr* addr, dogecoin_addrman_entry* entry_out)
+{
+    pthread_mutex_lock(&addrman->lock);
+    dogecoin_addrman_item* item = dogecoin_addrman_find(addrman, addr);
+    if (item)
+        *entry_out = item->entry;
+    pthread_mutex_unlock(&addrman->lock);
+    return item != NULL;
+}
+
+
+/**
+ * @brief This function records the start of a connection attempt, which
+ * counts as failed until dogecoin_addrman_good is called.
+ *
+ * @param addrman The store.
+ * @param addr The address connected to.
+ * @param now The current time in seconds.
+ *
+ * @return Nothing.
+ */
+void dogecoin_addrman_attempt(dogecoin_addrman* addrman, const struct sockaddr* addr, uint64_t now)
+{
+    pthread_mutex_lock(&addrman->lock);
+    dogecoin_addrman_item* item = dogecoin_addrman_find(addrman, addr);
+    if (item) {
+        item->entry.attempts++;
+        item->entry.last_try = now;
+    }
+    pthread_mutex_unlock(&addrman->lock);
+}
+
+
+/**
+ * @brief This function records a completed handshake and how long it took.
+ *
+ * @param addrman The store.
+ * @param addr The address connected to.
+ * @param handshake_ms The time from connecting to the verack.
+ * @param now The current time in seconds.
+ *
+ * @return Nothing.
+ */
+void dogecoin_addrman_good(dogecoin_addrman* addrman, const struct sockaddr* addr, uint32_t handshake_ms, uint64_t now)
+{
+    pthread_mutex_lock(&addrman->lock);
+    dogecoin_addrman_item* item = dogecoin_addrman_find(addrman, addr);
+    if (item) {
+        item->entry.attempts = 0;
+        item->entry.successes++;
+        item->entry.last_success = now;
+        item->entry.handshake_ms = dogecoin_addrman_smooth(item->entry.handshake_ms, handshake_ms);
+    }
+    pthread_mutex_unlock(&addrman->lock);
+}
+
+
+void dogecoin_addrman_failed(dogecoin_addrman* addrman, const struct sockaddr* addr)
+{
+    pthread_mutex_lock(&addrman->lock);
+    dogecoin_addrman_item* item = dogecoin_addrman_find(addrman, addr);
+    if (item)
+        item->entry.failures++;
+    pthread_mutex_unlock(&addrman->lock);
+}
+
+
+/**
+ * @brief This function records the round trip of a ping.
+ *
+ * @param addrman The store.
+ * @param addr The address of the peer.
+ * @param rtt_ms The time from sending the ping to receiving the pong.
+ *
+ * @return Nothing.
+ */
+void dogecoin_addrman_ping(dogecoin_addrman* addrman, const struct sockaddr* addr, uint32_t rtt_ms)
+{
+    pthread_mutex_lock(&addrman->lock);
+    dogecoin_addrman_item* item = dogecoin_addrman_find(addrman, addr);
+    if (item)
+        item->entry.ping_ms = dogecoin_addrman_smooth(item->entry.ping_ms, rtt_ms);
+    pthread_mutex_unlock(&addrman->lock);
+}
+
+
+/**
+ * @brief This function picks the addresses worth connecting to, ordered
+ * by their score. Addresses are skipped while a connection attempt runs
+ * or their backoff after failed attempts has not passed.
+ *
+ * @param addrman The store.
+ * @param now The current time in seconds.
+ * @param entries_out Receives the addresses, best first.
+ * @param max The capacity of entries_out.
+ *
+ * @return The number of addresses copied.
+ */
+size_t dogecoin_addrman_select(dogecoin_addrman* addrman, uint64_t now, dogecoin_addrman_entry* entries_out, size_t max)
+{
+    dogecoin_addrman_item *item, *tmp;
+    size_t count = 0, i;
+
+    pthread_mutex_lock(&addrman->lock);
+    dogecoin_addrman_candidate* candidates = dogecoin_calloc(HASH_COUNT(addrman->items) + 1, sizeof(*candidates));
+    HASH_ITER(hh, addrman->items, item, tmp) {
+        if (item->entry.attempts > 0) {
+            uint32_t shift = item->entry.attempts - 1;
+            if (shift > DOGECOIN_ADDRMAN_MAX_BACKOFF_SHIFT)
+                shift = DOGECOIN_ADDRMAN_MAX_BACKOFF_SHIFT;
+            if (item->entry.last_try + ((uint64_t)DOGECOIN_ADDRMAN_RETRY_S << shift) > now)
+                continue;
+        }
+        candidates[count].score = dogecoin_addrman_score(&item->entry);
+        candidates[count].item = item;
+        count++;
+    }
+    qsort(candidates, count, sizeof(*candidates), dogecoin_addrman_candidate_cmp);
+    if (count > max)
+        count = max;
+    for (i = 0; i < count; i++)
+        entries_out[i] = candidates[i].item->entry;
+    pthread_mutex_unlock(&addrman->lock);
+    dogecoin_free(candidates);
+    return count;
+}
+
+
+/**
+ * @brief This function writes all addresses and their statistics to a
+ * file. The file is written next to path first and then renamed, so a
+ * crash leaves the previous file intact.
+ *
+ * @param addrman The store.
+ * @param path The file to write.
+ *
+ * @return 1 if the file was written, 0 otherwise.
+ */
+dogecoin_bool dogecoin_addrman_save(dogecoin_addrman* addrman, const char* path)
+{
+    dogecoin_addrman_item *item, *tmp;
+    pthread_mutex_lock(&addrman->lock);
+    cstring* data = cstr_new_sz(64 + HASH_COUNT(addrman->items) * 66);
+    ser_u32(data, DOGECOIN_ADDRMAN_FILE_MAGIC);
+    ser_u32(data, DOGECOIN_ADDRMAN_FILE_VERSION);
+    ser_bytes(data, addrman->chain->netmagic, 4);
+    ser_varlen(data, HASH_COUNT(addrman->items));
+    HASH_ITER(hh, addrman->items, item, tmp) {
+        dogecoin_p2p_ser_addr(DOGECOIN_PROTOCOL_VERSION, &item->entry.addr, data);
+        ser_u64(data, item->entry.last_try);
+        ser_u64(data, item->entry.last_success);
+        ser_u32(data, item->entry.attempts);
+        ser_u32(data, item->entry.successes);
+        ser_u32(data, item->entry.failures);
+        ser_u32(data, item->entry.handshake_ms);
+        ser_u32(data, item->entry.ping_ms);
+    }
+    pthread_mutex_unlock(&addrman->lock);
+
+    uint256 checksum;
+    dogecoin_dblhash((const unsigned char*)data->str, data->len, checksum);
+    ser_bytes(data, checksum, 4);
+
+    cstring* tmp_path = cstr_new(path);
+    cstr_append_buf(tmp_path, ".new", 4);
+    FILE* file = fopen(tmp_path->str, "wb");
+    dogecoin_bool ok = file != NULL;
+    if (file) {
+        ok = fwrite(data->str, 1, data->len, file) == data->len;
+        ok = (fclose(file) == 0) && ok;
+    }
+#ifdef WIN32
+    if (ok)
+        remove(path);
+#endif
+    if (ok)
+        ok = rename(tmp_path->str, path) == 0;
+    if (!ok)
+        remove(tmp_path->str);
+    cstr_free(tmp_path, true);
+    cstr_free(data, true);
+    return ok;
+}
+
+
+/**
+ * @brief This function merges the addresses of a file written by
+ * dogecoin_addrman_save into the store, known addresses keep their
+ * statistics.
+ *
+ * @param addrman The store.
+ * @param path The file to read.
+ *
+ * @return 1 if the file was read, 0 if it is missing, corrupt or
+ * belongs to another chain.
+ */
+dogecoin_bool dogecoin_addrman_load(dogecoin_addrman* addrman, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+    cstring* data = cstr_new_sz(4096);
+    char chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        cstr_append_buf(data, chunk, read);
+    fclose(file);
+
+    uint256 checksum;
+    uint32_t magic = 0, version = 0, count = 0, i;
+    unsigned char netmagic[4];
+    dogecoin_bool ok = data->len >= 4;
+    if (ok) {
+        dogecoin_dblhash((const unsigned char*)data->str, data->len - 4, checksum);
+        ok = memcmp(checksum, data->str + data->len - 4, 4) == 0;
+    }
+    struct const_buffer buf = {data->str, ok ? data->len - 4 : 0};
+    ok = ok && deser_u32(&magic, &buf) && magic == DOGECOIN_ADDRMAN_FILE_MAGIC;
+    ok = ok && deser_u32(&version, &buf) && version == DOGECOIN_ADDRMAN_FILE_VERSION;
+    ok = ok && deser_bytes(netmagic, &buf, 4) && memcmp(netmagic, addrman->chain->netmagic, 4) == 0;
+    ok = ok && deser_varlen(&count, &buf) && count <= DOGECOIN_ADDRMAN_MAX_ENTRIES;
+
+    pthread_mutex_lock(&addrman->lock);
+    for (i = 0; ok && i < count; i++) {
+        dogecoin_addrman_entry entry;
+        dogecoin_mem_zero(&entry, sizeof(entry));
+        ok = dogecoin_p2p_deser_addr(DOGECOIN_PROTOCOL_VERSION, &entry.addr, &buf) &&
+             deser_u64(&entry.last_try, &buf) &&
+             deser_u64(&entry.last_success, &buf) &&
+             deser_u32(&entry.attempts, &buf) &&
+             deser_u32(&entry.successes, &buf) &&
+             deser_u32(&entry.failures, &buf) &&
+             deser_u32(&entry.handshake_ms, &buf) &&
+             deser_u32(&entry.ping_ms, &buf);
+        if (!ok)
+            break;
+        dogecoin_addrman_item* item = dogecoin_addrman_insert(addrman, &entry.addr, dogecoin_addrman_local_source);
+        if (item)
+            item->entry = entry;
+    }
+    pthread_mutex_unlock(&addrman->lock);
+    cstr_free(data, true);
+    return ok;
+}
+
+
+/**
+ * @brief This function appends the path of the chain's peer file below
+ * the default datadir to path_out.
+ *
+ * @param chain The chain whose file is requested.
+ * @param path_out The cstring receiving the path.
+ *
+ * @return Nothing.
+ */
+void dogecoin_addrman_default_path(const dogecoin_chainparams* chain, cstring* path_out)
+{
+    dogecoin_get_default_datadir(path_out);
+    /* mainnet keeps its files directly in the datadir */
+    if (strcmp(chain->chainname, "main") != 0) {
+        cstr_append_c(path_out, '/');
+        cstr_append_buf(path_out, chain->chainname, strlen(chain->chainname));
+    }
+    cstr_append_buf(path_out, "/addrman.dat", 12);
+}
@@ -32,6 +32,7 @@
 #include <string.h>
 
 #include <dogecoin/block.h>
+#include <dogecoin/merkle.h>
 #include <dogecoin/protocol.h>
 #include <dogecoin/serialize.h>
 #include <dogecoin/sha2.h>
@@ -102,12 +103,29 @@ int dogecoin_block_header_deserialize(dogecoin_block_header* header, struct cons
  * @return Nothing.
  */
 void dogecoin_block_header_serialize(cstring* s, const dogecoin_block_header* header) {
-    ser_s32(s, header->version);
-    ser_u256(s, header->prev_block);
-    ser_u256(s, header->merkle_root);
-    ser_u32(s, header->timestamp);
-    ser_u32(s, header->bits);
-    ser_u32(s, header->nonce);
+    ser_writer w;
+    if (!cstr_alloc_minsize(s, s->len + DOGECOIN_BLOCK_HEADER_SIZE))
+        return;
+    ser_writer_init_buf(&w, s->str + s->len, DOGECOIN_BLOCK_HEADER_SIZE);
+    dogecoin_block_header_serialize_writer(&w, header);
+    s->len += DOGECOIN_BLOCK_HEADER_SIZE;
+    s->str[s->len] = 0;
+}
+
+/**
+ * @brief This function serializes a dogecoin block header into
+ * a writer.
+ * 
+ * @param w The writer to write the serialized header to.
+ * @param header The block header to be serialized.
+ */
+void dogecoin_block_header_serialize_writer(ser_writer* w, const dogecoin_block_header* header) {
+    ser_writer_s32(w, header->version);
+    ser_writer_u256(w, header->prev_block);
+    ser_writer_u256(w, header->merkle_root);
+    ser_writer_u32(w, header->timestamp);
+    ser_writer_u32(w, header->bits);
+    ser_writer_u32(w, header->nonce);
 }
 
 /**
@@ -138,11 +156,572 @@ void dogecoin_block_header_copy(dogecoin_block_header* dest, const dogecoin_bloc
  * @return True.
  */
 dogecoin_bool dogecoin_block_header_hash(dogecoin_block_header* header, uint256 hash) {
-    cstring* s = cstr_new_sz(80);
-    dogecoin_block_header_serialize(s, header);
-    sha256_raw((const uint8_t*)s->str, s->len, hash);
+    unsigned char buf[DOGECOIN_BLOCK_HEADER_SIZE];
+    ser_writer w;
+    ser_writer_init_buf(&w, buf, sizeof(buf));
+    dogecoin_block_header_serialize_writer(&w, header);
+    sha256_raw(buf, sizeof(buf), hash);
+    sha256_raw(hash, SHA256_DIGEST_LENGTH, hash);
+    dogecoin_bool ret = true;
+    return ret;
+}
+
+
+/**
+ * @brief This function checks whether a header is followed
+ * by an auxpow payload.
+ * 
+ * @param header The pointer to the block header.
+ * 
+ * @return 1 if the auxpow flag is set, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_header_is_auxpow(const dogecoin_block_header* header) {
+    return (header->version & DOGECOIN_BLOCK_VERSION_AUXPOW) != 0;
+}
+
+/**
+ * @brief This function extracts the merged mining chain id
+ * from a header version.
+ * 
+ * @param header The pointer to the block header.
+ * 
+ * @return The chain id.
+ */
+int32_t dogecoin_block_header_chain_id(const dogecoin_block_header* header) {
+    return header->version / DOGECOIN_BLOCK_VERSION_CHAIN_START;
+}
+
+/**
+ * @brief This function reads a vector of hashes as used by
+ * the auxpow merkle branches.
+ * 
+ * @param branch The vector receiving the hashes.
+ * @param buf The buffer to deserialize from.
+ * 
+ * @return 1 if deserialization was successful, 0 otherwise.
+ */
+static dogecoin_bool dogecoin_auxpow_deserialize_branch(vector* branch, struct const_buffer* buf) {
+    uint32_t len, i;
+    if (!deser_varlen(&len, buf) || len > buf->len / DOGECOIN_HASH_LENGTH)
+        return false;
+    for (i = 0; i < len; i++) {
+        uint8_t* hash = dogecoin_malloc(DOGECOIN_HASH_LENGTH);
+        deser_u256(hash, buf);
+        vector_add(branch, hash);
+    }
+    return true;
+}
+
+/**
+ * @brief This function allocates a new, empty auxpow.
+ * 
+ * @return A pointer to the new auxpow object.
+ */
+dogecoin_auxpow* dogecoin_auxpow_new() {
+    dogecoin_auxpow* auxpow = dogecoin_calloc(1, sizeof(*auxpow));
+    auxpow->coinbase_tx = dogecoin_tx_new();
+    auxpow->coinbase_branch = vector_new(8, dogecoin_free);
+    auxpow->chain_branch = vector_new(1, dogecoin_free);
+    return auxpow;
+}
+
+/**
+ * @brief This function frees an auxpow and everything it owns.
+ * 
+ * @param auxpow The pointer to the auxpow to be freed.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_auxpow_free(dogecoin_auxpow* auxpow) {
+    if (!auxpow) return;
+    dogecoin_tx_free(auxpow->coinbase_tx);
+    vector_free(auxpow->coinbase_branch, true);
+    vector_free(auxpow->chain_branch, true);
+    dogecoin_free(auxpow);
+}
+
+/**
+ * @brief This function deserializes the auxpow following
+ * a merge mined block header.
+ * 
+ * @param auxpow The auxpow object to be constructed.
+ * @param buf The buffer to deserialize from.
+ * 
+ * @return 1 if deserialization was successful, 0 otherwise.
+ */
+dogecoin_bool dogecoin_auxpow_deserialize(dogecoin_auxpow* auxpow, struct const_buffer* buf) {
+    size_t consumed = 0;
+    if (!dogecoin_tx_deserialize(buf->p, buf->len, auxpow->coinbase_tx, &consumed))
+        return false;
+    deser_skip(buf, consumed);
+    if (!deser_u256(auxpow->parent_hash, buf))
+        return false;
+    if (!dogecoin_auxpow_deserialize_branch(auxpow->coinbase_branch, buf))
+        return false;
+    if (!deser_s32(&auxpow->coinbase_index, buf))
+        return false;
+    if (!dogecoin_auxpow_deserialize_branch(auxpow->chain_branch, buf))
+        return false;
+    if (!deser_s32(&auxpow->chain_index, buf))
+        return false;
+    return dogecoin_block_header_deserialize(&auxpow->parent_header, buf);
+}
+
+static void dogecoin_block_tx_free_cb(void* data) {
+    dogecoin_tx_free((dogecoin_tx*)data);
+}
+
+/**
+ * @brief This function allocates a new, empty block.
+ * 
+ * @return A pointer to the new block object.
+ */
+dogecoin_block* dogecoin_block_new() {
+    dogecoin_block* block = dogecoin_calloc(1, sizeof(*block));
+    block->txs = vector_new(1, dogecoin_block_tx_free_cb);
+    return block;
+}
+
+/**
+ * @brief This function frees a block, its auxpow and all
+ * of its transactions.
+ * 
+ * @param block The pointer to the block to be freed.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_block_free(dogecoin_block* block) {
+    if (!block) return;
+    dogecoin_auxpow_free(block->auxpow);
+    vector_free(block->txs, true);
+    dogecoin_free(block);
+}
+
+/**
+ * @brief This function deserializes a complete block: the
+ * header, the auxpow if flagged and every transaction.
+ * 
+ * @param block The block object to be constructed.
+ * @param buf The buffer to deserialize from.
+ * 
+ * @return 1 if deserialization was successful, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_deserialize(dogecoin_block* block, struct const_buffer* buf) {
+    uint32_t tx_count, i;
+    if (!dogecoin_block_header_deserialize(&block->header, buf))
+        return false;
+    if (dogecoin_block_header_is_auxpow(&block->header)) {
+        block->auxpow = dogecoin_auxpow_new();
+        if (!dogecoin_auxpow_deserialize(block->auxpow, buf))
+            return false;
+    }
+    /* a transaction takes at least 60 bytes */
+    if (!deser_varlen(&tx_count, buf) || tx_count > buf->len / 60)
+        return false;
+    for (i = 0; i < tx_count; i++) {
+        size_t consumed = 0;
+        dogecoin_tx* tx = dogecoin_tx_new();
+        if (!dogecoin_tx_deserialize(buf->p, buf->len, tx, &consumed)) {
+            dogecoin_tx_free(tx);
+            return false;
+        }
+        deser_skip(buf, consumed);
+        vector_add(block->txs, tx);
+    }
+    return true;
+}
+
+/**
+ * @brief This function reads a merkle branch without copying it.
+ * 
+ * @param branch Set to the first hash of the branch.
+ * @param len Set to the number of hashes.
+ * @param buf The buffer to read from.
+ * 
+ * @return 1 if the branch is complete, 0 otherwise.
+ */
+static dogecoin_bool dogecoin_auxpow_view_branch(const unsigned char** branch, uint32_t* len, struct const_buffer* buf) {
+    if (!deser_varlen(len, buf) || *len > buf->len / DOGECOIN_HASH_LENGTH)
+        return false;
+    *branch = buf->p;
+    return deser_skip(buf, (size_t)*len * DOGECOIN_HASH_LENGTH);
+}
+
+/**
+ * @brief This function parses a header followed by its
+ * auxpow, if the version flags one, as found at the start
+ * of blocks and merkleblock messages.
+ * 
+ * @param header The header to fill.
+ * @param has_auxpow Set if an auxpow follows the header.
+ * @param aux The auxpow view to fill, pointing into buf.
+ * @param buf The buffer to parse, advanced past the auxpow.
+ * 
+ * @return 1 if parsing was successful, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_header_view_parse(dogecoin_block_header* header, dogecoin_bool* has_auxpow, dogecoin_auxpow_view* aux, struct const_buffer* buf) {
+    dogecoin_mem_zero(aux, sizeof(*aux));
+    *has_auxpow = false;
+    if (!dogecoin_block_header_deserialize(header, buf))
+        return false;
+
+    if (dogecoin_block_header_is_auxpow(header)) {
+        *has_auxpow = true;
+        aux->coinbase_tx.p = buf->p;
+        if (!dogecoin_tx_skip(buf))
+            return false;
+        aux->coinbase_tx.len = (const char*)buf->p - (const char*)aux->coinbase_tx.p;
+        aux->parent_hash = buf->p;
+        if (!deser_skip(buf, DOGECOIN_HASH_LENGTH))
+            return false;
+        if (!dogecoin_auxpow_view_branch(&aux->coinbase_branch, &aux->coinbase_branch_len, buf))
+            return false;
+        if (!deser_s32(&aux->coinbase_index, buf))
+            return false;
+        if (!dogecoin_auxpow_view_branch(&aux->chain_branch, &aux->chain_branch_len, buf))
+            return false;
+        if (!deser_s32(&aux->chain_index, buf))
+            return false;
+        aux->parent_header = buf->p;
+        if (!deser_skip(buf, DOGECOIN_BLOCK_HEADER_SIZE))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief This function parses a serialized block into a
+ * view. Only the header and auxpow are decoded, the view
+ * keeps pointers into the buffer for everything else.
+ * 
+ * @param view The view to fill.
+ * @param buf The buffer holding the block, advanced to the first transaction.
+ * 
+ * @return 1 if parsing was successful, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_view_parse(dogecoin_block_view* view, struct const_buffer* buf) {
+    dogecoin_mem_zero(view, sizeof(*view));
+    if (!dogecoin_block_header_view_parse(&view->header, &view->has_auxpow, &view->auxpow, buf))
+        return false;
+
+    if (!deser_varlen(&view->tx_count, buf) || view->tx_count > buf->len / 60)
+        return false;
+    view->txs = *buf;
+    return true;
+}
+
+/**
+ * @brief This function releases the transaction index of
+ * a view. The viewed buffer is not touched.
+ * 
+ * @param view The view to be freed.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_block_view_free(dogecoin_block_view* view) {
+    if (view->tx_offsets) {
+        dogecoin_free(view->tx_offsets);
+        view->tx_offsets = NULL;
+    }
+}
+
+/**
+ * @brief This function locates the start of every transaction
+ * in the view. It is called on first access and only needs to
+ * be called directly to learn the size of the transaction list.
+ * 
+ * @param view The view to index.
+ * @param txs_size Set to the number of bytes used by all transactions (may be NULL).
+ * 
+ * @return 1 if all transactions are complete, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_view_index(dogecoin_block_view* view, size_t* txs_size) {
+    if (!view->tx_offsets) {
+        struct const_buffer buf = view->txs;
+        size_t* offsets = dogecoin_malloc(((size_t)view->tx_count + 1) * sizeof(size_t));
+        uint32_t i;
+        for (i = 0; i < view->tx_count; i++) {
+            offsets[i] = view->txs.len - buf.len;
+            if (!dogecoin_tx_skip(&buf)) {
+                dogecoin_free(offsets);
+                return false;
+            }
+        }
+        offsets[view->tx_count] = view->txs.len - buf.len;
+        view->tx_offsets = offsets;
+    }
+    if (txs_size)
+        *txs_size = view->tx_offsets[view->tx_count];
+    return true;
+}
+
+/**
+ * @brief This function returns the serialized bytes of a
+ * single transaction of the view.
+ * 
+ * @param view The view holding the transaction.
+ * @param idx The index of the transaction in the block.
+ * @param raw Set to the serialized transaction.
+ * 
+ * @return 1 if the transaction exists, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_view_tx_raw(dogecoin_block_view* view, uint32_t idx, struct const_buffer* raw) {
+    if (idx >= view->tx_count || !dogecoin_block_view_index(view, NULL))
+        return false;
+    raw->p = (const char*)view->txs.p + view->tx_offsets[idx];
+    raw->len = view->tx_offsets[idx + 1] - view->tx_offsets[idx];
+    return true;
+}
+
+/**
+ * @brief This function hashes a transaction of the view
+ * straight from its serialized bytes.
+ * 
+ * @param view The view holding the transaction.
+ * @param idx The index of the transaction in the block.
+ * @param hash The transaction hash.
+ * 
+ * @return 1 if the transaction exists, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_view_tx_hash(dogecoin_block_view* view, uint32_t idx, uint256 hash) {
+    struct const_buffer raw;
+    if (!dogecoin_block_view_tx_raw(view, idx, &raw))
+        return false;
+    sha256_raw(raw.p, raw.len, hash);
     sha256_raw(hash, SHA256_DIGEST_LENGTH, hash);
-    cstr_free(s, true);
+    return true;
+}
+
+/**
+ * @brief This function decodes a single transaction of the view.
+ * 
+ * @param view The view holding the transaction.
+ * @param idx The index of the transaction in the block.
+ * @param tx The freshly allocated transaction to decode into.
+ * 
+ * @return 1 if decoding was successful, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_view_tx(dogecoin_block_view* view, uint32_t idx, dogecoin_tx* tx) {
+    struct const_buffer raw;
+    if (!dogecoin_block_view_tx_raw(view, idx, &raw))
+        return false;
+    return dogecoin_tx_deserialize(raw.p, raw.len, tx, NULL);
+}
+
+/**
+ * @brief This function computes the merkle root over the
+ * transaction hashes of a block.
+ * 
+ * @param block The block.
+ * @param root The resulting root.
+ * @param mutated Set if the transaction list repeats a subtree (may be NULL).
+ * 
+ * @return 1 if the block has transactions, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_merkle_root(const dogecoin_block* block, uint256 root, dogecoin_bool* mutated) {
+    size_t i, count = block->txs->len;
+    uint256* leaves;
+    dogecoin_bool ret;
+    if (count == 0)
+        return dogecoin_merkle_root(NULL, 0, root, mutated);
+    leaves = dogecoin_malloc(count * sizeof(uint256));
+    for (i = 0; i < count; i++)
+        dogecoin_tx_hash(vector_idx(block->txs, i), leaves[i]);
+    ret = dogecoin_merkle_root((const uint256*)leaves, count, root, mutated);
+    dogecoin_free(leaves);
+    return ret;
+}
+
+/**
+ * @brief This function computes the merkle root over the
+ * transactions of a view, hashing them from their
+ * serialized bytes.
+ * 
+ * @param view The view.
+ * @param root The resulting root.
+ * @param mutated Set if the transaction list repeats a subtree (may be NULL).
+ * 
+ * @return 1 if all transactions could be hashed, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_view_merkle_root(dogecoin_block_view* view, uint256 root, dogecoin_bool* mutated) {
+    uint32_t i;
+    uint256* leaves;
     dogecoin_bool ret = true;
+    if (view->tx_count == 0 || !dogecoin_block_view_index(view, NULL))
+        return dogecoin_merkle_root(NULL, 0, root, mutated);
+    leaves = dogecoin_malloc((size_t)view->tx_count * sizeof(uint256));
+    for (i = 0; i < view->tx_count && ret; i++)
+        ret = dogecoin_block_view_tx_hash(view, i, leaves[i]);
+    if (ret)
+        ret = dogecoin_merkle_root((const uint256*)leaves, view->tx_count, root, mutated);
+    dogecoin_free(leaves);
+    return ret;
+}
+
+/* first occurrence of needle in haystack, NULL if there is none */
+static const unsigned char* dogecoin_auxpow_search(const unsigned char* haystack, size_t len, const unsigned char* needle, size_t needle_len) {
+    size_t i;
+    for (i = 0; i + needle_len <= len; i++) {
+        if (haystack[i] == needle[0] && memcmp(haystack + i, needle, needle_len) == 0)
+            return haystack + i;
+    }
+    return NULL;
+}
+
+/**
+ * @brief This function locates the script of the first input
+ * of a serialized coinbase transaction.
+ * 
+ * @param coinbase The serialized coinbase.
+ * @param script Set to the scriptSig.
+ * 
+ * @return 1 if the coinbase has an input, 0 otherwise.
+ */
+static dogecoin_bool dogecoin_auxpow_coinbase_script(const struct const_buffer* coinbase, struct const_buffer* script) {
+    struct const_buffer buf = *coinbase;
+    uint32_t vin_count, script_len;
+    if (!deser_skip(&buf, 4) || !deser_varlen(&vin_count, &buf) || vin_count == 0)
+        return false;
+    if (!deser_skip(&buf, 36) || !deser_varlen(&script_len, &buf) || script_len > buf.len)
+        return false;
+    script->p = buf.p;
+    script->len = script_len;
+    return true;
+}
+
+/**
+ * @brief This function derives the slot a chain must use in
+ * the merged mining tree from the nonce in the coinbase.
+ * 
+ * @param nonce The nonce following the merged mining root.
+ * @param chain_id The chain id.
+ * @param height The height of the merged mining tree.
+ * 
+ * @return The expected chain index.
+ */
+static uint32_t dogecoin_auxpow_expected_index(uint32_t nonce, int32_t chain_id, unsigned int height) {
+    uint32_t rand = nonce;
+    rand = rand * 1103515245 + 12345;
+    rand += (uint32_t)chain_id;
+    rand = rand * 1103515245 + 12345;
+    return rand % (1u << height);
+}
+
+/**
+ * @brief This function checks that an auxpow proves work
+ * on a block: the block hash leads through the chain branch
+ * to a merged mining root committed in the parent coinbase,
+ * which leads through the coinbase branch to the merkle root
+ * of the parent header.
+ * 
+ * @param auxpow The auxpow view.
+ * @param aux_block_hash The hash of the merge mined block.
+ * @param chain_id The chain id of the merge mined chain.
+ * 
+ * @return 1 if the auxpow commits to the block, 0 otherwise.
+ */
+dogecoin_bool dogecoin_auxpow_view_check(const dogecoin_auxpow_view* auxpow, const uint256 aux_block_hash, int32_t chain_id) {
+    static const unsigned char merged_mining_header[4] = {0xfa, 0xbe, 'm', 'm'};
+    unsigned char root_be[DOGECOIN_HASH_LENGTH];
+    uint256 chain_root, coinbase_hash, parent_root;
+    struct const_buffer script;
+    const unsigned char *script_end, *head, *pc;
+    uint32_t size, nonce;
+    int32_t parent_version;
+    int i;
+
+    /* the coinbase is the first transaction of the parent block */
+    if (auxpow->coinbase_index != 0)
+        return false;
+    parent_version = (int32_t)((uint32_t)auxpow->parent_header[0] | ((uint32_t)auxpow->parent_header[1] << 8) | ((uint32_t)auxpow->parent_header[2] << 16) | ((uint32_t)auxpow->parent_header[3] << 24));
+    if (parent_version / DOGECOIN_BLOCK_VERSION_CHAIN_START == chain_id)
+        return false;
+    if (auxpow->chain_branch_len > DOGECOIN_AUXPOW_MAX_CHAIN_BRANCH)
+        return false;
+
+    dogecoin_merkle_root_from_branch(aux_block_hash, (const uint256*)auxpow->chain_branch, auxpow->chain_branch_len, auxpow->chain_index, chain_root);
+    for (i = 0; i < DOGECOIN_HASH_LENGTH; i++)
+        root_be[i] = chain_root[DOGECOIN_HASH_LENGTH - 1 - i];
+
+    sha256_raw(auxpow->coinbase_tx.p, auxpow->coinbase_tx.len, coinbase_hash);
+    sha256_raw(coinbase_hash, SHA256_DIGEST_LENGTH, coinbase_hash);
+    dogecoin_merkle_root_from_branch(coinbase_hash, (const uint256*)auxpow->coinbase_branch, auxpow->coinbase_branch_len, auxpow->coinbase_index, parent_root);
+    if (memcmp(parent_root, auxpow->parent_header + 36, DOGECOIN_HASH_LENGTH) != 0)
+        return false;
+
+    if (!dogecoin_auxpow_coinbase_script(&auxpow->coinbase_tx, &script))
+        return false;
+    script_end = (const unsigned char*)script.p + script.len;
+    head = dogecoin_auxpow_search(script.p, script.len, merged_mining_header, sizeof(merged_mining_header));
+    pc = dogecoin_auxpow_search(script.p, script.len, root_be, sizeof(root_be));
+    if (!pc)
+        return false;
+    if (head) {
+        /* a single merged mining header, right in front of the root */
+        if (dogecoin_auxpow_search(head + 1, (size_t)(script_end - head - 1), merged_mining_header, sizeof(merged_mining_header)))
+            return false;
+        if (head + sizeof(merged_mining_header) != pc)
+            return false;
+    } else if (pc - (const unsigned char*)script.p > 20) {
+        /* legacy commitments without header must start early in the script */
+        return false;
+    }
+
+    pc += sizeof(root_be);
+    if (script_end - pc < 8)
+        return false;
+    size = (uint32_t)pc[0] | ((uint32_t)pc[1] << 8) | ((uint32_t)pc[2] << 16) | ((uint32_t)pc[3] << 24);
+    if (size != (1u << auxpow->chain_branch_len))
+        return false;
+    nonce = (uint32_t)pc[4] | ((uint32_t)pc[5] << 8) | ((uint32_t)pc[6] << 16) | ((uint32_t)pc[7] << 24);
+    return (uint32_t)auxpow->chain_index == dogecoin_auxpow_expected_index(nonce, chain_id, auxpow->chain_branch_len);
+}
+
+/* copies the hashes of a branch vector into one contiguous array */
+static unsigned char* dogecoin_auxpow_flatten_branch(const vector* branch) {
+    unsigned char* flat = dogecoin_malloc(branch->len * DOGECOIN_HASH_LENGTH + 1);
+    size_t i;
+    for (i = 0; i < branch->len; i++)
+        memcpy(flat + i * DOGECOIN_HASH_LENGTH, vector_idx(branch, i), DOGECOIN_HASH_LENGTH);
+    return flat;
+}
+
+/**
+ * @brief This function checks a decoded auxpow, see
+ * dogecoin_auxpow_view_check.
+ * 
+ * @param auxpow The auxpow.
+ * @param aux_block_hash The hash of the merge mined block.
+ * @param chain_id The chain id of the merge mined chain.
+ * 
+ * @return 1 if the auxpow commits to the block, 0 otherwise.
+ */
+dogecoin_bool dogecoin_auxpow_check(const dogecoin_auxpow* auxpow, const uint256 aux_block_hash, int32_t chain_id) {
+    dogecoin_auxpow_view view;
+    cstring* coinbase = cstr_new_sz(256);
+    cstring* parent = cstr_new_sz(DOGECOIN_BLOCK_HEADER_SIZE);
+    unsigned char* coinbase_branch = dogecoin_auxpow_flatten_branch(auxpow->coinbase_branch);
+    unsigned char* chain_branch = dogecoin_auxpow_flatten_branch(auxpow->chain_branch);
+    dogecoin_bool ret;
+
+    dogecoin_tx_serialize(coinbase, auxpow->coinbase_tx);
+    dogecoin_block_header_serialize(parent, &auxpow->parent_header);
+    dogecoin_mem_zero(&view, sizeof(view));
+    view.coinbase_tx.p = coinbase->str;
+    view.coinbase_tx.len = coinbase->len;
+    view.parent_hash = auxpow->parent_hash;
+    view.coinbase_branch = coinbase_branch;
+    view.coinbase_branch_len = (uint32_t)auxpow->coinbase_branch->len;
+    view.coinbase_index = auxpow->coinbase_index;
+    view.chain_branch = chain_branch;
+    view.chain_branch_len = (uint32_t)auxpow->chain_branch->len;
+    view.chain_index = auxpow->chain_index;
+    view.parent_header = (const unsigned char*)parent->str;
+    ret = dogecoin_auxpow_view_check(&view, aux_block_hash, chain_id);
+
+    dogecoin_free(coinbase_branch);
+    dogecoin_free(chain_branch);
+    cstr_free(coinbase, true);
+    cstr_free(parent, true);
     return ret;
 }
@@ -0,0 +1,607 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <dogecoin/blockfile.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/pow.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/sha2.h>
+#include <dogecoin/utils.h>
+#include <uthash/uthash.h>
+
+/*
+ * A scan runs in three phases:
+ *
+ * 1. every blk*.dat file is mapped and searched for records
+ *    (<netmagic> <u32 size> <block>); worker threads take one file each
+ *    and hash the 80 byte headers they find
+ * 2. the records are linked by their previous block hash, the block with
+ *    the most accumulated work reachable from the root (the record without
+ *    a parent) is the tip of the best chain
+ * 3. the blocks of that chain are parsed by the worker pool inside a
+ *    sliding window and handed to the callback strictly by height
+ */
+
+typedef struct dogecoin_blockfile_map_ {
+    const unsigned char* data;
+    size_t len;
+} dogecoin_blockfile_map;
+
+typedef struct dogecoin_blockfile_record_ {
+    uint256 hash;
+    uint256 prev;
+    uint32_t file;
+    size_t offset;
+    size_t len;
+    int64_t height; /* -1 while unknown, -2 if not connected to the root */
+    uint32_t bits;
+    uint256 chainwork; /* valid once the height is known */
+    UT_hash_handle hh;
+} dogecoin_blockfile_record;
+
+typedef struct dogecoin_blockfile_file_index_ {
+    dogecoin_blockfile_record* records;
+    size_t count;
+    size_t alloc;
+} dogecoin_blockfile_file_index;
+
+/* shared state of the worker pool */
+typedef struct dogecoin_blockfile_pool_ {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    const dogecoin_blockfile_scan_params* params;
+    const char* magic;
+    dogecoin_blockfile_map* maps;
+    size_t map_count;
+    dogecoin_blockfile_file_index* file_indexes;
+
+    /* phase 3 */
+    dogecoin_blockfile_record** chain;
+    size_t chain_len;
+    dogecoin_blockfile_block* slots;
+    dogecoin_bool* slot_ready;
+    dogecoin_bool* slot_ok;
+    size_t window;
+    size_t next_claim; /* next chain position a worker decodes */
+    size_t delivered;  /* positions below have been handed to the callback */
+    dogecoin_bool stop;
+    int phase;
+} dogecoin_blockfile_pool;
+
+/**
+ * @brief This function appends the blocks directory of the
+ * given chain below the default datadir to path_out.
+ *
+ * @param chain The chain whose directory is requested.
+ * @param path_out The cstring receiving the path.
+ *
+ * @return Nothing.
+ */
+void dogecoin_blockfile_default_dir(const dogecoin_chainparams* chain, cstring* path_out)
+{
+    dogecoin_get_default_datadir(path_out);
+    /* mainnet keeps its blocks directly in the datadir */
+    if (strcmp(chain->chainname, "main") != 0) {
+        cstr_append_c(path_out, '/');
+        cstr_append_buf(path_out, chain->chainname, strlen(chain->chainname));
+    }
+    cstr_append_buf(path_out, "/blocks", 7);
+}
+
+
+/**
+ * @brief This function sets the default parameters for a
+ * scan: default directory, one thread per cpu, no full
+ * transaction decoding.
+ *
+ * @param params The parameters to initialize.
+ * @param chain The chain to scan.
+ *
+ * @return Nothing.
+ */
+void dogecoin_blockfile_scan_params_init(dogecoin_blockfile_scan_params* params, const dogecoin_chainparams* chain)
+{
+    dogecoin_mem_zero(params, sizeof(*params));
+    params->chain = chain;
+    params->window = 256;
+}
+
+
+/**
+ * @brief This function maps a block file read only.
+ *
+ * @param path The path of the file.
+ * @param map The mapping to fill.
+ *
+ * @return 1 if the file was mapped, 0 otherwise.
+ */
+static dogecoin_bool dogecoin_blockfile_map_file(const char* path, dogecoin_blockfile_map* map)
+{
+#ifdef WIN32
+    /* no mmap, read the file instead */
+    FILE* file = fopen(path, "rb");
+    long size;
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    map->len = size > 0 ? (size_t)size : 0;
+    map->data = map->len ? dogecoin_malloc(map->len) : NULL;
+    if (map->len && fread((void*)map->data, 1, map->len, file) != map->len) {
+        dogecoin_free((void*)map->data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+    return true;
+#else
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    map->len = (size_t)st.st_size;
+    map->data = NULL;
+    if (map->len) {
+        void* p = mmap(NULL, map->len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        madvise(p, map->len, MADV_SEQUENTIAL);
+        map->data = p;
+    }
+    close(fd);
+    return true;
+#endif
+}
+
+
+static void dogecoin_blockfile_unmap(dogecoin_blockfile_map* map)
+{
+    if (!map->data)
+        return;
+#ifdef WIN32
+    dogecoin_free((void*)map->data);
+#else
+    munmap((void*)map->data, map->len);
+#endif
+    map->data = NULL;
+}
+
+
+/**
+ * @brief This function finds all block records of one file
+ * and hashes their headers.
+ *
+ * @param pool The pool holding the mapping and the magic.
+ * @param file The index of the file.
+ *
+ * @return Nothing.
+ */
+static void dogecoin_blockfile_index_file(dogecoin_blockfile_pool* pool, uint32_t file)
+{
+    const unsigned char* data = pool->maps[file].data;
+    size_t len = pool->maps[file].len, pos = 0;
+    dogecoin_blockfile_file_index* index = &pool->file_indexes[file];
+
+    while (len >= 8 && pos <= len - 8) {
+        /* records are back to back, but the preallocated tail of a file is zero filled */
+        if (memcmp(data + pos, pool->magic, 4) != 0) {
+            const unsigned char* next = memchr(data + pos + 1, (unsigned char)pool->magic[0], len - pos - 1);
+            if (!next)
+                break;
+            pos = next - data;
+            continue;
+        }
+        uint32_t size = data[pos + 4] | (data[pos + 5] << 8) | (data[pos + 6] << 16) | ((uint32_t)data[pos + 7] << 24);
+        if (size < DOGECOIN_BLOCK_HEADER_SIZE || size > len - pos - 8) {
+            pos++;
+            continue;
+        }
+        if (index->count == index->alloc) {
+            index->alloc = index->alloc ? index->alloc * 2 : 1024;
+            index->records = dogecoin_realloc(index->records, index->alloc * sizeof(*index->records));
+        }
+        dogecoin_blockfile_record* rec = &index->records[index->count++];
+        dogecoin_mem_zero(rec, sizeof(*rec));
+        rec->file = file;
+        rec->offset = pos + 8;
+        rec->len = size;
+        rec->height = -1;
+        memcpy(rec->prev, data + pos + 8 + 4, DOGECOIN_HASH_LENGTH);
+        rec->bits = data[pos + 8 + 72] | (data[pos + 8 + 73] << 8) | (data[pos + 8 + 74] << 16) | ((uint32_t)data[pos + 8 + 75] << 24);
+        sha256_raw(data + pos + 8, DOGECOIN_BLOCK_HEADER_SIZE, rec->hash);
+        sha256_raw(rec->hash, SHA256_DIGEST_LENGTH, rec->hash);
+        pos += 8 + (size_t)size;
+    }
+}
+
+
+/**
+ * @brief This function parses one block of the best chain
+ * into its slot of the window.
+ *
+ * @param pool The worker pool.
+ * @param idx The chain position to decode.
+ *
+ * @return 1 if the block could be parsed, 0 otherwise.
+ */
+static dogecoin_bool dogecoin_blockfile_decode(dogecoin_blockfile_pool* pool, size_t idx)
+{
+    dogecoin_blockfile_record* rec = pool->chain[idx];
+    dogecoin_blockfile_block* out = &pool->slots[idx % pool->window];
+    struct const_buffer buf;
+
+    dogecoin_mem_zero(out, sizeof(*out));
+    out->height = (uint32_t)rec->height;
+    memcpy(out->hash, rec->hash, DOGECOIN_HASH_LENGTH);
+    out->data = pool->maps[rec->file].data + rec->offset;
+    out->len = rec->len;
+    out->file = rec->file;
+    out->offset = rec->offset;
+
+    buf.p = out->data;
+    buf.len = out->len;
+    if (!dogecoin_block_view_parse(&out->view, &buf) || !dogecoin_block_view_index(&out->view, NULL))
+        return false;
+    if (pool->params->decode_txs) {
+        out->block = dogecoin_block_new();
+        buf.p = out->data;
+        buf.len = out->len;
+        if (!dogecoin_block_deserialize(out->block, &buf))
+            return false;
+    }
+    return true;
+}
+
+
+static void dogecoin_blockfile_release(dogecoin_blockfile_block* block)
+{
+    dogecoin_block_view_free(&block->view);
+    if (block->block) {
+        dogecoin_block_free(block->block);
+        block->block = NULL;
+    }
+}
+
+
+/**
+ * @brief This function is the body of a worker thread. In
+ * the index phase it takes whole files, in the decode phase
+ * it takes chain positions as long as they fit the window.
+ *
+ * @param arg The worker pool.
+ *
+ * @return NULL.
+ */
+static void* dogecoin_blockfile_worker(void* arg)
+{
+    dogecoin_blockfile_pool* pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->phase == 1) {
+        while (pool->next_claim < pool->map_count) {
+            size_t file = pool->next_claim++;
+            pthread_mutex_unlock(&pool->lock);
+            dogecoin_blockfile_index_file(pool, (uint32_t)file);
+            pthread_mutex_lock(&pool->lock);
+        }
+    } else {
+        for (;;) {
+            while (!pool->stop && pool->next_claim < pool->chain_len && pool->next_claim >= pool->delivered + pool->window)
+                pthread_cond_wait(&pool->cond, &pool->lock);
+            if (pool->stop || pool->next_claim >= pool->chain_len)
+                break;
+            size_t idx = pool->next_claim++;
+            pthread_mutex_unlock(&pool->lock);
+            dogecoin_bool ok = dogecoin_blockfile_decode(pool, idx);
+            pthread_mutex_lock(&pool->lock);
+            pool->slot_ok[idx % pool->window] = ok;
+            pool->slot_ready[idx % pool->window] = true;
+            pthread_cond_broadcast(&pool->cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+
+/**
+ * @brief This function runs the current phase on the given
+ * number of threads and waits for the index phase to finish.
+ *
+ * @param pool The worker pool.
+ * @param threads The thread handles.
+ * @param count The number of threads to start.
+ *
+ * @return The number of threads started.
+ */
+static size_t dogecoin_blockfile_start(dogecoin_blockfile_pool* pool, pthread_t* threads, size_t count)
+{
+    size_t started = 0;
+    for (; started < count; started++) {
+        if (pthread_create(&threads[started], NULL, dogecoin_blockfile_worker, pool) != 0)
+            break;
+    }
+    return started;
+}
+
+
+static void dogecoin_blockfile_join(pthread_t* threads, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+        pthread_join(threads[i], NULL);
+}
+
+
+/**
+ * @brief This function sets the height and the accumulated
+ * work of a record by walking back to the first ancestor whose
+ * height is known. Blocks with invalid bits are treated as not
+ * connected to the root.
+ *
+ * @param head The hash table of all records.
+ * @param rec The record whose height is needed.
+ * @param stack Scratch space for the walk.
+ *
+ * @return Nothing.
+ */
+static void dogecoin_blockfile_set_height(dogecoin_blockfile_record* head, dogecoin_blockfile_record* rec, vector* stack)
+{
+    uint256 work;
+    vector_resize(stack, 0);
+    while (rec->height == -1) {
+        dogecoin_blockfile_record* parent = NULL;
+        vector_add(stack, rec);
+        HASH_FIND(hh, head, rec->prev, DOGECOIN_HASH_LENGTH, parent);
+        if (!parent) {
+            /* a block without a parent is the root only if it is genesis */
+            static const uint256 null_hash = {0};
+            rec->height = -2;
+            if (memcmp(rec->prev, null_hash, DOGECOIN_HASH_LENGTH) == 0 && dogecoin_pow_block_work(rec->bits, work)) {
+                rec->height = 0;
+                memcpy(rec->chainwork, work, sizeof(work));
+            }
+            vector_remove_idx(stack, stack->len - 1);
+            break;
+        }
+        rec = parent;
+    }
+    while (stack->len) {
+        dogecoin_blockfile_record* child = vector_idx(stack, stack->len - 1);
+        child->height = -2;
+        if (rec->height >= 0 && dogecoin_pow_block_work(child->bits, work)) {
+            child->height = rec->height + 1;
+            memcpy(child->chainwork, rec->chainwork, sizeof(child->chainwork));
+            dogecoin_pow_work_add(child->chainwork, work);
+        }
+        rec = child;
+        vector_remove_idx(stack, stack->len - 1);
+    }
+}
+
+
+/**
+ * @brief This function scans all blk*.dat files of a blocks
+ * directory and delivers the blocks of the best chain in order.
+ *
+ * @param params The scan parameters.
+ * @param delivered Set to the number of blocks handed to the callback (may be NULL).
+ *
+ * @return 1 if the scan completed or was stopped by the callback, 0 on errors.
+ */
+dogecoin_bool dogecoin_blockfile_scan(const dogecoin_blockfile_scan_params* params, uint32_t* delivered)
+{
+    dogecoin_blockfile_pool pool;
+    dogecoin_blockfile_record* all = NULL;
+    dogecoin_blockfile_record* head = NULL;
+    dogecoin_blockfile_record* tip = NULL;
+    pthread_t* threads = NULL;
+    size_t nthreads = params->threads, started, total = 0, i, j;
+    dogecoin_bool ret = true;
+    cstring* dir;
+
+    if (delivered)
+        *delivered = 0;
+    if (!params->chain || !params->cb)
+        return false;
+
+    dogecoin_mem_zero(&pool, sizeof(pool));
+    pool.params = params;
+    pool.magic = (const char*)params->chain->netmagic;
+    pool.window = params->window ? params->window : 256;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+
+    if (nthreads == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? (size_t)cpus : 1;
+#else
+        nthreads = 1;
+#endif
+    }
+    threads = dogecoin_calloc(nthreads, sizeof(pthread_t));
+
+    /* map blk00000.dat, blk00001.dat, ... until the first missing file */
+    if (params->blocks_dir) {
+        dir = cstr_new(params->blocks_dir);
+    } else {
+        dir = cstr_new_sz(256);
+        dogecoin_blockfile_default_dir(params->chain, dir);
+    }
+    for (;;) {
+        char path[1024];
+        dogecoin_blockfile_map map;
+        snprintf(path, sizeof(path), "%s/blk%05u.dat", dir->str, (unsigned int)pool.map_count);
+        if (!dogecoin_blockfile_map_file(path, &map))
+            break;
+        pool.maps = dogecoin_realloc(pool.maps, (pool.map_count + 1) * sizeof(*pool.maps));
+        pool.maps[pool.map_count++] = map;
+    }
+    cstr_free(dir, true);
+    if (pool.map_count == 0) {
+        ret = false;
+        goto out;
+    }
+
+    /* phase 1: index the files in parallel */
+    pool.file_indexes = dogecoin_calloc(pool.map_count, sizeof(*pool.file_indexes));
+    pool.phase = 1;
+    started = dogecoin_blockfile_start(&pool, threads, nthreads < pool.map_count ? nthreads : pool.map_count);
+    if (started == 0)
+        dogecoin_blockfile_worker(&pool);
+    dogecoin_blockfile_join(threads, started);
+
+    /* phase 2: link the records, the records array must not move once hashed */
+    for (i = 0; i < pool.map_count; i++)
+        total += pool.file_indexes[i].count;
+    all = dogecoin_calloc(total ? total : 1, sizeof(*all));
+    for (i = 0, j = 0; i < pool.map_count; i++) {
+        if (pool.file_indexes[i].count)
+            memcpy(&all[j], pool.file_indexes[i].records, pool.file_indexes[i].count * sizeof(*all));
+        j += pool.file_indexes[i].count;
+        dogecoin_free(pool.file_indexes[i].records);
+    }
+    for (i = 0; i < total; i++) {
+        dogecoin_blockfile_record* dup = NULL;
+        HASH_FIND(hh, head, all[i].hash, DOGECOIN_HASH_LENGTH, dup);
+        if (!dup) {
+            HASH_ADD(hh, head, hash, DOGECOIN_HASH_LENGTH, &all[i]);
+        }
+    }
+    vector* stack = vector_new(64, NULL);
+    for (i = 0; i < total; i++) {
+        dogecoin_blockfile_record* rec = NULL;
+        HASH_FIND(hh, head, all[i].hash, DOGECOIN_HASH_LENGTH, rec);
+        if (rec != &all[i])
+            continue; /* duplicate record */
+        dogecoin_blockfile_set_height(head, rec, stack);
+        if (rec->height >= 0 && (!tip || dogecoin_pow_work_cmp(rec->chainwork, tip->chainwork) > 0))
+            tip = rec;
+    }
+    vector_free(stack, true);
+    if (!tip)
+        goto out;
+
+    pool.chain_len = (size_t)tip->height + 1;
+    pool.chain = dogecoin_calloc(pool.chain_len, sizeof(*pool.chain));
+    for (dogecoin_blockfile_record* rec = tip; rec; ) {
+        dogecoin_blockfile_record* parent = NULL;
+        pool.chain[rec->height] = rec;
+        if (rec->height == 0)
+            break;
+        HASH_FIND(hh, head, rec->prev, DOGECOIN_HASH_LENGTH, parent);
+        rec = parent;
+    }
+
+    /* phase 3: decode in parallel, deliver in order */
+    pool.slots = dogecoin_calloc(pool.window, sizeof(*pool.slots));
+    pool.slot_ready = dogecoin_calloc(pool.window, sizeof(*pool.slot_ready));
+    pool.slot_ok = dogecoin_calloc(pool.window, sizeof(*pool.slot_ok));
+    pool.next_claim = 0;
+    pool.phase = 3;
+    started = nthreads > 1 ? dogecoin_blockfile_start(&pool, threads, nthreads) : 0;
+
+    for (i = 0; i < pool.chain_len; i++) {
+        size_t slot = i % pool.window;
+        dogecoin_bool ok;
+        if (started == 0) {
+            /* single threaded, decode in place */
+            pool.slot_ok[slot] = dogecoin_blockfile_decode(&pool, i);
+            pool.slot_ready[slot] = true;
+        }
+        pthread_mutex_lock(&pool.lock);
+        while (!pool.slot_ready[slot])
+            pthread_cond_wait(&pool.cond, &pool.lock);
+        ok = pool.slot_ok[slot];
+        pthread_mutex_unlock(&pool.lock);
+
+        dogecoin_bool cont = ok && params->cb(&pool.slots[slot], params->ctx);
+        if (!ok)
+            ret = false;
+        else if (delivered)
+            (*delivered)++;
+        dogecoin_blockfile_release(&pool.slots[slot]);
+
+        pthread_mutex_lock(&pool.lock);
+        pool.slot_ready[slot] = false;
+        pool.delivered = i + 1;
+        if (!cont)
+            pool.stop = true;
+        pthread_cond_broadcast(&pool.cond);
+        pthread_mutex_unlock(&pool.lock);
+        if (!cont)
+            break;
+    }
+    dogecoin_blockfile_join(threads, started);
+
+    /* blocks decoded ahead of a stop were never delivered */
+    for (i = 0; i < pool.window; i++) {
+        if (pool.slot_ready[i])
+            dogecoin_blockfile_release(&pool.slots[i]);
+    }
+
+out:
+    HASH_CLEAR(hh, head);
+    if (all)
+        dogecoin_free(all);
+    if (pool.chain)
+        dogecoin_free(pool.chain);
+    if (pool.slots)
+        dogecoin_free(pool.slots);
+    if (pool.slot_ready)
+        dogecoin_free(pool.slot_ready);
+    if (pool.slot_ok)
+        dogecoin_free(pool.slot_ok);
+    if (pool.file_indexes)
+        dogecoin_free(pool.file_indexes);
+    for (i = 0; i < pool.map_count; i++)
+        dogecoin_blockfile_unmap(&pool.maps[i]);
+    if (pool.maps)
+        dogecoin_free(pool.maps);
+    dogecoin_free(threads);
+    pthread_cond_destroy(&pool.cond);
+    pthread_mutex_destroy(&pool.lock);
+    return ret;
+}
@@ -0,0 +1,602 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <dogecoin/blockfilter.h>
+#include <dogecoin/hash.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/script.h>
+#include <dogecoin/utxo.h>
+
+/*
+ * A basic filter maps its N elements to SipHash values reduced to
+ * [0, N * M), keyed by the first 16 bytes of the block hash. The sorted
+ * values are stored as Golomb-Rice coded deltas with parameter P: the
+ * quotient delta >> P in unary (ones closed by a zero), then the low P
+ * bits, all bits most significant first.
+ *
+ * Matching hashes the whole query set, sorts it and walks it alongside
+ * the decoded filter, so a wallet is checked in a single pass over the
+ * filter no matter how many scripts it watches.
+ */
+
+#define SIPROUND                                   \
+    do {                                           \
+        v0 += v1;                                  \
+        v1 = (v1 << 13) | (v1 >> 51);              \
+        v1 ^= v0;                                  \
+        v0 = (v0 << 32) | (v0 >> 32);              \
+        v2 += v3;                                  \
+        v3 = (v3 << 16) | (v3 >> 48);              \
+        v3 ^= v2;                                  \
+        v0 += v3;                                  \
+        v3 = (v3 << 21) | (v3 >> 43);              \
+        v3 ^= v0;                                  \
+        v2 += v1;                                  \
+        v1 = (v1 << 17) | (v1 >> 47);              \
+        v1 ^= v2;                                  \
+        v2 = (v2 << 32) | (v2 >> 32);              \
+    } while (0)
+
+static uint64_t blockfilter_read_le64(const unsigned char* p)
+{
+    uint64_t v = 0;
+    int i;
+    for (i = 7; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+
+/**
+ * @brief This function computes SipHash-2-4 of a message.
+ *
+ * @param k0 The first half of the key.
+ * @param k1 The second half of the key.
+ * @param data The message.
+ * @param len The length of the message.
+ *
+ * @return The 64 bit hash.
+ */
+uint64_t dogecoin_siphash(uint64_t k0, uint64_t k1, const unsigned char* data, size_t len)
+{
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+    uint64_t m, last = (uint64_t)len << 56;
+    size_t i, blocks = len / 8;
+
+    for (i = 0; i < blocks; i++) {
+        m = blockfilter_read_le64(data + i * 8);
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+    for (i = 0; i < (len & 7); i++)
+        last |= (uint64_t)data[blocks * 8 + i] << (8 * i);
+    v3 ^= last;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= last;
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+
+/* high 64 bits of the 128 bit product a * b, from 32 bit halves */
+static uint64_t blockfilter_mulhi64(uint64_t a, uint64_t b)
+{
+    uint64_t a_hi = a >> 32, a_lo = a & 0xffffffff, b_hi = b >> 32, b_lo = b & 0xffffffff;
+    uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi;
+    /* can't overflow: (2^32 - 1)^2 + 2 * (2^32 - 1) = 2^64 - 1 */
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    return a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+}
+
+/* maps a hash uniformly onto [0, range) */
+static uint64_t blockfilter_fastrange(uint64_t hash, uint64_t range)
+{
+    return blockfilter_mulhi64(hash, range);
+}
+
+static int blockfilter_u64_cmp(const void* a_, const void* b_)
+{
+    uint64_t a = *(const uint64_t*)a_, b = *(const uint64_t*)b_;
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+static int blockfilter_element_cmp(const void* a_, const void* b_)
+{
+    const struct const_buffer* a = a_;
+    const struct const_buffer* b = b_;
+    int r = memcmp(a->p, b->p, a->len < b->len ? a->len : b->len);
+    if (r)
+        return r;
+    return a->len < b->len ? -1 : (a->len > b->len ? 1 : 0);
+}
+
+/* hashes elements with the key of a block and reduces them to [0, n * M) */
+static void blockfilter_hash_elements(const uint256 block_hash, uint32_t n, const struct const_buffer* elements, size_t count, uint64_t* out)
+{
+    uint64_t k0 = blockfilter_read_le64(block_hash), k1 = blockfilter_read_le64(block_hash + 8);
+    uint64_t range = (uint64_t)n * DOGECOIN_BLOCKFILTER_BASIC_M;
+    size_t i;
+    for (i = 0; i < count; i++)
+        out[i] = blockfilter_fastrange(dogecoin_siphash(k0, k1, elements[i].p, elements[i].len), range);
+}
+
+
+typedef struct blockfilter_bit_writer_ {
+    cstring* s;
+    uint64_t acc;
+    int bits;
+} blockfilter_bit_writer;
+
+static void blockfilter_write_bits(blockfilter_bit_writer* w, uint64_t value, int nbits)
+{
+    while (nbits > 0) {
+        int take = nbits > 32 ? 32 : nbits;
+        nbits -= take;
+        w->acc = (w->acc << take) | ((value >> nbits) & ((1ULL << take) - 1));
+        w->bits += take;
+        while (w->bits >= 8) {
+            w->bits -= 8;
+            cstr_append_c(w->s, (char)(w->acc >> w->bits));
+        }
+    }
+}
+
+static void blockfilter_flush_bits(blockfilter_bit_writer* w)
+{
+    if (w->bits > 0)
+        cstr_append_c(w->s, (char)(w->acc << (8 - w->bits)));
+    w->bits = 0;
+}
+
+typedef struct blockfilter_bit_reader_ {
+    const unsigned char* p;
+    size_t len;
+    size_t pos; /* in bits */
+} blockfilter_bit_reader;
+
+static dogecoin_bool blockfilter_read_bit(blockfilter_bit_reader* r, int* bit)
+{
+    if (r->pos >= r->len * 8)
+        return false;
+    *bit = (r->p[r->pos >> 3] >> (7 - (r->pos & 7))) & 1;
+    r->pos++;
+    return true;
+}
+
+static dogecoin_bool blockfilter_read_bits(blockfilter_bit_reader* r, int nbits, uint64_t* value)
+{
+    int bit;
+    *value = 0;
+    if (r->pos + nbits > r->len * 8)
+        return false;
+    while (nbits-- > 0) {
+        if (!blockfilter_read_bit(r, &bit))
+            return false;
+        *value = (*value << 1) | (uint64_t)bit;
+    }
+    return true;
+}
+
+static dogecoin_bool blockfilter_read_golomb(blockfilter_bit_reader* r, uint64_t* value)
+{
+    uint64_t q = 0, rem;
+    int bit;
+    for (;;) {
+        if (!blockfilter_read_bit(r, &bit))
+            return false;
+        if (!bit)
+            break;
+        q++;
+    }
+    if (!blockfilter_read_bits(r, DOGECOIN_BLOCKFILTER_BASIC_P, &rem))
+        return false;
+    *value = (q << DOGECOIN_BLOCKFILTER_BASIC_P) | rem;
+    return true;
+}
+
+
+dogecoin_blockfilter* dogecoin_blockfilter_new()
+{
+    dogecoin_blockfilter* filter = dogecoin_calloc(1, sizeof(*filter));
+    filter->type = DOGECOIN_BLOCKFILTER_BASIC;
+    filter->encoded = cstr_new_sz(64);
+    return filter;
+}
+
+
+void dogecoin_blockfilter_free(dogecoin_blockfilter* filter)
+{
+    if (!filter)
+        return;
+    cstr_free(filter->encoded, true);
+    dogecoin_free(filter);
+}
+
+
+/**
+ * @brief This function builds the golomb coded set of a list
+ * of elements. Identical elements are counted once.
+ *
+ * @param filter The filter to fill.
+ * @param block_hash The hash of the block, the first 16 bytes key the hashes.
+ * @param elements The elements.
+ * @param count The number of elements.
+ *
+ * @return 1 if the filter was built, 0 if there are too many elements.
+ */
+dogecoin_bool dogecoin_blockfilter_build(dogecoin_blockfilter* filter, const uint256 block_hash, const struct const_buffer* elements, size_t count)
+{
+    struct const_buffer* unique = NULL;
+    uint64_t* hashes = NULL;
+    blockfilter_bit_writer w;
+    size_t n = 0, i;
+    uint64_t last = 0;
+
+    if (count > UINT32_MAX)
+        return false;
+    if (count) {
+        unique = dogecoin_malloc(count * sizeof(*unique));
+        memcpy(unique, elements, count * sizeof(*unique));
+        qsort(unique, count, sizeof(*unique), blockfilter_element_cmp);
+        for (i = 0; i < count; i++) {
+            if (n == 0 || blockfilter_element_cmp(&unique[n - 1], &unique[i]) != 0)
+                unique[n++] = unique[i];
+        }
+        hashes = dogecoin_malloc(n * sizeof(*hashes));
+        blockfilter_hash_elements(block_hash, (uint32_t)n, unique, n, hashes);
+        qsort(hashes, n, sizeof(*hashes), blockfilter_u64_cmp);
+    }
+
+    filter->type = DOGECOIN_BLOCKFILTER_BASIC;
+    memcpy(filter->block_hash, block_hash, DOGECOIN_HASH_LENGTH);
+    filter->n = (uint32_t)n;
+    cstr_resize(filter->encoded, 0);
+    ser_varlen(filter->encoded, filter->n);
+    filter->data_offset = filter->encoded->len;
+    w.s = filter->encoded;
+    w.acc = 0;
+    w.bits = 0;
+    for (i = 0; i < n; i++) {
+        uint64_t delta = hashes[i] - last;
+        uint64_t q = delta >> DOGECOIN_BLOCKFILTER_BASIC_P;
+        last = hashes[i];
+        while (q > 0) {
+            int run = q > 32 ? 32 : (int)q;
+            blockfilter_write_bits(&w, (1ULL << run) - 1, run);
+            q -= run;
+        }
+        blockfilter_write_bits(&w, 0, 1);
+        blockfilter_write_bits(&w, delta, DOGECOIN_BLOCKFILTER_BASIC_P);
+    }
+    blockfilter_flush_bits(&w);
+    if (unique)
+        dogecoin_free(unique);
+    if (hashes)
+        dogecoin_free(hashes);
+    return true;
+}
+
+
+/* finds output vout of a serialized transaction and points script at its script */
+static dogecoin_bool blockfilter_tx_output(struct const_buffer tx, uint32_t vout, struct const_buffer* script)
+{
+    uint32_t count, len, i;
+    if (!deser_skip(&tx, 4) || !deser_varlen(&count, &tx))
+        return false;
+    for (i = 0; i < count; i++) {
+        if (!deser_skip(&tx, 36) || !deser_varlen(&len, &tx) || !deser_skip(&tx, (size_t)len + 4))
+            return false;
+    }
+    if (!deser_varlen(&count, &tx) || vout >= count)
+        return false;
+    for (i = 0;; i++) {
+        if (!deser_skip(&tx, 8) || !deser_varlen(&len, &tx) || len > tx.len)
+            return false;
+        if (i == vout) {
+            script->p = tx.p;
+            script->len = len;
+            return true;
+        }
+        deser_skip(&tx, len);
+    }
+}
+
+typedef struct blockfilter_txid_ {
+    uint256 txid;
+    uint32_t index;
+} blockfilter_txid;
+
+static int blockfilter_txid_cmp(const void* a, const void* b)
+{
+    return memcmp(a, b, DOGECOIN_HASH_LENGTH);
+}
+
+typedef struct blockfilter_element_ {
+    const unsigned char* p; /* NULL for an offset into the spent scripts */
+    size_t offset;
+    size_t len;
+} blockfilter_element;
+
+static void blockfilter_add_element(blockfilter_element** elements, size_t* count, size_t* alloc, const unsigned char* p, size_t offset, size_t len)
+{
+    if (*count == *alloc) {
+        *alloc = *alloc ? *alloc * 2 : 64;
+        *elements = dogecoin_realloc(*elements, *alloc * sizeof(blockfilter_element));
+    }
+    (*elements)[*count].p = p;
+    (*elements)[*count].offset = offset;
+    (*elements)[*count].len = len;
+    (*count)++;
+}
+
+
+/**
+ * @brief This function builds the BIP158 basic filter of a
+ * block. Output scripts are used in place, the scripts spent
+ * by the inputs are resolved in the block itself or through
+ * the callback.
+ *
+ * @param filter The filter to fill.
+ * @param view The parsed block.
+ * @param block_hash The hash of the block.
+ * @param prevout_cb Looks up spent scripts, NULL to only use the outputs.
+ * @param ctx Passed to prevout_cb.
+ *
+ * @return 1 if the filter was built, 0 if the block is malformed or a spent output is unknown.
+ */
+dogecoin_bool dogecoin_blockfilter_build_basic(dogecoin_blockfilter* filter, dogecoin_block_view* view, const uint256 block_hash, dogecoin_blockfilter_prevout_cb prevout_cb, void* ctx)
+{
+    blockfilter_element* elements = NULL;
+    blockfilter_txid* txids = NULL;
+    struct const_buffer* buffers = NULL;
+    cstring* spent = cstr_new_sz(1024);
+    size_t count = 0, alloc = 0, i;
+    dogecoin_bool ok = false;
+    uint32_t t, n, num, len;
+
+    if (!dogecoin_block_view_index(view, NULL))
+        goto out;
+    if (prevout_cb && view->tx_count > 0) {
+        txids = dogecoin_malloc(view->tx_count * sizeof(*txids));
+        for (t = 0; t < view->tx_count; t++) {
+            if (!dogecoin_block_view_tx_hash(view, t, txids[t].txid))
+                goto out;
+            txids[t].index = t;
+        }
+        qsort(txids, view->tx_count, sizeof(*txids), blockfilter_txid_cmp);
+    }
+
+    for (t = 0; t < view->tx_count; t++) {
+        struct const_buffer tx;
+        if (!dogecoin_block_view_tx_raw(view, t, &tx) || !deser_skip(&tx, 4) || !deser_varlen(&num, &tx))
+            goto out;
+        for (n = 0; n < num; n++) {
+            const unsigned char* prevout = tx.p;
+            if (!deser_skip(&tx, 36) || !deser_varlen(&len, &tx) || !deser_skip(&tx, (size_t)len + 4))
+                goto out;
+            if (t > 0 && prevout_cb) {
+                uint32_t vout = (uint32_t)prevout[32] | ((uint32_t)prevout[33] << 8) | ((uint32_t)prevout[34] << 16) | ((uint32_t)prevout[35] << 24);
+                const blockfilter_txid* found = bsearch(prevout, txids, view->tx_count, sizeof(*txids), blockfilter_txid_cmp);
+                if (found && found->index < t) {
+                    struct const_buffer parent, script;
+                    if (!dogecoin_block_view_tx_raw(view, found->index, &parent) || !blockfilter_tx_output(parent, vout, &script))
+                        goto out;
+                    if (script.len)
+                        blockfilter_add_element(&elements, &count, &alloc, script.p, 0, script.len);
+                } else {
+                    size_t offset = spent->len;
+                    if (!prevout_cb(prevout, vout, spent, ctx))
+                        goto out;
+                    if (spent->len > offset)
+                        blockfilter_add_element(&elements, &count, &alloc, NULL, offset, spent->len - offset);
+                }
+            }
+        }
+        if (!deser_varlen(&num, &tx))
+            goto out;
+        for (n = 0; n < num; n++) {
+            const unsigned char* script;
+            if (!deser_skip(&tx, 8) || !deser_varlen(&len, &tx))
+                goto out;
+            script = tx.p;
+            if (!deser_skip(&tx, len))
+                goto out;
+            if (len == 0 || script[0] == OP_RETURN)
+                continue;
+            blockfilter_add_element(&elements, &count, &alloc, script, 0, len);
+        }
+    }
+
+    /* spent scripts are appended to one string, resolve their offsets now that it stopped growing */
+    if (count)
+        buffers = dogecoin_malloc(count * sizeof(*buffers));
+    for (i = 0; i < count; i++) {
+        buffers[i].p = elements[i].p ? elements[i].p : (const unsigned char*)spent->str + elements[i].offset;
+        buffers[i].len = elements[i].len;
+    }
+    ok = dogecoin_blockfilter_build(filter, block_hash, buffers, count);
+
+out:
+    if (elements)
+        dogecoin_free(elements);
+    if (buffers)
+        dogecoin_free(buffers);
+    if (txids)
+        dogecoin_free(txids);
+    cstr_free(spent, true);
+    return ok;
+}
+
+
+dogecoin_bool dogecoin_blockfilter_utxo_prevout_cb(const uint256 txid, uint32_t vout, cstring* script, void* ctx)
+{
+    dogecoin_utxo utxo;
+    dogecoin_bool ok;
+    utxo.script = cstr_new_sz(32);
+    ok = dogecoin_utxo_set_get((dogecoin_utxo_set*)ctx, txid, vout, &utxo);
+    if (ok)
+        cstr_append_buf(script, utxo.script->str, utxo.script->len);
+    cstr_free(utxo.script, true);
+    return ok;
+}
+
+
+typedef struct blockfilter_query_ {
+    uint64_t hash;
+    size_t index;
+} blockfilter_query;
+
+static int blockfilter_query_cmp(const void* a_, const void* b_)
+{
+    const blockfilter_query* a = a_;
+    const blockfilter_query* b = b_;
+    return a->hash < b->hash ? -1 : (a->hash > b->hash ? 1 : 0);
+}
+
+
+/**
+ * @brief This function tests a set of elements against a
+ * filter. The elements are hashed and sorted once, then the
+ * filter is decoded a single time while both sorted lists
+ * are merged.
+ *
+ * @param filter The filter.
+ * @param elements The elements to look for.
+ * @param count The number of elements.
+ * @param matched Receives 1 for every matched element, 0 otherwise. May be NULL.
+ *
+ * @return The number of matched elements, with matched NULL at most 1.
+ */
+size_t dogecoin_blockfilter_match(const dogecoin_blockfilter* filter, const struct const_buffer* elements, size_t count, uint8_t* matched)
+{
+    blockfilter_bit_reader r;
+    blockfilter_query* queries;
+    uint64_t* hashes;
+    uint64_t value = 0, delta;
+    size_t found = 0, q = 0, i;
+    uint32_t decoded = 0;
+
+    if (matched)
+        memset(matched, 0, count);
+    if (filter->n == 0 || count == 0)
+        return 0;
+    hashes = dogecoin_malloc(count * sizeof(*hashes));
+    queries = dogecoin_malloc(count * sizeof(*queries));
+    blockfilter_hash_elements(filter->block_hash, filter->n, elements, count, hashes);
+    for (i = 0; i < count; i++) {
+        queries[i].hash = hashes[i];
+        queries[i].index = i;
+    }
+    dogecoin_free(hashes);
+    qsort(queries, count, sizeof(*queries), blockfilter_query_cmp);
+
+    r.p = (const unsigned char*)filter->encoded->str + filter->data_offset;
+    r.len = filter->encoded->len - filter->data_offset;
+    r.pos = 0;
+    while (q < count && decoded < filter->n) {
+        if (!blockfilter_read_golomb(&r, &delta))
+            break;
+        value += delta;
+        decoded++;
+        while (q < count && queries[q].hash < value)
+            q++;
+        while (q < count && queries[q].hash == value) {
+            found++;
+            if (!matched)
+                goto out;
+            matched[queries[q].index] = 1;
+            q++;
+        }
+    }
+out:
+    dogecoin_free(queries);
+    return found;
+}
+
+
+void dogecoin_blockfilter_hash(const dogecoin_blockfilter* filter, uint256 hash)
+{
+    dogecoin_hash((const unsigned char*)filter->encoded->str, filter->encoded->len, hash);
+}
+
+
+void dogecoin_blockfilter_header(const dogecoin_blockfilter* filter, const uint256 prev_header, uint256 header)
+{
+    unsigned char data[2 * DOGECOIN_HASH_LENGTH];
+    dogecoin_blockfilter_hash(filter, data);
+    memcpy(data + DOGECOIN_HASH_LENGTH, prev_header, DOGECOIN_HASH_LENGTH);
+    dogecoin_hash(data, sizeof(data), header);
+}
+
+
+void dogecoin_blockfilter_serialize(cstring* s, const dogecoin_blockfilter* filter)
+{
+    ser_bytes(s, &filter->type, 1);
+    ser_u256(s, filter->block_hash);
+    ser_varlen(s, (uint32_t)filter->encoded->len);
+    ser_bytes(s, filter->encoded->str, filter->encoded->len);
+}
+
+
+/**
+ * @brief This function reads the payload of a cfilter message.
+ *
+ * @param filter The filter to fill.
+ * @param buf The buffer to read from.
+ *
+ * @return 1 if the filter was read, 0 otherwise.
+ */
+dogecoin_bool dogecoin_blockfilter_deserialize(dogecoin_blockfilter* filter, struct const_buffer* buf)
+{
+    struct const_buffer encoded;
+    uint32_t len;
+
+    if (!deser_bytes(&filter->type, buf, 1) || !deser_u256(filter->block_hash, buf) || !deser_varlen(&len, buf) || len > buf->len)
+        return false;
+    encoded.p = buf->p;
+    encoded.len = len;
+    deser_skip(buf, len);
+    cstr_resize(filter->encoded, 0);
+    cstr_append_buf(filter->encoded, encoded.p, encoded.len);
+    if (!deser_varlen(&filter->n, &encoded))
+        return false;
+    filter->data_offset = len - encoded.len;
+    return true;
+}
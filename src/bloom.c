@@ -0,0 +1,416 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#include <math.h>
+#include <string.h>
+
+#include <dogecoin/bloom.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/merkle.h>
+#include <dogecoin/script.h>
+
+#define BLOOM_LN2SQUARED 0.4804530139182014246671025263266649717305529515945455
+#define BLOOM_LN2 0.6931471805599453094172321214581765680755001343602552
+/* distance between the murmur seeds of two hash functions */
+#define BLOOM_SEED_STEP 0xFBA4C795
+
+#define BLOOM_ROTL32(x, r) (((x) << (r)) | ((x) >> (32 - (r))))
+
+static uint32_t bloom_read_le32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+/**
+ * @brief This function computes MurmurHash3 of the same data
+ * under several seeds. The mixing of a data block does not
+ * depend on the seed, so it is done once per block, and the
+ * per seed steps are independent lanes the compiler can
+ * vectorize.
+ *
+ * @param seeds The seeds.
+ * @param count The number of seeds.
+ * @param data The data to hash.
+ * @param len The length of the data.
+ * @param hashes Receives one hash per seed.
+ *
+ * @return Nothing.
+ */
+void dogecoin_murmurhash3_multi(const uint32_t* seeds, size_t count, const unsigned char* data, size_t len, uint32_t* hashes)
+{
+    const uint32_t c1 = 0xcc9e2d51, c2 = 0x1b873593;
+    size_t blocks = len / 4, i, j;
+    uint32_t k1;
+
+    for (j = 0; j < count; j++)
+        hashes[j] = seeds[j];
+    for (i = 0; i < blocks; i++) {
+        k1 = bloom_read_le32(data + i * 4);
+        k1 *= c1;
+        k1 = BLOOM_ROTL32(k1, 15);
+        k1 *= c2;
+        for (j = 0; j < count; j++) {
+            uint32_t h1 = hashes[j] ^ k1;
+            h1 = BLOOM_ROTL32(h1, 13);
+            hashes[j] = h1 * 5 + 0xe6546b64;
+        }
+    }
+
+    k1 = 0;
+    switch (len & 3) {
+    case 3:
+        k1 ^= (uint32_t)data[blocks * 4 + 2] << 16;
+        /* fall through */
+    case 2:
+        k1 ^= (uint32_t)data[blocks * 4 + 1] << 8;
+        /* fall through */
+    case 1:
+        k1 ^= data[blocks * 4];
+        k1 *= c1;
+        k1 = BLOOM_ROTL32(k1, 15);
+        k1 *= c2;
+    }
+
+    for (j = 0; j < count; j++) {
+        uint32_t h1 = hashes[j] ^ k1 ^ (uint32_t)len;
+        h1 ^= h1 >> 16;
+        h1 *= 0x85ebca6b;
+        h1 ^= h1 >> 13;
+        h1 *= 0xc2b2ae35;
+        h1 ^= h1 >> 16;
+        hashes[j] = h1;
+    }
+}
+
+
+uint32_t dogecoin_murmurhash3(uint32_t seed, const unsigned char* data, size_t len)
+{
+    uint32_t hash;
+    dogecoin_murmurhash3_multi(&seed, 1, data, len, &hash);
+    return hash;
+}
+
+
+static void bloom_set_seeds(dogecoin_bloom* filter)
+{
+    uint32_t i;
+    for (i = 0; i < filter->hash_funcs; i++)
+        filter->seeds[i] = i * BLOOM_SEED_STEP + filter->tweak;
+}
+
+
+/**
+ * @brief This function sets up a filter holding elements
+ * items at the given false positive rate. Size and number
+ * of hash functions are the BIP37 optimum, capped to the
+ * protocol limits.
+ *
+ * @param filter The filter to set up.
+ * @param elements The expected number of items.
+ * @param fp_rate The false positive rate, between 0 and 1.
+ * @param tweak The tweak mixed into the hash seeds.
+ * @param flags The dogecoin_bloom_update mode.
+ *
+ * @return 1 if the filter was set up, 0 if the parameters are out of range.
+ */
+dogecoin_bool dogecoin_bloom_init(dogecoin_bloom* filter, uint32_t elements, double fp_rate, uint32_t tweak, uint8_t flags)
+{
+    double bits, funcs;
+
+    dogecoin_mem_zero(filter, sizeof(*filter));
+    if (elements == 0 || !(fp_rate > 0.0 && fp_rate < 1.0))
+        return false;
+    bits = -1.0 / BLOOM_LN2SQUARED * elements * log(fp_rate);
+    if (bits > DOGECOIN_BLOOM_MAX_SIZE * 8)
+        bits = DOGECOIN_BLOOM_MAX_SIZE * 8;
+    filter->size = (uint32_t)bits / 8;
+    if (filter->size == 0)
+        filter->size = 1;
+    funcs = filter->size * 8 / (double)elements * BLOOM_LN2;
+    filter->hash_funcs = funcs > DOGECOIN_BLOOM_MAX_HASH_FUNCS ? DOGECOIN_BLOOM_MAX_HASH_FUNCS : (uint32_t)funcs;
+    if (filter->hash_funcs == 0)
+        filter->hash_funcs = 1;
+    filter->tweak = tweak;
+    filter->flags = flags;
+    filter->data = dogecoin_calloc(1, filter->size);
+    bloom_set_seeds(filter);
+    return true;
+}
+
+
+dogecoin_bloom* dogecoin_bloom_new(uint32_t elements, double fp_rate, uint32_t tweak, uint8_t flags)
+{
+    dogecoin_bloom* filter = dogecoin_malloc(sizeof(*filter));
+    if (!dogecoin_bloom_init(filter, elements, fp_rate, tweak, flags)) {
+        dogecoin_free(filter);
+        return NULL;
+    }
+    return filter;
+}
+
+
+void dogecoin_bloom_cleanup(dogecoin_bloom* filter)
+{
+    if (filter->data) {
+        dogecoin_free(filter->data);
+        filter->data = NULL;
+    }
+    filter->size = 0;
+}
+
+
+void dogecoin_bloom_free(dogecoin_bloom* filter)
+{
+    if (!filter)
+        return;
+    dogecoin_bloom_cleanup(filter);
+    dogecoin_free(filter);
+}
+
+
+void dogecoin_bloom_insert(dogecoin_bloom* filter, const unsigned char* data, size_t len)
+{
+    uint32_t hashes[DOGECOIN_BLOOM_MAX_HASH_FUNCS], i, bit;
+    if (filter->size == 0)
+        return;
+    dogecoin_murmurhash3_multi(filter->seeds, filter->hash_funcs, data, len, hashes);
+    for (i = 0; i < filter->hash_funcs; i++) {
+        bit = hashes[i] % (filter->size * 8);
+        filter->data[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+    }
+}
+
+
+dogecoin_bool dogecoin_bloom_contains(const dogecoin_bloom* filter, const unsigned char* data, size_t len)
+{
+    uint32_t hashes[DOGECOIN_BLOOM_MAX_HASH_FUNCS], i, bit;
+    if (filter->size == 0)
+        return false;
+    dogecoin_murmurhash3_multi(filter->seeds, filter->hash_funcs, data, len, hashes);
+    for (i = 0; i < filter->hash_funcs; i++) {
+        bit = hashes[i] % (filter->size * 8);
+        if (!(filter->data[bit >> 3] & (1 << (bit & 7))))
+            return false;
+    }
+    return true;
+}
+
+
+/* outpoints are hashed in their serialized form: txid, then the little endian index */
+static void bloom_outpoint_bytes(const dogecoin_tx_outpoint* outpoint, unsigned char* out)
+{
+    memcpy(out, outpoint->hash, DOGECOIN_HASH_LENGTH);
+    out[32] = (unsigned char)outpoint->n;
+    out[33] = (unsigned char)(outpoint->n >> 8);
+    out[34] = (unsigned char)(outpoint->n >> 16);
+    out[35] = (unsigned char)(outpoint->n >> 24);
+}
+
+
+void dogecoin_bloom_insert_outpoint(dogecoin_bloom* filter, const dogecoin_tx_outpoint* outpoint)
+{
+    unsigned char data[DOGECOIN_HASH_LENGTH + 4];
+    bloom_outpoint_bytes(outpoint, data);
+    dogecoin_bloom_insert(filter, data, sizeof(data));
+}
+
+
+dogecoin_bool dogecoin_bloom_contains_outpoint(const dogecoin_bloom* filter, const dogecoin_tx_outpoint* outpoint)
+{
+    unsigned char data[DOGECOIN_HASH_LENGTH + 4];
+    bloom_outpoint_bytes(outpoint, data);
+    return dogecoin_bloom_contains(filter, data, sizeof(data));
+}
+
+
+void dogecoin_bloom_insert_pubkey(dogecoin_bloom* filter, const dogecoin_pubkey* pubkey)
+{
+    uint160 hash160;
+    dogecoin_bloom_insert(filter, pubkey->pubkey, pubkey->compressed ? DOGECOIN_ECKEY_COMPRESSED_LENGTH : DOGECOIN_ECKEY_UNCOMPRESSED_LENGTH);
+    dogecoin_pubkey_get_hash160(pubkey, hash160);
+    dogecoin_bloom_insert(filter, hash160, sizeof(hash160));
+}
+
+
+/* checks every data push of a script against the filter */
+static dogecoin_bool bloom_match_script(const dogecoin_bloom* filter, const cstring* script)
+{
+    dogecoin_script_iter iter;
+    enum opcodetype op;
+    const unsigned char* data;
+    size_t datalen;
+
+    if (!script)
+        return false;
+    dogecoin_script_iter_init(&iter, (const unsigned char*)script->str, script->len);
+    while (dogecoin_script_iter_next(&iter, &op, &data, &datalen)) {
+        if (datalen > 0 && dogecoin_bloom_contains(filter, data, datalen))
+            return true;
+    }
+    return false;
+}
+
+
+/**
+ * @brief This function tells whether a transaction is
+ * relevant to a filter, following BIP37. When an output
+ * matches, its outpoint is inserted as the update flags
+ * ask for, so later spends of it match as well.
+ *
+ * @param filter The filter.
+ * @param tx The transaction.
+ * @param txid The hash of the transaction.
+ *
+ * @return 1 if the transaction matches, 0 otherwise.
+ */
+dogecoin_bool dogecoin_bloom_match_tx(dogecoin_bloom* filter, const dogecoin_tx* tx, const uint256 txid)
+{
+    dogecoin_bool found = false;
+    size_t i;
+
+    if (filter->size == 0)
+        return false;
+    if (dogecoin_bloom_contains(filter, txid, DOGECOIN_HASH_LENGTH))
+        found = true;
+
+    for (i = 0; i < tx->vout->len; i++) {
+        const dogecoin_tx_out* tx_out = dogecoin_tx_vout(tx, i);
+        uint8_t mode = filter->flags & DOGECOIN_BLOOM_UPDATE_MASK;
+        dogecoin_tx_outpoint outpoint;
+        if (!bloom_match_script(filter, tx_out->script_pubkey))
+            continue;
+        found = true;
+        memcpy(outpoint.hash, txid, DOGECOIN_HASH_LENGTH);
+        outpoint.n = (uint32_t)i;
+        if (mode == DOGECOIN_BLOOM_UPDATE_ALL) {
+            dogecoin_bloom_insert_outpoint(filter, &outpoint);
+        } else if (mode == DOGECOIN_BLOOM_UPDATE_P2PUBKEY_ONLY) {
+            dogecoin_script_template tmpl;
+            enum dogecoin_tx_out_type type = dogecoin_script_classify_buf((const unsigned char*)tx_out->script_pubkey->str, tx_out->script_pubkey->len, &tmpl);
+            if (type == DOGECOIN_TX_PUBKEY || type == DOGECOIN_TX_MULTISIG)
+                dogecoin_bloom_insert_outpoint(filter, &outpoint);
+        }
+    }
+    if (found)
+        return true;
+
+    for (i = 0; i < tx->vin->len; i++) {
+        const dogecoin_tx_in* tx_in = dogecoin_tx_vin(tx, i);
+        if (dogecoin_bloom_contains_outpoint(filter, &tx_in->prevout) || bloom_match_script(filter, tx_in->script_sig))
+            return true;
+    }
+    return false;
+}
+
+
+void dogecoin_bloom_serialize(cstring* s, const dogecoin_bloom* filter)
+{
+    ser_varlen(s, filter->size);
+    ser_bytes(s, filter->data, filter->size);
+    ser_u32(s, filter->hash_funcs);
+    ser_u32(s, filter->tweak);
+    ser_bytes(s, &filter->flags, 1);
+}
+
+
+void dogecoin_bloom_serialize_writer(ser_writer* w, const dogecoin_bloom* filter)
+{
+    ser_writer_varlen(w, filter->size);
+    ser_writer_bytes(w, filter->data, filter->size);
+    ser_writer_u32(w, filter->hash_funcs);
+    ser_writer_u32(w, filter->tweak);
+    ser_writer_bytes(w, &filter->flags, 1);
+}
+
+
+/**
+ * @brief This function reads a filterload payload into a
+ * filter. Filters beyond the BIP37 size or hash function
+ * limits are rejected.
+ *
+ * @param filter The filter to fill, release it with dogecoin_bloom_cleanup.
+ * @param buf The buffer to read from.
+ *
+ * @return 1 if the filter was read, 0 otherwise.
+ */
+dogecoin_bool dogecoin_bloom_deserialize(dogecoin_bloom* filter, struct const_buffer* buf)
+{
+    uint32_t size;
+
+    dogecoin_mem_zero(filter, sizeof(*filter));
+    if (!deser_varlen(&size, buf) || size > DOGECOIN_BLOOM_MAX_SIZE || size > buf->len)
+        return false;
+    filter->data = dogecoin_malloc(size ? size : 1);
+    filter->size = size;
+    if (!deser_bytes(filter->data, buf, size) || !deser_u32(&filter->hash_funcs, buf) || !deser_u32(&filter->tweak, buf) ||
+        !deser_bytes(&filter->flags, buf, 1) || filter->hash_funcs > DOGECOIN_BLOOM_MAX_HASH_FUNCS) {
+        dogecoin_bloom_cleanup(filter);
+        return false;
+    }
+    bloom_set_seeds(filter);
+    return true;
+}
+
+
+/**
+ * @brief This function parses a merkleblock message: the
+ * header with its auxpow, the transaction count and the
+ * partial merkle tree. Nothing is copied, the result points
+ * into the buffer.
+ *
+ * @param mb The merkleblock to fill.
+ * @param buf The message payload.
+ *
+ * @return 1 if parsing was successful, 0 otherwise.
+ */
+dogecoin_bool dogecoin_merkleblock_parse(dogecoin_merkleblock* mb, struct const_buffer* buf)
+{
+    dogecoin_mem_zero(mb, sizeof(*mb));
+    if (!dogecoin_block_header_view_parse(&mb->header, &mb->has_auxpow, &mb->auxpow, buf))
+        return false;
+    if (!deser_u32(&mb->total_txs, buf))
+        return false;
+    if (!deser_varlen(&mb->hash_count, buf) || mb->hash_count > buf->len / DOGECOIN_HASH_LENGTH)
+        return false;
+    mb->hashes = buf->p;
+    if (!deser_skip(buf, (size_t)mb->hash_count * DOGECOIN_HASH_LENGTH))
+        return false;
+    if (!deser_varlen(&mb->flag_bytes, buf))
+        return false;
+    mb->flags = buf->p;
+    return deser_skip(buf, mb->flag_bytes);
+}
+
+
+dogecoin_bool dogecoin_merkleblock_verify(const dogecoin_merkleblock* mb, uint256* matches, uint32_t* indexes, size_t* match_count)
+{
+    uint256 root;
+    if (!dogecoin_merkle_partial_extract(mb->total_txs, mb->hashes, mb->hash_count, mb->flags, mb->flag_bytes, root, matches, indexes, match_count))
+        return false;
+    return memcmp(root, mb->header.merkle_root, DOGECOIN_HASH_LENGTH) == 0;
+}
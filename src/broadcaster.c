@@ -0,0 +1,732 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <dogecoin/broadcaster.h>
+#include <dogecoin/hash.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/protocol.h>
+#include <dogecoin/serialize.h>
+
+#include <uthash/uthash.h>
+
+/* a tracked transaction and who fetched it */
+typedef struct dogecoin_broadcast_entry_ {
+    dogecoin_broadcast_status status;
+    cstring* raw;
+    int* fetched_by; /* ids of the peers that fetched it */
+    size_t fetched_count;
+    size_t fetched_alloc;
+    UT_hash_handle hh;
+} dogecoin_broadcast_entry;
+
+struct dogecoin_broadcaster_state_ {
+    pthread_mutex_t lock; /* guards everything below */
+    pthread_cond_t cond;
+    dogecoin_broadcast_entry* entries; /* txid -> entry */
+    cstring* queue;                    /* txids waiting for the next INV */
+    vector* peers;                     /* nodes that completed the handshake */
+    dogecoin_addrman* addrman;         /* peers of earlier runs when broadcasting to the dns seed's peers, else NULL */
+    cstring* addrman_path;
+    dogecoin_bool running;
+    dogecoin_bool stop;
+    pthread_t net_thread;
+    pthread_t flush_thread;
+};
+
+/**
+ * @brief This function checks whether a peer fetched the entry.
+ *
+ * @param entry The entry.
+ * @param nodeid The id of the peer.
+ *
+ * @return 1 if the peer fetched it, 0 otherwise.
+ */
+static dogecoin_bool broadcaster_fetched_by(const dogecoin_broadcast_entry* entry, int nodeid)
+{
+    size_t i;
+    for (i = 0; i < entry->fetched_count; i++)
+        if (entry->fetched_by[i] == nodeid)
+            return true;
+    return false;
+}
+
+
+static void broadcaster_add_fetcher(dogecoin_broadcast_entry* entry, int nodeid)
+{
+    if (entry->fetched_count == entry->fetched_alloc) {
+        entry->fetched_alloc = entry->fetched_alloc ? entry->fetched_alloc * 2 : 8;
+        entry->fetched_by = dogecoin_realloc(entry->fetched_by, entry->fetched_alloc * sizeof(*entry->fetched_by));
+    }
+    entry->fetched_by[entry->fetched_count++] = nodeid;
+}
+
+
+static void broadcaster_entry_free(dogecoin_broadcast_entry* entry)
+{
+    cstr_free(entry->raw, true);
+    dogecoin_free(entry->fetched_by);
+    dogecoin_free(entry);
+}
+
+/**
+ * @brief This function remembers a copy of the entry's status for the
+ * status callback, which runs once the lock is released.
+ *
+ * @param broadcaster The broadcaster.
+ * @param changed The collected statuses.
+ * @param entry The entry whose state changed.
+ *
+ * @return Nothing.
+ */
+static void broadcaster_changed(const dogecoin_broadcaster* broadcaster, vector* changed, const dogecoin_broadcast_entry* entry)
+{
+    if (!broadcaster->status_cb)
+        return;
+    dogecoin_broadcast_status* status = dogecoin_malloc(sizeof(*status));
+    memcpy(status, &entry->status, sizeof(*status));
+    vector_add(changed, status);
+}
+
+
+static void broadcaster_report(dogecoin_broadcaster* broadcaster, vector* changed)
+{
+    size_t i;
+    for (i = 0; i < changed->len; i++)
+        broadcaster->status_cb(broadcaster, vector_idx(changed, i));
+    vector_free(changed, true);
+}
+
+
+/**
+ * @brief This function announces txids to a peer, split into INVs of
+ * at most DOGECOIN_MAX_INV_SZ items.
+ *
+ * @param node The peer.
+ * @param txids The concatenated 32 byte txids.
+ * @param count The number of txids.
+ *
+ * @return Nothing.
+ */
+static void broadcaster_send_inv(dogecoin_node* node, const unsigned char* txids, size_t count)
+{
+    size_t start = 0;
+    while (start < count) {
+        size_t batch = count - start < DOGECOIN_MAX_INV_SZ ? count - start : DOGECOIN_MAX_INV_SZ;
+        dogecoin_p2p_msg_writer mw;
+        dogecoin_p2p_msg_writer_init(&mw, 9 + batch * 36);
+        ser_writer_varlen(&mw.w, (uint32_t)batch);
+        size_t i;
+        for (i = 0; i < batch; i++) {
+            dogecoin_p2p_inv_msg inv_msg;
+            dogecoin_p2p_msg_inv_init(&inv_msg, DOGECOIN_INV_TYPE_TX, (uint8_t*)txids + (start + i) * DOGECOIN_HASH_LENGTH);
+            dogecoin_p2p_msg_inv_ser_writer(&inv_msg, &mw.w);
+        }
+        dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_INV);
+        start += batch;
+    }
+}
+
+
+/**
+ * @brief This function waits on the broadcaster's condition for at most
+ * the given time, the lock must be held.
+ */
+static void broadcaster_wait(dogecoin_broadcaster_state* state, unsigned int ms)
+{
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ms / 1000;
+    until.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&state->cond, &state->lock, &until);
+}
+
+
+/**
+ * @brief This function adds a new peer to the announcement list and
+ * announces every transaction the network has not shown us yet.
+ *
+ * @param node The peer that completed the handshake.
+ *
+ * @return Nothing.
+ */
+static void broadcaster_handshake_done(struct dogecoin_node_* node)
+{
+    dogecoin_broadcaster* broadcaster = node->nodegroup->ctx;
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    vector* changed = vector_new(8, dogecoin_free);
+    cstring* txids = cstr_new_sz(1024);
+    dogecoin_broadcast_entry *entry, *tmp;
+
+    pthread_mutex_lock(&state->lock);
+    /* a repeated verack must not announce everything again */
+    if (vector_find(state->peers, node) >= 0) {
+        pthread_mutex_unlock(&state->lock);
+        vector_free(changed, true);
+        cstr_free(txids, true);
+        return;
+    }
+    vector_add(state->peers, node);
+    HASH_ITER(hh, state->entries, entry, tmp) {
+        if (entry->status.state == DOGECOIN_BROADCAST_SEEN)
+            continue;
+        cstr_append_buf(txids, entry->status.txid, DOGECOIN_HASH_LENGTH);
+        entry->status.announced++;
+        if (entry->status.state == DOGECOIN_BROADCAST_QUEUED) {
+            entry->status.state = DOGECOIN_BROADCAST_ANNOUNCED;
+            broadcaster_changed(broadcaster, changed, entry);
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    broadcaster_send_inv(node, (const unsigned char*)txids->str, txids->len / DOGECOIN_HASH_LENGTH);
+    cstr_free(txids, true);
+    broadcaster_report(broadcaster, changed);
+}
+
+
+static void broadcaster_connection_state_changed(struct dogecoin_node_* node)
+{
+    dogecoin_broadcaster_state* state = ((dogecoin_broadcaster*)node->nodegroup->ctx)->state;
+    /* misbehaving peers are still connected here and get disconnected right after */
+    if ((node->state & NODE_CONNECTED) == NODE_CONNECTED && (node->state & NODE_MISSBEHAVED) != NODE_MISSBEHAVED)
+        return;
+    pthread_mutex_lock(&state->lock);
+    vector_remove(state->peers, node);
+    pthread_mutex_unlock(&state->lock);
+}
+
+
+/* drops connections that raced a stop request */
+static dogecoin_bool broadcaster_timer(struct dogecoin_node_* node, uint64_t* now)
+{
+    (void)now;
+    dogecoin_broadcaster_state* state = ((dogecoin_broadcaster*)node->nodegroup->ctx)->state;
+    pthread_mutex_lock(&state->lock);
+    dogecoin_bool stop = state->stop;
+    pthread_mutex_unlock(&state->lock);
+    if (stop) {
+        dogecoin_node_disconnect(node);
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * @brief This function handles an INV: a transaction announced by a peer
+ * that did not fetch it from us has propagated.
+ *
+ * @param node The peer.
+ * @param hdr The message header.
+ * @param buf The payload.
+ *
+ * @return 1 if the message is well formed, 0 otherwise.
+ */
+static dogecoin_bool broadcaster_handle_inv(struct dogecoin_node_* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    (void)hdr;
+    dogecoin_broadcaster* broadcaster = node->nodegroup->ctx;
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    struct const_buffer payload = *buf;
+    uint32_t count, i;
+    if (!deser_varlen(&count, &payload) || count > DOGECOIN_MAX_INV_SZ)
+        return false;
+
+    vector* changed = vector_new(8, dogecoin_free);
+    dogecoin_bool ok = true;
+    pthread_mutex_lock(&state->lock);
+    for (i = 0; i < count; i++) {
+        dogecoin_p2p_inv_msg inv_msg;
+        if (!dogecoin_p2p_msg_inv_deser(&inv_msg, &payload)) {
+            ok = false;
+            break;
+        }
+        if (inv_msg.type != DOGECOIN_INV_TYPE_TX)
+            continue;
+        dogecoin_broadcast_entry* entry = NULL;
+        HASH_FIND(hh, state->entries, inv_msg.hash, DOGECOIN_HASH_LENGTH, entry);
+        if (!entry || broadcaster_fetched_by(entry, node->nodeid))
+            continue;
+        entry->status.seen++;
+        if (entry->status.state != DOGECOIN_BROADCAST_SEEN) {
+            entry->status.state = DOGECOIN_BROADCAST_SEEN;
+            broadcaster_changed(broadcaster, changed, entry);
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+    broadcaster_report(broadcaster, changed);
+    return ok;
+}
+
+
+/**
+ * @brief This function serves a GETDATA from the tracked transactions
+ * and answers the items it does not have with a NOTFOUND.
+ *
+ * @param node The peer.
+ * @param hdr The message header.
+ * @param buf The payload.
+ *
+ * @return 1 if the message is well formed, 0 otherwise.
+ */
+static dogecoin_bool broadcaster_handle_getdata(struct dogecoin_node_* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    (void)hdr;
+    dogecoin_broadcaster* broadcaster = node->nodegroup->ctx;
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    struct const_buffer payload = *buf;
+    uint32_t count, i;
+    if (!deser_varlen(&count, &payload) || count > DOGECOIN_MAX_INV_SZ)
+        return false;
+
+    vector* changed = vector_new(8, dogecoin_free);
+    vector* replies = vector_new(count ? count : 1, NULL);
+    cstring* notfound = cstr_new_sz(64);
+    uint32_t notfound_count = 0;
+    dogecoin_bool ok = true;
+    pthread_mutex_lock(&state->lock);
+    for (i = 0; i < count; i++) {
+        dogecoin_p2p_inv_msg inv_msg;
+        if (!dogecoin_p2p_msg_inv_deser(&inv_msg, &payload)) {
+            ok = false;
+            break;
+        }
+        dogecoin_broadcast_entry* entry = NULL;
+        if (inv_msg.type == DOGECOIN_INV_TYPE_TX)
+            HASH_FIND(hh, state->entries, inv_msg.hash, DOGECOIN_HASH_LENGTH, entry);
+        if (!entry) {
+            dogecoin_p2p_msg_inv_ser(&inv_msg, notfound);
+            notfound_count++;
+            continue;
+        }
+        dogecoin_p2p_msg_writer mw;
+        dogecoin_p2p_msg_writer_init(&mw, entry->raw->len);
+        ser_writer_bytes(&mw.w, entry->raw->str, entry->raw->len);
+        cstring* reply = dogecoin_p2p_msg_writer_finish(&mw, node->nodegroup->chainparams->netmagic, DOGECOIN_MSG_TX);
+        if (reply)
+            vector_add(replies, reply);
+        if (!broadcaster_fetched_by(entry, node->nodeid)) {
+            broadcaster_add_fetcher(entry, node->nodeid);
+            entry->status.requested++;
+        }
+        if (entry->status.state < DOGECOIN_BROADCAST_REQUESTED) {
+            entry->status.state = DOGECOIN_BROADCAST_REQUESTED;
+            broadcaster_changed(broadcaster, changed, entry);
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    for (i = 0; i < replies->len; i++) {
+        cstring* p2p_msg = vector_idx(replies, i);
+        dogecoin_node_send(node, p2p_msg);
+        cstr_free(p2p_msg, true);
+    }
+    vector_free(replies, true);
+    if (ok && notfound_count > 0) {
+        dogecoin_p2p_msg_writer mw;
+        dogecoin_p2p_msg_writer_init(&mw, 9 + notfound->len);
+        ser_writer_varlen(&mw.w, notfound_count);
+        ser_writer_bytes(&mw.w, notfound->str, notfound->len);
+        dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_NOTFOUND);
+    }
+    cstr_free(notfound, true);
+    broadcaster_report(broadcaster, changed);
+    return ok;
+}
+
+
+/**
+ * @brief This function creates a broadcaster and its node group, its
+ * connections are opened by dogecoin_broadcaster_start.
+ *
+ * @param chain The chain to broadcast on.
+ * @param ips Comma separated peers, NULL to query the chain's dns seed.
+ * @param maxpeers The number of connections to keep.
+ *
+ * @return The broadcaster, NULL if the group could not be set up.
+ */
+dogecoin_broadcaster* dogecoin_broadcaster_new(const dogecoin_chainparams* chain, const char* ips, int maxpeers)
+{
+    dogecoin_broadcaster* broadcaster = dogecoin_calloc(1, sizeof(*broadcaster));
+    broadcaster->group = dogecoin_node_group_new(chain);
+    if (!broadcaster->group || !dogecoin_node_group_set_threads(broadcaster->group, 1, 0)) {
+        dogecoin_node_group_free(broadcaster->group);
+        dogecoin_free(broadcaster);
+        return NULL;
+    }
+    broadcaster->inv_interval_ms = 1000;
+    broadcaster->expiry_s = 3600;
+    broadcaster->reconnect_s = 10;
+    broadcaster->status_cb = NULL;
+
+    dogecoin_broadcaster_state* state = dogecoin_calloc(1, sizeof(*state));
+    pthread_mutex_init(&state->lock, NULL);
+    pthread_cond_init(&state->cond, NULL);
+    state->entries = NULL;
+    state->addrman = NULL;
+    state->addrman_path = NULL;
+    state->queue = cstr_new_sz(1024);
+    state->peers = vector_new(maxpeers > 0 ? maxpeers : 1, NULL);
+    broadcaster->state = state;
+
+    dogecoin_node_group* group = broadcaster->group;
+    group->ctx = broadcaster;
+    group->desired_amount_connected_nodes = maxpeers;
+    group->handshake_done_cb = broadcaster_handshake_done;
+    group->node_connection_state_changed_cb = broadcaster_connection_state_changed;
+    group->periodic_timer_cb = broadcaster_timer;
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_INV, broadcaster_handle_inv);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_GETDATA, broadcaster_handle_getdata);
+    if (ips == NULL) {
+        /* start from the peers that worked last time instead of the dns seed */
+        state->addrman = dogecoin_addrman_new(group->chainparams);
+        state->addrman_path = cstr_new_sz(256);
+        dogecoin_addrman_default_path(group->chainparams, state->addrman_path);
+        dogecoin_addrman_load(state->addrman, state->addrman_path->str);
+        group->addrman = state->addrman;
+    }
+    dogecoin_node_group_add_peers_by_ip_or_seed(group, ips);
+    return broadcaster;
+}
+
+
+void dogecoin_broadcaster_free(dogecoin_broadcaster* broadcaster)
+{
+    if (!broadcaster)
+        return;
+    dogecoin_broadcaster_stop(broadcaster);
+    dogecoin_node_group_free(broadcaster->group);
+
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    if (state->addrman) {
+        dogecoin_addrman_save(state->addrman, state->addrman_path->str);
+        dogecoin_addrman_free(state->addrman);
+        cstr_free(state->addrman_path, true);
+    }
+    dogecoin_broadcast_entry *entry, *tmp;
+    HASH_ITER(hh, state->entries, entry, tmp) {
+        HASH_DEL(state->entries, entry);
+        broadcaster_entry_free(entry);
+    }
+    cstr_free(state->queue, true);
+    vector_free(state->peers, true);
+    pthread_mutex_destroy(&state->lock);
+    pthread_cond_destroy(&state->cond);
+    dogecoin_free(state);
+    dogecoin_free(broadcaster);
+}
+
+
+static void* broadcaster_net_run(void* ctx)
+{
+    dogecoin_broadcaster* broadcaster = ctx;
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    pthread_mutex_lock(&state->lock);
+    while (!state->stop) {
+        pthread_mutex_unlock(&state->lock);
+        dogecoin_node_group_rearm_nodes(broadcaster->group);
+        /* peers learned from addr messages since the last round */
+        dogecoin_node_group_add_peers_from_addrman(broadcaster->group);
+        dogecoin_node_group_connect_next_nodes(broadcaster->group);
+        /* returns once every connection is gone */
+        dogecoin_node_group_event_loop(broadcaster->group);
+        pthread_mutex_lock(&state->lock);
+        if (!state->stop)
+            broadcaster_wait(state, broadcaster->reconnect_s * 1000);
+    }
+    pthread_mutex_unlock(&state->lock);
+    return NULL;
+}
+
+
+/**
+ * @brief This function drops transactions that have been tracked for
+ * longer than the expiry, reporting those the network did not show us.
+ */
+static void broadcaster_expire(dogecoin_broadcaster* broadcaster)
+{
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    vector* changed = vector_new(8, dogecoin_free);
+    uint64_t now = time(NULL);
+    dogecoin_broadcast_entry *entry, *tmp;
+
+    pthread_mutex_lock(&state->lock);
+    HASH_ITER(hh, state->entries, entry, tmp) {
+        if (now - entry->status.queued_time < broadcaster->expiry_s)
+            continue;
+        HASH_DEL(state->entries, entry);
+        if (entry->status.state != DOGECOIN_BROADCAST_SEEN) {
+            entry->status.state = DOGECOIN_BROADCAST_EXPIRED;
+            broadcaster_changed(broadcaster, changed, entry);
+        }
+        broadcaster_entry_free(entry);
+    }
+    pthread_mutex_unlock(&state->lock);
+    broadcaster_report(broadcaster, changed);
+}
+
+
+static void* broadcaster_flush_run(void* ctx)
+{
+    dogecoin_broadcaster* broadcaster = ctx;
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    pthread_mutex_lock(&state->lock);
+    while (!state->stop) {
+        broadcaster_wait(state, broadcaster->inv_interval_ms);
+        if (state->stop)
+            break;
+        pthread_mutex_unlock(&state->lock);
+        dogecoin_broadcaster_flush(broadcaster);
+        broadcaster_expire(broadcaster);
+        pthread_mutex_lock(&state->lock);
+    }
+    pthread_mutex_unlock(&state->lock);
+    return NULL;
+}
+
+
+/**
+ * @brief This function connects to the peers and starts the threads
+ * keeping the connections and announcing queued transactions.
+ *
+ * @param broadcaster The broadcaster.
+ *
+ * @return 1 if the broadcaster was started, 0 if it already runs or the
+ * threads could not be created.
+ */
+dogecoin_bool dogecoin_broadcaster_start(dogecoin_broadcaster* broadcaster)
+{
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    pthread_mutex_lock(&state->lock);
+    if (state->running) {
+        pthread_mutex_unlock(&state->lock);
+        return false;
+    }
+    state->stop = false;
+    if (pthread_create(&state->net_thread, NULL, broadcaster_net_run, broadcaster) != 0) {
+        pthread_mutex_unlock(&state->lock);
+        return false;
+    }
+    if (pthread_create(&state->flush_thread, NULL, broadcaster_flush_run, broadcaster) != 0) {
+        state->stop = true;
+        pthread_mutex_unlock(&state->lock);
+        dogecoin_node_group_shutdown(broadcaster->group);
+        pthread_join(state->net_thread, NULL);
+        return false;
+    }
+    state->running = true;
+    pthread_mutex_unlock(&state->lock);
+    return true;
+}
+
+
+/**
+ * @brief This function disconnects all peers and stops the threads,
+ * tracked and queued transactions are kept for the next start.
+ *
+ * @param broadcaster The broadcaster.
+ *
+ * @return Nothing.
+ */
+void dogecoin_broadcaster_stop(dogecoin_broadcaster* broadcaster)
+{
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    pthread_mutex_lock(&state->lock);
+    if (!state->running) {
+        pthread_mutex_unlock(&state->lock);
+        return;
+    }
+    state->stop = true;
+    pthread_cond_broadcast(&state->cond);
+    pthread_mutex_unlock(&state->lock);
+
+    /* connections opened after this are dropped by the periodic timer */
+    dogecoin_node_group_shutdown(broadcaster->group);
+    pthread_join(state->net_thread, NULL);
+    pthread_join(state->flush_thread, NULL);
+
+    pthread_mutex_lock(&state->lock);
+    vector_resize(state->peers, 0);
+    state->running = false;
+    pthread_mutex_unlock(&state->lock);
+}
+
+
+/**
+ * @brief This function starts tracking a serialized transaction and
+ * queues it for the next INV, it takes ownership of raw.
+ */
+static dogecoin_bool broadcaster_add(dogecoin_broadcaster* broadcaster, cstring* raw, uint256 txid_out)
+{
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    dogecoin_broadcast_entry* entry = NULL;
+    uint256 txid;
+    dogecoin_dblhash((const unsigned char*)raw->str, raw->len, txid);
+    if (txid_out)
+        memcpy(txid_out, txid, DOGECOIN_HASH_LENGTH);
+
+    vector* changed = vector_new(1, dogecoin_free);
+    pthread_mutex_lock(&state->lock);
+    HASH_FIND(hh, state->entries, txid, DOGECOIN_HASH_LENGTH, entry);
+    if (entry) {
+        pthread_mutex_unlock(&state->lock);
+        vector_free(changed, true);
+        cstr_free(raw, true);
+        return false;
+    }
+    entry = dogecoin_calloc(1, sizeof(*entry));
+    memcpy(entry->status.txid, txid, DOGECOIN_HASH_LENGTH);
+    entry->status.state = DOGECOIN_BROADCAST_QUEUED;
+    entry->status.queued_time = time(NULL);
+    entry->raw = raw;
+    HASH_ADD(hh, state->entries, status.txid, DOGECOIN_HASH_LENGTH, entry);
+    cstr_append_buf(state->queue, txid, DOGECOIN_HASH_LENGTH);
+    broadcaster_changed(broadcaster, changed, entry);
+    pthread_mutex_unlock(&state->lock);
+    broadcaster_report(broadcaster, changed);
+    return true;
+}
+
+
+/**
+ * @brief This function queues a transaction for broadcasting.
+ *
+ * @param broadcaster The broadcaster.
+ * @param tx The transaction, it is serialized right away.
+ * @param txid_out Receives the txid if not NULL.
+ *
+ * @return 1 if the transaction was queued, 0 if it is already tracked.
+ */
+dogecoin_bool dogecoin_broadcaster_add_tx(dogecoin_broadcaster* broadcaster, const dogecoin_tx* tx, uint256 txid_out)
+{
+    cstring* raw = cstr_new_sz(1024);
+    dogecoin_tx_serialize(raw, tx);
+    return broadcaster_add(broadcaster, raw, txid_out);
+}
+
+
+/**
+ * @brief This function queues a serialized transaction for broadcasting.
+ *
+ * @param broadcaster The broadcaster.
+ * @param data The serialized transaction.
+ * @param len Its length.
+ * @param txid_out Receives the txid if not NULL.
+ *
+ * @return 1 if the transaction was queued, 0 if it does not parse or is
+ * already tracked.
+ */
+dogecoin_bool dogecoin_broadcaster_add_raw(dogecoin_broadcaster* broadcaster, const unsigned char* data, size_t len, uint256 txid_out)
+{
+    dogecoin_tx* tx = dogecoin_tx_new();
+    size_t consumed = 0;
+    dogecoin_bool valid = dogecoin_tx_deserialize(data, len, tx, &consumed) && consumed == len;
+    dogecoin_tx_free(tx);
+    if (!valid)
+        return false;
+    return broadcaster_add(broadcaster, cstr_new_buf(data, len), txid_out);
+}
+
+
+/**
+ * @brief This function sends the queued txids to every connected peer,
+ * batched into as few INVs as possible. Without peers they stay queued.
+ *
+ * @param broadcaster The broadcaster.
+ *
+ * @return The number of transactions announced.
+ */
+size_t dogecoin_broadcaster_flush(dogecoin_broadcaster* broadcaster)
+{
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    vector* changed = vector_new(8, dogecoin_free);
+    cstring* txids = cstr_new_sz(1024);
+    vector* peers;
+    size_t i, count = 0;
+
+    pthread_mutex_lock(&state->lock);
+    peers = vector_new(state->peers->len ? state->peers->len : 1, NULL);
+    for (i = 0; i < state->peers->len; i++)
+        vector_add(peers, vector_idx(state->peers, i));
+    if (peers->len > 0) {
+        for (i = 0; i + DOGECOIN_HASH_LENGTH <= state->queue->len; i += DOGECOIN_HASH_LENGTH) {
+            dogecoin_broadcast_entry* entry = NULL;
+            HASH_FIND(hh, state->entries, state->queue->str + i, DOGECOIN_HASH_LENGTH, entry);
+            if (!entry)
+                continue;
+            cstr_append_buf(txids, entry->status.txid, DOGECOIN_HASH_LENGTH);
+            entry->status.announced += (uint32_t)peers->len;
+            if (entry->status.state == DOGECOIN_BROADCAST_QUEUED) {
+                entry->status.state = DOGECOIN_BROADCAST_ANNOUNCED;
+                broadcaster_changed(broadcaster, changed, entry);
+            }
+        }
+        cstr_resize(state->queue, 0);
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    count = txids->len / DOGECOIN_HASH_LENGTH;
+    if (count > 0) {
+        for (i = 0; i < peers->len; i++)
+            broadcaster_send_inv(vector_idx(peers, i), (const unsigned char*)txids->str, count);
+    }
+    vector_free(peers, true);
+    cstr_free(txids, true);
+    broadcaster_report(broadcaster, changed);
+    return count;
+}
+
+
+/**
+ * @brief This function copies the propagation status of a transaction.
+ *
+ * @param broadcaster The broadcaster.
+ * @param txid The transaction.
+ * @param status_out Receives the status.
+ *
+ * @return 1 if the transaction is tracked, 0 otherwise.
+ */
+dogecoin_bool dogecoin_broadcaster_get_status(dogecoin_broadcaster* broadcaster, const uint256 txid, dogecoin_broadcast_status* status_out)
+{
+    dogecoin_broadcaster_state* state = broadcaster->state;
+    dogecoin_broadcast_entry* entry = NULL;
+    pthread_mutex_lock(&state->lock);
+    HASH_FIND(hh, state->entries, txid, DOGECOIN_HASH_LENGTH, entry);
+    if (entry)
+        memcpy(status_out, &entry->status, sizeof(*status_out));
+    pthread_mutex_unlock(&state->lock);
+    return entry != NULL;
+}
@@ -26,6 +26,8 @@
 
  */
 
+#include <string.h>
+
 #include <dogecoin/chainparams.h>
 
 const dogecoin_chainparams dogecoin_chainparams_main = {
@@ -40,6 +42,13 @@ const dogecoin_chainparams dogecoin_chainparams_main = {
     {0x91, 0x56, 0x35, 0x2c, 0x18, 0x18, 0xb3, 0x2e, 0x90, 0xc9, 0xe7, 0x92, 0xef, 0xd6, 0xa1, 0x1a, 0x82, 0xfe, 0x79, 0x56, 0xa6, 0x30, 0xf0, 0x3b, 0xbe, 0xe2, 0x36, 0xce, 0xda, 0xe3, 0x91, 0x1a},
     22556,
     {{"seed.multidoge.org"}, {{1}}},
+    0x1e0fffff, // ~uint256(0) >> 20
+    60,         // one minute blocks
+    4 * 60 * 60,
+    145000,
+    0,
+    false,
+    false,
 };
 
 const dogecoin_chainparams dogecoin_chainparams_test = {
@@ -54,6 +63,13 @@ const dogecoin_chainparams dogecoin_chainparams_test = {
     {0x9e, 0x55, 0x50, 0x73, 0xd0, 0xc4, 0xf3, 0x64, 0x56, 0xdb, 0x89, 0x51, 0xf4, 0x49, 0x70, 0x4d, 0x54, 0x4d, 0x28, 0x26, 0xd9, 0xaa, 0x60, 0x63, 0x6b, 0x40, 0x37, 0x46, 0x26, 0x78, 0x0a, 0xbb},
     44556,
     {{"testseed.jrn.me.uk"}, {{0}}},
+    0x1e0fffff, // ~uint256(0) >> 20
+    60,
+    4 * 60 * 60,
+    145000,
+    157500,
+    true,
+    false,
 };
 
 const dogecoin_chainparams dogecoin_chainparams_regtest = {
@@ -68,6 +84,13 @@ const dogecoin_chainparams dogecoin_chainparams_regtest = {
     {0xa5, 0x73, 0xe9, 0x1c, 0x17, 0x72, 0x07, 0x6c, 0x0d, 0x40, 0xf7, 0x0e, 0x44, 0x08, 0xc8, 0x3a, 0x31, 0x70, 0x5f, 0x29, 0x6a, 0xe6, 0xe7, 0x62, 0x9d, 0x4a, 0xdc, 0xb5, 0xa3, 0x60, 0x21, 0x3d},
     18332,
     {{"testseed.jrn.me.uk"}, {{0}}},
+    0x207fffff, // ~uint256(0) >> 1
+    60,
+    4 * 60 * 60,
+    10,
+    20,
+    true,
+    true,
 };
 
 const dogecoin_checkpoint dogecoin_mainnet_checkpoint_array[] = {
@@ -112,6 +135,28 @@ const dogecoin_checkpoint dogecoin_testnet_checkpoint_array[] = {
     {3286675, "07fef07a255d510297c9189dc96da5f4e41a8184bc979df8294487f07fee1cf3", 1628932841, 0x1e0fffff},
     {3445426, "70574db7856bd685abe7b0a8a3e79b29882620645bd763b01459176bceb58cd1", 1635884611, 0x1e0fffff}};
 
+/**
+ * @brief This function returns the checkpoints of a chain.
+ *
+ * @param chain The chain parameters.
+ * @param count_out The number of checkpoints.
+ *
+ * @return The checkpoints ordered by height or NULL if the chain has none.
+ */
+const dogecoin_checkpoint* dogecoin_chainparams_checkpoints(const dogecoin_chainparams* chain, size_t* count_out)
+{
+    if (strcmp(chain->chainname, dogecoin_chainparams_main.chainname) == 0) {
+        *count_out = sizeof(dogecoin_mainnet_checkpoint_array) / sizeof(dogecoin_mainnet_checkpoint_array[0]);
+        return dogecoin_mainnet_checkpoint_array;
+    }
+    if (strcmp(chain->chainname, dogecoin_chainparams_test.chainname) == 0) {
+        *count_out = sizeof(dogecoin_testnet_checkpoint_array) / sizeof(dogecoin_testnet_checkpoint_array[0]);
+        return dogecoin_testnet_checkpoint_array;
+    }
+    *count_out = 0;
+    return NULL;
+}
+
 const dogecoin_chainparams* chain_from_b58_prefix(const char* address) {
     /* determine address prefix for network chainparams */
     uint8_t prefix[1];
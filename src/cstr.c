@@ -9,10 +9,47 @@
 #include <dogecoin/mem.h>
 
 
+/* buffers up to this size (incl. NUL) live in the same allocation as the cstring itself */
+#define CSTR_INLINE_MAX 256
+
+
+/**
+ * @brief This function rounds a buffer size up to the
+ * power of two used as allocation size.
+ * 
+ * @param sz The required buffer size, including the NUL byte.
+ * 
+ * @return The allocation size.
+ */
+static size_t cstr_alloc_size(size_t sz)
+{
+    size_t al_sz = 8;
+    while (al_sz < sz) {
+        al_sz <<= 1;
+    }
+    return al_sz;
+}
+
+
+/**
+ * @brief This function checks whether the buffer of a
+ * cstring is stored inline, directly behind the struct.
+ * 
+ * @param s The cstring to check.
+ * 
+ * @return 1 if the buffer is inline, 0 if it lives on the heap.
+ */
+static int cstr_is_inline(const cstring* s)
+{
+    return s->str == (const char*)(s + 1);
+}
+
+
 /**
  * @brief This function takes a cstring and allocates a new
  * buffer of the specified size. If the buffer is already 
- * allocated and is large enough, no change occurs.
+ * allocated and is large enough, no change occurs. An inline
+ * buffer that is too small spills over to the heap.
  * 
  * @param s The cstring whose buffer is to be reallocated.
  * @param sz The new desired size of the buffer.
@@ -21,8 +58,7 @@
  */
 static int cstr_alloc_min_sz(cstring* s, size_t sz)
 {
-    unsigned int shift;
-    unsigned int al_sz;
+    size_t al_sz;
     char* new_s;
 
     sz++; /* NULL overhead */
@@ -31,14 +67,19 @@ static int cstr_alloc_min_sz(cstring* s, size_t sz)
         return 1;
     }
 
-    shift = 3;
-    while ((al_sz = (1 << shift)) < sz) {
-        shift++;
-    }
+    al_sz = cstr_alloc_size(sz);
 
-    new_s = dogecoin_realloc(s->str, al_sz);
-    if (!new_s) {
-        return 0;
+    if (cstr_is_inline(s)) {
+        new_s = dogecoin_malloc(al_sz);
+        if (!new_s) {
+            return 0;
+        }
+        memcpy_safe(new_s, s->str, s->len);
+    } else {
+        new_s = dogecoin_realloc(s->str, al_sz);
+        if (!new_s) {
+            return 0;
+        }
     }
 
     s->str = new_s;
@@ -88,7 +129,8 @@ int cstr_alloc_minsize(cstring* s, size_t new_sz)
 
 /**
  * @brief This function allocates a new cstring of the
- * specified size.
+ * specified size. Small buffers are placed inline behind
+ * the struct so that only one allocation is needed.
  * 
  * @param sz The size of the string to allocate.
  * 
@@ -96,15 +138,32 @@ int cstr_alloc_minsize(cstring* s, size_t new_sz)
  */
 cstring* cstr_new_sz(size_t sz)
 {
-    cstring* s = dogecoin_calloc(1, sizeof(cstring));
-    if (!s) {
-        return NULL;
+    cstring* s;
+    size_t al_sz = cstr_alloc_size(sz + 1);
+
+    if (al_sz > CSTR_INLINE_MAX) {
+        s = dogecoin_calloc(1, sizeof(cstring));
+        if (!s) {
+            return NULL;
+        }
+
+        if (!cstr_alloc_min_sz(s, sz)) {
+            dogecoin_free(s);
+            return NULL;
+        }
+
+        return s;
     }
 
-    if (!cstr_alloc_min_sz(s, sz)) {
-        dogecoin_free(s);
+    /* small strings: struct and buffer in a single allocation */
+    s = dogecoin_malloc(sizeof(cstring) + al_sz);
+    if (!s) {
         return NULL;
     }
+    s->str = (char*)(s + 1);
+    s->len = 0;
+    s->alloc = al_sz;
+    s->str[0] = 0;
 
     return s;
 }
@@ -167,6 +226,8 @@ cstring* cstr_new(const char* init_str)
  * 
  * @param s The pointer to the cstring to be freed.
  * @param free_buf Whether the buffer inside the cstring should be freed.
+ * Keeping the buffer (free_buf == 0) requires a heap buffer, inline
+ * buffers (see cstr_new_sz) are released together with the struct.
  * 
  * @return Nothing.
  */
@@ -176,7 +237,8 @@ void cstr_free(cstring* s, int free_buf)
         return;
     }
 
-    if (free_buf) {
+    /* inline buffers go away with the struct, so they can't be handed over */
+    if (free_buf && !cstr_is_inline(s)) {
         dogecoin_free(s->str);
     }
 
@@ -0,0 +1,698 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <dogecoin/headerchain.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/pow.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/sha2.h>
+#include <dogecoin/utils.h>
+
+/* file layout: magic, version, netmagic, root height, root hash, then fixed size records */
+#define HEADERCHAIN_FILE_MAGIC "DOGEHDRS"
+#define HEADERCHAIN_FILE_VERSION 1
+#define HEADERCHAIN_FILE_HEADER_SIZE (8 + 4 + 4 + 4 + DOGECOIN_HASH_LENGTH)
+
+#define HEADERCHAIN_ARENA_CHUNK (1 << 20)
+#define HEADERCHAIN_LOCATOR_DENSE 10
+#define HEADERCHAIN_PREFETCH 16
+
+struct dogecoin_headerchain_arena_ {
+    struct dogecoin_headerchain_arena_* next;
+    size_t used;
+    size_t cap;
+    uint8_t data[];
+};
+
+static uint32_t headerchain_read_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void headerchain_write_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+
+/**
+ * @brief This function hands out zeroed memory from a chain of
+ * chunks which are only released together with the tree.
+ *
+ * @param arena The arena.
+ * @param size The number of bytes.
+ * @param min_chunk The size of a new chunk if one is needed.
+ *
+ * @return A pointer to the memory.
+ */
+static void* headerchain_arena_alloc(dogecoin_headerchain_arena** arena, size_t size, size_t min_chunk)
+{
+    dogecoin_headerchain_arena* chunk = *arena;
+    size = (size + 7) & ~(size_t)7;
+    if (!chunk || chunk->cap - chunk->used < size) {
+        size_t cap = min_chunk > size ? min_chunk : size;
+        chunk = dogecoin_calloc(1, sizeof(*chunk) + cap);
+        chunk->cap = cap;
+        chunk->next = *arena;
+        *arena = chunk;
+    }
+    void* p = chunk->data + chunk->used;
+    chunk->used += size;
+    return p;
+}
+
+
+static void headerchain_arena_free(dogecoin_headerchain_arena* arena)
+{
+    while (arena) {
+        dogecoin_headerchain_arena* next = arena->next;
+        dogecoin_free(arena);
+        arena = next;
+    }
+}
+
+
+/* block hashes are uniformly distributed, their first bytes are the bucket */
+static size_t headerchain_slot(const dogecoin_headerchain* hc, const uint8_t* hash)
+{
+    uint64_t key;
+    memcpy(&key, hash, sizeof(key));
+    return (size_t)key & (hc->table_size - 1);
+}
+
+
+static void headerchain_table_insert(dogecoin_headerchain* hc, dogecoin_headerchain_entry* entry)
+{
+    size_t slot = headerchain_slot(hc, entry->record);
+    while (hc->table[slot])
+        slot = (slot + 1) & (hc->table_size - 1);
+    hc->table[slot] = entry;
+}
+
+
+/**
+ * @brief This function resizes the hash table to hold at
+ * least the given number of entries at half load.
+ *
+ * @param hc The header tree.
+ * @param entries The number of entries to make room for.
+ *
+ * @return Nothing.
+ */
+static void headerchain_table_reserve(dogecoin_headerchain* hc, size_t entries)
+{
+    dogecoin_headerchain_entry** old = hc->table;
+    size_t old_size = hc->table_size, size = 1024, i;
+    while (size < entries * 2)
+        size <<= 1;
+    if (size <= old_size)
+        return;
+    hc->table = dogecoin_calloc(size, sizeof(*hc->table));
+    hc->table_size = size;
+    for (i = 0; i < old_size; i++) {
+        if (old[i])
+            headerchain_table_insert(hc, old[i]);
+    }
+    dogecoin_free(old);
+}
+
+
+static void headerchain_best_reserve(dogecoin_headerchain* hc, size_t len)
+{
+    if (len <= hc->best_alloc)
+        return;
+    size_t alloc = hc->best_alloc ? hc->best_alloc : 1024;
+    while (alloc < len)
+        alloc <<= 1;
+    hc->best = dogecoin_realloc(hc->best, alloc * sizeof(*hc->best));
+    hc->best_alloc = alloc;
+}
+
+
+/**
+ * @brief This function finds the entry of a block hash.
+ *
+ * @param hc The header tree.
+ * @param hash The block hash.
+ *
+ * @return The entry or NULL if the hash is unknown.
+ */
+dogecoin_headerchain_entry* dogecoin_headerchain_find(const dogecoin_headerchain* hc, const uint256 hash)
+{
+    size_t slot = headerchain_slot(hc, hash);
+    dogecoin_headerchain_entry* entry;
+    while ((entry = hc->table[slot]) != NULL) {
+        if (memcmp(entry->record, hash, DOGECOIN_HASH_LENGTH) == 0)
+            return entry;
+        slot = (slot + 1) & (hc->table_size - 1);
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief This function checks whether an entry is part of
+ * the best chain.
+ *
+ * @param hc The header tree.
+ * @param entry The entry.
+ *
+ * @return 1 if the entry is on the best chain, 0 otherwise.
+ */
+dogecoin_bool dogecoin_headerchain_is_best(const dogecoin_headerchain* hc, const dogecoin_headerchain_entry* entry)
+{
+    size_t idx;
+    if (!entry || entry->height < hc->root->height)
+        return false;
+    idx = entry->height - hc->root->height;
+    return idx < hc->best_len && hc->best[idx] == entry;
+}
+
+
+/**
+ * @brief This function returns the best chain entry at a height.
+ *
+ * @param hc The header tree.
+ * @param height The height.
+ *
+ * @return The entry or NULL if the height is outside the best chain.
+ */
+dogecoin_headerchain_entry* dogecoin_headerchain_at_height(const dogecoin_headerchain* hc, uint32_t height)
+{
+    if (height < hc->root->height || height - hc->root->height >= hc->best_len)
+        return NULL;
+    return hc->best[height - hc->root->height];
+}
+
+
+dogecoin_headerchain_entry* dogecoin_headerchain_tip(const dogecoin_headerchain* hc)
+{
+    return hc->tip;
+}
+
+
+const uint8_t* dogecoin_headerchain_entry_hash(const dogecoin_headerchain_entry* entry)
+{
+    return entry->record;
+}
+
+
+void dogecoin_headerchain_entry_header(const dogecoin_headerchain_entry* entry, dogecoin_block_header* header)
+{
+    struct const_buffer buf = {entry->record + DOGECOIN_HASH_LENGTH, DOGECOIN_BLOCK_HEADER_SIZE};
+    dogecoin_block_header_deserialize(header, &buf);
+}
+
+
+uint32_t dogecoin_headerchain_entry_time(const dogecoin_headerchain_entry* entry)
+{
+    return headerchain_read_u32(entry->record + DOGECOIN_HASH_LENGTH + 68);
+}
+
+
+uint32_t dogecoin_headerchain_entry_bits(const dogecoin_headerchain_entry* entry)
+{
+    return headerchain_read_u32(entry->record + DOGECOIN_HASH_LENGTH + 72);
+}
+
+
+/**
+ * @brief This function moves the best chain to a new tip and
+ * advances the checkpoint anchor along with it.
+ *
+ * @param hc The header tree.
+ * @param tip The new tip.
+ *
+ * @return 1 if blocks of the old best chain were disconnected, 0 otherwise.
+ */
+static dogecoin_bool headerchain_set_tip(dogecoin_headerchain* hc, dogecoin_headerchain_entry* tip)
+{
+    dogecoin_headerchain_entry* fork = tip;
+    const uint32_t root_height = hc->root->height;
+    size_t i;
+
+    while (!dogecoin_headerchain_is_best(hc, fork))
+        fork = fork->prev;
+    dogecoin_bool reorg = fork != hc->tip;
+
+    headerchain_best_reserve(hc, tip->height - root_height + 1);
+    for (dogecoin_headerchain_entry* e = tip; e != fork; e = e->prev)
+        hc->best[e->height - root_height] = e;
+    hc->best_len = tip->height - root_height + 1;
+    hc->tip = tip;
+
+    /* headers at checkpoint heights match the checkpoint, the highest one reached is final */
+    for (i = hc->checkpoint_count; i > 0; i--) {
+        const dogecoin_checkpoint* cp = &hc->checkpoints[i - 1];
+        if (cp->height <= tip->height && cp->height >= root_height) {
+            if (!hc->anchor || cp->height > hc->anchor->height)
+                hc->anchor = hc->best[cp->height - root_height];
+            break;
+        }
+    }
+    return reorg;
+}
+
+
+/**
+ * @brief This function links a stored record into the tree.
+ *
+ * @param hc The header tree.
+ * @param record The block hash followed by the serialized header.
+ * @param reorg Set if the best chain was reorganized, may be NULL.
+ *
+ * @return The new entry or NULL if the record was rejected.
+ */
+static dogecoin_headerchain_entry* headerchain_link(dogecoin_headerchain* hc, const uint8_t* record, dogecoin_bool* reorg)
+{
+    const uint8_t* header = record + DOGECOIN_HASH_LENGTH;
+    dogecoin_headerchain_entry* prev = hc->last;
+    uint256 work;
+    size_t i;
+
+    /* headers arrive and are stored in chain order, skip the table for the common case */
+    if (!prev || memcmp(prev->record, header + 4, DOGECOIN_HASH_LENGTH) != 0)
+        prev = dogecoin_headerchain_find(hc, header + 4);
+    if (!prev)
+        return NULL;
+    /* no forks below the last checkpoint on the best chain */
+    if (hc->anchor && prev->height < hc->anchor->height)
+        return NULL;
+    for (i = 0; i < hc->checkpoint_count; i++) {
+        if (hc->checkpoints[i].height == prev->height + 1 && memcmp(hc->checkpoint_hashes[i], record, DOGECOIN_HASH_LENGTH) != 0)
+            return NULL;
+    }
+    if (!dogecoin_pow_block_work(headerchain_read_u32(header + 72), work))
+        return NULL;
+
+    dogecoin_headerchain_entry* entry = headerchain_arena_alloc(&hc->entries, sizeof(*entry), HEADERCHAIN_ARENA_CHUNK);
+    entry->record = record;
+    entry->prev = prev;
+    entry->height = prev->height + 1;
+    memcpy(entry->chainwork, prev->chainwork, sizeof(entry->chainwork));
+    dogecoin_pow_work_add(entry->chainwork, work);
+
+    headerchain_table_reserve(hc, hc->count + 1);
+    headerchain_table_insert(hc, entry);
+    hc->count++;
+    hc->last = entry;
+
+    if (dogecoin_pow_work_cmp(entry->chainwork, hc->tip->chainwork) > 0) {
+        dogecoin_bool moved = headerchain_set_tip(hc, entry);
+        if (reorg)
+            *reorg = moved;
+    }
+    return entry;
+}
+
+
+/**
+ * @brief This function creates a header tree anchored at one
+ * of the chain's checkpoints. Starting at a recent checkpoint
+ * skips downloading everything before it.
+ *
+ * @param chain The chain parameters.
+ * @param start_height The height of the checkpoint to start at, 0 for the genesis block.
+ *
+ * @return The header tree or NULL if there is no checkpoint at start_height.
+ */
+dogecoin_headerchain* dogecoin_headerchain_new(const dogecoin_chainparams* chain, uint32_t start_height)
+{
+    dogecoin_headerchain* hc = dogecoin_calloc(1, sizeof(*hc));
+    uint8_t* record;
+    size_t i;
+
+    hc->chain = chain;
+    hc->checkpoints = dogecoin_chainparams_checkpoints(chain, &hc->checkpoint_count);
+    if (hc->checkpoint_count) {
+        hc->checkpoint_hashes = dogecoin_calloc(hc->checkpoint_count, sizeof(uint256));
+        for (i = 0; i < hc->checkpoint_count; i++)
+            utils_uint256_sethex((char*)hc->checkpoints[i].hash, hc->checkpoint_hashes[i]);
+    }
+
+    /* the root only carries what the checkpoint knows about its header */
+    record = headerchain_arena_alloc(&hc->records, DOGECOIN_HEADERCHAIN_RECORD_SIZE, HEADERCHAIN_ARENA_CHUNK);
+    if (start_height == 0 && !hc->checkpoint_count) {
+        memcpy(record, chain->genesisblockhash, DOGECOIN_HASH_LENGTH);
+    } else {
+        for (i = 0; i < hc->checkpoint_count && hc->checkpoints[i].height != start_height; i++)
+            ;
+        if (i == hc->checkpoint_count) {
+            dogecoin_headerchain_free(hc);
+            return NULL;
+        }
+        memcpy(record, hc->checkpoint_hashes[i], DOGECOIN_HASH_LENGTH);
+        headerchain_write_u32(record + DOGECOIN_HASH_LENGTH, 1);
+        headerchain_write_u32(record + DOGECOIN_HASH_LENGTH + 68, hc->checkpoints[i].timestamp);
+        headerchain_write_u32(record + DOGECOIN_HASH_LENGTH + 72, hc->checkpoints[i].target);
+    }
+
+    hc->root = headerchain_arena_alloc(&hc->entries, sizeof(*hc->root), HEADERCHAIN_ARENA_CHUNK);
+    hc->root->record = record;
+    hc->root->height = start_height;
+    headerchain_table_reserve(hc, 1);
+    headerchain_table_insert(hc, hc->root);
+    hc->count = 1;
+    headerchain_best_reserve(hc, 1);
+    hc->best[0] = hc->root;
+    hc->best_len = 1;
+    hc->tip = hc->root;
+    hc->last = hc->root;
+    hc->anchor = hc->checkpoint_count ? hc->root : NULL;
+    return hc;
+}
+
+
+void dogecoin_headerchain_free(dogecoin_headerchain* hc)
+{
+    if (!hc)
+        return;
+    if (hc->file)
+        fclose(hc->file);
+    if (hc->map) {
+#ifdef WIN32
+        dogecoin_free((void*)hc->map);
+#else
+        munmap((void*)hc->map, hc->map_len);
+#endif
+    }
+    headerchain_arena_free(hc->entries);
+    headerchain_arena_free(hc->records);
+    dogecoin_free(hc->table);
+    dogecoin_free(hc->best);
+    dogecoin_free(hc->checkpoint_hashes);
+    dogecoin_free(hc);
+}
+
+
+/**
+ * @brief This function maps a header file read only.
+ *
+ * @param hc The header tree, receives the mapping.
+ * @param file The open file.
+ *
+ * @return 1 if the file was mapped, 0 otherwise.
+ */
+static dogecoin_bool headerchain_map(dogecoin_headerchain* hc, FILE* file)
+{
+    long size;
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0)
+        return false;
+    hc->map_len = (size_t)size;
+    if (!hc->map_len)
+        return true;
+#ifdef WIN32
+    /* no mmap, read the file instead */
+    uint8_t* data = dogecoin_malloc(hc->map_len);
+    fseek(file, 0, SEEK_SET);
+    if (fread(data, 1, hc->map_len, file) != hc->map_len) {
+        dogecoin_free(data);
+        return false;
+    }
+    hc->map = data;
+#else
+    void* p = mmap(NULL, hc->map_len, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (p == MAP_FAILED)
+        return false;
+    madvise(p, hc->map_len, MADV_SEQUENTIAL);
+    hc->map = p;
+#endif
+    return true;
+}
+
+
+/**
+ * @brief This function loads the headers stored in a file and
+ * keeps the file open to append further headers. The records
+ * are used in place from a single mapping, a truncated or
+ * unlinkable tail is cut off before the next append.
+ *
+ * @param hc A header tree which has no headers besides its root yet.
+ * @param path The path of the file.
+ *
+ * @return 1 if the file was loaded or created, 0 if it doesn't belong to this tree.
+ */
+dogecoin_bool dogecoin_headerchain_load(dogecoin_headerchain* hc, const char* path)
+{
+    uint8_t file_header[HEADERCHAIN_FILE_HEADER_SIZE];
+    size_t valid_len = HEADERCHAIN_FILE_HEADER_SIZE, count, i;
+
+    if (hc->file || hc->count != 1)
+        return false;
+    FILE* file = fopen(path, "r+b");
+    if (!file)
+        file = fopen(path, "w+b");
+    if (!file)
+        return false;
+    if (!headerchain_map(hc, file)) {
+        fclose(file);
+        return false;
+    }
+
+    memcpy(file_header, HEADERCHAIN_FILE_MAGIC, 8);
+    headerchain_write_u32(file_header + 8, HEADERCHAIN_FILE_VERSION);
+    memcpy(file_header + 12, hc->chain->netmagic, 4);
+    headerchain_write_u32(file_header + 16, hc->root->height);
+    memcpy(file_header + 20, hc->root->record, DOGECOIN_HASH_LENGTH);
+
+    if (hc->map_len >= HEADERCHAIN_FILE_HEADER_SIZE) {
+        if (memcmp(hc->map, file_header, HEADERCHAIN_FILE_HEADER_SIZE) != 0) {
+            fclose(file);
+            return false;
+        }
+        count = (hc->map_len - HEADERCHAIN_FILE_HEADER_SIZE) / DOGECOIN_HEADERCHAIN_RECORD_SIZE;
+        headerchain_table_reserve(hc, count + 1);
+        headerchain_best_reserve(hc, count + 1);
+        for (i = 0; i < count; i++) {
+            const uint8_t* record = hc->map + HEADERCHAIN_FILE_HEADER_SIZE + i * DOGECOIN_HEADERCHAIN_RECORD_SIZE;
+#ifdef __GNUC__
+            /* the table slots are random, fetch them ahead of the insert */
+            if (i + HEADERCHAIN_PREFETCH < count)
+                __builtin_prefetch(&hc->table[headerchain_slot(hc, record + HEADERCHAIN_PREFETCH * DOGECOIN_HEADERCHAIN_RECORD_SIZE)], 1);
+#endif
+            /* records are only appended once, no need to look for duplicates */
+            if (!headerchain_link(hc, record, NULL))
+                break;
+            valid_len += DOGECOIN_HEADERCHAIN_RECORD_SIZE;
+        }
+    } else {
+        /* new or partially written file */
+        fseek(file, 0, SEEK_SET);
+        if (fwrite(file_header, 1, sizeof(file_header), file) != sizeof(file_header)) {
+            fclose(file);
+            return false;
+        }
+    }
+
+    fflush(file);
+    if (valid_len < hc->map_len) {
+#ifdef WIN32
+        _chsize(_fileno(file), (long)valid_len);
+#else
+        if (ftruncate(fileno(file), (off_t)valid_len) != 0) {
+            fclose(file);
+            return false;
+        }
+#endif
+    }
+    fseek(file, 0, SEEK_END);
+    hc->file = file;
+    return true;
+}
+
+
+/**
+ * @brief This function stops appending to the file after a
+ * failed write. Records written behind a partial one would be
+ * misaligned, the next load drops the partial record.
+ *
+ * @param hc The header tree.
+ *
+ * @return Nothing.
+ */
+static void headerchain_file_failed(dogecoin_headerchain* hc)
+{
+    fclose(hc->file);
+    hc->file = NULL;
+    hc->file_failed = true;
+}
+
+
+dogecoin_bool dogecoin_headerchain_flush(dogecoin_headerchain* hc)
+{
+    if (hc->file && fflush(hc->file) != 0)
+        headerchain_file_failed(hc);
+    return !hc->file_failed;
+}
+
+
+/**
+ * @brief This function adds a header to the tree. Headers
+ * which fork off below the last checkpoint of the best chain
+ * or contradict a checkpoint are rejected. The best chain
+ * follows the most accumulated work.
+ *
+ * @param hc The header tree.
+ * @param header The header to add.
+ * @param reorg Set if blocks of the best chain were disconnected, may be NULL.
+ *
+ * @return The entry of the header, also if it was known already, or NULL if it was rejected or its parent is unknown.
+ */
+dogecoin_headerchain_entry* dogecoin_headerchain_connect(dogecoin_headerchain* hc, const dogecoin_block_header* header, dogecoin_bool* reorg)
+{
+    uint8_t buf[DOGECOIN_HEADERCHAIN_RECORD_SIZE];
+    dogecoin_headerchain_entry* entry;
+    ser_writer w;
+
+    if (reorg)
+        *reorg = false;
+    ser_writer_init_buf(&w, buf + DOGECOIN_HASH_LENGTH, DOGECOIN_BLOCK_HEADER_SIZE);
+    dogecoin_block_header_serialize_writer(&w, header);
+    sha256_raw(buf + DOGECOIN_HASH_LENGTH, DOGECOIN_BLOCK_HEADER_SIZE, buf);
+    sha256_raw(buf, SHA256_DIGEST_LENGTH, buf);
+
+    if ((entry = dogecoin_headerchain_find(hc, buf)) != NULL)
+        return entry;
+    uint8_t* record = headerchain_arena_alloc(&hc->records, DOGECOIN_HEADERCHAIN_RECORD_SIZE, HEADERCHAIN_ARENA_CHUNK);
+    memcpy(record, buf, sizeof(buf));
+    entry = headerchain_link(hc, record, reorg);
+    if (!entry) {
+        /* give the space back, it is the last allocation of the arena */
+        hc->records->used -= (DOGECOIN_HEADERCHAIN_RECORD_SIZE + 7) & ~(size_t)7;
+        return NULL;
+    }
+    if (hc->file && fwrite(record, 1, DOGECOIN_HEADERCHAIN_RECORD_SIZE, hc->file) != DOGECOIN_HEADERCHAIN_RECORD_SIZE)
+        headerchain_file_failed(hc);
+    return entry;
+}
+
+
+/**
+ * @brief This function seeds a validation context with an
+ * entry and as many of its ancestors as the context keeps.
+ * The walk back happens once, the context then advances
+ * header by header.
+ *
+ * @param hc The header tree.
+ * @param entry The entry which becomes the last header of the context.
+ * @param ctx The context to initialize.
+ *
+ * @return Nothing.
+ */
+void dogecoin_headerchain_pow_context(const dogecoin_headerchain* hc, const dogecoin_headerchain_entry* entry, dogecoin_pow_context* ctx)
+{
+    const dogecoin_headerchain_entry* ancestors[DOGECOIN_POW_TIME_WINDOW];
+    size_t n = 0;
+
+    while (entry && n < DOGECOIN_POW_TIME_WINDOW) {
+        ancestors[n++] = entry;
+        entry = entry->prev;
+    }
+    dogecoin_pow_context_init(ctx, hc->chain);
+    while (n > 0) {
+        entry = ancestors[--n];
+        dogecoin_pow_context_add(ctx, entry->record, entry->height, dogecoin_headerchain_entry_bits(entry), dogecoin_headerchain_entry_time(entry));
+    }
+}
+
+
+/**
+ * @brief This function validates the headers of a headers
+ * message in one go and adds the valid ones to the tree.
+ *
+ * @param hc The header tree.
+ * @param headers The headers, each following the previous one.
+ * @param pow_headers NULL, or per header the auxpow parent header (NULL entries for regular headers).
+ * @param count The number of headers.
+ * @param reorg Set if blocks of the best chain were disconnected, may be NULL.
+ *
+ * @return The number of leading headers which were valid and added.
+ */
+size_t dogecoin_headerchain_connect_headers(dogecoin_headerchain* hc, const dogecoin_block_header* headers, const dogecoin_block_header* const* pow_headers, size_t count, dogecoin_bool* reorg)
+{
+    dogecoin_headerchain_entry* parent;
+    dogecoin_pow_context* ctx;
+    size_t valid, i;
+
+    if (reorg)
+        *reorg = false;
+    if (count == 0 || (parent = dogecoin_headerchain_find(hc, headers[0].prev_block)) == NULL)
+        return 0;
+    ctx = dogecoin_malloc(sizeof(*ctx));
+    dogecoin_headerchain_pow_context(hc, parent, ctx);
+    valid = dogecoin_pow_context_connect_headers(ctx, headers, pow_headers, count);
+    dogecoin_free(ctx);
+
+    for (i = 0; i < valid; i++) {
+        dogecoin_bool moved = false;
+        if (!dogecoin_headerchain_connect(hc, &headers[i], &moved))
+            break;
+        if (reorg && moved)
+            *reorg = true;
+    }
+    return i;
+}
+
+
+/**
+ * @brief This function builds a block locator of the best
+ * chain: the latest headers one by one, then exponentially
+ * sparser back to the root.
+ *
+ * @param hc The header tree.
+ * @param blocklocators The vector to fill with allocated uint256 hashes.
+ *
+ * @return Nothing.
+ */
+void dogecoin_headerchain_locator(const dogecoin_headerchain* hc, vector* blocklocators)
+{
+    size_t idx = hc->best_len - 1, step = 1;
+    for (;;) {
+        uint256* hash = dogecoin_malloc(sizeof(uint256));
+        memcpy(hash, hc->best[idx]->record, DOGECOIN_HASH_LENGTH);
+        vector_add(blocklocators, hash);
+        if (idx == 0)
+            break;
+        if (blocklocators->len >= HEADERCHAIN_LOCATOR_DENSE)
+            step <<= 1;
+        idx = idx > step ? idx - step : 0;
+    }
+}
@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <string.h>
 #include <dogecoin/mem.h>
 
 void* dogecoin_malloc_internal(size_t size);
@@ -206,6 +207,318 @@ void dogecoin_free_internal(void* ptr)
     free(ptr);
 }
 
+/*
+ * Allocation instrumentation
+ *
+ * The instrumented mapper wraps whatever mapper was active when it got
+ * installed and prepends a small header to every block that remembers the
+ * requested size and the call-site slot. Nothing here is touched unless
+ * dogecoin_mem_set_mapper_instrumented() has been called, so the default
+ * allocation path keeps its cost of a single indirect call.
+ */
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#define DOGECOIN_MEM_TLS __declspec(thread)
+#define DOGECOIN_MEM_LOCK_XCHG(l) InterlockedExchange((volatile LONG*)(l), 1)
+#define DOGECOIN_MEM_LOCK_CLEAR(l) InterlockedExchange((volatile LONG*)(l), 0)
+#else
+#define DOGECOIN_MEM_TLS __thread
+#define DOGECOIN_MEM_LOCK_XCHG(l) __sync_lock_test_and_set((l), 1)
+#define DOGECOIN_MEM_LOCK_CLEAR(l) __sync_lock_release(l)
+#endif
+
+/* keep the header a multiple of 16 bytes so the user pointer retains malloc alignment */
+typedef union dogecoin_mem_header {
+    struct {
+        size_t size;
+        size_t site;
+    } h;
+    unsigned char pad[16];
+} dogecoin_mem_header;
+
+static dogecoin_mem_mapper inner_mem_mapper = {dogecoin_malloc_internal, dogecoin_calloc_internal, dogecoin_realloc_internal, dogecoin_free_internal};
+static dogecoin_mem_stats mem_stats;
+static volatile long mem_stats_lock = 0;
+static DOGECOIN_MEM_TLS const char* mem_current_tag = NULL;
+
+static void mem_stats_acquire()
+{
+    while (DOGECOIN_MEM_LOCK_XCHG(&mem_stats_lock)) {
+    }
+}
+
+static void mem_stats_release()
+{
+    DOGECOIN_MEM_LOCK_CLEAR(&mem_stats_lock);
+}
+
+/**
+ * @brief This function maps an allocation size to its
+ * power-of-two size class.
+ * 
+ * @param size The requested size in bytes.
+ * 
+ * @return The index of the size class bucket.
+ */
+static unsigned int mem_size_class(size_t size)
+{
+    unsigned int bucket = 0;
+    size_t limit = 16;
+    while (size > limit && bucket < DOGECOIN_MEM_SIZE_CLASSES - 1) {
+        limit <<= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * @brief This function looks up (or registers) the slot of the
+ * calling thread's current tag. Must be called with the lock held.
+ * 
+ * @return The slot index, 0 for untagged or overflowing tags.
+ */
+static size_t mem_site_slot()
+{
+    const char* tag = mem_current_tag;
+    size_t i;
+    if (!tag)
+        return 0;
+    for (i = 1; i < mem_stats.site_count; i++) {
+        if (mem_stats.sites[i].tag == tag || strcmp(mem_stats.sites[i].tag, tag) == 0)
+            return i;
+    }
+    if (mem_stats.site_count >= DOGECOIN_MEM_MAX_SITES)
+        return 0;
+    mem_stats.sites[mem_stats.site_count].tag = tag;
+    return mem_stats.site_count++;
+}
+
+static void mem_stats_account_alloc(dogecoin_mem_header* hdr, size_t size)
+{
+    dogecoin_mem_site_stats* site;
+    mem_stats_acquire();
+    hdr->h.size = size;
+    hdr->h.site = mem_site_slot();
+    site = &mem_stats.sites[hdr->h.site];
+    mem_stats.live_bytes += size;
+    mem_stats.live_allocs++;
+    mem_stats.total_allocs++;
+    mem_stats.size_classes[mem_size_class(size)]++;
+    if (mem_stats.live_bytes > mem_stats.peak_bytes)
+        mem_stats.peak_bytes = mem_stats.live_bytes;
+    site->allocs++;
+    site->live_bytes += size;
+    if (site->live_bytes > site->peak_bytes)
+        site->peak_bytes = site->live_bytes;
+    mem_stats_release();
+}
+
+static void mem_stats_account_free(const dogecoin_mem_header* hdr)
+{
+    dogecoin_mem_site_stats* site;
+    mem_stats_acquire();
+    site = &mem_stats.sites[hdr->h.site];
+    /* counters may have been reset while the block was alive */
+    mem_stats.live_bytes -= hdr->h.size <= mem_stats.live_bytes ? hdr->h.size : mem_stats.live_bytes;
+    if (mem_stats.live_allocs)
+        mem_stats.live_allocs--;
+    mem_stats.total_frees++;
+    site->live_bytes -= hdr->h.size <= site->live_bytes ? hdr->h.size : site->live_bytes;
+    site->frees++;
+    mem_stats_release();
+}
+
+static void* dogecoin_malloc_instrumented(size_t size)
+{
+    dogecoin_mem_header* hdr;
+    if (size > SIZE_MAX - sizeof(*hdr))
+        return NULL;
+    hdr = inner_mem_mapper.dogecoin_malloc(sizeof(*hdr) + size);
+    if (!hdr)
+        return NULL;
+    mem_stats_account_alloc(hdr, size);
+    return hdr + 1;
+}
+
+static void* dogecoin_calloc_instrumented(size_t count, size_t size)
+{
+    dogecoin_mem_header* hdr;
+    if (size && count > (SIZE_MAX - sizeof(*hdr)) / size)
+        return NULL;
+    hdr = inner_mem_mapper.dogecoin_calloc(1, sizeof(*hdr) + count * size);
+    if (!hdr)
+        return NULL;
+    mem_stats_account_alloc(hdr, count * size);
+    return hdr + 1;
+}
+
+static void* dogecoin_realloc_instrumented(void* ptr, size_t size)
+{
+    dogecoin_mem_header* hdr;
+    dogecoin_mem_header old;
+    if (!ptr)
+        return dogecoin_malloc_instrumented(size);
+    if (size > SIZE_MAX - sizeof(*hdr))
+        return NULL;
+    old = *((dogecoin_mem_header*)ptr - 1);
+    hdr = inner_mem_mapper.dogecoin_realloc((dogecoin_mem_header*)ptr - 1, sizeof(*hdr) + size);
+    if (!hdr)
+        return NULL;
+    /* a realloc is accounted as a free of the old block plus a new allocation */
+    mem_stats_account_free(&old);
+    mem_stats_account_alloc(hdr, size);
+    mem_stats_acquire();
+    mem_stats.total_reallocs++;
+    mem_stats.total_allocs--;
+    mem_stats.total_frees--;
+    mem_stats_release();
+    return hdr + 1;
+}
+
+static void dogecoin_free_instrumented(void* ptr)
+{
+    dogecoin_mem_header* hdr;
+    if (!ptr)
+        return;
+    hdr = (dogecoin_mem_header*)ptr - 1;
+    mem_stats_account_free(hdr);
+    inner_mem_mapper.dogecoin_free(hdr);
+}
+
+
+/**
+ * @brief This function installs the instrumented memory mapper
+ * on top of the current one and resets the statistics.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_mem_set_mapper_instrumented()
+{
+    if (dogecoin_mem_instrumented())
+        return;
+    inner_mem_mapper = current_mem_mapper;
+    dogecoin_mem_stats_reset();
+    current_mem_mapper.dogecoin_malloc = dogecoin_malloc_instrumented;
+    current_mem_mapper.dogecoin_calloc = dogecoin_calloc_instrumented;
+    current_mem_mapper.dogecoin_realloc = dogecoin_realloc_instrumented;
+    current_mem_mapper.dogecoin_free = dogecoin_free_instrumented;
+}
+
+
+/**
+ * @brief This function checks whether the instrumented
+ * memory mapper is the one currently in use.
+ * 
+ * @return True if allocations are being instrumented.
+ */
+dogecoin_bool dogecoin_mem_instrumented()
+{
+    return current_mem_mapper.dogecoin_malloc == dogecoin_malloc_instrumented;
+}
+
+
+/**
+ * @brief This function sets the call-site tag of the calling
+ * thread which subsequent allocations are attributed to.
+ * 
+ * @param tag The tag (NULL for untagged).
+ * 
+ * @return The previously active tag.
+ */
+const char* dogecoin_mem_set_tag(const char* tag)
+{
+    const char* prev = mem_current_tag;
+    mem_current_tag = tag;
+    return prev;
+}
+
+
+/**
+ * @brief This function copies the current allocation
+ * statistics into stats.
+ * 
+ * @param stats The snapshot to be filled.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_mem_stats_snapshot(dogecoin_mem_stats* stats)
+{
+    if (!stats)
+        return;
+    mem_stats_acquire();
+    *stats = mem_stats;
+    mem_stats_release();
+}
+
+
+/**
+ * @brief This function resets all counters. Live blocks
+ * stay tracked in their slot but no longer count as live.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_mem_stats_reset()
+{
+    size_t i;
+    mem_stats_acquire();
+    for (i = 0; i < DOGECOIN_MEM_SIZE_CLASSES; i++)
+        mem_stats.size_classes[i] = 0;
+    mem_stats.live_bytes = mem_stats.peak_bytes = mem_stats.live_allocs = 0;
+    mem_stats.total_allocs = mem_stats.total_reallocs = mem_stats.total_frees = 0;
+    /* keep registered tags so slots of live blocks remain valid */
+    if (mem_stats.site_count == 0)
+        mem_stats.site_count = 1;
+    mem_stats.sites[0].tag = "untagged";
+    for (i = 0; i < mem_stats.site_count; i++) {
+        mem_stats.sites[i].allocs = mem_stats.sites[i].frees = 0;
+        mem_stats.sites[i].live_bytes = mem_stats.sites[i].peak_bytes = 0;
+    }
+    mem_stats_release();
+}
+
+
+/**
+ * @brief This function prints a human readable report of
+ * a statistics snapshot.
+ * 
+ * @param stream The stream to print to.
+ * @param stats The snapshot to print, NULL to take a fresh one.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_mem_stats_print(FILE* stream, const dogecoin_mem_stats* stats)
+{
+    dogecoin_mem_stats snapshot;
+    size_t i, limit = 16;
+    if (!stream)
+        return;
+    if (!stats) {
+        dogecoin_mem_stats_snapshot(&snapshot);
+        stats = &snapshot;
+    }
+    fprintf(stream, "live: %llu bytes in %llu blocks, peak: %llu bytes\n",
+            (unsigned long long)stats->live_bytes, (unsigned long long)stats->live_allocs, (unsigned long long)stats->peak_bytes);
+    fprintf(stream, "allocs: %llu, reallocs: %llu, frees: %llu\n",
+            (unsigned long long)stats->total_allocs, (unsigned long long)stats->total_reallocs, (unsigned long long)stats->total_frees);
+    for (i = 0; i < DOGECOIN_MEM_SIZE_CLASSES; i++, limit <<= 1) {
+        if (!stats->size_classes[i])
+            continue;
+        if (i == DOGECOIN_MEM_SIZE_CLASSES - 1)
+            fprintf(stream, "  >%-10llu %llu\n", (unsigned long long)(limit >> 1), (unsigned long long)stats->size_classes[i]);
+        else
+            fprintf(stream, "  <=%-9llu %llu\n", (unsigned long long)limit, (unsigned long long)stats->size_classes[i]);
+    }
+    for (i = 0; i < stats->site_count; i++) {
+        const dogecoin_mem_site_stats* site = &stats->sites[i];
+        if (!site->allocs && !site->live_bytes)
+            continue;
+        fprintf(stream, "  %-24s allocs: %llu, frees: %llu, live: %llu, peak: %llu\n", site->tag,
+                (unsigned long long)site->allocs, (unsigned long long)site->frees,
+                (unsigned long long)site->live_bytes, (unsigned long long)site->peak_bytes);
+    }
+}
+
 void* memcpy_safe(void* destination, const void* source, size_t count) {
     char *pszDest = (char *)destination;
     const char *pszSource =( const char*)source;
@@ -0,0 +1,357 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <string.h>
+
+#include <dogecoin/mem.h>
+#include <dogecoin/merkle.h>
+#include <dogecoin/sha2.h>
+
+/**
+ * @brief This function computes the merkle root of a list of
+ * leaves. Each level is hashed in place with the batched
+ * 64 byte double SHA-256, an odd node is paired with itself.
+ *
+ * @param leaves The leaves.
+ * @param count The number of leaves.
+ * @param root The resulting root.
+ * @param mutated Set if identical nodes were paired, may be NULL.
+ *
+ * @return 1 if the root was computed, 0 if there are no leaves.
+ */
+dogecoin_bool dogecoin_merkle_root(const uint256* leaves, size_t count, uint256 root, dogecoin_bool* mutated)
+{
+    uint8_t* level;
+    size_t n = count, i;
+    dogecoin_bool dup = false;
+
+    if (mutated)
+        *mutated = false;
+    memset(root, 0, DOGECOIN_HASH_LENGTH);
+    if (count == 0)
+        return false;
+    level = dogecoin_malloc((count + 1) * DOGECOIN_HASH_LENGTH);
+    memcpy(level, leaves, count * DOGECOIN_HASH_LENGTH);
+    while (n > 1) {
+        for (i = 0; i + 1 < n; i += 2) {
+            if (memcmp(level + i * DOGECOIN_HASH_LENGTH, level + (i + 1) * DOGECOIN_HASH_LENGTH, DOGECOIN_HASH_LENGTH) == 0)
+                dup = true;
+        }
+        if (n & 1) {
+            memcpy(level + n * DOGECOIN_HASH_LENGTH, level + (n - 1) * DOGECOIN_HASH_LENGTH, DOGECOIN_HASH_LENGTH);
+            n++;
+        }
+        n /= 2;
+        sha256d64(level, level, n);
+    }
+    memcpy(root, level, DOGECOIN_HASH_LENGTH);
+    dogecoin_free(level);
+    if (mutated)
+        *mutated = dup;
+    return true;
+}
+
+
+/**
+ * @brief This function generates the merkle branch of a
+ * leaf: the sibling on every level up to the root.
+ *
+ * @param leaves The leaves.
+ * @param count The number of leaves.
+ * @param index The position of the leaf to prove.
+ * @param branch The resulting siblings, leaf level first.
+ *
+ * @return The length of the branch, 0 if index is out of range or there is a single leaf.
+ */
+size_t dogecoin_merkle_branch(const uint256* leaves, size_t count, uint32_t index, uint256 branch[DOGECOIN_MERKLE_MAX_DEPTH])
+{
+    uint8_t* level;
+    size_t n = count, len = 0;
+
+    if (index >= count)
+        return 0;
+    level = dogecoin_malloc((count + 1) * DOGECOIN_HASH_LENGTH);
+    memcpy(level, leaves, count * DOGECOIN_HASH_LENGTH);
+    while (n > 1 && len < DOGECOIN_MERKLE_MAX_DEPTH) {
+        if (n & 1) {
+            memcpy(level + n * DOGECOIN_HASH_LENGTH, level + (n - 1) * DOGECOIN_HASH_LENGTH, DOGECOIN_HASH_LENGTH);
+            n++;
+        }
+        memcpy(branch[len++], level + (index ^ 1) * DOGECOIN_HASH_LENGTH, DOGECOIN_HASH_LENGTH);
+        n /= 2;
+        sha256d64(level, level, n);
+        index >>= 1;
+    }
+    dogecoin_free(level);
+    return len;
+}
+
+
+/**
+ * @brief This function computes the root a merkle branch
+ * leads to, the bits of index tell on which side the leaf's
+ * path is on every level.
+ *
+ * @param leaf The leaf.
+ * @param branch The siblings, leaf level first.
+ * @param len The length of the branch.
+ * @param index The position of the leaf.
+ * @param root The resulting root.
+ *
+ * @return Nothing.
+ */
+void dogecoin_merkle_root_from_branch(const uint256 leaf, const uint256* branch, size_t len, int64_t index, uint256 root)
+{
+    uint8_t node[2 * DOGECOIN_HASH_LENGTH];
+    size_t i;
+
+    if (index < 0) {
+        memset(root, 0, DOGECOIN_HASH_LENGTH);
+        return;
+    }
+    memcpy(root, leaf, DOGECOIN_HASH_LENGTH);
+    for (i = 0; i < len; i++, index >>= 1) {
+        if (index & 1) {
+            memcpy(node, branch[i], DOGECOIN_HASH_LENGTH);
+            memcpy(node + DOGECOIN_HASH_LENGTH, root, DOGECOIN_HASH_LENGTH);
+        } else {
+            memcpy(node, root, DOGECOIN_HASH_LENGTH);
+            memcpy(node + DOGECOIN_HASH_LENGTH, branch[i], DOGECOIN_HASH_LENGTH);
+        }
+        sha256d64(root, node, 1);
+    }
+}
+
+
+dogecoin_bool dogecoin_merkle_verify_branch(const uint256 leaf, const uint256* branch, size_t len, uint32_t index, const uint256 root)
+{
+    uint256 computed;
+    if (len < DOGECOIN_MERKLE_MAX_DEPTH && (index >> len) != 0)
+        return false; /* index outside of the tree */
+    dogecoin_merkle_root_from_branch(leaf, branch, len, index, computed);
+    return memcmp(computed, root, DOGECOIN_HASH_LENGTH) == 0;
+}
+
+
+/* number of nodes on a level of a tree with total leaves, height 0 being the leaves */
+static uint32_t merkle_partial_width(uint32_t total, int height)
+{
+    return (uint32_t)(((uint64_t)total + ((uint64_t)1 << height) - 1) >> height);
+}
+
+typedef struct merkle_partial_builder_ {
+    uint32_t total;
+    const uint8_t* levels[DOGECOIN_MERKLE_MAX_DEPTH + 1];
+    const uint8_t* matched[DOGECOIN_MERKLE_MAX_DEPTH + 1];
+    cstring* hashes;
+    cstring* flags;
+    size_t flags_start;
+    size_t bits;
+} merkle_partial_builder;
+
+static void merkle_partial_build_node(merkle_partial_builder* b, int height, uint32_t pos)
+{
+    uint8_t parent_of_match = b->matched[height][pos];
+    if ((b->bits & 7) == 0)
+        cstr_append_c(b->flags, 0);
+    if (parent_of_match)
+        b->flags->str[b->flags_start + (b->bits >> 3)] |= (char)(1 << (b->bits & 7));
+    b->bits++;
+    if (height == 0 || !parent_of_match) {
+        cstr_append_buf(b->hashes, b->levels[height] + (size_t)pos * DOGECOIN_HASH_LENGTH, DOGECOIN_HASH_LENGTH);
+        return;
+    }
+    merkle_partial_build_node(b, height - 1, pos * 2);
+    if (pos * 2 + 1 < merkle_partial_width(b->total, height - 1))
+        merkle_partial_build_node(b, height - 1, pos * 2 + 1);
+}
+
+
+/**
+ * @brief This function builds the partial merkle tree of a
+ * merkleblock message. All levels of the tree are hashed
+ * once with the batched double SHA-256, the tree is then
+ * walked depth first, descending only into subtrees which
+ * hold a matched leaf.
+ *
+ * @param leaves The leaves.
+ * @param count The number of leaves.
+ * @param match Flags the leaves to prove.
+ * @param hashes The node hashes are appended to this string.
+ * @param flags The flag bytes are appended to this string.
+ *
+ * @return 1 if the tree was built, 0 if there are no or too many leaves.
+ */
+dogecoin_bool dogecoin_merkle_partial_build(const uint256* leaves, size_t count, const dogecoin_bool* match, cstring* hashes, cstring* flags)
+{
+    merkle_partial_builder b;
+    uint8_t *nodes, *matched;
+    size_t total_nodes = 0, offset = 0, i;
+    int height = 0, h;
+
+    if (count == 0 || count > DOGECOIN_MERKLE_MAX_PARTIAL_LEAVES)
+        return false;
+    while (merkle_partial_width((uint32_t)count, height) > 1)
+        height++;
+    /* every level gets an even number of slots, room to pair an odd last node with itself */
+    for (h = 0; h <= height; h++)
+        total_nodes += (merkle_partial_width((uint32_t)count, h) + 1) & ~(size_t)1;
+    nodes = dogecoin_malloc(total_nodes * DOGECOIN_HASH_LENGTH);
+    matched = dogecoin_calloc(1, total_nodes);
+
+    dogecoin_mem_zero(&b, sizeof(b));
+    b.total = (uint32_t)count;
+    b.hashes = hashes;
+    b.flags = flags;
+    b.flags_start = flags->len;
+    memcpy(nodes, leaves, count * DOGECOIN_HASH_LENGTH);
+    for (i = 0; i < count; i++)
+        matched[i] = match[i] ? 1 : 0;
+    for (h = 0; h <= height; h++) {
+        size_t width = merkle_partial_width((uint32_t)count, h), slots = (width + 1) & ~(size_t)1;
+        uint8_t* level = nodes + offset * DOGECOIN_HASH_LENGTH;
+        b.levels[h] = level;
+        b.matched[h] = matched + offset;
+        if (h == height)
+            break;
+        if (width & 1)
+            memcpy(level + width * DOGECOIN_HASH_LENGTH, level + (width - 1) * DOGECOIN_HASH_LENGTH, DOGECOIN_HASH_LENGTH);
+        for (i = 0; i < width; i++)
+            matched[offset + slots + i / 2] |= matched[offset + i];
+        sha256d64(level + slots * DOGECOIN_HASH_LENGTH, level, slots / 2);
+        offset += slots;
+    }
+    merkle_partial_build_node(&b, height, 0);
+    dogecoin_free(nodes);
+    dogecoin_free(matched);
+    return true;
+}
+
+
+typedef struct merkle_partial_extractor_ {
+    uint32_t total;
+    const unsigned char* hashes;
+    size_t hash_count;
+    size_t hashes_used;
+    const unsigned char* flags;
+    size_t flag_bytes;
+    size_t bits_used;
+    uint256* matches;
+    uint32_t* indexes;
+    size_t match_count;
+    dogecoin_bool bad;
+} merkle_partial_extractor;
+
+static void merkle_partial_extract_node(merkle_partial_extractor* e, int height, uint32_t pos, uint8_t* out)
+{
+    uint8_t node[2 * DOGECOIN_HASH_LENGTH];
+    dogecoin_bool parent_of_match;
+
+    if (e->bits_used >= e->flag_bytes * 8) {
+        e->bad = true;
+        return;
+    }
+    parent_of_match = (e->flags[e->bits_used >> 3] >> (e->bits_used & 7)) & 1;
+    e->bits_used++;
+    if (height == 0 || !parent_of_match) {
+        if (e->hashes_used >= e->hash_count) {
+            e->bad = true;
+            return;
+        }
+        memcpy(out, e->hashes + e->hashes_used++ * DOGECOIN_HASH_LENGTH, DOGECOIN_HASH_LENGTH);
+        if (height == 0 && parent_of_match) {
+            if (e->matches)
+                memcpy(e->matches[e->match_count], out, DOGECOIN_HASH_LENGTH);
+            if (e->indexes)
+                e->indexes[e->match_count] = pos;
+            e->match_count++;
+        }
+        return;
+    }
+    merkle_partial_extract_node(e, height - 1, pos * 2, node);
+    if (e->bad)
+        return;
+    if (pos * 2 + 1 < merkle_partial_width(e->total, height - 1)) {
+        merkle_partial_extract_node(e, height - 1, pos * 2 + 1, node + DOGECOIN_HASH_LENGTH);
+        /* identical siblings would let another leaf list prove the same root (CVE-2012-2459) */
+        if (!e->bad && memcmp(node, node + DOGECOIN_HASH_LENGTH, DOGECOIN_HASH_LENGTH) == 0)
+            e->bad = true;
+        if (e->bad)
+            return;
+    } else {
+        memcpy(node + DOGECOIN_HASH_LENGTH, node, DOGECOIN_HASH_LENGTH);
+    }
+    sha256d64(out, node, 1);
+}
+
+
+/**
+ * @brief This function walks the partial merkle tree of a
+ * merkleblock message, collecting the matched leaves and
+ * computing the root. The tree must use every hash and flag
+ * byte given.
+ *
+ * @param total The number of leaves of the full tree.
+ * @param hashes The node hashes, 32 bytes each.
+ * @param hash_count The number of node hashes.
+ * @param flags The flag bits.
+ * @param flag_bytes The number of flag bytes.
+ * @param root The resulting root.
+ * @param matches Receives the matched leaves, may be NULL.
+ * @param indexes Receives the positions of the matched leaves, may be NULL.
+ * @param match_count Set to the number of matched leaves.
+ *
+ * @return 1 if the tree is well formed, 0 otherwise.
+ */
+dogecoin_bool dogecoin_merkle_partial_extract(uint32_t total, const unsigned char* hashes, size_t hash_count, const unsigned char* flags, size_t flag_bytes, uint256 root, uint256* matches, uint32_t* indexes, size_t* match_count)
+{
+    merkle_partial_extractor e;
+    int height = 0;
+
+    *match_count = 0;
+    memset(root, 0, DOGECOIN_HASH_LENGTH);
+    if (total == 0 || total > DOGECOIN_MERKLE_MAX_PARTIAL_LEAVES || hash_count > total || hash_count == 0 || flag_bytes * 8 < hash_count)
+        return false;
+    while (merkle_partial_width(total, height) > 1)
+        height++;
+
+    dogecoin_mem_zero(&e, sizeof(e));
+    e.total = total;
+    e.hashes = hashes;
+    e.hash_count = hash_count;
+    e.flags = flags;
+    e.flag_bytes = flag_bytes;
+    e.matches = matches;
+    e.indexes = indexes;
+    merkle_partial_extract_node(&e, height, 0, root);
+    *match_count = e.match_count;
+    /* all flag bytes and hashes have to be consumed */
+    if (e.bad || (e.bits_used + 7) / 8 != flag_bytes || e.hashes_used != hash_count) {
+        memset(root, 0, DOGECOIN_HASH_LENGTH);
+        return false;
+    }
+    return true;
+}
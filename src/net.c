@@ -49,11 +49,15 @@
 #include <event2/util.h>
 #include <event2/buffer.h>
 #include <event2/bufferevent.h>
+#include <event2/dns.h>
+#include <event2/thread.h>
 
+#include <dogecoin/bloom.h>
 #include <dogecoin/buffer.h>
 #include <dogecoin/chainparams.h>
 #include <dogecoin/cstr.h>
 #include <dogecoin/hash.h>
+#include <dogecoin/merkle.h>
 #include <dogecoin/net.h>
 #include <dogecoin/protocol.h>
 #include <dogecoin/serialize.h>
@@ -64,6 +68,261 @@
 static const int DOGECOIN_PERIODICAL_NODE_TIMER_S = 3;
 static const int DOGECOIN_PING_INTERVAL_S = 120;
 static const int DOGECOIN_CONNECT_TIMEOUT_S = 10;
+static const unsigned int DOGECOIN_DNS_SEED_TIMEOUT_S = 5;
+static const size_t DOGECOIN_NODE_SEND_LIMIT = 16 * 1024 * 1024;
+static const size_t DOGECOIN_NODE_SEND_HIGH_WATERMARK = 4 * 1024 * 1024;
+static const size_t DOGECOIN_NODE_SEND_LOW_WATERMARK = 512 * 1024;
+
+static void dogecoin_node_group_register_default_handlers(dogecoin_node_group* group);
+static dogecoin_bool dogecoin_node_group_connect_next_nodes_locked(dogecoin_node_group* group);
+
+static uint64_t dogecoin_node_time_ms(void)
+{
+    struct timeval tv;
+    evutil_gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + (uint64_t)tv.tv_usec / 1000;
+}
+
+/* a complete message waiting for a worker */
+typedef struct dogecoin_node_job_ {
+    struct dogecoin_node_job_* next;
+    dogecoin_node* node;
+    uint32_t generation; /* the node's connection the message arrived on */
+    dogecoin_p2p_msg_hdr hdr;
+    cstring* payload;
+} dogecoin_node_job;
+
+/* a worker processes the messages of the nodes hashed to it in arrival order */
+typedef struct dogecoin_node_worker_ {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    dogecoin_node_job* head;
+    dogecoin_node_job* tail;
+    size_t queued;
+    dogecoin_bool stop;
+    dogecoin_bool started;
+} dogecoin_node_worker;
+
+/* an event base and the thread running it */
+typedef struct dogecoin_node_shard_ {
+    struct event_base* base;
+    pthread_t thread;
+    pthread_mutex_t lock; /* guards the bufferevents of the shard's nodes against senders on other threads */
+    dogecoin_bool running;
+} dogecoin_node_shard;
+
+typedef struct dogecoin_node_threads_ {
+    pthread_mutex_t lock; /* recursive, serializes connection state changes across shards */
+    pthread_cond_t idle;  /* signalled after a connection state change */
+    dogecoin_node_shard* shards;
+    size_t shard_count;
+    size_t next_shard;
+    dogecoin_node_worker* workers;
+    size_t worker_count;
+} dogecoin_node_threads;
+
+/* the number of dns seed slots of dogecoin_chainparams */
+#define DOGECOIN_DNS_SEED_SLOTS (sizeof(((dogecoin_chainparams*)0)->dnsseeds) / sizeof(dogecoin_dns_seed))
+
+/* an A or AAAA query for one of the chain's dns seeds */
+typedef struct dogecoin_dns_query_ {
+    struct dogecoin_dns_seeding_* seeding;
+    const char* domain;
+    int family;
+} dogecoin_dns_query;
+
+typedef struct dogecoin_dns_seeding_ {
+    dogecoin_node_group* group;
+    struct evdns_base* dns;
+    dogecoin_dns_query queries[2 * DOGECOIN_DNS_SEED_SLOTS]; /* both families of every seed */
+    size_t pending; /* queries not answered or timed out yet, guarded by the group lock */
+    dogecoin_bool stopped; /* the group shut down, late answers are dropped */
+} dogecoin_dns_seeding;
+
+/* group may be NULL for nodes that were never added to one */
+static void dogecoin_node_group_lock(dogecoin_node_group* group)
+{
+    if (group && group->threads)
+        pthread_mutex_lock(&group->threads->lock);
+}
+
+static void dogecoin_node_group_unlock(dogecoin_node_group* group)
+{
+    if (group && group->threads)
+        pthread_mutex_unlock(&group->threads->lock);
+}
+
+/* a node's stats, state and generation are guarded like its bufferevent, by the shard's lock in
+ * threaded groups. state is written under the group lock as well, so either lock allows reading it */
+static void dogecoin_node_stats_lock(dogecoin_node* node)
+{
+    if (node->shard)
+        pthread_mutex_lock(&node->shard->lock);
+}
+
+static void dogecoin_node_stats_unlock(dogecoin_node* node)
+{
+    if (node->shard)
+        pthread_mutex_unlock(&node->shard->lock);
+}
+
+static void dogecoin_node_group_notify(dogecoin_node_group* group)
+{
+    if (group && group->threads)
+        pthread_cond_broadcast(&group->threads->idle);
+}
+
+/**
+ * This function hands a call that changes the node's connection over to
+ * the thread running the node's event base, libevent objects must only
+ * be released there.
+ *
+ * @param node The node the call is about.
+ * @param cb The callback, invoked with the node as its argument.
+ *
+ * @return 1 if the call was scheduled, 0 if the caller may run it directly.
+ */
+static dogecoin_bool dogecoin_node_defer_to_shard(dogecoin_node* node, event_callback_fn cb)
+{
+    dogecoin_node_shard* shard = node->shard;
+    if (!shard)
+        return false;
+    dogecoin_bool deferred = false;
+    dogecoin_node_group_lock(node->nodegroup);
+    if (shard->running && !pthread_equal(pthread_self(), shard->thread)) {
+        struct timeval now = {0, 0};
+        deferred = event_base_once(shard->base, -1, EV_TIMEOUT, cb, node, &now) == 0;
+    }
+    dogecoin_node_group_unlock(node->nodegroup);
+    return deferred;
+}
+
+static void dogecoin_node_deferred_disconnect(evutil_socket_t fd, short event, void* ctx)
+{
+    UNUSED(fd);
+    UNUSED(event);
+    dogecoin_node_disconnect((dogecoin_node*)ctx);
+}
+
+static void dogecoin_node_deferred_misbehave(evutil_socket_t fd, short event, void* ctx)
+{
+    UNUSED(fd);
+    UNUSED(event);
+    dogecoin_node_misbehave((dogecoin_node*)ctx);
+}
+
+static void* dogecoin_node_worker_run(void* ctx)
+{
+    dogecoin_node_worker* worker = ctx;
+    pthread_mutex_lock(&worker->lock);
+    for (;;) {
+        while (!worker->head && !worker->stop)
+            pthread_cond_wait(&worker->cond, &worker->lock);
+        if (worker->stop)
+            break;
+        dogecoin_node_job* job = worker->head;
+        worker->head = job->next;
+        if (!worker->head)
+            worker->tail = NULL;
+        worker->queued--;
+        pthread_mutex_unlock(&worker->lock);
+
+        /* messages of a connection that was closed or replaced since are dropped */
+        dogecoin_node_stats_lock(job->node);
+        dogecoin_bool current = job->generation == job->node->generation &&
+                                (job->node->state & NODE_CONNECTED) == NODE_CONNECTED;
+        dogecoin_node_stats_unlock(job->node);
+        if (current) {
+            struct const_buffer buf = {job->payload->str, job->payload->len};
+            dogecoin_node_parse_message(job->node, &job->hdr, &buf);
+        }
+        cstr_free(job->payload, true);
+        dogecoin_free(job);
+        pthread_mutex_lock(&worker->lock);
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+/**
+ * This function queues a complete message for the worker that owns the
+ * node, so a node's messages are processed one at a time and in order.
+ */
+static void dogecoin_node_queue_message(dogecoin_node* node, uint32_t generation, const dogecoin_p2p_msg_hdr* hdr, const unsigned char* payload)
+{
+    dogecoin_node_threads* threads = node->nodegroup->threads;
+    dogecoin_node_worker* worker = &threads->workers[(size_t)node->nodeid % threads->worker_count];
+    dogecoin_node_job* job = dogecoin_calloc(1, sizeof(*job));
+    job->node = node;
+    job->generation = generation;
+    job->hdr = *hdr;
+    job->payload = cstr_new_buf(payload, hdr->data_len);
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->tail)
+        worker->tail->next = job;
+    else
+        worker->head = job;
+    worker->tail = job;
+    worker->queued++;
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->lock);
+}
+
+static void* dogecoin_node_shard_run(void* ctx)
+{
+    dogecoin_node_shard* shard = ctx;
+    event_base_loop(shard->base, EVLOOP_NO_EXIT_ON_EMPTY);
+    return NULL;
+}
+
+/**
+ * This function stops and joins the workers and drops the messages they
+ * did not get to.
+ */
+static void dogecoin_node_threads_stop_workers(dogecoin_node_threads* threads)
+{
+    size_t i;
+    for (i = 0; i < threads->worker_count; i++) {
+        dogecoin_node_worker* worker = &threads->workers[i];
+        pthread_mutex_lock(&worker->lock);
+        worker->stop = true;
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->lock);
+        if (worker->started)
+            pthread_join(worker->thread, NULL);
+        worker->started = false;
+        while (worker->head) {
+            dogecoin_node_job* job = worker->head;
+            worker->head = job->next;
+            cstr_free(job->payload, true);
+            dogecoin_free(job);
+        }
+        worker->tail = NULL;
+        worker->queued = 0;
+    }
+}
+
+static void dogecoin_node_threads_free(dogecoin_node_threads* threads)
+{
+    size_t i;
+    dogecoin_node_threads_stop_workers(threads);
+    for (i = 0; i < threads->worker_count; i++) {
+        pthread_mutex_destroy(&threads->workers[i].lock);
+        pthread_cond_destroy(&threads->workers[i].cond);
+    }
+    for (i = 0; i < threads->shard_count; i++) {
+        if (threads->shards[i].base)
+            event_base_free(threads->shards[i].base);
+        pthread_mutex_destroy(&threads->shards[i].lock);
+    }
+    pthread_mutex_destroy(&threads->lock);
+    pthread_cond_destroy(&threads->idle);
+    dogecoin_free(threads->workers);
+    dogecoin_free(threads->shards);
+    dogecoin_free(threads);
+}
 
 /**
  * This function is used to print debug messages to the log file
@@ -95,12 +354,77 @@ int net_write_log_null(const char* format, ...)
     return 1;
 }
 
+/**
+ * This function adds a message to the node's totals and to the counters
+ * of its command, the caller holds the stats lock.
+ *
+ * @param stats The node's stats.
+ * @param command The message's command, 12 bytes padded with zeros.
+ * @param len The size of the message including its header.
+ * @param out Whether the message was sent or received.
+ */
+static void dogecoin_node_stats_count(dogecoin_node_stats* stats, const char* command, size_t len, dogecoin_bool out)
+{
+    dogecoin_node_cmd_stats* cmd = NULL;
+    size_t i;
+    for (i = 0; i < stats->cmd_count && !cmd; i++)
+        if (strncmp(stats->cmds[i].command, command, sizeof(stats->cmds[i].command)) == 0)
+            cmd = &stats->cmds[i];
+    if (!cmd && stats->cmd_count < DOGECOIN_NODE_MAX_CMD_STATS) {
+        cmd = &stats->cmds[stats->cmd_count++];
+        strncpy(cmd->command, command, sizeof(cmd->command));
+    }
+    if (out) {
+        stats->msgs_out++;
+        stats->bytes_out += len;
+        if (cmd) {
+            cmd->msgs_out++;
+            cmd->bytes_out += len;
+        }
+    } else {
+        stats->msgs_in++;
+        stats->bytes_in += len;
+        if (cmd) {
+            cmd->msgs_in++;
+            cmd->bytes_in += len;
+        }
+    }
+}
+
+/**
+ * Parse one complete message (header and payload), or queue it for the
+ * workers in threaded groups, and report whether the node is still
+ * connected afterwards.
+ */
+static dogecoin_bool dogecoin_node_read_message(dogecoin_node* node, struct bufferevent* bev, const unsigned char* raw, dogecoin_p2p_msg_hdr* hdr)
+{
+    dogecoin_node_stats_lock(node);
+    dogecoin_node_stats_count(&node->stats, hdr->command, DOGECOIN_P2P_HDRSZ + hdr->data_len, false);
+    uint32_t generation = node->generation;
+    dogecoin_node_stats_unlock(node);
+    if (node->nodegroup->threads && node->nodegroup->threads->worker_count > 0) {
+        dogecoin_node_queue_message(node, generation, hdr, raw + DOGECOIN_P2P_HDRSZ);
+        return true;
+    }
+    struct const_buffer cmd_data_buf = {raw + DOGECOIN_P2P_HDRSZ, hdr->data_len};
+    dogecoin_node_parse_message(node, hdr, &cmd_data_buf);
+
+    // parsing may have disconnected the node and released the bufferevent
+    return (node->state & NODE_CONNECTED) == NODE_CONNECTED && node->event_bev == bev;
+}
+
 /**
  * If we have a complete message, parse it
- * 
+ *
+ * Complete messages are parsed straight out of the bufferevent's input
+ * buffer, only the 24 byte header is pulled up to learn the payload size.
+ * A message that has not fully arrived is moved into the node's receive
+ * buffer, which is sized once for the whole message and reused for every
+ * later one, and topped up from the input buffer until it is complete.
+ *
  * @param bev The bufferevent that is being read from.
  * @param ctx The node object.
- * 
+ *
  * @return dogecoin_bool (uint8_t)
  */
 void read_cb(struct bufferevent* bev, void* ctx)
@@ -109,69 +433,84 @@ void read_cb(struct bufferevent* bev, void* ctx)
     if (!input)
         return;
 
-    size_t length = evbuffer_get_length(input);
     dogecoin_node* node = (dogecoin_node*)ctx;
-
-    if ((node->state & NODE_CONNECTED) != NODE_CONNECTED) {
-        // ignore messages from disconnected peers
-        return;
-    }
-    // expand the cstring buffer if required
-    cstr_alloc_minsize(node->recvBuffer, node->recvBuffer->len + length);
-
-    // copy direct to cstring, avoid another heap buffer
-    evbuffer_copyout(input, node->recvBuffer->str + node->recvBuffer->len, length);
-    node->recvBuffer->len += length;
-
-    // drain the event buffer
-    evbuffer_drain(input, length);
-
-    struct const_buffer buf = {node->recvBuffer->str, node->recvBuffer->len};
+    cstring* partial = node->recvBuffer;
     dogecoin_p2p_msg_hdr hdr;
-    char* read_upto = NULL;
 
-    do {
-        if (buf.len < DOGECOIN_P2P_HDRSZ) {
-            break;
+    while ((node->state & NODE_CONNECTED) == NODE_CONNECTED) {
+        size_t length = evbuffer_get_length(input);
+
+        if (partial->len > 0) {
+            // finish the message we are already holding a part of
+            struct const_buffer buf = {partial->str, DOGECOIN_P2P_HDRSZ};
+            dogecoin_p2p_deser_msghdr(&hdr, &buf);
+            size_t missing = DOGECOIN_P2P_HDRSZ + hdr.data_len - partial->len;
+            size_t take = length < missing ? length : missing;
+            evbuffer_remove(input, partial->str + partial->len, take);
+            partial->len += take;
+            if (take < missing)
+                break;
+            partial->len = 0;
+            if (!dogecoin_node_read_message(node, bev, (const unsigned char*)partial->str, &hdr))
+                return;
+            continue;
         }
 
+        if (length < DOGECOIN_P2P_HDRSZ)
+            break;
+        unsigned char* raw = evbuffer_pullup(input, DOGECOIN_P2P_HDRSZ);
+        if (!raw)
+            break;
+        struct const_buffer buf = {raw, DOGECOIN_P2P_HDRSZ};
         dogecoin_p2p_deser_msghdr(&hdr, &buf);
         if (hdr.data_len > DOGECOIN_MAX_P2P_MSG_SIZE) {
             dogecoin_node_misbehave(node);
             return;
         }
-        if (buf.len < hdr.data_len) {
+
+        size_t msg_len = DOGECOIN_P2P_HDRSZ + hdr.data_len;
+        if (length < msg_len) {
+            // keep what we have, the buffer only grows if this message is the largest so far
+            cstr_alloc_minsize(partial, msg_len);
+            evbuffer_remove(input, partial->str, length);
+            partial->len = length;
             break;
         }
-        if (buf.len >= hdr.data_len) {
-            struct const_buffer cmd_data_buf = {buf.p, buf.len};
-            if ((node->state & NODE_CONNECTED) != NODE_CONNECTED) {
-                return;
-            }
-            dogecoin_node_parse_message(node, &hdr, &cmd_data_buf);
-
-            buf.p = (const unsigned char*)buf.p + hdr.data_len;
-            buf.len -= hdr.data_len;
 
-            read_upto = (void*)buf.p;
+        if (evbuffer_get_contiguous_space(input) >= msg_len) {
+            raw = evbuffer_pullup(input, msg_len);
+        } else {
+            cstr_alloc_minsize(partial, msg_len);
+            evbuffer_copyout(input, partial->str, msg_len);
+            raw = (unsigned char*)partial->str;
         }
-        if (buf.len == 0) {
-            node->recvBuffer->len = 0;
-            break;
-        }
-    } while (1);
+        if (!dogecoin_node_read_message(node, bev, raw, &hdr))
+            return;
+        evbuffer_drain(input, msg_len);
+    }
+}
 
-    if (read_upto != NULL && node->recvBuffer->len != 0 && read_upto != (node->recvBuffer->str + node->recvBuffer->len)) {
-        char* end = node->recvBuffer->str + node->recvBuffer->len;
-        size_t available_chunk_data = end - read_upto;
-        cstring* tmp = cstr_new_buf(read_upto, available_chunk_data);
-        cstr_free(node->recvBuffer, true);
-        node->recvBuffer = tmp;
+/**
+ * This function moves whole bulk messages into the socket's buffer while
+ * it holds no more than the low watermark, so control messages sent in
+ * the meantime only wait behind that much data. The caller holds the
+ * stats lock.
+ */
+static void dogecoin_node_send_bulk(dogecoin_node* node)
+{
+    struct evbuffer* output = bufferevent_get_output(node->event_bev);
+    unsigned char header[DOGECOIN_P2P_HDRSZ];
+    while (evbuffer_get_length(output) <= node->nodegroup->send_low_watermark && evbuffer_copyout(node->send_bulk, header, sizeof(header)) == (ev_ssize_t)sizeof(header)) {
+        struct const_buffer buf = {header, sizeof(header)};
+        dogecoin_p2p_msg_hdr hdr;
+        dogecoin_p2p_deser_msghdr(&hdr, &buf);
+        evbuffer_remove_buffer(node->send_bulk, output, DOGECOIN_P2P_HDRSZ + hdr.data_len);
     }
 }
 
 /**
- * This function is called when the client sends data to the server
+ * This function is called when the socket's buffer drained to the low
+ * watermark, it refills it with bulk messages and resumes a paused node.
  * 
  * @param ev The bufferevent object.
  * @param ctx The context parameter is a pointer to the context object that was 
@@ -180,7 +519,24 @@ void read_cb(struct bufferevent* bev, void* ctx)
 void write_cb(struct bufferevent* ev, void* ctx)
 {
     UNUSED(ev);
-    UNUSED(ctx);
+    dogecoin_node* node = (dogecoin_node*)ctx;
+    dogecoin_node_group* group = node->nodegroup;
+    dogecoin_bool resumed = false;
+
+    dogecoin_node_stats_lock(node);
+    if (node->event_bev) {
+        dogecoin_node_send_bulk(node);
+        size_t queued = evbuffer_get_length(bufferevent_get_output(node->event_bev)) + evbuffer_get_length(node->send_bulk);
+        if (node->send_paused && queued <= group->send_low_watermark) {
+            node->send_paused = false;
+            resumed = true;
+        }
+    }
+    dogecoin_node_stats_unlock(node);
+
+    /* outside the lock, the callback is likely to send */
+    if (resumed && group->send_resumed_cb)
+        group->send_resumed_cb(node);
 }
 
 /**
@@ -201,30 +557,42 @@ void node_periodical_timer(int fd, short int event, void* ctx)
     UNUSED(fd);
     UNUSED(event);
     dogecoin_node* node = (dogecoin_node*)ctx;
+    dogecoin_node_group* group = node->nodegroup;
     uint64_t now = time(NULL);
 
+    dogecoin_node_group_lock(group);
+    /* whichever node's timer notices first reports for the group */
+    if (group->stats_interval_s && group->stats_last_time + group->stats_interval_s <= now) {
+        dogecoin_node_group_stats stats;
+        group->stats_last_time = now;
+        dogecoin_node_group_get_stats(group, &stats);
+        if (group->stats_cb)
+            group->stats_cb(group, &stats);
+        else
+            group->log_write_cb("Peers: %d connected, %d connecting, ping %" PRIu64 " ms, in %" PRIu64 " msgs / %" PRIu64 " bytes, out %" PRIu64 " msgs / %" PRIu64 " bytes, queued %" PRIu64 " bytes out, %" PRIu64 " bytes in, %" PRIu64 " msgs\n",
+                stats.connected, stats.connecting, stats.ping_avg_ms, stats.msgs_in, stats.bytes_in, stats.msgs_out, stats.bytes_out,
+                (uint64_t)stats.send_queue, (uint64_t)stats.recv_queue, (uint64_t)stats.worker_queue);
+    }
     if (node->nodegroup->periodic_timer_cb)
-        if (!node->nodegroup->periodic_timer_cb(node, &now))
+        if (!node->nodegroup->periodic_timer_cb(node, &now)) {
+            dogecoin_node_group_unlock(group);
             return;
+        }
 
     if (node->time_started_con + DOGECOIN_CONNECT_TIMEOUT_S < now && ((node->state & NODE_CONNECTING) == NODE_CONNECTING)) {
-        node->state = 0;
+        dogecoin_node_stats_lock(node);
+        node->state = NODE_ERRORED | NODE_TIMEOUT;
+        dogecoin_node_stats_unlock(node);
         node->time_started_con = 0;
-        node->state |= NODE_ERRORED;
-        node->state |= NODE_TIMEOUT;
         dogecoin_node_connection_state_changed(node);
     }
 
     /* This is checking if the node is connected and if the last ping time is greater than the current
     time plus the ping interval. */
     if (((node->state & NODE_CONNECTED) == NODE_CONNECTED) && node->lastping + DOGECOIN_PING_INTERVAL_S < now) {
-        uint64_t nonce;
-        dogecoin_cheap_random_bytes((uint8_t*)&nonce, sizeof(nonce));
-        cstring* pingmsg = dogecoin_p2p_message_new(node->nodegroup->chainparams->netmagic, DOGECOIN_MSG_PING, &nonce, sizeof(nonce));
-        dogecoin_node_send(node, pingmsg);
-        cstr_free(pingmsg, true);
-        node->lastping = now;
+        dogecoin_node_send_ping(node);
     }
+    dogecoin_node_group_unlock(group);
 }
 
 /**
@@ -238,35 +606,41 @@ void event_cb(struct bufferevent* ev, short type, void* ctx)
 {
     UNUSED(ev);
     dogecoin_node* node = (dogecoin_node*)ctx;
+    dogecoin_node_group* group = node->nodegroup;
+    dogecoin_node_group_lock(group);
     node->nodegroup->log_write_cb("Event callback on node %d\n", node->nodeid);
 
     if (((type & BEV_EVENT_TIMEOUT) != 0) && ((node->state & NODE_CONNECTING) == NODE_CONNECTING)) {
         node->nodegroup->log_write_cb("Timout connecting to node %d.\n", node->nodeid);
-        node->state = 0;
-        node->state |= NODE_ERRORED;
-        node->state |= NODE_TIMEOUT;
+        dogecoin_node_stats_lock(node);
+        node->state = NODE_ERRORED | NODE_TIMEOUT;
+        dogecoin_node_stats_unlock(node);
         dogecoin_node_connection_state_changed(node);
     } else if (((type & BEV_EVENT_EOF) != 0) ||
                ((type & BEV_EVENT_ERROR) != 0)) {
-        node->state = 0;
-        node->state |= NODE_ERRORED;
-        node->state |= NODE_DISCONNECTED;
+        uint32_t state = NODE_ERRORED | NODE_DISCONNECTED;
         if ((type & BEV_EVENT_EOF) != 0) {
             node->nodegroup->log_write_cb("Disconnected from the remote peer %d.\n", node->nodeid);
-            node->state |= NODE_DISCONNECTED_FROM_REMOTE_PEER;
+            state |= NODE_DISCONNECTED_FROM_REMOTE_PEER;
         }
         else {
             node->nodegroup->log_write_cb("Error connecting to node %d.\n", node->nodeid);
         }
+        dogecoin_node_stats_lock(node);
+        node->state = state;
+        dogecoin_node_stats_unlock(node);
         dogecoin_node_connection_state_changed(node);
     } else if (type & BEV_EVENT_CONNECTED) {
         node->nodegroup->log_write_cb("Successful connected to node %d.\n", node->nodeid);
+        dogecoin_node_stats_lock(node);
         node->state |= NODE_CONNECTED;
         node->state &= ~NODE_CONNECTING;
         node->state &= ~NODE_ERRORED;
+        dogecoin_node_stats_unlock(node);
         dogecoin_node_connection_state_changed(node);
     }
     node->nodegroup->log_write_cb("Connected nodes: %d\n", dogecoin_node_group_amount_of_connected_nodes(node->nodegroup, NODE_CONNECTED));
+    dogecoin_node_group_unlock(group);
 }
 
 /**
@@ -288,6 +662,8 @@ dogecoin_node* dogecoin_node_new()
     dogecoin_hash_clear(node->last_requested_inv);
 
     node->recvBuffer = cstr_new_sz(DOGECOIN_P2P_MESSAGE_CHUNK_SIZE);
+    node->send_bulk = evbuffer_new();
+    node->send_paused = false;
     node->hints = 0;
     return node;
 }
@@ -304,7 +680,12 @@ dogecoin_bool dogecoin_node_set_ipport(dogecoin_node* node, const char* ipport)
 {
     int outlen = (int)sizeof(node->addr);
 
-    return (evutil_parse_sockaddr_port(ipport, &node->addr, &outlen) == 0);
+    return (evutil_parse_sockaddr_port(ipport, (struct sockaddr*)&node->addr, &outlen) == 0);
+}
+
+static int dogecoin_node_addr_len(const dogecoin_node* node)
+{
+    return node->addr.ss_family == AF_INET6 ? (int)sizeof(struct sockaddr_in6) : (int)sizeof(struct sockaddr_in);
 }
 
 /**
@@ -314,10 +695,17 @@ dogecoin_bool dogecoin_node_set_ipport(dogecoin_node* node, const char* ipport)
  */
 void dogecoin_node_release_events(dogecoin_node* node)
 {
+    if (node->shard)
+        pthread_mutex_lock(&node->shard->lock);
     if (node->event_bev) {
         bufferevent_free(node->event_bev);
         node->event_bev = NULL;
     }
+    /* a reconnect starts with an empty queue */
+    evbuffer_drain(node->send_bulk, evbuffer_get_length(node->send_bulk));
+    node->send_paused = false;
+    if (node->shard)
+        pthread_mutex_unlock(&node->shard->lock);
 
     if (node->timer_event) {
         event_del(node->timer_event);
@@ -335,9 +723,15 @@ void dogecoin_node_release_events(dogecoin_node* node)
  */
 dogecoin_bool dogecoin_node_misbehave(dogecoin_node* node)
 {
+    if (dogecoin_node_defer_to_shard(node, dogecoin_node_deferred_misbehave))
+        return 0;
+    dogecoin_node_group_lock(node->nodegroup);
     node->nodegroup->log_write_cb("Mark node %d as missbehaved\n", node->nodeid);
+    dogecoin_node_stats_lock(node);
     node->state |= NODE_MISSBEHAVED;
+    dogecoin_node_stats_unlock(node);
     dogecoin_node_connection_state_changed(node);
+    dogecoin_node_group_unlock(node->nodegroup);
     return 0;
 }
 
@@ -348,16 +742,23 @@ dogecoin_bool dogecoin_node_misbehave(dogecoin_node* node)
  */
 void dogecoin_node_disconnect(dogecoin_node* node)
 {
+    if (dogecoin_node_defer_to_shard(node, dogecoin_node_deferred_disconnect))
+        return;
+    dogecoin_node_group_lock(node->nodegroup);
     if ((node->state & NODE_CONNECTED) == NODE_CONNECTED || (node->state & NODE_CONNECTING) == NODE_CONNECTING) {
         node->nodegroup->log_write_cb("Disconnect node %d\n", node->nodeid);
     }
     dogecoin_node_release_events(node);
 
+    dogecoin_node_stats_lock(node);
     node->state &= ~NODE_CONNECTING;
     node->state &= ~NODE_CONNECTED;
     node->state |= NODE_DISCONNECTED;
+    dogecoin_node_stats_unlock(node);
 
     node->time_started_con = 0;
+    dogecoin_node_group_notify(node->nodegroup);
+    dogecoin_node_group_unlock(node->nodegroup);
 }
 
 /**
@@ -369,6 +770,8 @@ void dogecoin_node_free(dogecoin_node* node)
 {
     dogecoin_node_disconnect(node);
     cstr_free(node->recvBuffer, true);
+    evbuffer_free(node->send_bulk);
+    dogecoin_bloom_free(node->peer_filter);
     dogecoin_free(node);
 }
 
@@ -442,8 +845,25 @@ dogecoin_node_group* dogecoin_node_group_new(const dogecoin_chainparams* chainpa
     node_group->node_connection_state_changed_cb = NULL;
     node_group->should_connect_to_more_nodes_cb = NULL;
     node_group->handshake_done_cb = NULL;
+    node_group->merkleblock_cb = NULL;
+    node_group->getcfilters_cb = NULL;
+    node_group->cfilter_cb = NULL;
+    node_group->bloom_filter = NULL;
     node_group->log_write_cb = net_write_log_null;
     node_group->desired_amount_connected_nodes = 25;
+    node_group->trust_local_peers = false;
+    node_group->threads = NULL;
+    node_group->addrman = NULL;
+    node_group->dns_nameserver = NULL;
+    node_group->seeding = NULL;
+    node_group->stats_interval_s = 0;
+    node_group->stats_last_time = 0;
+    node_group->stats_cb = NULL;
+    node_group->send_limit = DOGECOIN_NODE_SEND_LIMIT;
+    node_group->send_high_watermark = DOGECOIN_NODE_SEND_HIGH_WATERMARK;
+    node_group->send_low_watermark = DOGECOIN_NODE_SEND_LOW_WATERMARK;
+    node_group->send_resumed_cb = NULL;
+    dogecoin_node_group_register_default_handlers(node_group);
 
     return node_group;
 }
@@ -454,10 +874,39 @@ dogecoin_node_group* dogecoin_node_group_new(const dogecoin_chainparams* chainpa
  * @param group The group to shutdown.
  */
 void dogecoin_node_group_shutdown(dogecoin_node_group *group) {
+    dogecoin_node_group_lock(group);
+    if (group->seeding)
+        group->seeding->stopped = true;
     for (size_t i = 0; i < group->nodes->len; i++) {
         dogecoin_node* node = vector_idx(group->nodes, i);
         dogecoin_node_disconnect(node);
     }
+    dogecoin_node_group_unlock(group);
+}
+
+/**
+ * Lets peers that dropped out be connected again, only misbehaving
+ * peers stay excluded. The group's loop must not run.
+ * 
+ * @param group The group.
+ */
+void dogecoin_node_group_rearm_nodes(dogecoin_node_group* group)
+{
+    dogecoin_node_group_lock(group);
+    for (size_t i = 0; i < group->nodes->len; i++) {
+        dogecoin_node* node = vector_idx(group->nodes, i);
+        if ((node->state & NODE_MISSBEHAVED) == NODE_MISSBEHAVED)
+            continue;
+        if ((node->state & (NODE_ERRORED | NODE_DISCONNECTED)) == 0)
+            continue;
+        dogecoin_node_stats_lock(node);
+        node->state = 0;
+        dogecoin_node_stats_unlock(node);
+        node->version_handshake = false;
+        node->time_started_con = 0;
+        node->recvBuffer->len = 0;
+    }
+    dogecoin_node_group_unlock(group);
 }
 
 /**
@@ -470,24 +919,167 @@ void dogecoin_node_group_free(dogecoin_node_group* group)
     if (!group)
         return;
 
+    /* workers hold messages of the nodes, the nodes hold events of the bases */
+    if (group->threads)
+        dogecoin_node_threads_stop_workers(group->threads);
+    if (group->nodes) {
+        vector_free(group->nodes, true);
+    }
+    if (group->seeding) {
+        /* unanswered queries are dropped without calling back */
+        evdns_base_free(group->seeding->dns, 0);
+        dogecoin_free(group->seeding);
+    }
+    if (group->threads)
+        dogecoin_node_threads_free(group->threads);
     if (group->event_base) {
         event_base_free(group->event_base);
     }
+    dogecoin_free(group);
+}
 
-    if (group->nodes) {
-        vector_free(group->nodes, true);
+/**
+ * @brief This function switches the group to threaded mode: nodes are
+ * spread over the given number of event bases, each run by its own
+ * thread, and complete messages are processed by a pool of workers.
+ *
+ * @param group The group, none of its nodes may be connecting yet.
+ * @param shards The number of event-base threads, at least one.
+ * @param workers The number of message workers, 0 processes messages on
+ * the event-base threads.
+ *
+ * @return 1 if the group is threaded now, 0 otherwise.
+ */
+dogecoin_bool dogecoin_node_group_set_threads(dogecoin_node_group* group, size_t shards, size_t workers)
+{
+    if (group->threads || group->seeding || shards == 0)
+        return false;
+    if (dogecoin_node_group_amount_of_connected_nodes(group, NODE_CONNECTED) > 0 || dogecoin_node_group_amount_of_connected_nodes(group, NODE_CONNECTING) > 0)
+        return false;
+    /* event bases created from here on lock themselves and can be woken up from other threads */
+    if (evthread_use_pthreads() != 0)
+        return false;
+
+    dogecoin_node_threads* threads = dogecoin_calloc(1, sizeof(*threads));
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&threads->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_cond_init(&threads->idle, NULL);
+
+    size_t i;
+    threads->shards = dogecoin_calloc(shards, sizeof(*threads->shards));
+    for (i = 0; i < shards; i++) {
+        pthread_mutex_init(&threads->shards[i].lock, NULL);
+        threads->shard_count++;
+        threads->shards[i].base = event_base_new();
+        if (!threads->shards[i].base) {
+            dogecoin_node_threads_free(threads);
+            return false;
+        }
     }
-    dogecoin_free(group);
+
+    threads->workers = dogecoin_calloc(workers ? workers : 1, sizeof(*threads->workers));
+    for (i = 0; i < workers; i++) {
+        dogecoin_node_worker* worker = &threads->workers[i];
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_cond_init(&worker->cond, NULL);
+        threads->worker_count++;
+        worker->started = pthread_create(&worker->thread, NULL, dogecoin_node_worker_run, worker) == 0;
+        if (!worker->started) {
+            dogecoin_node_threads_free(threads);
+            return false;
+        }
+    }
+
+    group->threads = threads;
+    return true;
+}
+
+/* whether a node is connecting or connected or a dns seed query is pending.
+ * The dns callbacks count the queries down under the group lock, so they are read under it as well */
+static dogecoin_bool dogecoin_node_group_busy(dogecoin_node_group* group)
+{
+    dogecoin_node_group_lock(group);
+    dogecoin_bool busy = dogecoin_node_group_amount_of_connected_nodes(group, NODE_CONNECTED) > 0 ||
+                         dogecoin_node_group_amount_of_connected_nodes(group, NODE_CONNECTING) > 0 ||
+                         (group->seeding && group->seeding->pending > 0);
+    dogecoin_node_group_unlock(group);
+    return busy;
 }
 
 /**
  * The event loop is the core of the event-driven networking library
+ *
+ * Threaded groups run one loop per shard and wait here until no node is
+ * connecting or connected any more and the dns seeds are done.
  * 
  * @param group The dogecoin_node_group object.
  */
 void dogecoin_node_group_event_loop(dogecoin_node_group* group)
 {
-    event_base_dispatch(group->event_base);
+    dogecoin_node_threads* threads = group->threads;
+    if (!threads) {
+        event_base_dispatch(group->event_base);
+        return;
+    }
+
+    size_t i, running = 0;
+    pthread_mutex_lock(&threads->lock);
+    for (i = 0; i < threads->shard_count; i++) {
+        dogecoin_node_shard* shard = &threads->shards[i];
+        shard->running = pthread_create(&shard->thread, NULL, dogecoin_node_shard_run, shard) == 0;
+        running += shard->running;
+    }
+
+    /* like event_base_dispatch, return once no node is connecting or connected and the dns seeds are done */
+    while (running == threads->shard_count && dogecoin_node_group_busy(group)) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += DOGECOIN_PERIODICAL_NODE_TIMER_S;
+        pthread_cond_timedwait(&threads->idle, &threads->lock, &until);
+    }
+    for (i = 0; i < threads->shard_count; i++) {
+        dogecoin_node_shard* shard = &threads->shards[i];
+        if (shard->running)
+            event_base_loopbreak(shard->base);
+    }
+    pthread_mutex_unlock(&threads->lock);
+
+    for (i = 0; i < threads->shard_count; i++) {
+        dogecoin_node_shard* shard = &threads->shards[i];
+        if (!shard->running)
+            continue;
+        pthread_join(shard->thread, NULL);
+        pthread_mutex_lock(&threads->lock);
+        shard->running = false;
+        pthread_mutex_unlock(&threads->lock);
+    }
+}
+
+/**
+ * @brief This function takes a snapshot of the node's counters together
+ * with how much is queued on its connection right now.
+ *
+ * @param node The node.
+ * @param stats_out The snapshot.
+ */
+void dogecoin_node_get_stats(dogecoin_node* node, dogecoin_node_stats* stats_out)
+{
+    dogecoin_node_group_lock(node->nodegroup);
+    dogecoin_node_stats_lock(node);
+    *stats_out = node->stats;
+    stats_out->nodeid = node->nodeid;
+    stats_out->state = node->state;
+    stats_out->send_queue = 0;
+    stats_out->recv_queue = 0;
+    if (node->event_bev) {
+        stats_out->send_queue = evbuffer_get_length(bufferevent_get_output(node->event_bev)) + evbuffer_get_length(node->send_bulk);
+        stats_out->recv_queue = evbuffer_get_length(bufferevent_get_input(node->event_bev));
+    }
+    dogecoin_node_stats_unlock(node);
+    dogecoin_node_group_unlock(node->nodegroup);
 }
 
 /**
@@ -498,9 +1090,12 @@ void dogecoin_node_group_event_loop(dogecoin_node_group* group)
  */
 void dogecoin_node_group_add_node(dogecoin_node_group* group, dogecoin_node* node)
 {
+    /* the vector may move while threads walk it */
+    dogecoin_node_group_lock(group);
     vector_add(group->nodes, node);
     node->nodegroup = group;
     node->nodeid = group->nodes->len;
+    dogecoin_node_group_unlock(group);
 }
 
 /**
@@ -514,14 +1109,60 @@ void dogecoin_node_group_add_node(dogecoin_node_group* group, dogecoin_node* nod
 int dogecoin_node_group_amount_of_connected_nodes(dogecoin_node_group* group, enum NODE_STATE state)
 {
     int count = 0;
+    dogecoin_node_group_lock(group);
     for (size_t i = 0; i < group->nodes->len; i++) {
         dogecoin_node* node = vector_idx(group->nodes, i);
         if ((node->state & state) == state)
             count++;
     }
+    dogecoin_node_group_unlock(group);
     return count;
 }
 
+/**
+ * @brief This function sums the snapshots of the group's nodes up and
+ * adds the messages waiting for the workers.
+ *
+ * @param group The group.
+ * @param stats_out The sums.
+ */
+void dogecoin_node_group_get_stats(dogecoin_node_group* group, dogecoin_node_group_stats* stats_out)
+{
+    dogecoin_node_stats node_stats;
+    uint64_t ping_sum = 0, pinged = 0;
+    size_t i;
+    dogecoin_mem_zero(stats_out, sizeof(*stats_out));
+    dogecoin_node_group_lock(group);
+    for (i = 0; i < group->nodes->len; i++) {
+        dogecoin_node_get_stats(vector_idx(group->nodes, i), &node_stats);
+        if ((node_stats.state & NODE_CONNECTED) == NODE_CONNECTED) {
+            stats_out->connected++;
+            if (node_stats.pongs) {
+                ping_sum += node_stats.ping_ms;
+                pinged++;
+            }
+        } else if ((node_stats.state & NODE_CONNECTING) == NODE_CONNECTING)
+            stats_out->connecting++;
+        stats_out->msgs_in += node_stats.msgs_in;
+        stats_out->bytes_in += node_stats.bytes_in;
+        stats_out->msgs_out += node_stats.msgs_out;
+        stats_out->bytes_out += node_stats.bytes_out;
+        stats_out->send_queue += node_stats.send_queue;
+        stats_out->recv_queue += node_stats.recv_queue;
+    }
+    if (pinged)
+        stats_out->ping_avg_ms = ping_sum / pinged;
+    if (group->threads) {
+        for (i = 0; i < group->threads->worker_count; i++) {
+            dogecoin_node_worker* worker = &group->threads->workers[i];
+            pthread_mutex_lock(&worker->lock);
+            stats_out->worker_queue += worker->queued;
+            pthread_mutex_unlock(&worker->lock);
+        }
+    }
+    dogecoin_node_group_unlock(group);
+}
+
 /**
  * Try to connect to a node that is not connected, not in connecting state, not errored, and has not
  * been connected for more than DOGECOIN_PERIODICAL_NODE_TIMER_S seconds.
@@ -531,6 +1172,15 @@ int dogecoin_node_group_amount_of_connected_nodes(dogecoin_node_group* group, en
  * @return A boolean value.
  */
 dogecoin_bool dogecoin_node_group_connect_next_nodes(dogecoin_node_group* group)
+{
+    dogecoin_bool result;
+    dogecoin_node_group_lock(group);
+    result = dogecoin_node_group_connect_next_nodes_locked(group);
+    dogecoin_node_group_unlock(group);
+    return result;
+}
+
+static dogecoin_bool dogecoin_node_group_connect_next_nodes_locked(dogecoin_node_group* group)
 {
     dogecoin_bool connected_at_least_to_one_node = false;
     int connect_amount = group->desired_amount_connected_nodes - dogecoin_node_group_amount_of_connected_nodes(group, NODE_CONNECTED);
@@ -545,26 +1195,47 @@ dogecoin_bool dogecoin_node_group_connect_next_nodes(dogecoin_node_group* group)
             !((node->state & NODE_CONNECTING) == NODE_CONNECTING) &&
             !((node->state & NODE_DISCONNECTED) == NODE_DISCONNECTED) &&
             !((node->state & NODE_ERRORED) == NODE_ERRORED)) {
-            /* setup buffer event */
-            node->event_bev = bufferevent_socket_new(group->event_base, -1, BEV_OPT_CLOSE_ON_FREE);
+            /* threaded groups spread the nodes over the shards */
+            struct event_base* base = group->event_base;
+            int options = BEV_OPT_CLOSE_ON_FREE;
+            if (group->threads) {
+                node->shard = &group->threads->shards[group->threads->next_shard++ % group->threads->shard_count];
+                base = node->shard->base;
+                options |= BEV_OPT_THREADSAFE | BEV_OPT_DEFER_CALLBACKS | BEV_OPT_UNLOCK_CALLBACKS;
+            }
+
+            /* setup buffer event, the node counts as connecting before another thread may see the
+             * connection. messages still queued from an earlier connection are dropped */
+            dogecoin_node_stats_lock(node);
+            node->state |= NODE_CONNECTING;
+            node->generation++;
+            dogecoin_node_stats_unlock(node);
+            node->time_started_con = time(NULL);
+            node->time_started_con_ms = dogecoin_node_time_ms();
+            if (group->addrman)
+                dogecoin_addrman_attempt(group->addrman, (struct sockaddr*)&node->addr, node->time_started_con);
+            node->event_bev = bufferevent_socket_new(base, -1, options);
             bufferevent_setcb(node->event_bev, read_cb, write_cb, event_cb, node);
+            bufferevent_setwatermark(node->event_bev, EV_WRITE, group->send_low_watermark, 0);
             bufferevent_enable(node->event_bev, EV_READ | EV_WRITE);
-            if (bufferevent_socket_connect(node->event_bev, (struct sockaddr*)&node->addr, sizeof(node->addr)) < 0) {
+            if (bufferevent_socket_connect(node->event_bev, (struct sockaddr*)&node->addr, dogecoin_node_addr_len(node)) < 0) {
                 if (node->event_bev) {
                     bufferevent_free(node->event_bev);
                     node->event_bev = NULL;
                 }
+                dogecoin_node_stats_lock(node);
+                node->state &= ~NODE_CONNECTING;
+                dogecoin_node_stats_unlock(node);
+                node->time_started_con = 0;
                 return false;
             }
 
             /* setup periodic timer */
-            node->time_started_con = time(NULL);
             struct timeval tv;
             tv.tv_sec = DOGECOIN_PERIODICAL_NODE_TIMER_S;
             tv.tv_usec = 0;
-            node->timer_event = event_new(group->event_base, 0, EV_TIMEOUT | EV_PERSIST, node_periodical_timer, node);
+            node->timer_event = event_new(base, 0, EV_TIMEOUT | EV_PERSIST, node_periodical_timer, node);
             event_add(node->timer_event, &tv);
-            node->state |= NODE_CONNECTING;
             connected_at_least_to_one_node = true;
             node->nodegroup->log_write_cb("Trying to connect to %d...\n", node->nodeid);
             connect_amount--;
@@ -583,10 +1254,15 @@ dogecoin_bool dogecoin_node_group_connect_next_nodes(dogecoin_node_group* group)
  */
 void dogecoin_node_connection_state_changed(dogecoin_node* node)
 {
+    dogecoin_node_group_lock(node->nodegroup);
+    dogecoin_node_group_notify(node->nodegroup);
     if (node->nodegroup->node_connection_state_changed_cb)
         node->nodegroup->node_connection_state_changed_cb(node);
 
     if ((node->state & NODE_ERRORED) == NODE_ERRORED) {
+        /* the handshake never completed */
+        if (node->nodegroup->addrman && !node->version_handshake)
+            dogecoin_addrman_failed(node->nodegroup->addrman, (struct sockaddr*)&node->addr);
         dogecoin_node_release_events(node);
 
         /* connect to more nodes are required */
@@ -603,24 +1279,127 @@ void dogecoin_node_connection_state_changed(dogecoin_node* node)
         }
     } else
         dogecoin_node_send_version(node);
+    dogecoin_node_group_unlock(node->nodegroup);
+}
+
+/**
+ * This function tells control messages, which are small and keep the
+ * connection and the relay going, from bulk data.
+ */
+static dogecoin_bool dogecoin_node_is_control_msg(const char* command)
+{
+    const char* control[] = {DOGECOIN_MSG_VERSION, DOGECOIN_MSG_VERACK, DOGECOIN_MSG_PING, DOGECOIN_MSG_PONG, DOGECOIN_MSG_INV,
+                             DOGECOIN_MSG_GETDATA, DOGECOIN_MSG_NOTFOUND, DOGECOIN_MSG_GETADDR, DOGECOIN_MSG_GETHEADERS};
+    size_t i;
+    for (i = 0; i < sizeof(control) / sizeof(control[0]); i++)
+        if (strncmp(command, control[i], 12) == 0)
+            return true;
+    return false;
 }
 
 /**
  * Send a message to a node
+ *
+ * Control messages go straight into the socket's buffer, bulk messages
+ * queue behind it until it drained to the group's low watermark. Small
+ * messages appended to the buffer share its chains and leave in one
+ * write. A node with more than the group's high watermark queued is
+ * paused until its queue drained below the low watermark, messages that
+ * would grow it beyond the send limit are dropped.
  * 
  * @param node the node that is sending the message
- * @param data The data to send.
+ * @param data The complete message, header included.
  * 
  * @return dogecoin_bool (uint8_t)
  */
-void dogecoin_node_send(dogecoin_node* node, cstring* data)
+dogecoin_bool dogecoin_node_send(dogecoin_node* node, cstring* data)
 {
-    if ((node->state & NODE_CONNECTED) != NODE_CONNECTED)
-        return;
+    if (data->len < DOGECOIN_P2P_HDRSZ)
+        return false;
+
+    /* other threads may be sending to or releasing the bufferevent of a threaded group's node */
+    dogecoin_bool sent = false;
+    dogecoin_node_group* group = node->nodegroup;
+    dogecoin_node_stats_lock(node);
+    if ((node->state & NODE_CONNECTED) == NODE_CONNECTED && node->event_bev) {
+        char* dummy = data->str + 4;
+        size_t queued = evbuffer_get_length(bufferevent_get_output(node->event_bev)) + evbuffer_get_length(node->send_bulk);
+        if (queued > 0 && queued + data->len > group->send_limit) {
+            group->log_write_cb("send queue of node %d is full, dropping %.12s\n", node->nodeid, dummy);
+        } else {
+            if (dogecoin_node_is_control_msg(dummy)) {
+                bufferevent_write(node->event_bev, data->str, data->len);
+            } else {
+                evbuffer_add(node->send_bulk, data->str, data->len);
+                dogecoin_node_send_bulk(node);
+            }
+            group->log_write_cb("sending message to node %d: %s\n", node->nodeid, dummy);
+            dogecoin_node_stats_count(&node->stats, dummy, data->len, true);
+            if (!node->send_paused && queued + data->len >= group->send_high_watermark) {
+                group->log_write_cb("pausing node %d with %d bytes queued\n", node->nodeid, (int)(queued + data->len));
+                node->send_paused = true;
+            }
+            sent = true;
+        }
+    }
+    dogecoin_node_stats_unlock(node);
+    return sent;
+}
 
-    bufferevent_write(node->event_bev, data->str, data->len);
-    char* dummy = data->str + 4;
-    node->nodegroup->log_write_cb("sending message to node %d: %s\n", node->nodeid, dummy);
+/**
+ * Finish a message serialized in place through a message writer and
+ * send it to a node
+ * 
+ * @param node the node that is sending the message
+ * @param mw The message writer, started with dogecoin_p2p_msg_writer_init.
+ * @param command The command string.
+ * 
+ * @return dogecoin_bool (uint8_t)
+ */
+dogecoin_bool dogecoin_node_send_message(dogecoin_node* node, dogecoin_p2p_msg_writer* mw, const char* command)
+{
+    cstring* msg = dogecoin_p2p_msg_writer_finish(mw, node->nodegroup->chainparams->netmagic, command);
+    dogecoin_bool sent = msg && dogecoin_node_send(node, msg);
+    cstr_free(msg, true);
+    return sent;
+}
+
+/**
+ * @brief This function reports whether the node's producers should hold
+ * back bulk messages.
+ *
+ * @param node The node.
+ *
+ * @return 1 if the node's send queue is above the high watermark, 0 otherwise.
+ */
+dogecoin_bool dogecoin_node_send_paused(dogecoin_node* node)
+{
+    dogecoin_node_stats_lock(node);
+    dogecoin_bool paused = node->send_paused;
+    dogecoin_node_stats_unlock(node);
+    return paused;
+}
+
+/**
+ * This function sends a ping with a fresh nonce, the matching pong
+ * measures the round trip.
+ *
+ * @param node The node to ping.
+ */
+void dogecoin_node_send_ping(dogecoin_node* node)
+{
+    uint64_t nonce;
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_cheap_random_bytes((uint8_t*)&nonce, sizeof(nonce));
+    dogecoin_p2p_msg_writer_init(&mw, sizeof(nonce));
+    ser_writer_u64(&mw.w, nonce);
+    /* the pong may arrive on another thread */
+    dogecoin_node_group_lock(node->nodegroup);
+    node->ping_nonce = nonce;
+    node->ping_sent_ms = dogecoin_node_time_ms();
+    node->lastping = time(NULL);
+    dogecoin_node_group_unlock(node->nodegroup);
+    dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_PING);
 }
 
 /**
@@ -633,79 +1412,535 @@ void dogecoin_node_send_version(dogecoin_node* node)
     if (!node)
         return;
 
-    cstring* version_msg_cstr = cstr_new_sz(256);
-
     /* copy socket_addr to p2p addr */
     dogecoin_p2p_address fromAddr;
     dogecoin_p2p_address_init(&fromAddr);
     dogecoin_p2p_address toAddr;
     dogecoin_p2p_address_init(&toAddr);
-    dogecoin_addr_to_p2paddr(&node->addr, &toAddr);
+    dogecoin_addr_to_p2paddr((struct sockaddr*)&node->addr, &toAddr);
 
     /* create a version message struct */
     dogecoin_p2p_version_msg version_msg;
     dogecoin_mem_zero(&version_msg, sizeof(version_msg));
 
-    /* create a serialized version message */
-    dogecoin_p2p_msg_version_init(&version_msg, &fromAddr, &toAddr, node->nodegroup->clientstr, true);
-    dogecoin_p2p_msg_version_ser(&version_msg, version_msg_cstr);
+    /* create a serialized version message, with a filter transactions are only relayed once it is loaded (BIP37) */
+    dogecoin_p2p_msg_version_init(&version_msg, &fromAddr, &toAddr, node->nodegroup->clientstr, node->nodegroup->bloom_filter == NULL);
+    if (node->nodegroup->getcfilters_cb)
+        version_msg.services |= DOGECOIN_NODE_COMPACT_FILTERS;
 
-    /* create p2p message */
-    cstring* p2p_msg = dogecoin_p2p_message_new(node->nodegroup->chainparams->netmagic, DOGECOIN_MSG_VERSION, version_msg_cstr->str, version_msg_cstr->len);
+    /* serialize the p2p message in place behind its header */
+    ser_writer counter;
+    ser_writer_init_counter(&counter);
+    dogecoin_p2p_msg_version_ser_writer(&version_msg, &counter);
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, counter.written);
+    dogecoin_p2p_msg_version_ser_writer(&version_msg, &mw.w);
 
     /* send message */
-    dogecoin_node_send(node, p2p_msg);
+    dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_VERSION);
+}
 
-    /* cleanup */
-    cstr_free(version_msg_cstr, true);
-    cstr_free(p2p_msg, true);
+/**
+ * Loads a bloom filter into the remote node, from then on it
+ * relays matching transactions and answers filtered block
+ * requests with merkleblock messages.
+ * 
+ * @param node The node to send the filter to.
+ * @param filter The filter.
+ */
+void dogecoin_node_send_filterload(dogecoin_node* node, const dogecoin_bloom* filter)
+{
+    ser_writer counter;
+    ser_writer_init_counter(&counter);
+    dogecoin_bloom_serialize_writer(&counter, filter);
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, counter.written);
+    dogecoin_bloom_serialize_writer(&mw.w, filter);
+    dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_FILTERLOAD);
 }
 
 /**
- * This function parses a command message received from another node.
+ * Adds a single element to the filter loaded into the remote node
  * 
+ * @param node The node to send the element to.
+ * @param data The element.
+ * @param len The length of the element, at most DOGECOIN_BLOOM_MAX_ELEMENT_SIZE.
+ */
+void dogecoin_node_send_filteradd(dogecoin_node* node, const unsigned char* data, size_t len)
+{
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, len + 3);
+    ser_writer_varlen(&mw.w, (uint32_t)len);
+    ser_writer_bytes(&mw.w, data, len);
+    dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_FILTERADD);
+}
+
+/**
+ * Removes the filter loaded into the remote node
+ * 
+ * @param node The node to send the message to.
+ */
+void dogecoin_node_send_filterclear(dogecoin_node* node)
+{
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, 0);
+    dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_FILTERCLEAR);
+}
+
+/**
+ * Requests the basic compact filters of a range of blocks,
+ * the node answers with one cfilter message per block
+ * 
+ * @param node The node to request the filters from.
+ * @param start_height The height of the first block.
+ * @param stop_hash The hash of the last block.
+ */
+void dogecoin_node_send_getcfilters(dogecoin_node* node, uint32_t start_height, const uint256 stop_hash)
+{
+    uint8_t filter_type = DOGECOIN_BLOCKFILTER_BASIC;
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, 1 + 4 + DOGECOIN_HASH_LENGTH);
+    ser_writer_bytes(&mw.w, &filter_type, 1);
+    ser_writer_u32(&mw.w, start_height);
+    ser_writer_bytes(&mw.w, stop_hash, DOGECOIN_HASH_LENGTH);
+    dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_GETCFILTERS);
+}
+
+/**
+ * Sends a compact filter to the remote node
+ * 
+ * @param node The node to send the filter to.
+ * @param filter The filter.
+ */
+void dogecoin_node_send_cfilter(dogecoin_node* node, const dogecoin_blockfilter* filter)
+{
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, 1 + DOGECOIN_HASH_LENGTH + 5 + filter->encoded->len);
+    ser_writer_bytes(&mw.w, &filter->type, 1);
+    ser_writer_u256(&mw.w, filter->block_hash);
+    ser_writer_varlen(&mw.w, (uint32_t)filter->encoded->len);
+    ser_writer_bytes(&mw.w, filter->encoded->str, filter->encoded->len);
+    dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_CFILTER);
+}
+
+static void dogecoin_node_blockfilter_free_cb(void* obj)
+{
+    dogecoin_blockfilter_free((dogecoin_blockfilter*)obj);
+}
+
+/**
+ * Answers a getcfilters request with the filters the groups
+ * callback provides, at most MAX_GETCFILTERS_SIZE of them
+ * 
+ * @param node The node that sent the request.
+ * @param buf The message payload.
+ * 
+ * @return dogecoin_bool (uint8_t)
+ */
+static dogecoin_bool dogecoin_node_process_getcfilters(dogecoin_node* node, const struct const_buffer* buf)
+{
+    struct const_buffer payload = *buf;
+    uint8_t filter_type;
+    uint32_t start_height;
+    uint256 stop_hash;
+    vector* filters;
+    dogecoin_bool ok;
+
+    if (!dogecoin_p2p_deser_msg_getcfilters(&filter_type, &start_height, stop_hash, &payload) || filter_type != DOGECOIN_BLOCKFILTER_BASIC)
+        return false;
+    if (!node->nodegroup->getcfilters_cb)
+        return true;
+    filters = vector_new(16, dogecoin_node_blockfilter_free_cb);
+    ok = node->nodegroup->getcfilters_cb(node, filter_type, start_height, stop_hash, filters) && filters->len <= MAX_GETCFILTERS_SIZE;
+    for (size_t i = 0; ok && i < filters->len; i++)
+        dogecoin_node_send_cfilter(node, vector_idx(filters, i));
+    vector_free(filters, true);
+    return ok;
+}
+
+/**
+ * Inserts an element into the groups bloom filter and sends it
+ * to all nodes which already loaded the filter
+ * 
+ * @param group The node group.
+ * @param data The element.
+ * @param len The length of the element.
+ * 
+ * @return dogecoin_bool (uint8_t)
+ */
+dogecoin_bool dogecoin_node_group_filteradd(dogecoin_node_group* group, const unsigned char* data, size_t len)
+{
+    if (!group->bloom_filter || len > DOGECOIN_BLOOM_MAX_ELEMENT_SIZE)
+        return false;
+    /* the nodes and the filter are shared with the group's threads */
+    dogecoin_node_group_lock(group);
+    dogecoin_bloom_insert(group->bloom_filter, data, len);
+    for (size_t i = 0; i < group->nodes->len; i++) {
+        dogecoin_node* node = vector_idx(group->nodes, i);
+        if ((node->state & NODE_CONNECTED) == NODE_CONNECTED && node->version_handshake)
+            dogecoin_node_send_filteradd(node, data, len);
+    }
+    dogecoin_node_group_unlock(group);
+    return true;
+}
+
+/**
+ * Checks a merkleblock message against its header and passes
+ * the proven transactions to the groups callback
+ * 
+ * @param node The node that sent the message.
+ * @param buf The message payload.
+ * 
+ * @return dogecoin_bool (uint8_t)
+ */
+static dogecoin_bool dogecoin_node_process_merkleblock(dogecoin_node* node, const struct const_buffer* buf)
+{
+    struct const_buffer payload = *buf;
+    dogecoin_merkleblock merkleblock;
+    uint256* matches;
+    size_t match_count;
+
+    if (!dogecoin_merkleblock_parse(&merkleblock, &payload) || merkleblock.hash_count > DOGECOIN_MERKLE_MAX_PARTIAL_LEAVES)
+        return false;
+    matches = dogecoin_malloc((merkleblock.hash_count ? merkleblock.hash_count : 1) * sizeof(uint256));
+    if (!dogecoin_merkleblock_verify(&merkleblock, matches, NULL, &match_count)) {
+        dogecoin_free(matches);
+        return false;
+    }
+    if (node->nodegroup->merkleblock_cb)
+        node->nodegroup->merkleblock_cb(node, &merkleblock, (const uint256*)matches, match_count);
+    dogecoin_free(matches);
+    return true;
+}
+
+/**
+ * This function splits a 12 byte command into the integers the dispatch
+ * table compares and returns the table slot the command starts probing at.
+ */
+static size_t dogecoin_node_cmd_key(const char command[12], uint64_t* lo, uint32_t* hi)
+{
+    memcpy(lo, command, sizeof(*lo));
+    memcpy(hi, command + sizeof(*lo), sizeof(*hi));
+    return (size_t)(((*lo ^ ((uint64_t)*hi << 29)) * 0x9E3779B97F4A7C15ULL) >> 58) & (DOGECOIN_NODE_MAX_HANDLERS - 1);
+}
+
+
+/**
+ * @brief This function registers the handler the given command is
+ * dispatched to, replacing any earlier one.
+ *
+ * @param group The group whose dispatch table is updated.
+ * @param command The command name, at most 12 characters.
+ * @param handler The handler, NULL to leave the command unhandled.
+ *
+ * @return 1 if the handler was registered, 0 otherwise.
+ */
+dogecoin_bool dogecoin_node_group_register_handler(dogecoin_node_group* group, const char* command, dogecoin_node_msg_handler handler)
+{
+    char padded[12] = {0};
+    size_t len = command ? strlen(command) : 0;
+    if (len == 0 || len > sizeof(padded))
+        return false;
+    memcpy(padded, command, len);
+
+    uint64_t lo;
+    uint32_t hi;
+    size_t slot = dogecoin_node_cmd_key(padded, &lo, &hi);
+    size_t i;
+    for (i = 0; i < DOGECOIN_NODE_MAX_HANDLERS; i++) {
+        dogecoin_node_msg_handler_entry* entry = &group->handlers[(slot + i) & (DOGECOIN_NODE_MAX_HANDLERS - 1)];
+        if ((entry->cmd_lo == 0 && entry->cmd_hi == 0) || (entry->cmd_lo == lo && entry->cmd_hi == hi)) {
+            entry->cmd_lo = lo;
+            entry->cmd_hi = hi;
+            entry->handler = handler;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * @brief This function looks up the handler of a command as it appears
+ * in a message header (NUL padded to 12 bytes).
+ *
+ * @param group The group whose dispatch table is searched.
+ * @param command The 12 byte command.
+ *
+ * @return The handler, NULL if the command has none.
+ */
+dogecoin_node_msg_handler dogecoin_node_group_get_handler(const dogecoin_node_group* group, const char command[12])
+{
+    uint64_t lo;
+    uint32_t hi;
+    size_t slot = dogecoin_node_cmd_key(command, &lo, &hi);
+    size_t i;
+    for (i = 0; i < DOGECOIN_NODE_MAX_HANDLERS; i++) {
+        const dogecoin_node_msg_handler_entry* entry = &group->handlers[(slot + i) & (DOGECOIN_NODE_MAX_HANDLERS - 1)];
+        if (entry->cmd_lo == lo && entry->cmd_hi == hi)
+            return entry->handler;
+        if (entry->cmd_lo == 0 && entry->cmd_hi == 0)
+            break;
+    }
+    return NULL;
+}
+
+
+static dogecoin_bool dogecoin_node_handle_version(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    dogecoin_p2p_version_msg v_msg_check;
+    if (!dogecoin_p2p_msg_version_deser(&v_msg_check, buf)) {
+        return false;
+    }
+    if ((v_msg_check.services & DOGECOIN_NODE_NETWORK) != DOGECOIN_NODE_NETWORK) {
+        dogecoin_node_disconnect(node);
+    }
+    if (node->nodegroup->bloom_filter && (v_msg_check.services & DOGECOIN_NODE_BLOOM) != DOGECOIN_NODE_BLOOM) {
+        /* the peer would ignore our filter and send us everything */
+        dogecoin_node_disconnect(node);
+    }
+    node->bestknownheight = v_msg_check.start_height;
+    node->nodegroup->log_write_cb("Connected to node %d: %s (%d)\n", node->nodeid, v_msg_check.useragent, v_msg_check.start_height);
+    /* confirm version via verack */
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, 0);
+    dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_VERACK);
+    return true;
+}
+
+static dogecoin_bool dogecoin_node_handle_verack(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    UNUSED(buf);
+    /* complete handshake if verack has been received */
+    node->version_handshake = true;
+    dogecoin_node_group_lock(node->nodegroup);
+    uint64_t handshake_ms = dogecoin_node_time_ms() - node->time_started_con_ms;
+    dogecoin_node_group_unlock(node->nodegroup);
+    dogecoin_node_stats_lock(node);
+    node->stats.handshake_ms = handshake_ms;
+    dogecoin_node_stats_unlock(node);
+    dogecoin_addrman* addrman = node->nodegroup->addrman;
+    if (addrman) {
+        dogecoin_addrman_good(addrman, (struct sockaddr*)&node->addr, (uint32_t)handshake_ms, time(NULL));
+        /* learn more peers while the store has room */
+        if (dogecoin_addrman_size(addrman) < DOGECOIN_ADDRMAN_MAX_ENTRIES) {
+            dogecoin_p2p_msg_writer mw;
+            dogecoin_p2p_msg_writer_init(&mw, 0);
+            dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_GETADDR);
+        }
+    }
+    dogecoin_node_group_lock(node->nodegroup);
+    if (node->nodegroup->bloom_filter)
+        dogecoin_node_send_filterload(node, node->nodegroup->bloom_filter);
+    dogecoin_node_group_unlock(node->nodegroup);
+    if (node->nodegroup->handshake_done_cb)
+        node->nodegroup->handshake_done_cb(node);
+    return true;
+}
+
+static dogecoin_bool dogecoin_node_handle_ping(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    uint64_t nonce = 0;
+    if (!deser_u64(&nonce, buf)) {
+        return false;
+    }
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, sizeof(nonce));
+    ser_writer_u64(&mw.w, nonce);
+    dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_PONG);
+    return true;
+}
+
+static dogecoin_bool dogecoin_node_handle_pong(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    uint64_t nonce = 0, rtt_ms = 0;
+    if (!deser_u64(&nonce, buf)) {
+        return false;
+    }
+    /* the timer sending pings may run on another thread */
+    dogecoin_node_group_lock(node->nodegroup);
+    dogecoin_bool answered = node->ping_sent_ms && nonce == node->ping_nonce;
+    if (answered) {
+        rtt_ms = dogecoin_node_time_ms() - node->ping_sent_ms;
+        node->ping_sent_ms = 0;
+    }
+    dogecoin_node_group_unlock(node->nodegroup);
+    if (answered) {
+        dogecoin_node_stats_lock(node);
+        if (node->stats.pongs == 0 || rtt_ms < node->stats.ping_min_ms)
+            node->stats.ping_min_ms = rtt_ms;
+        node->stats.ping_ms = rtt_ms;
+        node->stats.pongs++;
+        dogecoin_node_stats_unlock(node);
+    }
+    if (rtt_ms && node->nodegroup->addrman)
+        dogecoin_addrman_ping(node->nodegroup->addrman, (struct sockaddr*)&node->addr, (uint32_t)rtt_ms);
+    return true;
+}
+
+static dogecoin_bool dogecoin_node_handle_addr(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    if (!node->nodegroup->addrman)
+        return true;
+    struct const_buffer payload = *buf;
+    uint64_t now = time(NULL);
+    uint32_t count, i;
+    if (!deser_varlen(&count, &payload) || count > DOGECOIN_ADDRMAN_MAX_ADDR_SZ) {
+        return false;
+    }
+    for (i = 0; i < count; i++) {
+        dogecoin_p2p_address addr;
+        if (!dogecoin_p2p_deser_addr(DOGECOIN_PROTOCOL_VERSION, &addr, &payload)) {
+            return false;
+        }
+        if ((addr.services & DOGECOIN_NODE_NETWORK) == DOGECOIN_NODE_NETWORK)
+            dogecoin_addrman_add_from(node->nodegroup->addrman, &addr, (struct sockaddr*)&node->addr, now);
+    }
+    return true;
+}
+
+static dogecoin_bool dogecoin_node_handle_filterload(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    struct const_buffer payload = *buf;
+    dogecoin_bloom* filter = dogecoin_calloc(1, sizeof(*filter));
+    if (!dogecoin_bloom_deserialize(filter, &payload)) {
+        dogecoin_free(filter);
+        return false;
+    }
+    dogecoin_bloom_free(node->peer_filter);
+    node->peer_filter = filter;
+    return true;
+}
+
+static dogecoin_bool dogecoin_node_handle_filteradd(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    struct const_buffer payload = *buf;
+    uint32_t len = 0;
+    if (!deser_varlen(&len, &payload) || len > DOGECOIN_BLOOM_MAX_ELEMENT_SIZE || len > payload.len || !node->peer_filter) {
+        return false;
+    }
+    dogecoin_bloom_insert(node->peer_filter, payload.p, len);
+    return true;
+}
+
+static dogecoin_bool dogecoin_node_handle_filterclear(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    UNUSED(buf);
+    dogecoin_bloom_free(node->peer_filter);
+    node->peer_filter = NULL;
+    return true;
+}
+
+static dogecoin_bool dogecoin_node_handle_merkleblock(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    return dogecoin_node_process_merkleblock(node, buf);
+}
+
+static dogecoin_bool dogecoin_node_handle_getcfilters(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    return dogecoin_node_process_getcfilters(node, buf);
+}
+
+static dogecoin_bool dogecoin_node_handle_cfilter(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
+{
+    UNUSED(hdr);
+    struct const_buffer payload = *buf;
+    dogecoin_blockfilter* filter = dogecoin_blockfilter_new();
+    if (!dogecoin_blockfilter_deserialize(filter, &payload)) {
+        dogecoin_blockfilter_free(filter);
+        return false;
+    }
+    if (node->nodegroup->cfilter_cb)
+        node->nodegroup->cfilter_cb(node, filter);
+    dogecoin_blockfilter_free(filter);
+    return true;
+}
+
+/**
+ * This function fills a new group's dispatch table with the commands the
+ * library handles itself.
+ *
+ * @param group The group to set up.
+ */
+static void dogecoin_node_group_register_default_handlers(dogecoin_node_group* group)
+{
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_VERSION, dogecoin_node_handle_version);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_VERACK, dogecoin_node_handle_verack);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_PING, dogecoin_node_handle_ping);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_PONG, dogecoin_node_handle_pong);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_ADDR, dogecoin_node_handle_addr);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_FILTERLOAD, dogecoin_node_handle_filterload);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_FILTERADD, dogecoin_node_handle_filteradd);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_FILTERCLEAR, dogecoin_node_handle_filterclear);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_MERKLEBLOCK, dogecoin_node_handle_merkleblock);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_GETCFILTERS, dogecoin_node_handle_getcfilters);
+    dogecoin_node_group_register_handler(group, DOGECOIN_MSG_CFILTER, dogecoin_node_handle_cfilter);
+}
+
+
+/**
+ * This function checks whether the node's address is a loopback address.
+ */
+static dogecoin_bool dogecoin_node_is_local(const dogecoin_node* node)
+{
+    if (node->addr.ss_family == AF_INET) {
+        const struct sockaddr_in* in = (const struct sockaddr_in*)&node->addr;
+        return (ntohl(in->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (node->addr.ss_family == AF_INET6) {
+        const struct sockaddr_in6* in6 = (const struct sockaddr_in6*)&node->addr;
+        return memcmp(&in6->sin6_addr, &in6addr_loopback, sizeof(in6addr_loopback)) == 0;
+    }
+    return false;
+}
+
+
+/**
+ * This function parses a command message received from another node.
+ *
+ * The payload checksum is verified unless the group trusts local peers
+ * and the node is one, then the command is dispatched through the
+ * group's handler table.
+ *
  * @param node The node that received the message.
  * @param hdr The header of the message.
  * @param buf The buffer containing the message.
- * 
+ *
  * @return int
  */
 int dogecoin_node_parse_message(dogecoin_node* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf)
 {
-    node->nodegroup->log_write_cb("received command from node %d: %s\n", node->nodeid, hdr->command);
+    node->nodegroup->log_write_cb("received command from node %d: %.12s\n", node->nodeid, hdr->command);
     if (memcmp(hdr->netmagic, node->nodegroup->chainparams->netmagic, sizeof(node->nodegroup->chainparams->netmagic)) != 0) {
         return dogecoin_node_misbehave(node);
     }
+    if (buf->len < hdr->data_len) {
+        return dogecoin_node_misbehave(node);
+    }
+    if (!node->nodegroup->trust_local_peers || !dogecoin_node_is_local(node)) {
+        uint256 hash;
+        dogecoin_dblhash(buf->p, hdr->data_len, hash);
+        if (memcmp(hash, hdr->hash, sizeof(hdr->hash)) != 0) {
+            node->nodegroup->log_write_cb("checksum mismatch in %.12s from node %d\n", hdr->command, node->nodeid);
+            return dogecoin_node_misbehave(node);
+        }
+    }
 
     /* send the header and buffer to the possible callback */
     if (!node->nodegroup->parse_cmd_cb || node->nodegroup->parse_cmd_cb(node, hdr, buf)) {
-        if (strcmp(hdr->command, DOGECOIN_MSG_VERSION) == 0) {
-            dogecoin_p2p_version_msg v_msg_check;
-            if (!dogecoin_p2p_msg_version_deser(&v_msg_check, buf)) {
-                return dogecoin_node_misbehave(node);
-            }
-            if ((v_msg_check.services & DOGECOIN_NODE_NETWORK) != DOGECOIN_NODE_NETWORK) {
-                dogecoin_node_disconnect(node);
-            }
-            node->bestknownheight = v_msg_check.start_height;
-            node->nodegroup->log_write_cb("Connected to node %d: %s (%d)\n", node->nodeid, v_msg_check.useragent, v_msg_check.start_height);
-            /* confirm version via verack */
-            cstring* verack = dogecoin_p2p_message_new(node->nodegroup->chainparams->netmagic, DOGECOIN_MSG_VERACK, NULL, 0);
-            dogecoin_node_send(node, verack);
-            cstr_free(verack, true);
-        } else if (strcmp(hdr->command, DOGECOIN_MSG_VERACK) == 0) {
-            /* complete handshake if verack has been received */
-            node->version_handshake = true;
-            if (node->nodegroup->handshake_done_cb)
-                node->nodegroup->handshake_done_cb(node);
-        } else if (strcmp(hdr->command, DOGECOIN_MSG_PING) == 0) {
-            uint64_t nonce = 0;
-            if (!deser_u64(&nonce, buf)) {
-                return dogecoin_node_misbehave(node);
-            }
-            cstring* pongmsg = dogecoin_p2p_message_new(node->nodegroup->chainparams->netmagic, DOGECOIN_MSG_PONG, &nonce, 8);
-            dogecoin_node_send(node, pongmsg);
-            cstr_free(pongmsg, true);
+        dogecoin_node_msg_handler handler = dogecoin_node_group_get_handler(node->nodegroup, hdr->command);
+        if (handler && !handler(node, hdr, buf)) {
+            return dogecoin_node_misbehave(node);
         }
     }
 
@@ -769,7 +2004,168 @@ size_t dogecoin_get_peers_from_dns(const char* seed, vector* ips_out, int port,
 }
 
 /**
- * It takes a comma seperated list of IPs and adds them to the group
+ * This function checks whether one of the group's nodes has the address.
+ */
+static dogecoin_bool dogecoin_node_group_has_addr(dogecoin_node_group* group, const struct sockaddr* addr)
+{
+    dogecoin_p2p_address p2p_addr, node_addr;
+    dogecoin_bool found = false;
+    dogecoin_addr_to_p2paddr((struct sockaddr*)addr, &p2p_addr);
+    dogecoin_node_group_lock(group);
+    for (size_t i = 0; i < group->nodes->len && !found; i++) {
+        dogecoin_node* node = vector_idx(group->nodes, i);
+        dogecoin_addr_to_p2paddr((struct sockaddr*)&node->addr, &node_addr);
+        found = memcmp(p2p_addr.ip, node_addr.ip, 16) == 0 && p2p_addr.port == node_addr.port;
+    }
+    dogecoin_node_group_unlock(group);
+    return found;
+}
+
+/**
+ * This function adds the addresses a dns seed answered with to the group
+ * (and its addrman) and connects to them right away, without waiting for
+ * the other seeds.
+ */
+static void dogecoin_node_group_dns_cb(int result, char type, int count, int ttl, void* addresses, void* arg)
+{
+    UNUSED(ttl);
+    dogecoin_dns_query* query = arg;
+    dogecoin_dns_seeding* seeding = query->seeding;
+    dogecoin_node_group* group = seeding->group;
+    int i, added = 0;
+
+    dogecoin_node_group_lock(group);
+    for (i = 0; result == DNS_ERR_NONE && !seeding->stopped && i < count; i++) {
+        dogecoin_node* node = dogecoin_node_new();
+        if (type == DNS_IPv4_A) {
+            struct sockaddr_in* addr = (struct sockaddr_in*)&node->addr;
+            addr->sin_family = AF_INET;
+            addr->sin_port = htons(group->chainparams->default_port);
+            memcpy(&addr->sin_addr, (const unsigned char*)addresses + i * 4, 4);
+        } else if (type == DNS_IPv6_AAAA) {
+            struct sockaddr_in6* addr = (struct sockaddr_in6*)&node->addr;
+            addr->sin6_family = AF_INET6;
+            addr->sin6_port = htons(group->chainparams->default_port);
+            memcpy(&addr->sin6_addr, (const unsigned char*)addresses + i * 16, 16);
+        } else {
+            dogecoin_node_free(node);
+            continue;
+        }
+        if (group->addrman)
+            dogecoin_addrman_add_sockaddr(group->addrman, (struct sockaddr*)&node->addr, DOGECOIN_NODE_NETWORK, time(NULL));
+        if (dogecoin_node_group_has_addr(group, (struct sockaddr*)&node->addr)) {
+            dogecoin_node_free(node);
+            continue;
+        }
+        dogecoin_node_group_add_node(group, node);
+        added++;
+    }
+    group->log_write_cb("DNS seed %s answered with %d %s addresses\n", query->domain, added, query->family == AF_INET6 ? "ipv6" : "ipv4");
+    if (added && dogecoin_node_group_amount_of_connected_nodes(group, NODE_CONNECTED) + dogecoin_node_group_amount_of_connected_nodes(group, NODE_CONNECTING) < group->desired_amount_connected_nodes)
+        dogecoin_node_group_connect_next_nodes(group);
+    seeding->pending--;
+    dogecoin_node_group_notify(group);
+    dogecoin_node_group_unlock(group);
+}
+
+/**
+ * @brief This function queries every dns seed of the group's chain for
+ * ipv4 and ipv6 addresses at once, instead of one blocking lookup after
+ * the other. The answers are handled by the group's event loop (the
+ * first shard's in threaded mode) as they arrive, so connecting starts
+ * with the fastest seed while the others are still resolving. A group
+ * seeds only once, and switching it to threaded mode must happen before.
+ *
+ * @param group The group to add the answers to.
+ * @param timeout_s The seconds after which unanswered queries give up.
+ *
+ * @return 1 if at least one query is pending, 0 otherwise.
+ */
+dogecoin_bool dogecoin_node_group_seed_async(dogecoin_node_group* group, unsigned int timeout_s)
+{
+    if (group->seeding)
+        return false;
+    struct event_base* base = group->threads ? group->threads->shards[0].base : group->event_base;
+    /* a resolver without queries must not keep the loop from returning */
+    int flags = EVDNS_BASE_DISABLE_WHEN_INACTIVE | (group->dns_nameserver ? 0 : EVDNS_BASE_INITIALIZE_NAMESERVERS);
+    struct evdns_base* dns = evdns_base_new(base, flags);
+    if (!dns)
+        return false;
+    if (group->dns_nameserver && evdns_base_nameserver_ip_add(dns, group->dns_nameserver) != 0) {
+        evdns_base_free(dns, 0);
+        return false;
+    }
+    char timeout[16];
+    sprintf(timeout, "%u", timeout_s ? timeout_s : 1);
+    evdns_base_set_option(dns, "timeout:", timeout);
+    /* a single try, the timeout bounds the whole seeding */
+    evdns_base_set_option(dns, "attempts:", "1");
+
+    dogecoin_dns_seeding* seeding = dogecoin_calloc(1, sizeof(*seeding));
+    seeding->group = group;
+    seeding->dns = dns;
+    size_t i, queries = 0;
+    dogecoin_node_group_lock(group);
+    group->seeding = seeding;
+    for (i = 0; i < DOGECOIN_DNS_SEED_SLOTS; i++) {
+        const char* domain = group->chainparams->dnsseeds[i].domain;
+        if (strlen(domain) == 0)
+            continue;
+        int n;
+        for (n = 0; n < 2; n++) {
+            dogecoin_dns_query* query = &seeding->queries[queries++];
+            query->seeding = seeding;
+            query->domain = domain;
+            query->family = n == 0 ? AF_INET : AF_INET6;
+            /* answers on other threads wait for the group lock */
+            seeding->pending++;
+            struct evdns_request* request = query->family == AF_INET
+                ? evdns_base_resolve_ipv4(dns, domain, DNS_QUERY_NO_SEARCH, dogecoin_node_group_dns_cb, query)
+                : evdns_base_resolve_ipv6(dns, domain, DNS_QUERY_NO_SEARCH, dogecoin_node_group_dns_cb, query);
+            if (!request)
+                seeding->pending--;
+        }
+    }
+    dogecoin_bool pending = seeding->pending > 0;
+    dogecoin_node_group_unlock(group);
+    return pending;
+}
+
+/**
+ * It adds nodes for the best addresses of the group's addrman in order of
+ * their score, so the fastest and most reliable peers are connected first.
+ * Addresses the group already has a node for are skipped.
+ *
+ * @param group the node group to add the nodes to
+ *
+ * @return the number of nodes added
+ */
+size_t dogecoin_node_group_add_peers_from_addrman(dogecoin_node_group *group) {
+    if (!group->addrman || group->desired_amount_connected_nodes <= 0)
+        return 0;
+    /* like connect_next_nodes, keep a few spares for peers that don't answer */
+    size_t max = (size_t)group->desired_amount_connected_nodes * 3;
+    dogecoin_addrman_entry* entries = dogecoin_calloc(max, sizeof(*entries));
+    size_t count = dogecoin_addrman_select(group->addrman, time(NULL), entries, max);
+    size_t added = 0;
+    for (size_t i = 0; i < count; i++) {
+        dogecoin_node* node = dogecoin_node_new();
+        dogecoin_p2paddr_to_addr(&entries[i].addr, (struct sockaddr*)&node->addr);
+        if (dogecoin_node_group_has_addr(group, (struct sockaddr*)&node->addr)) {
+            dogecoin_node_free(node);
+            continue;
+        }
+        dogecoin_node_group_add_node(group, node);
+        added++;
+    }
+    dogecoin_free(entries);
+    return added;
+}
+
+/**
+ * It takes a comma seperated list of IPs and adds them to the group. Without
+ * IPs the best addresses of the group's addrman are used and the DNS seeds are
+ * only queried if they are too few, their answers arrive in the event loop.
  * 
  * @param group the node group to add the nodes to
  * @param ips comma seperated list of ip addresses
@@ -778,14 +2174,27 @@ size_t dogecoin_get_peers_from_dns(const char* seed, vector* ips_out, int port,
  */
 dogecoin_bool dogecoin_node_group_add_peers_by_ip_or_seed(dogecoin_node_group *group, const char *ips) {
     if (ips == NULL) {
+        if (group->addrman && dogecoin_node_group_add_peers_from_addrman(group) >= (size_t)group->desired_amount_connected_nodes) {
+            return true;
+        }
+        /* resolved while connecting, blocking only if the resolver can't be set up */
+        if (dogecoin_node_group_seed_async(group, DOGECOIN_DNS_SEED_TIMEOUT_S)) {
+            return true;
+        }
         /* === DNS QUERY === */
         vector* ips_dns = vector_new(10, free);
-        const dogecoin_dns_seed seed = group->chainparams->dnsseeds[0];
-        if (strlen(seed.domain) == 0) {
+        size_t seed, seeds = 0;
+        for (seed = 0; seed < DOGECOIN_DNS_SEED_SLOTS; seed++) {
+            const char* domain = group->chainparams->dnsseeds[seed].domain;
+            if (strlen(domain) == 0)
+                continue;
+            dogecoin_get_peers_from_dns(domain, ips_dns, group->chainparams->default_port, AF_INET);
+            seeds++;
+        }
+        if (seeds == 0) {
+            vector_free(ips_dns, true);
             return false;
         }
-        /* todo: make sure we have enough peers, eventually */
-        dogecoin_get_peers_from_dns(seed.domain, ips_dns, group->chainparams->default_port, AF_INET);
         unsigned int i;
         for (i = 0; i < ips_dns->len; i++) {
             char* ip = (char*)vector_idx(ips_dns, i);
@@ -793,11 +2202,20 @@ dogecoin_bool dogecoin_node_group_add_peers_by_ip_or_seed(dogecoin_node_group *g
             /* create a node */
             dogecoin_node* node = dogecoin_node_new();
             if (dogecoin_node_set_ipport(node, ip) > 0) {
-                /* add the node to the group */
-                dogecoin_node_group_add_node(group, node);
+                if (group->addrman) {
+                    /* added in score order below */
+                    dogecoin_addrman_add_sockaddr(group->addrman, (struct sockaddr*)&node->addr, DOGECOIN_NODE_NETWORK, time(NULL));
+                    dogecoin_node_free(node);
+                } else {
+                    /* add the node to the group */
+                    dogecoin_node_group_add_node(group, node);
+                }
+            } else {
+                dogecoin_node_free(node);
             }
         }
         vector_free(ips_dns, true);
+        dogecoin_node_group_add_peers_from_addrman(group);
     } else {
         // add comma seperated ips (nodes)
         char working_str[64];
@@ -808,7 +2226,12 @@ dogecoin_bool dogecoin_node_group_add_peers_by_ip_or_seed(dogecoin_node_group *g
             if (i == strlen(ips) || ips[i] == ',') {
                 dogecoin_node* node = dogecoin_node_new();
                 if (dogecoin_node_set_ipport(node, working_str) > 0) {
+                    /* remember user supplied peers too, so their statistics are kept */
+                    if (group->addrman)
+                        dogecoin_addrman_add_sockaddr(group->addrman, (struct sockaddr*)&node->addr, DOGECOIN_NODE_NETWORK, time(NULL));
                     dogecoin_node_group_add_node(group, node);
+                } else {
+                    dogecoin_node_free(node);
                 }
                 offset = 0;
                 dogecoin_mem_zero(working_str, sizeof(working_str));
@@ -858,8 +2281,10 @@ static dogecoin_bool broadcast_timer_cb(dogecoin_node* node, uint64_t* now) {
  */
 void broadcast_handshake_done(struct dogecoin_node_* node) {
     char ipaddr[256];
-    struct sockaddr_in* ad = (struct sockaddr_in*)&node->addr;
-    evutil_inet_ntop(node->addr.sa_family, &ad->sin_addr, ipaddr, sizeof(ipaddr));
+    if (node->addr.ss_family == AF_INET6)
+        evutil_inet_ntop(AF_INET6, &((struct sockaddr_in6*)&node->addr)->sin6_addr, ipaddr, sizeof(ipaddr));
+    else
+        evutil_inet_ntop(AF_INET, &((struct sockaddr_in*)&node->addr)->sin_addr, ipaddr, sizeof(ipaddr));
 
     printf("Successfully connected to peer %d (%s)\n", node->nodeid, ipaddr);
     struct broadcast_ctx* ctx = (struct broadcast_ctx*)node->nodegroup->ctx;
@@ -870,22 +2295,18 @@ void broadcast_handshake_done(struct dogecoin_node_* node) {
         }
 
     /* create a INV */
-    cstring* inv_msg_cstr = cstr_new_sz(256);
     dogecoin_p2p_inv_msg inv_msg;
     dogecoin_mem_zero(&inv_msg, sizeof(inv_msg));
 
-    uint256 hash;
-    dogecoin_tx_hash(ctx->tx, hash);
-    dogecoin_p2p_msg_inv_init(&inv_msg, DOGECOIN_INV_TYPE_TX, hash);
+    dogecoin_p2p_msg_inv_init(&inv_msg, DOGECOIN_INV_TYPE_TX, ctx->txhash);
 
     /* serialize the inv count (1) */
-    ser_varlen(inv_msg_cstr, 1);
-    dogecoin_p2p_msg_inv_ser(&inv_msg, inv_msg_cstr);
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, 1 + 4 + DOGECOIN_HASH_LENGTH);
+    ser_writer_varlen(&mw.w, 1);
+    dogecoin_p2p_msg_inv_ser_writer(&inv_msg, &mw.w);
 
-    cstring* p2p_msg = dogecoin_p2p_message_new(node->nodegroup->chainparams->netmagic, DOGECOIN_MSG_INV, inv_msg_cstr->str, inv_msg_cstr->len);
-    cstr_free(inv_msg_cstr, true);
-    dogecoin_node_send(node, p2p_msg);
-    cstr_free(p2p_msg, true);
+    dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_INV);
 
     /* INV sent */
     node->hints |= (1 << 0);
@@ -921,13 +2342,8 @@ dogecoin_bool broadcast_should_connect_more(dogecoin_node* node) {
 void broadcast_post_cmd(struct dogecoin_node_* node, dogecoin_p2p_msg_hdr* hdr, struct const_buffer* buf) {
     struct broadcast_ctx* ctx = (struct broadcast_ctx*)node->nodegroup->ctx;
     if (strcmp(hdr->command, DOGECOIN_MSG_INV) == 0) {
-        /* hash the tx */
-        /* TODO: cache the hash */
-        uint256 hash;
-        dogecoin_tx_hash(ctx->tx, hash);
-
         uint32_t vsize;
-        if (!deser_varlen(&vsize, buf)) {
+        if (!deser_varlen(&vsize, buf) || vsize > DOGECOIN_MAX_INV_SZ) {
             dogecoin_node_misbehave(node);
             return;
             };
@@ -937,7 +2353,7 @@ void broadcast_post_cmd(struct dogecoin_node_* node, dogecoin_p2p_msg_hdr* hdr,
                 dogecoin_node_misbehave(node);
                 return;
                 }
-            if (memcmp(hash, inv_msg.hash, sizeof(hash)) == 0) {
+            if (memcmp(ctx->txhash, inv_msg.hash, sizeof(ctx->txhash)) == 0) {
                 /* tx found on peer */
                 node->hints |= (1 << 2);
                 printf("node %d has the tx\n", node->nodeid);
@@ -947,28 +2363,33 @@ void broadcast_post_cmd(struct dogecoin_node_* node, dogecoin_p2p_msg_hdr* hdr,
             }
         }
     else if (strcmp(hdr->command, DOGECOIN_MSG_GETDATA) == 0 && ((node->hints & (1 << 1)) != (1 << 1))) {
-        ctx->getdata_from_peers++;
-        // only allow a single object in GETDATA for the broadcaster
         uint32_t vsize;
-        if (!deser_varlen(&vsize, buf) || vsize != 1) {
+        if (!deser_varlen(&vsize, buf) || vsize > DOGECOIN_MAX_INV_SZ) {
             dogecoin_node_misbehave(node);
             return;
             }
 
-        dogecoin_p2p_inv_msg inv_msg;
-        dogecoin_mem_zero(&inv_msg, sizeof(inv_msg));
-        if (!dogecoin_p2p_msg_inv_deser(&inv_msg, buf) || inv_msg.type != DOGECOIN_INV_TYPE_TX) {
-            dogecoin_node_misbehave(node);
+        /* peers may batch our tx with other items, only answer for ours */
+        dogecoin_bool requested = false;
+        for (unsigned int i = 0; i < vsize; i++) {
+            dogecoin_p2p_inv_msg inv_msg;
+            if (!dogecoin_p2p_msg_inv_deser(&inv_msg, buf)) {
+                dogecoin_node_misbehave(node);
+                return;
+                }
+            if (inv_msg.type == DOGECOIN_INV_TYPE_TX && memcmp(ctx->txhash, inv_msg.hash, sizeof(ctx->txhash)) == 0)
+                requested = true;
+            }
+        if (!requested) {
             return;
-            };
+            }
+        ctx->getdata_from_peers++;
 
         /* send the tx */
-        cstring* tx_ser = cstr_new_sz(1024);
-        dogecoin_tx_serialize(tx_ser, ctx->tx);
-        cstring* p2p_msg = dogecoin_p2p_message_new(node->nodegroup->chainparams->netmagic, DOGECOIN_MSG_TX, tx_ser->str, tx_ser->len);
-        cstr_free(tx_ser, true);
-        dogecoin_node_send(node, p2p_msg);
-        cstr_free(p2p_msg, true);
+        dogecoin_p2p_msg_writer mw;
+        dogecoin_p2p_msg_writer_init(&mw, dogecoin_tx_serialized_size(ctx->tx));
+        dogecoin_tx_serialize_writer(&mw.w, ctx->tx);
+        dogecoin_node_send_message(node, &mw, DOGECOIN_MSG_TX);
 
         /* tx sent */
         node->hints |= (1 << 1);
@@ -992,6 +2413,7 @@ void broadcast_post_cmd(struct dogecoin_node_* node, dogecoin_p2p_msg_hdr* hdr,
 dogecoin_bool broadcast_tx(const dogecoin_chainparams* chain, const dogecoin_tx* tx, const char* ips, int maxpeers, int timeout, dogecoin_bool debug) {
     struct broadcast_ctx ctx;
     ctx.tx = tx;
+    dogecoin_tx_hash(tx, ctx.txhash);
     ctx.debuglevel = debug;
     ctx.timeout = timeout;
     ctx.max_peers_to_inv = 2;
@@ -1016,13 +2438,22 @@ dogecoin_bool broadcast_tx(const dogecoin_chainparams* chain, const dogecoin_tx*
     group->handshake_done_cb = broadcast_handshake_done;
     group->should_connect_to_more_nodes_cb = broadcast_should_connect_more;
 
+    /* without ips start from the peers that worked last time instead of the dns seed */
+    dogecoin_addrman* addrman = NULL;
+    cstring* addrman_path = NULL;
+    if (ips == NULL) {
+        addrman = dogecoin_addrman_new(group->chainparams);
+        addrman_path = cstr_new_sz(256);
+        dogecoin_addrman_default_path(group->chainparams, addrman_path);
+        dogecoin_addrman_load(addrman, addrman_path->str);
+        group->addrman = addrman;
+    }
+
     dogecoin_node_group_add_peers_by_ip_or_seed(group, ips);
 
-    uint256 txhash;
-    dogecoin_tx_hash(tx, txhash);
-    char hexout[sizeof(txhash) * 2 + 1];
-    utils_bin_to_hex(txhash, sizeof(txhash), hexout);
-    hexout[sizeof(txhash) * 2] = 0;
+    char hexout[sizeof(ctx.txhash) * 2 + 1];
+    utils_bin_to_hex(ctx.txhash, sizeof(ctx.txhash), hexout);
+    hexout[sizeof(ctx.txhash) * 2] = 0;
     utils_reverse_hex(hexout, strlen(hexout));
     printf("Start broadcasting transaction: %s with timeout %d seconds\n", hexout, timeout);
     /* connect to the next node */
@@ -1035,6 +2466,11 @@ dogecoin_bool broadcast_tx(const dogecoin_chainparams* chain, const dogecoin_tx*
 
     /* cleanup (free) nodes structures from the heap */
     dogecoin_node_group_free(group);
+    if (addrman) {
+        dogecoin_addrman_save(addrman, addrman_path->str);
+        dogecoin_addrman_free(addrman);
+        cstr_free(addrman_path, true);
+    }
 
     printf("\n\nResult:\n=============\n");
     printf("Max nodes to connect to: %d\n", ctx.max_peers_to_connect);
@@ -0,0 +1,722 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <string.h>
+
+#include <dogecoin/mem.h>
+#include <dogecoin/pow.h>
+#include <dogecoin/scrypt.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/sha2.h>
+#include <dogecoin/utils.h>
+
+/**
+ * @brief This function expands the compact representation
+ * of a target (nBits) into a little endian 256 bit number.
+ *
+ * @param bits The compact target.
+ * @param target The expanded target.
+ *
+ * @return 1 if the target is positive and fits 256 bits, 0 otherwise.
+ */
+dogecoin_bool dogecoin_pow_compact_to_target(uint32_t bits, uint256 target)
+{
+    uint32_t size = bits >> 24;
+    uint32_t word = bits & 0x007fffff;
+    uint32_t i;
+
+    memset(target, 0, DOGECOIN_HASH_LENGTH);
+    if (word == 0 || (bits & 0x00800000))
+        return false; /* zero or negative */
+    if (size > 34 || (word > 0xff && size > 33) || (word > 0xffff && size > 32))
+        return false; /* overflow */
+
+    if (size <= 3) {
+        word >>= 8 * (3 - size);
+        for (i = 0; i < 3; i++)
+            target[i] = (uint8_t)(word >> (8 * i));
+    } else {
+        for (i = 0; i < 3; i++) {
+            if (size - 3 + i < DOGECOIN_HASH_LENGTH)
+                target[size - 3 + i] = (uint8_t)(word >> (8 * i));
+        }
+    }
+    for (i = 0; i < DOGECOIN_HASH_LENGTH; i++) {
+        if (target[i])
+            return true;
+    }
+    return false;
+}
+
+
+/**
+ * @brief This function compares two little endian 256 bit
+ * numbers such as hashes, targets or chain work.
+ *
+ * @param a The first number.
+ * @param b The second number.
+ *
+ * @return -1 if a < b, 0 if equal, 1 if a > b.
+ */
+int dogecoin_pow_work_cmp(const uint256 a, const uint256 b)
+{
+    int i;
+    for (i = DOGECOIN_HASH_LENGTH - 1; i >= 0; i--) {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief This function adds a little endian 256 bit number
+ * to an accumulator, wrapping on overflow.
+ *
+ * @param a The accumulator.
+ * @param b The number to add.
+ *
+ * @return Nothing.
+ */
+void dogecoin_pow_work_add(uint256 a, const uint256 b)
+{
+    unsigned int carry = 0;
+    int i;
+    for (i = 0; i < DOGECOIN_HASH_LENGTH; i++) {
+        carry += (unsigned int)a[i] + b[i];
+        a[i] = (uint8_t)carry;
+        carry >>= 8;
+    }
+}
+
+
+/* 256 bit helpers on 32 bit little endian limbs, used for the work division */
+#define POW_LIMBS 8
+
+static void pow_limbs_from_bytes(uint32_t* x, const uint8_t* b)
+{
+    int i;
+    for (i = 0; i < POW_LIMBS; i++)
+        x[i] = (uint32_t)b[4 * i] | ((uint32_t)b[4 * i + 1] << 8) | ((uint32_t)b[4 * i + 2] << 16) | ((uint32_t)b[4 * i + 3] << 24);
+}
+
+static void pow_limbs_to_bytes(uint8_t* b, const uint32_t* x)
+{
+    int i;
+    for (i = 0; i < POW_LIMBS; i++) {
+        b[4 * i] = (uint8_t)x[i];
+        b[4 * i + 1] = (uint8_t)(x[i] >> 8);
+        b[4 * i + 2] = (uint8_t)(x[i] >> 16);
+        b[4 * i + 3] = (uint8_t)(x[i] >> 24);
+    }
+}
+
+static int pow_limbs_bits(const uint32_t* x)
+{
+    int i, b;
+    for (i = POW_LIMBS - 1; i >= 0; i--) {
+        if (x[i]) {
+            for (b = 31; b > 0; b--) {
+                if (x[i] & (1u << b))
+                    break;
+            }
+            return i * 32 + b + 1;
+        }
+    }
+    return 0;
+}
+
+static int pow_limbs_cmp(const uint32_t* a, const uint32_t* b)
+{
+    int i;
+    for (i = POW_LIMBS - 1; i >= 0; i--) {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+static void pow_limbs_sub(uint32_t* a, const uint32_t* b)
+{
+    uint64_t borrow = 0;
+    int i;
+    for (i = 0; i < POW_LIMBS; i++) {
+        uint64_t d = (uint64_t)a[i] - b[i] - borrow;
+        a[i] = (uint32_t)d;
+        borrow = (d >> 32) & 1;
+    }
+}
+
+static void pow_limbs_shl(uint32_t* x, int shift)
+{
+    int limbs = shift / 32, bits = shift % 32, i;
+    for (i = POW_LIMBS - 1; i >= 0; i--) {
+        uint32_t v = 0;
+        if (i - limbs >= 0) {
+            v = x[i - limbs] << bits;
+            if (bits && i - limbs - 1 >= 0)
+                v |= x[i - limbs - 1] >> (32 - bits);
+        }
+        x[i] = v;
+    }
+}
+
+static void pow_limbs_shr1(uint32_t* x)
+{
+    int i;
+    for (i = 0; i < POW_LIMBS; i++)
+        x[i] = (x[i] >> 1) | (i + 1 < POW_LIMBS ? x[i + 1] << 31 : 0);
+}
+
+
+static void pow_limbs_mul32(uint32_t* x, uint32_t m, uint32_t* overflow)
+{
+    uint64_t carry = 0;
+    int i;
+    for (i = 0; i < POW_LIMBS; i++) {
+        carry += (uint64_t)x[i] * m;
+        x[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    *overflow = (uint32_t)carry;
+}
+
+static void pow_limbs_div32(uint32_t* x, uint32_t d)
+{
+    uint64_t rem = 0;
+    int i;
+    for (i = POW_LIMBS - 1; i >= 0; i--) {
+        uint64_t cur = (rem << 32) | x[i];
+        x[i] = (uint32_t)(cur / d);
+        rem = cur % d;
+    }
+}
+
+
+/**
+ * @brief This function computes the amount of work a block
+ * with the given target represents, 2^256 / (target + 1),
+ * evaluated as ~target / (target + 1) + 1.
+ *
+ * @param bits The compact target.
+ * @param work The resulting work.
+ *
+ * @return 1 if the target is valid, 0 otherwise (work is zero).
+ */
+dogecoin_bool dogecoin_pow_block_work(uint32_t bits, uint256 work)
+{
+    uint256 target;
+    uint32_t num[POW_LIMBS], div[POW_LIMBS], q[POW_LIMBS];
+    int i, shift;
+
+    memset(work, 0, DOGECOIN_HASH_LENGTH);
+    if (!dogecoin_pow_compact_to_target(bits, target))
+        return false;
+    pow_limbs_from_bytes(div, target);
+    for (i = 0; i < POW_LIMBS; i++)
+        num[i] = ~div[i];
+    /* div = target + 1, a target of 2^256 - 1 leaves num at zero */
+    for (i = 0; i < POW_LIMBS && ++div[i] == 0; i++)
+        ;
+    memset(q, 0, sizeof(q));
+
+    shift = pow_limbs_bits(num) - pow_limbs_bits(div);
+    if (shift >= 0 && pow_limbs_bits(div) > 0) {
+        pow_limbs_shl(div, shift);
+        for (; shift >= 0; shift--) {
+            if (pow_limbs_cmp(num, div) >= 0) {
+                pow_limbs_sub(num, div);
+                q[shift / 32] |= 1u << (shift % 32);
+            }
+            pow_limbs_shr1(div);
+        }
+    }
+    /* + 1 */
+    for (i = 0; i < POW_LIMBS && ++q[i] == 0; i++)
+        ;
+    pow_limbs_to_bytes(work, q);
+    return true;
+}
+
+
+/**
+ * @brief This function checks a proof of work hash against
+ * the target given by bits. The target must not be easier
+ * than the chain's proof of work limit.
+ *
+ * @param hash The proof of work (scrypt) hash.
+ * @param bits The compact target.
+ * @param chain The chain parameters.
+ *
+ * @return 1 if the hash meets the target, 0 otherwise.
+ */
+dogecoin_bool dogecoin_pow_check(const uint256 hash, uint32_t bits, const dogecoin_chainparams* chain)
+{
+    uint256 target, limit;
+    if (!dogecoin_pow_compact_to_target(bits, target))
+        return false;
+    if (dogecoin_pow_compact_to_target(chain->pow_limit, limit) && dogecoin_pow_work_cmp(target, limit) > 0)
+        return false;
+    return dogecoin_pow_work_cmp(hash, target) <= 0;
+}
+
+
+static void dogecoin_pow_serialize_header(const dogecoin_block_header* header, uint8_t out[DOGECOIN_BLOCK_HEADER_SIZE])
+{
+    ser_writer w;
+    ser_writer_init_buf(&w, out, DOGECOIN_BLOCK_HEADER_SIZE);
+    dogecoin_block_header_serialize_writer(&w, header);
+}
+
+
+/**
+ * @brief This function computes the scrypt proof of work
+ * hash of a block header.
+ *
+ * @param header The block header.
+ * @param hash The proof of work hash.
+ *
+ * @return Nothing.
+ */
+void dogecoin_block_header_pow_hash(const dogecoin_block_header* header, uint256 hash)
+{
+    uint8_t buf[DOGECOIN_BLOCK_HEADER_SIZE];
+    dogecoin_pow_serialize_header(header, buf);
+    dogecoin_scrypt_1024_1_1_256(buf, hash);
+}
+
+
+/**
+ * @brief This function checks the proof of work of a block
+ * header. Merge mined blocks are proven by the parent block,
+ * whose header is hashed against the target of this block.
+ *
+ * @param header The block header carrying the target.
+ * @param pow_header The auxpow parent header or NULL to hash header itself.
+ * @param chain The chain parameters.
+ *
+ * @return 1 if the proof of work is valid, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_header_check_pow(const dogecoin_block_header* header, const dogecoin_block_header* pow_header, const dogecoin_chainparams* chain)
+{
+    uint256 hash;
+    dogecoin_block_header_pow_hash(pow_header ? pow_header : header, hash);
+    return dogecoin_pow_check(hash, header->bits, chain);
+}
+
+
+/**
+ * @brief This function checks the proof of work of many
+ * headers, hashing them with the multi lane scrypt.
+ *
+ * @param pow_headers The headers to hash.
+ * @param bits The target for each header.
+ * @param count The number of headers.
+ * @param chain The chain parameters.
+ * @param valid_out The result for each header (may be NULL).
+ *
+ * @return 1 if all headers are valid, 0 otherwise.
+ */
+dogecoin_bool dogecoin_block_headers_check_pow(const dogecoin_block_header* const* pow_headers, const uint32_t* bits, size_t count, const dogecoin_chainparams* chain, dogecoin_bool* valid_out)
+{
+    uint8_t* inputs;
+    uint8_t* hashes;
+    dogecoin_bool all_valid = true;
+    size_t i;
+
+    if (count == 0)
+        return true;
+    inputs = dogecoin_malloc(count * DOGECOIN_BLOCK_HEADER_SIZE);
+    hashes = dogecoin_malloc(count * DOGECOIN_HASH_LENGTH);
+    for (i = 0; i < count; i++)
+        dogecoin_pow_serialize_header(pow_headers[i], inputs + i * DOGECOIN_BLOCK_HEADER_SIZE);
+    dogecoin_scrypt_1024_1_1_256_batch(inputs, count, hashes);
+    for (i = 0; i < count; i++) {
+        dogecoin_bool valid = dogecoin_pow_check(hashes + i * DOGECOIN_HASH_LENGTH, bits[i], chain);
+        if (valid_out)
+            valid_out[i] = valid;
+        all_valid = all_valid && valid;
+    }
+    dogecoin_free(inputs);
+    dogecoin_free(hashes);
+    return all_valid;
+}
+
+
+/**
+ * @brief This function converts a target into its compact
+ * representation (nBits), dropping all but the top 23 bits.
+ *
+ * @param target The little endian target.
+ *
+ * @return The compact target.
+ */
+uint32_t dogecoin_pow_target_to_compact(const uint256 target)
+{
+    int size = DOGECOIN_HASH_LENGTH, i;
+    uint32_t compact = 0;
+
+    while (size > 0 && target[size - 1] == 0)
+        size--;
+    for (i = 0; i < 3; i++) {
+        int idx = size - 1 - i;
+        compact = (compact << 8) | (idx >= 0 ? target[idx] : 0);
+    }
+    /* the sign bit must stay clear */
+    if (compact & 0x00800000) {
+        compact >>= 8;
+        size++;
+    }
+    return compact | ((uint32_t)size << 24);
+}
+
+
+/**
+ * @brief This function retargets the difficulty like Dogecoin
+ * Core's CalculateDogecoinNextWorkRequired: the timespan is
+ * damped and clamped (digishield from the chain's digishield
+ * height on), then the target is scaled by it.
+ *
+ * @param last_bits The bits of the last header.
+ * @param next_height The height of the header being retargeted.
+ * @param actual_timespan The time the retarget period took.
+ * @param chain The chain parameters.
+ *
+ * @return The new compact target, never easier than the chain's limit.
+ */
+uint32_t dogecoin_pow_calculate_next_bits(uint32_t last_bits, uint32_t next_height, int64_t actual_timespan, const dogecoin_chainparams* chain)
+{
+    const dogecoin_bool digishield = next_height >= chain->digishield_height;
+    const int64_t retarget = digishield ? chain->pow_target_spacing : chain->pow_target_timespan;
+    int64_t modulated = actual_timespan, min_timespan, max_timespan;
+    uint256 target, limit;
+    uint32_t x[POW_LIMBS], l[POW_LIMBS], overflow;
+
+    if (digishield) {
+        /* amplitude filter */
+        modulated = retarget + (modulated - retarget) / 8;
+        min_timespan = retarget - retarget / 4;
+        max_timespan = retarget + retarget / 2;
+    } else if (next_height > 10000) {
+        min_timespan = retarget / 4;
+        max_timespan = retarget * 4;
+    } else if (next_height > 5000) {
+        min_timespan = retarget / 8;
+        max_timespan = retarget * 4;
+    } else {
+        min_timespan = retarget / 16;
+        max_timespan = retarget * 4;
+    }
+    if (modulated < min_timespan)
+        modulated = min_timespan;
+    else if (modulated > max_timespan)
+        modulated = max_timespan;
+
+    dogecoin_pow_compact_to_target(chain->pow_limit, limit);
+    if (!dogecoin_pow_compact_to_target(last_bits, target))
+        return chain->pow_limit;
+    pow_limbs_from_bytes(x, target);
+    pow_limbs_from_bytes(l, limit);
+    pow_limbs_mul32(x, (uint32_t)modulated, &overflow);
+    pow_limbs_div32(x, (uint32_t)retarget);
+    if (overflow || pow_limbs_cmp(x, l) > 0)
+        return chain->pow_limit;
+    pow_limbs_to_bytes(target, x);
+    return dogecoin_pow_target_to_compact(target);
+}
+
+
+void dogecoin_pow_context_init(dogecoin_pow_context* ctx, const dogecoin_chainparams* chain)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->chain = chain;
+}
+
+
+/**
+ * @brief This function appends a header to the context, it
+ * becomes the parent of the next header to check. Only the
+ * timestamps and the last bits are kept, so checks never
+ * walk back through the ancestors.
+ *
+ * @param ctx The context.
+ * @param hash The hash of the header.
+ * @param height The height of the header.
+ * @param bits The compact target of the header.
+ * @param time The timestamp of the header.
+ *
+ * @return Nothing.
+ */
+void dogecoin_pow_context_add(dogecoin_pow_context* ctx, const uint256 hash, uint32_t height, uint32_t bits, uint32_t time)
+{
+    const dogecoin_chainparams* chain = ctx->chain;
+    const uint32_t interval = chain->pow_target_timespan / chain->pow_target_spacing;
+
+    memcpy(ctx->hash, hash, DOGECOIN_HASH_LENGTH);
+    ctx->height = height;
+    ctx->bits = bits;
+    ctx->time_pos = ctx->time_count ? (ctx->time_pos + 1) % DOGECOIN_POW_TIME_WINDOW : 0;
+    ctx->times[ctx->time_pos] = time;
+    if (ctx->time_count < DOGECOIN_POW_TIME_WINDOW)
+        ctx->time_count++;
+    /* the testnet minimum difficulty rule falls back to the last block that didn't use it */
+    if (!chain->pow_allow_min_difficulty || height % interval == 0 || bits != chain->pow_limit)
+        ctx->normal_bits = bits;
+}
+
+
+/* timestamp of the header back positions before the last one */
+static uint32_t dogecoin_pow_context_time(const dogecoin_pow_context* ctx, uint32_t back)
+{
+    return ctx->times[(ctx->time_pos + DOGECOIN_POW_TIME_WINDOW - back) % DOGECOIN_POW_TIME_WINDOW];
+}
+
+
+/**
+ * @brief This function computes the median of the timestamps
+ * of the last eleven headers.
+ *
+ * @param ctx The context.
+ *
+ * @return The median time past, 0 for an empty context.
+ */
+uint32_t dogecoin_pow_context_median_time_past(const dogecoin_pow_context* ctx)
+{
+    uint32_t times[DOGECOIN_POW_MEDIAN_TIME_SPAN];
+    uint32_t n = ctx->time_count < DOGECOIN_POW_MEDIAN_TIME_SPAN ? ctx->time_count : DOGECOIN_POW_MEDIAN_TIME_SPAN;
+    uint32_t i, j;
+
+    if (n == 0)
+        return 0;
+    for (i = 0; i < n; i++) {
+        uint32_t t = dogecoin_pow_context_time(ctx, i);
+        for (j = i; j > 0 && times[j - 1] > t; j--)
+            times[j] = times[j - 1];
+        times[j] = t;
+    }
+    return times[n / 2];
+}
+
+
+/**
+ * @brief This function computes the bits the next header must
+ * carry, following Dogecoin Core's GetNextWorkRequired.
+ *
+ * @param ctx The context.
+ * @param time The timestamp of the next header.
+ * @param bits_out The required compact target.
+ *
+ * @return 1 if the bits are known, 0 if the context lacks the needed ancestors or the chain doesn't retarget.
+ */
+dogecoin_bool dogecoin_pow_context_next_bits(const dogecoin_pow_context* ctx, uint32_t time, uint32_t* bits_out)
+{
+    const dogecoin_chainparams* chain = ctx->chain;
+    const uint32_t next = ctx->height + 1;
+    uint32_t interval, back, last_time;
+
+    if (!ctx->time_count || chain->pow_no_retargeting)
+        return false;
+    last_time = dogecoin_pow_context_time(ctx, 0);
+    /* late blocks may be mined at minimum difficulty on testnet, once the parent reached min_difficulty_height */
+    const dogecoin_bool late = (int64_t)time > (int64_t)last_time + 2 * (int64_t)chain->pow_target_spacing;
+    if (chain->pow_allow_min_difficulty && ctx->height >= chain->min_difficulty_height && late) {
+        *bits_out = chain->pow_limit;
+        return true;
+    }
+
+    interval = next >= chain->digishield_height ? 1 : chain->pow_target_timespan / chain->pow_target_spacing;
+    if (next % interval != 0) {
+        if (chain->pow_allow_min_difficulty) {
+            if (late) {
+                *bits_out = chain->pow_limit;
+                return true;
+            }
+            if (!ctx->normal_bits)
+                return false;
+            *bits_out = ctx->normal_bits;
+            return true;
+        }
+        *bits_out = ctx->bits;
+        return true;
+    }
+
+    /* go back the full period unless it's the first retarget */
+    back = next != interval ? interval : interval - 1;
+    if (back >= ctx->time_count)
+        return false;
+    *bits_out = dogecoin_pow_calculate_next_bits(ctx->bits, next, (int64_t)last_time - (int64_t)dogecoin_pow_context_time(ctx, back), chain);
+    return true;
+}
+
+
+/**
+ * @brief This function checks the bits of the header following the
+ * last header of the context. Without the ancestors a retarget looks
+ * back to, such as right after a checkpoint anchor, the bits must lie
+ * within what retargeting the last header's bits can produce.
+ *
+ * @param ctx The context, holding at least the parent.
+ * @param time The timestamp of the header.
+ * @param bits The bits of the header.
+ *
+ * @return 1 if the bits are required or, lacking ancestors, possible, 0 otherwise.
+ */
+static dogecoin_bool dogecoin_pow_context_bits_ok(const dogecoin_pow_context* ctx, uint32_t time, uint32_t bits)
+{
+    const dogecoin_chainparams* chain = ctx->chain;
+    const uint32_t next = ctx->height + 1;
+    uint32_t required, interval;
+    uint256 target, easiest, hardest;
+
+    if (chain->pow_no_retargeting)
+        return true;
+    if (dogecoin_pow_context_next_bits(ctx, time, &required))
+        return bits == required;
+    interval = next >= chain->digishield_height ? 1 : chain->pow_target_timespan / chain->pow_target_spacing;
+    /* the testnet rule repeats the last bits not using the minimum difficulty, which are unknown */
+    if (next % interval != 0)
+        return false;
+    if (!dogecoin_pow_compact_to_target(bits, target))
+        return false;
+    dogecoin_pow_compact_to_target(dogecoin_pow_calculate_next_bits(ctx->bits, next, 0, chain), hardest);
+    dogecoin_pow_compact_to_target(dogecoin_pow_calculate_next_bits(ctx->bits, next, INT32_MAX, chain), easiest);
+    return dogecoin_pow_work_cmp(target, hardest) >= 0 && dogecoin_pow_work_cmp(target, easiest) <= 0;
+}
+
+
+/**
+ * @brief This function checks the hash of a header against a
+ * checkpoint at its height, if there is one.
+ *
+ * @param chain The chain parameters.
+ * @param height The height of the header.
+ * @param hash The hash of the header.
+ *
+ * @return 0 if a checkpoint at height has another hash, 1 otherwise.
+ */
+static dogecoin_bool dogecoin_pow_checkpoint_ok(const dogecoin_chainparams* chain, uint32_t height, const uint256 hash)
+{
+    size_t count, lo = 0, hi;
+    const dogecoin_checkpoint* checkpoints = dogecoin_chainparams_checkpoints(chain, &count);
+    uint256 expected;
+
+    hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (checkpoints[mid].height < height)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == count || checkpoints[lo].height != height)
+        return true;
+    utils_uint256_sethex((char*)checkpoints[lo].hash, expected);
+    return memcmp(expected, hash, DOGECOIN_HASH_LENGTH) == 0;
+}
+
+
+/**
+ * @brief This function checks whether a header may follow the
+ * last header of the context. The proof of work itself is not
+ * checked.
+ *
+ * @param ctx The context, holding at least the parent.
+ * @param header The header.
+ * @param hash The hash of the header.
+ *
+ * @return 1 if the header connects, has a timestamp after the median time past (and not after max_time), the required bits and matches a checkpoint at its height, 0 otherwise.
+ */
+dogecoin_bool dogecoin_pow_context_check(const dogecoin_pow_context* ctx, const dogecoin_block_header* header, const uint256 hash)
+{
+
+    if (!ctx->time_count || memcmp(header->prev_block, ctx->hash, DOGECOIN_HASH_LENGTH) != 0)
+        return false;
+    if (header->timestamp <= dogecoin_pow_context_median_time_past(ctx))
+        return false;
+    if (ctx->max_time && (int64_t)header->timestamp > ctx->max_time)
+        return false;
+    if (!dogecoin_pow_context_bits_ok(ctx, header->timestamp, header->bits))
+        return false;
+    return dogecoin_pow_checkpoint_ok(ctx->chain, ctx->height + 1, hash);
+}
+
+
+/**
+ * @brief This function validates a run of consecutive headers
+ * such as a headers message. The contextual checks run first
+ * on a copy of the context, then the proof of work of all
+ * headers passing them is checked with the batched scrypt.
+ * The context is advanced past the leading valid headers.
+ *
+ * @param ctx The context, holding at least the parent of the first header.
+ * @param headers The headers.
+ * @param pow_headers NULL, or per header the auxpow parent header proving its work (NULL entries for regular headers).
+ * @param count The number of headers.
+ *
+ * @return The number of leading headers which are valid.
+ */
+size_t dogecoin_pow_context_connect_headers(dogecoin_pow_context* ctx, const dogecoin_block_header* headers, const dogecoin_block_header* const* pow_headers, size_t count)
+{
+    dogecoin_pow_context* tmp;
+    const dogecoin_block_header** pow;
+    uint8_t* hashes;
+    uint32_t* bits;
+    dogecoin_bool* valid;
+    uint8_t buf[DOGECOIN_BLOCK_HEADER_SIZE];
+    size_t n, i;
+
+    if (count == 0)
+        return 0;
+    tmp = dogecoin_malloc(sizeof(*tmp));
+    *tmp = *ctx;
+    pow = dogecoin_malloc(count * sizeof(*pow));
+    hashes = dogecoin_malloc(count * DOGECOIN_HASH_LENGTH);
+    bits = dogecoin_malloc(count * sizeof(*bits));
+    valid = dogecoin_malloc(count * sizeof(*valid));
+
+    for (n = 0; n < count; n++) {
+        uint8_t* hash = hashes + n * DOGECOIN_HASH_LENGTH;
+        dogecoin_pow_serialize_header(&headers[n], buf);
+        sha256_raw(buf, sizeof(buf), hash);
+        sha256_raw(hash, SHA256_DIGEST_LENGTH, hash);
+        if (!dogecoin_pow_context_check(tmp, &headers[n], hash))
+            break;
+        dogecoin_pow_context_add(tmp, hash, tmp->height + 1, headers[n].bits, headers[n].timestamp);
+        pow[n] = pow_headers && pow_headers[n] ? pow_headers[n] : &headers[n];
+        bits[n] = headers[n].bits;
+    }
+
+    dogecoin_block_headers_check_pow(pow, bits, n, ctx->chain, valid);
+    for (i = 0; i < n && valid[i]; i++)
+        dogecoin_pow_context_add(ctx, hashes + i * DOGECOIN_HASH_LENGTH, ctx->height + 1, headers[i].bits, headers[i].timestamp);
+
+    dogecoin_free(tmp);
+    dogecoin_free(pow);
+    dogecoin_free(hashes);
+    dogecoin_free(bits);
+    dogecoin_free(valid);
+    return i;
+}
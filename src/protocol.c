@@ -79,32 +79,170 @@ void dogecoin_p2p_address_init(dogecoin_p2p_address* addr)
  */
 cstring* dogecoin_p2p_message_new(const unsigned char netmagic[4], const char* command, const void* data, uint32_t data_len)
 {
-    cstring* s = cstr_new_sz(DOGECOIN_P2P_HDRSZ + data_len);
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, data_len);
+    if (data_len > 0)
+        ser_writer_bytes(&mw.w, data, data_len);
+    return dogecoin_p2p_msg_writer_finish(&mw, netmagic, command);
+}
+
+/**
+ * Write the 24 byte header of a p2p message
+ * 
+ * @param netmagic The magic number is a 4-byte value that identifies the network.
+ * @param command The command string.
+ * @param data_len The length of the data payload.
+ * @param payload_hash The double sha256 hash of the payload, the first 4 bytes are the checksum.
+ * @param hdr_out The buffer receiving the DOGECOIN_P2P_HDRSZ header bytes.
+ */
+void dogecoin_p2p_message_header(const unsigned char netmagic[4], const char* command, uint32_t data_len, const uint256 payload_hash, unsigned char* hdr_out)
+{
+    size_t cmdlen = strlen(command);
 
     /* network identifier (magic number) */
-    cstr_append_buf(s, netmagic, 4);
+    memcpy(hdr_out, netmagic, 4);
 
-    /* command string */
-    char command_null[12];
-    dogecoin_mem_zero(command_null, 12);
-    memcpy_safe(command_null, command, strlen(command));
-    //memset(command_null+strlen(command), 0, 12-strlen(command));
-    cstr_append_buf(s, command_null, 12);
+    /* command string, zero padded */
+    dogecoin_mem_zero(hdr_out + 4, 12);
+    memcpy(hdr_out + 4, command, cmdlen < 12 ? cmdlen : 12);
 
     /* data length, always 4 bytes */
     uint32_t data_len_le = htole32(data_len);
-    cstr_append_buf(s, &data_len_le, 4);
+    memcpy(hdr_out + 16, &data_len_le, 4);
 
     /* data checksum (first 4 bytes of the double sha256 hash of the pl) */
+    memcpy(hdr_out + 20, payload_hash, 4);
+}
+
+/**
+ * Reserve the room for a p2p message header in a writer, the payload is
+ * written right behind it and dogecoin_p2p_message_finish fills the header in.
+ * 
+ * @param w The writer.
+ * @param hdr_pos Receives the position of the header.
+ * 
+ * @return dogecoin_bool (uint8_t)
+ */
+dogecoin_bool dogecoin_p2p_message_begin(ser_writer* w, ser_writer_pos* hdr_pos)
+{
+    return ser_writer_reserve(w, DOGECOIN_P2P_HDRSZ, hdr_pos);
+}
+
+/**
+ * Fill in the header reserved by dogecoin_p2p_message_begin for the payload
+ * written since. The checksum is computed over the written segments in place.
+ * 
+ * @param w The writer.
+ * @param hdr_pos The position returned by dogecoin_p2p_message_begin.
+ * @param netmagic The magic number is a 4-byte value that identifies the network.
+ * @param command The command string.
+ * 
+ * @return dogecoin_bool (uint8_t)
+ */
+dogecoin_bool dogecoin_p2p_message_finish(ser_writer* w, const ser_writer_pos* hdr_pos, const unsigned char netmagic[4], const char* command)
+{
+    dogecoin_iovec segs_stack[8];
+    dogecoin_iovec* segs = segs_stack;
+    size_t i, nsegs, skip = DOGECOIN_P2P_HDRSZ, data_len = 0;
+    sha256_context ctx;
     uint256 msghash;
-    dogecoin_hash(data, data_len, msghash);
-    cstr_append_buf(s, &msghash[0], 4);
+    unsigned char hdr[24];
 
-    /* data payload */
-    if (data_len > 0)
-        cstr_append_buf(s, data, data_len);
+    if (!ser_writer_ok(w))
+        return false;
+    if (w->counting)
+        return true;
+
+    nsegs = ser_writer_segments(w, hdr_pos, segs, 8);
+    if (nsegs > 8) {
+        segs = dogecoin_calloc(nsegs, sizeof(*segs));
+        ser_writer_segments(w, hdr_pos, segs, nsegs);
+    }
+
+    sha256_init(&ctx);
+    for (i = 0; i < nsegs; i++) {
+        const unsigned char* p = segs[i].base;
+        size_t len = segs[i].len;
+        /* the first bytes are the reserved header itself */
+        if (skip) {
+            size_t n = skip < len ? skip : len;
+            p += n;
+            len -= n;
+            skip -= n;
+        }
+        sha256_write(&ctx, p, len);
+        data_len += len;
+    }
+    sha256_finalize(&ctx, msghash);
+    sha256_raw(msghash, SHA256_DIGEST_LENGTH, msghash);
+
+    if (segs != segs_stack)
+        dogecoin_free(segs);
+    if (skip || data_len > DOGECOIN_MAX_P2P_MSG_SIZE)
+        return false;
+
+    dogecoin_p2p_message_header(netmagic, command, (uint32_t)data_len, msghash, hdr);
+    return ser_writer_fill(w, hdr_pos, hdr, sizeof(hdr));
+}
 
-    return s;
+/**
+ * Allocate a message for a payload of at most payload_len bytes and
+ * reserve its header, the payload is then serialized through mw->w.
+ * 
+ * @param mw The message writer to initialize.
+ * @param payload_len The size of the payload.
+ */
+void dogecoin_p2p_msg_writer_init(dogecoin_p2p_msg_writer* mw, size_t payload_len)
+{
+    mw->msg = cstr_new_sz(DOGECOIN_P2P_HDRSZ + payload_len);
+    ser_writer_init_buf(&mw->w, mw->msg->str, DOGECOIN_P2P_HDRSZ + payload_len);
+    dogecoin_p2p_message_begin(&mw->w, &mw->hdr_pos);
+}
+
+/**
+ * Fill in the header of a message started with dogecoin_p2p_msg_writer_init
+ * 
+ * @param mw The message writer.
+ * @param netmagic The magic number is a 4-byte value that identifies the network.
+ * @param command The command string.
+ * 
+ * @return The message, or NULL if the payload didn't fit.
+ */
+cstring* dogecoin_p2p_msg_writer_finish(dogecoin_p2p_msg_writer* mw, const unsigned char netmagic[4], const char* command)
+{
+    cstring* msg = mw->msg;
+    mw->msg = NULL;
+    if (!dogecoin_p2p_message_finish(&mw->w, &mw->hdr_pos, netmagic, command)) {
+        cstr_free(msg, true);
+        return NULL;
+    }
+    msg->len = mw->w.written;
+    msg->str[msg->len] = 0;
+    return msg;
+}
+
+/**
+ * Grow a cstring by len bytes and point a writer at them, the
+ * cstring serializers below count their writer version first.
+ * 
+ * @param s The cstring to append to.
+ * @param len The number of bytes that will be written.
+ * @param w The writer to initialize.
+ * 
+ * @return dogecoin_bool (uint8_t)
+ */
+static dogecoin_bool cstr_writer_init(cstring* s, size_t len, ser_writer* w)
+{
+    if (!cstr_alloc_minsize(s, s->len + len))
+        return false;
+    ser_writer_init_buf(w, s->str + s->len, len);
+    return true;
+}
+
+static void cstr_writer_done(cstring* s, const ser_writer* w)
+{
+    s->len += w->written;
+    s->str[s->len] = 0;
 }
 
 /**
@@ -128,11 +266,31 @@ dogecoin_bool dogecoin_p2p_deser_addr(unsigned int protocol_version, dogecoin_p2
         return false;
     if (!deser_bytes(&addr->ip, buf, 16))
         return false;
-    if (!deser_u16(&addr->port, buf))
+    /* the port is the only field in network byte order */
+    uint16_t port_be;
+    if (!deser_bytes(&port_be, buf, 2))
         return false;
+    addr->port = ntohs(port_be);
     return true;
 }
 
+/**
+ * Serialize a dogecoin_p2p_address struct to a writer
+ * 
+ * @param protover The protocol version.
+ * @param addr The address to serialize.
+ * @param w The writer to serialize to.
+ */
+void dogecoin_p2p_ser_addr_writer(unsigned int protover, const dogecoin_p2p_address* addr, ser_writer* w)
+{
+    if (protover >= DOGECOIN_ADDR_TIME_VERSION)
+        ser_writer_u32(w, addr->time);
+    ser_writer_u64(w, addr->services);
+    ser_writer_bytes(w, addr->ip, 16);
+    uint16_t port_be = htons(addr->port);
+    ser_writer_bytes(w, &port_be, 2);
+}
+
 /**
  * Serialize a dogecoin_p2p_address struct to a cstring
  * 
@@ -142,11 +300,13 @@ dogecoin_bool dogecoin_p2p_deser_addr(unsigned int protocol_version, dogecoin_p2
  */
 void dogecoin_p2p_ser_addr(unsigned int protover, const dogecoin_p2p_address* addr, cstring* s)
 {
-    if (protover >= DOGECOIN_ADDR_TIME_VERSION)
-        ser_u32(s, addr->time);
-    ser_u64(s, addr->services);
-    ser_bytes(s, addr->ip, 16);
-    ser_u16(s, addr->port);
+    ser_writer w;
+    ser_writer_init_counter(&w);
+    dogecoin_p2p_ser_addr_writer(protover, addr, &w);
+    if (!cstr_writer_init(s, w.written, &w))
+        return;
+    dogecoin_p2p_ser_addr_writer(protover, addr, &w);
+    cstr_writer_done(s, &w);
 }
 
 
@@ -187,10 +347,12 @@ void dogecoin_p2paddr_to_addr(dogecoin_p2p_address* p2p_addr, struct sockaddr* a
     if (!is_ipv4_mapped(p2p_addr->ip)) {
         /* ipv6 */
         struct sockaddr_in6* saddr = (struct sockaddr_in6*)addr_out;
+        saddr->sin6_family = AF_INET6;
         memcpy_safe(&saddr->sin6_addr, p2p_addr->ip, 16);
         saddr->sin6_port = htons(p2p_addr->port);
     } else {
         struct sockaddr_in* saddr = (struct sockaddr_in*)addr_out;
+        saddr->sin_family = AF_INET;
         memcpy_safe(&saddr->sin_addr, &p2p_addr->ip[12], 4);
         saddr->sin_port = htons(p2p_addr->port);
     }
@@ -235,15 +397,32 @@ void dogecoin_p2p_msg_version_init(dogecoin_p2p_version_msg* msg, const dogecoin
  */
 void dogecoin_p2p_msg_version_ser(dogecoin_p2p_version_msg* msg, cstring* buf)
 {
-    ser_s32(buf, msg->version);
-    ser_u64(buf, msg->services);
-    ser_s64(buf, msg->timestamp);
-    dogecoin_p2p_ser_addr(0, &msg->addr_recv, buf);
-    dogecoin_p2p_ser_addr(0, &msg->addr_from, buf);
-    ser_u64(buf, msg->nonce);
-    ser_str(buf, msg->useragent, 1024);
-    ser_s32(buf, msg->start_height);
-    cstr_append_c(buf, msg->relay);
+    ser_writer w;
+    ser_writer_init_counter(&w);
+    dogecoin_p2p_msg_version_ser_writer(msg, &w);
+    if (!cstr_writer_init(buf, w.written, &w))
+        return;
+    dogecoin_p2p_msg_version_ser_writer(msg, &w);
+    cstr_writer_done(buf, &w);
+}
+
+/**
+ * It serializes a dogecoin_p2p_version_msg object into a writer
+ * 
+ * @param msg the message object
+ * @param w the writer to serialize into
+ */
+void dogecoin_p2p_msg_version_ser_writer(dogecoin_p2p_version_msg* msg, ser_writer* w)
+{
+    ser_writer_s32(w, msg->version);
+    ser_writer_u64(w, msg->services);
+    ser_writer_s64(w, msg->timestamp);
+    dogecoin_p2p_ser_addr_writer(0, &msg->addr_recv, w);
+    dogecoin_p2p_ser_addr_writer(0, &msg->addr_from, w);
+    ser_writer_u64(w, msg->nonce);
+    ser_writer_str(w, msg->useragent, 1024);
+    ser_writer_s32(w, msg->start_height);
+    ser_writer_bytes(w, &msg->relay, 1);
 }
 
 /**
@@ -319,8 +498,23 @@ void dogecoin_p2p_msg_inv_init(dogecoin_p2p_inv_msg* msg, uint32_t type, uint256
  */
 void dogecoin_p2p_msg_inv_ser(dogecoin_p2p_inv_msg* msg, cstring* buf)
 {
-    ser_u32(buf, msg->type);
-    ser_bytes(buf, msg->hash, DOGECOIN_HASH_LENGTH);
+    ser_writer w;
+    if (!cstr_writer_init(buf, 4 + DOGECOIN_HASH_LENGTH, &w))
+        return;
+    dogecoin_p2p_msg_inv_ser_writer(msg, &w);
+    cstr_writer_done(buf, &w);
+}
+
+/**
+ * Serialize a dogecoin_p2p_inv_msg to a writer.
+ * 
+ * @param msg The message object to serialize.
+ * @param w The writer to serialize into.
+ */
+void dogecoin_p2p_msg_inv_ser_writer(dogecoin_p2p_inv_msg* msg, ser_writer* w)
+{
+    ser_writer_u32(w, msg->type);
+    ser_writer_bytes(w, msg->hash, DOGECOIN_HASH_LENGTH);
 }
 
 /**
@@ -349,19 +543,34 @@ dogecoin_bool dogecoin_p2p_msg_inv_deser(dogecoin_p2p_inv_msg* msg, struct const
  * @param s the serialized message
  */
 void dogecoin_p2p_msg_getheaders(vector* blocklocators, uint256 hashstop, cstring* s)
+{
+    ser_writer w;
+    ser_writer_init_counter(&w);
+    dogecoin_p2p_msg_getheaders_writer(blocklocators, hashstop, &w);
+    if (!cstr_writer_init(s, w.written, &w))
+        return;
+    dogecoin_p2p_msg_getheaders_writer(blocklocators, hashstop, &w);
+    cstr_writer_done(s, &w);
+}
+
+/**
+ * This function serializes a getheaders message into a writer
+ * 
+ * @param blocklocators a vector of block hashes
+ * @param hashstop The hash of the last block in the chain that we want to download.
+ * @param w the writer to serialize into
+ */
+void dogecoin_p2p_msg_getheaders_writer(vector* blocklocators, uint256 hashstop, ser_writer* w)
 {
     unsigned int i;
 
-    ser_u32(s, DOGECOIN_PROTOCOL_VERSION);
-    ser_varlen(s, blocklocators->len);
+    ser_writer_u32(w, DOGECOIN_PROTOCOL_VERSION);
+    ser_writer_varlen(w, blocklocators->len);
     for (i = 0; i < blocklocators->len; i++) {
         uint256 *hash = vector_idx(blocklocators, i);
-        ser_bytes(s, hash, DOGECOIN_HASH_LENGTH);
+        ser_writer_bytes(w, hash, DOGECOIN_HASH_LENGTH);
     }
-    if (hashstop)
-        ser_bytes(s, hashstop, DOGECOIN_HASH_LENGTH);
-    else
-        ser_bytes(s, NULLHASH, DOGECOIN_HASH_LENGTH);
+    ser_writer_bytes(w, hashstop ? hashstop : NULLHASH, DOGECOIN_HASH_LENGTH);
 }
 
 /**
@@ -395,6 +604,42 @@ dogecoin_bool dogecoin_p2p_deser_msg_getheaders(vector* blocklocators, uint256 h
     return true;
 }
 
+/**
+ * This function serializes a getcfilters message
+ * 
+ * @param filter_type The type of the requested filters.
+ * @param start_height The height of the first block.
+ * @param stop_hash The hash of the last block.
+ * @param s the serialized message
+ */
+void dogecoin_p2p_msg_getcfilters(uint8_t filter_type, uint32_t start_height, const uint256 stop_hash, cstring* s)
+{
+    ser_bytes(s, &filter_type, 1);
+    ser_u32(s, start_height);
+    ser_bytes(s, stop_hash, DOGECOIN_HASH_LENGTH);
+}
+
+/**
+ * Deserialize a getcfilters message
+ * 
+ * @param filter_type The type of the requested filters.
+ * @param start_height The height of the first block.
+ * @param stop_hash The hash of the last block.
+ * @param buf the buffer to deserialize from
+ * 
+ * @return dogecoin_bool (uint8_t)
+ */
+dogecoin_bool dogecoin_p2p_deser_msg_getcfilters(uint8_t* filter_type, uint32_t* start_height, uint256 stop_hash, struct const_buffer* buf)
+{
+    if (!deser_bytes(filter_type, buf, 1))
+        return false;
+    if (!deser_u32(start_height, buf))
+        return false;
+    if (!deser_u256(stop_hash, buf))
+        return false;
+    return true;
+}
+
 /**
  * Deserialize the dogecoin_p2p_msg_hdr structure
  * 
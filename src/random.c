@@ -26,6 +26,7 @@
 
 */
 
+#include <dogecoin/mem.h>
 #include <dogecoin/random.h>
 
 #include <assert.h>
@@ -38,6 +39,12 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#if defined HAVE_SYS_RANDOM_H && ! defined _WIN32
+#  include <sys/random.h>
+#endif
+#ifndef RANDOM_DEVICE
+#  define RANDOM_DEVICE "/dev/urandom"
+#endif
 #if defined _WIN32 && ! defined __CYGWIN__
 # define WIN32_LEAN_AND_MEAN
 # include <windows.h>
@@ -191,13 +198,202 @@ dogecoin_bool dogecoin_random_bytes_internal(uint8_t* buf, uint32_t len, const u
     return -1;
 #else
     (void)update_seed; //unused
-    FILE* frand = fopen("/dev/urandom", "r"); // figure out why RANDOM_DEVICE is undeclared here
-    if (!frand)
+    size_t done = 0;
+#if defined HAVE_SYS_RANDOM_H && defined HAVE_GETRANDOM
+    /* getrandom() avoids the open/read/close round trip of the device file */
+    while (done < len) {
+        ssize_t r = getrandom(buf + done, len - done, 0);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            break; /* ENOSYS on old kernels, fall back to the device */
+            }
+        done += (size_t)r;
+        }
+    if (done == len)
+        return true;
+#endif
+#ifdef O_CLOEXEC
+    int fd = open(RANDOM_DEVICE, O_RDONLY | O_CLOEXEC);
+#else
+    int fd = open(RANDOM_DEVICE, O_RDONLY);
+#endif
+    if (fd < 0)
         return false;
-    size_t len_read = fread(buf, 1, len, frand);
-    assert(len_read == len);
-    fclose(frand);
-    return true;
+    while (done < len) {
+        ssize_t r = read(fd, buf + done, len - done);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+        done += (size_t)r;
+        }
+    close(fd);
+    return done == len;
 #endif
     }
 #endif
+
+/*
+ * ChaCha20 based deterministic random bit generator.
+ *
+ * Every thread keeps its own generator, seeded from the operating system
+ * source above. Output is produced a buffer at a time, the first 32 bytes
+ * of each buffer immediately replace the key (fast key erasure) and every
+ * byte handed out is wiped from the buffer, so a later state compromise
+ * does not reveal earlier output. The generator reseeds after
+ * DOGECOIN_DRBG_RESEED_BYTES of output, when the caller asks for it via
+ * update_seed and, on unix, when it notices it is running in a forked child.
+ */
+
+#if defined(_MSC_VER)
+#define DOGECOIN_DRBG_TLS __declspec(thread)
+#else
+#define DOGECOIN_DRBG_TLS __thread
+#endif
+
+#define DOGECOIN_DRBG_KEY_SIZE 32
+#define DOGECOIN_DRBG_BUF_SIZE (16 * 64)
+#define DOGECOIN_DRBG_RESEED_BYTES (1024 * 1024)
+
+typedef struct dogecoin_drbg_ {
+    uint32_t key[8];
+    uint32_t nonce[2];
+    uint64_t counter;
+    uint8_t buf[DOGECOIN_DRBG_BUF_SIZE];
+    size_t avail; /* unused bytes at the end of buf */
+    uint64_t output_since_seed;
+    long pid;
+    int seeded;
+} dogecoin_drbg;
+
+static DOGECOIN_DRBG_TLS dogecoin_drbg drbg_state;
+
+#define CHACHA_ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define CHACHA_QR(a, b, c, d)                   \
+    a += b; d ^= a; d = CHACHA_ROTL(d, 16);     \
+    c += d; b ^= c; b = CHACHA_ROTL(b, 12);     \
+    a += b; d ^= a; d = CHACHA_ROTL(d, 8);      \
+    c += d; b ^= c; b = CHACHA_ROTL(b, 7);
+
+static uint32_t chacha_load32_le(const uint8_t* p)
+    {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+static void chacha_store32_le(uint8_t* p, uint32_t v)
+    {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    }
+
+/* one 64 byte ChaCha20 block (64 bit counter in words 12/13, 64 bit nonce) */
+static void chacha20_block(const uint32_t key[8], const uint32_t nonce[2], uint64_t counter, uint8_t out[64])
+    {
+    uint32_t in[16], x[16];
+    int i;
+    in[0] = 0x61707865;
+    in[1] = 0x3320646e;
+    in[2] = 0x79622d32;
+    in[3] = 0x6b206574;
+    for (i = 0; i < 8; i++)
+        in[4 + i] = key[i];
+    in[12] = (uint32_t)counter;
+    in[13] = (uint32_t)(counter >> 32);
+    in[14] = nonce[0];
+    in[15] = nonce[1];
+    memcpy(x, in, sizeof(x));
+    for (i = 0; i < 10; i++) {
+        CHACHA_QR(x[0], x[4], x[8], x[12]);
+        CHACHA_QR(x[1], x[5], x[9], x[13]);
+        CHACHA_QR(x[2], x[6], x[10], x[14]);
+        CHACHA_QR(x[3], x[7], x[11], x[15]);
+        CHACHA_QR(x[0], x[5], x[10], x[15]);
+        CHACHA_QR(x[1], x[6], x[11], x[12]);
+        CHACHA_QR(x[2], x[7], x[8], x[13]);
+        CHACHA_QR(x[3], x[4], x[9], x[14]);
+        }
+    for (i = 0; i < 16; i++)
+        chacha_store32_le(out + 4 * i, x[i] + in[i]);
+    dogecoin_mem_zero(x, sizeof(x));
+    dogecoin_mem_zero(in, sizeof(in));
+    }
+
+static long dogecoin_drbg_getpid(void)
+    {
+#if defined _WIN32 && ! defined __CYGWIN__
+    return 0;
+#else
+    return (long)getpid();
+#endif
+    }
+
+/* mixes fresh operating system entropy into the key and picks a new nonce */
+static dogecoin_bool dogecoin_drbg_reseed(dogecoin_drbg* d)
+    {
+    uint8_t seed[DOGECOIN_DRBG_KEY_SIZE + 8];
+    int i;
+    if (!default_rnd_mapper.dogecoin_random_bytes(seed, sizeof(seed), 1))
+        return false;
+    for (i = 0; i < 8; i++)
+        d->key[i] ^= chacha_load32_le(seed + 4 * i);
+    d->nonce[0] = chacha_load32_le(seed + DOGECOIN_DRBG_KEY_SIZE);
+    d->nonce[1] = chacha_load32_le(seed + DOGECOIN_DRBG_KEY_SIZE + 4);
+    d->counter = 0;
+    dogecoin_mem_zero(seed, sizeof(seed));
+    /* drop buffered output derived from the previous key */
+    dogecoin_mem_zero(d->buf, sizeof(d->buf));
+    d->avail = 0;
+    d->output_since_seed = 0;
+    d->pid = dogecoin_drbg_getpid();
+    d->seeded = 1;
+    return true;
+    }
+
+/* fills the buffer with keystream and rekeys from its first 32 bytes */
+static void dogecoin_drbg_refill(dogecoin_drbg* d)
+    {
+    size_t off;
+    int i;
+    for (off = 0; off < sizeof(d->buf); off += 64)
+        chacha20_block(d->key, d->nonce, d->counter++, d->buf + off);
+    for (i = 0; i < 8; i++)
+        d->key[i] = chacha_load32_le(d->buf + 4 * i);
+    dogecoin_mem_zero(d->buf, DOGECOIN_DRBG_KEY_SIZE);
+    d->avail = sizeof(d->buf) - DOGECOIN_DRBG_KEY_SIZE;
+    }
+
+static void dogecoin_random_init_drbg(void)
+    {
+    dogecoin_drbg_reseed(&drbg_state);
+    }
+
+static dogecoin_bool dogecoin_random_bytes_drbg(uint8_t* buf, uint32_t len, const uint8_t update_seed)
+    {
+    dogecoin_drbg* d = &drbg_state;
+    if (!d->seeded || update_seed || d->pid != dogecoin_drbg_getpid() || d->output_since_seed >= DOGECOIN_DRBG_RESEED_BYTES) {
+        if (!dogecoin_drbg_reseed(d))
+            return false;
+        }
+    d->output_since_seed += len;
+    while (len > 0) {
+        if (d->avail == 0)
+            dogecoin_drbg_refill(d);
+        size_t n = d->avail < len ? d->avail : len;
+        uint8_t* src = d->buf + sizeof(d->buf) - d->avail;
+        memcpy(buf, src, n);
+        dogecoin_mem_zero(src, n);
+        d->avail -= n;
+        buf += n;
+        len -= (uint32_t)n;
+        }
+    return true;
+    }
+
+void dogecoin_rnd_set_mapper_drbg()
+    {
+    dogecoin_rnd_mapper mapper = { dogecoin_random_init_drbg, dogecoin_random_bytes_drbg };
+    current_rnd_mapper = mapper;
+    }
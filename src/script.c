@@ -52,58 +52,19 @@ dogecoin_bool dogecoin_script_copy_without_op_codeseperator(const cstring* scrip
     if (script_in->len == 0)
         return false; /* EOF */
 
-    struct const_buffer buf = {script_in->str, script_in->len};
-    unsigned char opcode;
-    while (buf.len > 0) {
-        if (!deser_bytes(&opcode, &buf, 1))
-            goto err_out;
-
-        uint32_t data_len = 0;
-
-        if (opcode < OP_PUSHDATA1 && opcode > OP_0) {
-            data_len = opcode;
-            cstr_append_buf(script_out, &opcode, 1);
-        } else if (opcode == OP_PUSHDATA1) {
-            uint8_t v8;
-            if (!deser_bytes(&v8, &buf, 1))
-                goto err_out;
-            cstr_append_buf(script_out, &opcode, 1);
-            cstr_append_buf(script_out, &v8, 1);
-            data_len = v8;
-        } else if (opcode == OP_PUSHDATA2) {
-            uint16_t v16;
-            if (!deser_u16(&v16, &buf))
-                goto err_out;
-            cstr_append_buf(script_out, &opcode, 1);
-            cstr_append_buf(script_out, &v16, 2);
-            data_len = v16;
-        } else if (opcode == OP_PUSHDATA4) {
-            uint32_t v32;
-            if (!deser_u32(&v32, &buf))
-                goto err_out;
-            cstr_append_buf(script_out, &opcode, 1);
-            cstr_append_buf(script_out, &v32, 4);
-            data_len = v32;
-        } else if (opcode == OP_CODESEPARATOR)
-            continue;
-
-        if (data_len > 0) {
-            assert(data_len < 16777215); //limit max push to 0xFFFFFF
-            unsigned char* bufpush = (unsigned char*)dogecoin_calloc(1, data_len);
-            if (!deser_bytes(bufpush, &buf, data_len)) {
-                dogecoin_free(bufpush);
-                goto err_out;
-            }
-            cstr_append_buf(script_out, bufpush, data_len);
-            dogecoin_free(bufpush);
-        } else
-            cstr_append_buf(script_out, &opcode, 1);
+    dogecoin_script_iter iter;
+    enum opcodetype opcode;
+    const unsigned char* data;
+    size_t datalen, start = 0;
+
+    dogecoin_script_iter_init(&iter, (const unsigned char*)script_in->str, script_in->len);
+    while (dogecoin_script_iter_next(&iter, &opcode, &data, &datalen)) {
+        if (opcode != OP_CODESEPARATOR)
+            cstr_append_buf(script_out, script_in->str + start, iter.pos - start);
+        start = iter.pos;
     }
 
-    return true;
-
-err_out:
-    return false;
+    return !iter.error;
 }
 
 
@@ -173,60 +134,105 @@ dogecoin_bool dogecoin_script_get_ops(const cstring* script_in, vector* ops_out)
     if (script_in->len == 0)
         return false; /* EOF */
 
-    struct const_buffer buf = {script_in->str, script_in->len};
-    unsigned char opcode;
+    dogecoin_script_iter iter;
+    enum opcodetype opcode;
+    const unsigned char* data;
+    size_t datalen;
 
-    dogecoin_script_op* op = NULL;
-    while (buf.len > 0) {
-        op = dogecoin_script_op_new();
+    dogecoin_script_iter_init(&iter, (const unsigned char*)script_in->str, script_in->len);
+    while (dogecoin_script_iter_next(&iter, &opcode, &data, &datalen)) {
+        dogecoin_script_op* op = dogecoin_script_op_new();
+        op->op = opcode;
+        if (data && datalen > 0) {
+            op->data = dogecoin_calloc(1, datalen);
+            memcpy_safe(op->data, data, datalen);
+            op->datalen = datalen;
+        }
+        vector_add(ops_out, op);
+    }
 
-        if (!deser_bytes(&opcode, &buf, 1))
-            goto err_out;
+    return !iter.error;
+}
 
-        op->op = opcode;
 
-        uint32_t data_len;
-
-        if (opcode < OP_PUSHDATA1) {
-            data_len = opcode;
-        } else if (opcode == OP_PUSHDATA1) {
-            uint8_t v8;
-            if (!deser_bytes(&v8, &buf, 1))
-                goto err_out;
-            data_len = v8;
-        } else if (opcode == OP_PUSHDATA2) {
-            uint16_t v16;
-            if (!deser_u16(&v16, &buf))
-                goto err_out;
-            data_len = v16;
-        } else if (opcode == OP_PUSHDATA4) {
-            uint32_t v32;
-            if (!deser_u32(&v32, &buf))
-                goto err_out;
-            data_len = v32;
-        } else {
-            vector_add(ops_out, op);
-            continue;
-        }
+/**
+ * @brief This function initializes an iterator over the
+ * operations of a script. The script is not copied and must
+ * outlive the iterator.
+ * 
+ * @param iter The iterator to initialize.
+ * @param script The script bytes.
+ * @param len The length of the script.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_script_iter_init(dogecoin_script_iter* iter, const unsigned char* script, size_t len)
+{
+    iter->script = script;
+    iter->len = script ? len : 0;
+    iter->pos = 0;
+    iter->error = false;
+}
 
-        // don't alloc a push buffer if there is no more data available
-        if (buf.len == 0 || data_len > buf.len) {
-            goto err_out;
-        }
 
-        op->data = dogecoin_calloc(1, data_len);
-        memcpy_safe(op->data, buf.p, data_len);
-        op->datalen = data_len;
+/**
+ * @brief This function reads the next operation of a script.
+ * For push opcodes data points to the pushed bytes inside the
+ * script, otherwise it is set to NULL.
+ * 
+ * @param iter The iterator to advance.
+ * @param op The opcode read.
+ * @param data The pushed data (may be NULL).
+ * @param datalen The length of the pushed data (may be NULL).
+ * 
+ * @return 1 if an operation was read, 0 at the end of the script or
+ * if the script is truncated (in which case iter->error is set).
+ */
+dogecoin_bool dogecoin_script_iter_next(dogecoin_script_iter* iter, enum opcodetype* op, const unsigned char** data, size_t* datalen)
+{
+    const unsigned char* script = iter->script;
+    size_t len = iter->len;
+    size_t p = iter->pos;
+    size_t n = 0;
+    unsigned char opcode;
 
-        vector_add(ops_out, op);
+    if (iter->error || p >= len)
+        return false;
+    opcode = script[p++];
 
-        if (!deser_skip(&buf, data_len))
+    if (opcode < OP_PUSHDATA1) {
+        n = opcode;
+    } else if (opcode == OP_PUSHDATA1) {
+        if (len - p < 1)
+            goto err_out;
+        n = script[p];
+        p += 1;
+    } else if (opcode == OP_PUSHDATA2) {
+        if (len - p < 2)
             goto err_out;
+        n = script[p] | ((size_t)script[p + 1] << 8);
+        p += 2;
+    } else if (opcode == OP_PUSHDATA4) {
+        if (len - p < 4)
+            goto err_out;
+        n = script[p] | ((size_t)script[p + 1] << 8) | ((size_t)script[p + 2] << 16) | ((size_t)script[p + 3] << 24);
+        p += 4;
     }
 
+    if (n > len - p)
+        goto err_out;
+
+    if (op)
+        *op = (enum opcodetype)opcode;
+    if (data)
+        *data = opcode <= OP_PUSHDATA4 ? script + p : NULL;
+    if (datalen)
+        *datalen = n;
+    iter->pos = p + n;
     return true;
+
 err_out:
-    dogecoin_script_op_free_cb(op);
+    iter->error = true;
     return false;
 }
 
@@ -463,6 +469,125 @@ enum dogecoin_tx_out_type dogecoin_script_classify_ops(const vector* ops)
 }
 
 
+/**
+ * @brief This function checks whether a pushed buffer
+ * has the size and header byte of an EC public key.
+ * 
+ * @param data The pushed data.
+ * @param datalen The length of the pushed data.
+ * 
+ * @return 1 if it looks like a pubkey, 0 otherwise.
+ */
+static dogecoin_bool dogecoin_script_is_pubkey_data(const unsigned char* data, size_t datalen)
+{
+    if (datalen != DOGECOIN_ECKEY_COMPRESSED_LENGTH && datalen != DOGECOIN_ECKEY_UNCOMPRESSED_LENGTH)
+        return false;
+    return dogecoin_pubkey_get_length(data[0]) == datalen;
+}
+
+
+/**
+ * @brief This function matches a multisig script
+ * (m <pubkey>... n OP_CHECKMULTISIG) without allocating.
+ * 
+ * @param script The script bytes.
+ * @param len The length of the script.
+ * @param tmpl The template to fill (may be NULL).
+ * 
+ * @return 1 if the script is a multisig script, 0 otherwise.
+ */
+static dogecoin_bool dogecoin_script_match_multisig(const unsigned char* script, size_t len, dogecoin_script_template* tmpl)
+{
+    dogecoin_script_iter iter;
+    enum opcodetype opcode;
+    const unsigned char* data;
+    size_t datalen, end;
+    unsigned int keys = 0;
+
+    /* at least m, n and OP_CHECKMULTISIG */
+    if (len < 3 || script[len - 1] != OP_CHECKMULTISIG)
+        return false;
+    if (!(script[0] == OP_0 || (script[0] >= OP_1 && script[0] <= OP_16)))
+        return false;
+    end = len - 2;
+    if (!(script[end] == OP_0 || (script[end] >= OP_1 && script[end] <= OP_16)))
+        return false;
+
+    dogecoin_script_iter_init(&iter, script, end);
+    iter.pos = 1;
+    while (dogecoin_script_iter_next(&iter, &opcode, &data, &datalen)) {
+        if (opcode > OP_PUSHDATA4 || !dogecoin_script_is_pubkey_data(data, datalen) || keys >= 16)
+            return false;
+        if (tmpl) {
+            tmpl->pubkeys[keys] = data;
+            tmpl->pubkey_lens[keys] = datalen;
+        }
+        keys++;
+    }
+    if (iter.error)
+        return false;
+
+    if (tmpl) {
+        tmpl->required_sigs = script[0] == OP_0 ? 0 : script[0] - OP_1 + 1;
+        tmpl->pubkey_count = keys;
+    }
+    return true;
+}
+
+
+/**
+ * @brief This function classifies a raw script by matching
+ * its bytes against the standard templates. The template
+ * data points into the script, no memory is allocated.
+ * 
+ * @param script The script bytes.
+ * @param len The length of the script.
+ * @param tmpl The template receiving the embedded hash/pubkeys (may be NULL).
+ * 
+ * @return The script type.
+ */
+enum dogecoin_tx_out_type dogecoin_script_classify_buf(const unsigned char* script, size_t len, dogecoin_script_template* tmpl)
+{
+    enum dogecoin_tx_out_type type = DOGECOIN_TX_NONSTANDARD;
+    const unsigned char* data = NULL;
+    size_t datalen = 0;
+
+    if (tmpl)
+        dogecoin_mem_zero(tmpl, sizeof(*tmpl));
+    if (!script)
+        return DOGECOIN_TX_NONSTANDARD;
+
+    if (len == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 &&
+        script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG) {
+        /* OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG */
+        type = DOGECOIN_TX_PUBKEYHASH;
+        data = script + 3;
+        datalen = 20;
+    } else if (len == 23 && script[0] == OP_HASH160 && script[1] == 20 && script[22] == OP_EQUAL) {
+        /* OP_HASH160 <20 bytes> OP_EQUAL */
+        type = DOGECOIN_TX_SCRIPTHASH;
+        data = script + 2;
+        datalen = 20;
+    } else if ((len == DOGECOIN_ECKEY_COMPRESSED_LENGTH + 2 || len == DOGECOIN_ECKEY_UNCOMPRESSED_LENGTH + 2) &&
+               script[0] == len - 2 && script[len - 1] == OP_CHECKSIG &&
+               dogecoin_script_is_pubkey_data(script + 1, len - 2)) {
+        /* <pubkey> OP_CHECKSIG */
+        type = DOGECOIN_TX_PUBKEY;
+        data = script + 1;
+        datalen = len - 2;
+    } else if (dogecoin_script_match_multisig(script, len, tmpl)) {
+        type = DOGECOIN_TX_MULTISIG;
+    }
+
+    if (tmpl) {
+        tmpl->type = type;
+        tmpl->data = data;
+        tmpl->datalen = datalen;
+    }
+    return type;
+}
+
+
 /**
  * @brief This function takes a cstring representation of
  * a script, classifies it as one of the four script types
@@ -476,23 +601,15 @@ enum dogecoin_tx_out_type dogecoin_script_classify_ops(const vector* ops)
  */
 enum dogecoin_tx_out_type dogecoin_script_classify(const cstring* script, vector* data_out)
 {
-    //INFO: could be speed up by not forming a vector
-    //      and directly parse the script cstring
-
-    enum dogecoin_tx_out_type tx_out_type = DOGECOIN_TX_NONSTANDARD;
-    vector* ops = vector_new(10, dogecoin_script_op_free_cb);
-    dogecoin_script_get_ops(script, ops);
-
-    if (dogecoin_script_is_pubkeyhash(ops, data_out))
-        tx_out_type = DOGECOIN_TX_PUBKEYHASH;
-    if (dogecoin_script_is_scripthash(ops, data_out))
-        tx_out_type = DOGECOIN_TX_SCRIPTHASH;
-    if (dogecoin_script_is_pubkey(ops, data_out))
-        tx_out_type = DOGECOIN_TX_PUBKEY;
-    if (dogecoin_script_is_multisig(ops))
-        tx_out_type = DOGECOIN_TX_MULTISIG;
+    dogecoin_script_template tmpl;
+    enum dogecoin_tx_out_type tx_out_type = dogecoin_script_classify_buf((const unsigned char*)script->str, script->len, &tmpl);
+
+    if (data_out && tmpl.data) {
+        uint8_t* buffer = dogecoin_calloc(1, tmpl.datalen);
+        memcpy_safe(buffer, tmpl.data, tmpl.datalen);
+        vector_add(data_out, buffer);
+    }
 
-    vector_free(ops, true);
     return tx_out_type;
 }
 
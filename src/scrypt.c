@@ -0,0 +1,425 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2009 Colin Percival
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <dogecoin/mem.h>
+#include <dogecoin/scrypt.h>
+#include <dogecoin/sha2.h>
+
+/*
+ * scrypt with N=1024, r=1, p=1 as used for the dogecoin (and litecoin)
+ * proof of work:
+ *
+ *   B = PBKDF2-HMAC-SHA256(header, header, 1, 128)
+ *   X = ROMix(B)          (1024 x 128 byte scratchpad, Salsa20/8 BlockMix)
+ *   H = PBKDF2-HMAC-SHA256(header, X, 1, 32)
+ *
+ * The vector paths run several independent hashes side by side, lane l of
+ * every vector holds a word of hash l, so each Salsa20/8 operation works
+ * on 4 (SSE2) or 8 (AVX2) headers at once. AVX2 is chosen at runtime.
+ */
+
+#if defined(__SSE2__)
+#define DOGECOIN_SCRYPT_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__ >= 5)
+#define DOGECOIN_SCRYPT_AVX2 1
+#include <immintrin.h>
+#endif
+
+#define SCRYPT_N 1024
+#define SCRYPT_WORDS 32 /* 128 bytes per block, r = 1 */
+#define SCRYPT_MAX_LANES 8
+
+/* the 8 rounds of Salsa20/8, OP(d, a, b, n) performs x[d] ^= rotl(x[a] + x[b], n) */
+#define SCRYPT_SALSA8_ROUNDS(OP)                                                 \
+    for (int r_ = 0; r_ < 8; r_ += 2) {                                          \
+        OP(4, 0, 12, 7); OP(8, 4, 0, 9); OP(12, 8, 4, 13); OP(0, 12, 8, 18);     \
+        OP(9, 5, 1, 7); OP(13, 9, 5, 9); OP(1, 13, 9, 13); OP(5, 1, 13, 18);     \
+        OP(14, 10, 6, 7); OP(2, 14, 10, 9); OP(6, 2, 14, 13); OP(10, 6, 2, 18);  \
+        OP(3, 15, 11, 7); OP(7, 3, 15, 9); OP(11, 7, 3, 13); OP(15, 11, 7, 18);  \
+        OP(1, 0, 3, 7); OP(2, 1, 0, 9); OP(3, 2, 1, 13); OP(0, 3, 2, 18);        \
+        OP(6, 5, 4, 7); OP(7, 6, 5, 9); OP(4, 7, 6, 13); OP(5, 4, 7, 18);        \
+        OP(11, 10, 9, 7); OP(8, 11, 10, 9); OP(9, 8, 11, 13); OP(10, 9, 8, 18);  \
+        OP(12, 15, 14, 7); OP(13, 12, 15, 9); OP(14, 13, 12, 13); OP(15, 14, 13, 18); \
+    }
+
+typedef struct scrypt_hmac_ {
+    sha256_context inner;
+    sha256_context outer;
+} scrypt_hmac;
+
+/**
+ * @brief This function precomputes the inner and outer
+ * HMAC-SHA256 states for a key.
+ *
+ * @param h The HMAC state to initialize.
+ * @param key The key.
+ * @param keylen The length of the key.
+ *
+ * @return Nothing.
+ */
+static void scrypt_hmac_init(scrypt_hmac* h, const uint8_t* key, size_t keylen)
+{
+    uint8_t k[SHA256_BLOCK_LENGTH], pad[SHA256_BLOCK_LENGTH];
+    int i;
+
+    memset(k, 0, sizeof(k));
+    if (keylen > SHA256_BLOCK_LENGTH)
+        sha256_raw(key, keylen, k);
+    else
+        memcpy(k, key, keylen);
+
+    for (i = 0; i < SHA256_BLOCK_LENGTH; i++)
+        pad[i] = k[i] ^ 0x36;
+    sha256_init(&h->inner);
+    sha256_write(&h->inner, pad, sizeof(pad));
+    for (i = 0; i < SHA256_BLOCK_LENGTH; i++)
+        pad[i] = k[i] ^ 0x5c;
+    sha256_init(&h->outer);
+    sha256_write(&h->outer, pad, sizeof(pad));
+}
+
+/**
+ * @brief This function computes PBKDF2-HMAC-SHA256 with a
+ * single iteration from a precomputed HMAC state.
+ *
+ * @param h The HMAC state of the password.
+ * @param salt The salt.
+ * @param saltlen The length of the salt.
+ * @param out The derived key.
+ * @param outlen The length of the derived key.
+ *
+ * @return Nothing.
+ */
+static void scrypt_pbkdf2_sha256(const scrypt_hmac* h, const uint8_t* salt, size_t saltlen, uint8_t* out, size_t outlen)
+{
+    sha256_context salted = h->inner, ctx;
+    uint8_t u[SHA256_DIGEST_LENGTH], t[SHA256_DIGEST_LENGTH], ibuf[4];
+    uint32_t i;
+
+    sha256_write(&salted, salt, saltlen);
+    for (i = 1; outlen > 0; i++) {
+        size_t n = outlen < sizeof(t) ? outlen : sizeof(t);
+        ibuf[0] = (uint8_t)(i >> 24);
+        ibuf[1] = (uint8_t)(i >> 16);
+        ibuf[2] = (uint8_t)(i >> 8);
+        ibuf[3] = (uint8_t)i;
+        ctx = salted;
+        sha256_write(&ctx, ibuf, 4);
+        sha256_finalize(&ctx, u);
+        ctx = h->outer;
+        sha256_write(&ctx, u, sizeof(u));
+        sha256_finalize(&ctx, t);
+        memcpy(out, t, n);
+        out += n;
+        outlen -= n;
+    }
+}
+
+/* B = PBKDF2(input, input, 1, 128) as little endian words */
+static void scrypt_prepare(const uint8_t* input, scrypt_hmac* h, uint32_t X[SCRYPT_WORDS])
+{
+    uint8_t b[SCRYPT_WORDS * 4];
+    int k;
+    scrypt_hmac_init(h, input, DOGECOIN_SCRYPT_INPUT_LENGTH);
+    scrypt_pbkdf2_sha256(h, input, DOGECOIN_SCRYPT_INPUT_LENGTH, b, sizeof(b));
+    for (k = 0; k < SCRYPT_WORDS; k++)
+        X[k] = (uint32_t)b[4 * k] | ((uint32_t)b[4 * k + 1] << 8) | ((uint32_t)b[4 * k + 2] << 16) | ((uint32_t)b[4 * k + 3] << 24);
+}
+
+/* H = PBKDF2(input, X, 1, 32) */
+static void scrypt_finish(const scrypt_hmac* h, const uint32_t X[SCRYPT_WORDS], uint8_t output[32])
+{
+    uint8_t b[SCRYPT_WORDS * 4];
+    int k;
+    for (k = 0; k < SCRYPT_WORDS; k++) {
+        b[4 * k] = (uint8_t)X[k];
+        b[4 * k + 1] = (uint8_t)(X[k] >> 8);
+        b[4 * k + 2] = (uint8_t)(X[k] >> 16);
+        b[4 * k + 3] = (uint8_t)(X[k] >> 24);
+    }
+    scrypt_pbkdf2_sha256(h, b, sizeof(b), output, 32);
+}
+
+#define SCRYPT_ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define SCRYPT_SCALAR_OP(d, a, b, n) x[d] ^= SCRYPT_ROTL32(x[a] + x[b], n);
+
+static void scrypt_xor_salsa8(uint32_t B[16], const uint32_t Bx[16])
+{
+    uint32_t x[16];
+    int i;
+    for (i = 0; i < 16; i++)
+        x[i] = (B[i] ^= Bx[i]);
+    SCRYPT_SALSA8_ROUNDS(SCRYPT_SCALAR_OP)
+    for (i = 0; i < 16; i++)
+        B[i] += x[i];
+}
+
+static void scrypt_core(uint32_t X[SCRYPT_WORDS], uint32_t* V)
+{
+    uint32_t i, k, j;
+    for (i = 0; i < SCRYPT_N; i++) {
+        memcpy(&V[i * SCRYPT_WORDS], X, SCRYPT_WORDS * sizeof(uint32_t));
+        scrypt_xor_salsa8(&X[0], &X[16]);
+        scrypt_xor_salsa8(&X[16], &X[0]);
+    }
+    for (i = 0; i < SCRYPT_N; i++) {
+        j = SCRYPT_WORDS * (X[16] & (SCRYPT_N - 1));
+        for (k = 0; k < SCRYPT_WORDS; k++)
+            X[k] ^= V[j + k];
+        scrypt_xor_salsa8(&X[0], &X[16]);
+        scrypt_xor_salsa8(&X[16], &X[0]);
+    }
+}
+
+static void scrypt_hash_scalar(const uint8_t* input, uint8_t* output, uint32_t* V)
+{
+    scrypt_hmac h;
+    uint32_t X[SCRYPT_WORDS];
+    scrypt_prepare(input, &h, X);
+    scrypt_core(X, V);
+    scrypt_finish(&h, X, output);
+}
+
+#ifdef DOGECOIN_SCRYPT_SSE2
+#define SCRYPT_SSE2_OP(d, a, b, n)                                          \
+    {                                                                       \
+        __m128i t_ = _mm_add_epi32(x[a], x[b]);                             \
+        x[d] = _mm_xor_si128(x[d], _mm_or_si128(_mm_slli_epi32(t_, n), _mm_srli_epi32(t_, 32 - n))); \
+    }
+
+static void scrypt_xor_salsa8_sse2(__m128i B[16], const __m128i Bx[16])
+{
+    __m128i x[16];
+    int i;
+    for (i = 0; i < 16; i++)
+        x[i] = B[i] = _mm_xor_si128(B[i], Bx[i]);
+    SCRYPT_SALSA8_ROUNDS(SCRYPT_SSE2_OP)
+    for (i = 0; i < 16; i++)
+        B[i] = _mm_add_epi32(B[i], x[i]);
+}
+
+/* hashes 4 inputs, V holds SCRYPT_N * SCRYPT_WORDS * 4 words */
+static void scrypt_hash_sse2(const uint8_t* inputs, uint8_t* outputs, uint32_t* V)
+{
+    scrypt_hmac h[4];
+    uint32_t X[4][SCRYPT_WORDS], j[4];
+    __m128i B[SCRYPT_WORDS];
+    uint32_t i, k;
+    int l;
+
+    for (l = 0; l < 4; l++)
+        scrypt_prepare(inputs + l * DOGECOIN_SCRYPT_INPUT_LENGTH, &h[l], X[l]);
+    for (k = 0; k < SCRYPT_WORDS; k++)
+        B[k] = _mm_set_epi32((int)X[3][k], (int)X[2][k], (int)X[1][k], (int)X[0][k]);
+
+    for (i = 0; i < SCRYPT_N; i++) {
+        for (k = 0; k < SCRYPT_WORDS; k++)
+            _mm_storeu_si128((__m128i*)&V[(i * SCRYPT_WORDS + k) * 4], B[k]);
+        scrypt_xor_salsa8_sse2(&B[0], &B[16]);
+        scrypt_xor_salsa8_sse2(&B[16], &B[0]);
+    }
+    for (i = 0; i < SCRYPT_N; i++) {
+        _mm_storeu_si128((__m128i*)j, B[16]);
+        for (l = 0; l < 4; l++)
+            j[l] = (j[l] & (SCRYPT_N - 1)) * SCRYPT_WORDS * 4 + l;
+        for (k = 0; k < SCRYPT_WORDS; k++) {
+            /* every lane reads its own scratchpad row */
+            __m128i v = _mm_set_epi32((int)V[j[3] + k * 4], (int)V[j[2] + k * 4], (int)V[j[1] + k * 4], (int)V[j[0] + k * 4]);
+            B[k] = _mm_xor_si128(B[k], v);
+        }
+        scrypt_xor_salsa8_sse2(&B[0], &B[16]);
+        scrypt_xor_salsa8_sse2(&B[16], &B[0]);
+    }
+
+    for (k = 0; k < SCRYPT_WORDS; k++) {
+        uint32_t w[4];
+        _mm_storeu_si128((__m128i*)w, B[k]);
+        for (l = 0; l < 4; l++)
+            X[l][k] = w[l];
+    }
+    for (l = 0; l < 4; l++)
+        scrypt_finish(&h[l], X[l], outputs + l * 32);
+}
+#endif
+
+#ifdef DOGECOIN_SCRYPT_AVX2
+#define SCRYPT_AVX2_OP(d, a, b, n)                                          \
+    {                                                                       \
+        __m256i t_ = _mm256_add_epi32(x[a], x[b]);                          \
+        x[d] = _mm256_xor_si256(x[d], _mm256_or_si256(_mm256_slli_epi32(t_, n), _mm256_srli_epi32(t_, 32 - n))); \
+    }
+
+__attribute__((target("avx2")))
+static void scrypt_xor_salsa8_avx2(__m256i B[16], const __m256i Bx[16])
+{
+    __m256i x[16];
+    int i;
+    for (i = 0; i < 16; i++)
+        x[i] = B[i] = _mm256_xor_si256(B[i], Bx[i]);
+    SCRYPT_SALSA8_ROUNDS(SCRYPT_AVX2_OP)
+    for (i = 0; i < 16; i++)
+        B[i] = _mm256_add_epi32(B[i], x[i]);
+}
+
+/* hashes 8 inputs, V holds SCRYPT_N * SCRYPT_WORDS * 8 words */
+__attribute__((target("avx2")))
+static void scrypt_hash_avx2(const uint8_t* inputs, uint8_t* outputs, uint32_t* V)
+{
+    scrypt_hmac h[8];
+    uint32_t X[8][SCRYPT_WORDS], w[8];
+    __m256i B[SCRYPT_WORDS];
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i mask = _mm256_set1_epi32(SCRYPT_N - 1);
+    uint32_t i, k;
+    int l;
+
+    for (l = 0; l < 8; l++)
+        scrypt_prepare(inputs + l * DOGECOIN_SCRYPT_INPUT_LENGTH, &h[l], X[l]);
+    for (k = 0; k < SCRYPT_WORDS; k++) {
+        for (l = 0; l < 8; l++)
+            w[l] = X[l][k];
+        B[k] = _mm256_loadu_si256((const __m256i*)w);
+    }
+
+    for (i = 0; i < SCRYPT_N; i++) {
+        for (k = 0; k < SCRYPT_WORDS; k++)
+            _mm256_storeu_si256((__m256i*)&V[(i * SCRYPT_WORDS + k) * 8], B[k]);
+        scrypt_xor_salsa8_avx2(&B[0], &B[16]);
+        scrypt_xor_salsa8_avx2(&B[16], &B[0]);
+    }
+    for (i = 0; i < SCRYPT_N; i++) {
+        /* index of word 0 of each lane's row: (j * 32) * 8 + lane */
+        __m256i idx = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(B[16], mask), 8), lane);
+        for (k = 0; k < SCRYPT_WORDS; k++) {
+            __m256i v = _mm256_i32gather_epi32((const int*)V, _mm256_add_epi32(idx, _mm256_set1_epi32((int)k * 8)), 4);
+            B[k] = _mm256_xor_si256(B[k], v);
+        }
+        scrypt_xor_salsa8_avx2(&B[0], &B[16]);
+        scrypt_xor_salsa8_avx2(&B[16], &B[0]);
+    }
+
+    for (k = 0; k < SCRYPT_WORDS; k++) {
+        _mm256_storeu_si256((__m256i*)w, B[k]);
+        for (l = 0; l < 8; l++)
+            X[l][k] = w[l];
+    }
+    for (l = 0; l < 8; l++)
+        scrypt_finish(&h[l], X[l], outputs + l * 32);
+}
+
+static int scrypt_have_avx2(void)
+{
+    static int have_avx2 = -1;
+    if (have_avx2 < 0) {
+        __builtin_cpu_init();
+        have_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return have_avx2;
+}
+#endif
+
+
+/**
+ * @brief This function returns how many inputs the batch
+ * function hashes in parallel on this cpu.
+ *
+ * @return The number of lanes.
+ */
+unsigned int dogecoin_scrypt_lanes(void)
+{
+#ifdef DOGECOIN_SCRYPT_AVX2
+    if (scrypt_have_avx2())
+        return 8;
+#endif
+#ifdef DOGECOIN_SCRYPT_SSE2
+    return 4;
+#else
+    return 1;
+#endif
+}
+
+
+/**
+ * @brief This function computes the scrypt(1024, 1, 1)
+ * proof of work hash of an 80 byte block header.
+ *
+ * @param input The serialized header.
+ * @param output The resulting hash.
+ *
+ * @return Nothing.
+ */
+void dogecoin_scrypt_1024_1_1_256(const uint8_t input[DOGECOIN_SCRYPT_INPUT_LENGTH], uint8_t output[32])
+{
+    uint32_t* V = dogecoin_malloc(SCRYPT_N * SCRYPT_WORDS * sizeof(uint32_t));
+    scrypt_hash_scalar(input, output, V);
+    dogecoin_free(V);
+}
+
+
+/**
+ * @brief This function computes the scrypt(1024, 1, 1) hashes
+ * of consecutive 80 byte inputs, using the widest vector
+ * lanes available and one shared scratchpad.
+ *
+ * @param inputs The serialized headers, count * 80 bytes.
+ * @param count The number of headers.
+ * @param outputs The resulting hashes, count * 32 bytes.
+ *
+ * @return Nothing.
+ */
+void dogecoin_scrypt_1024_1_1_256_batch(const uint8_t* inputs, size_t count, uint8_t* outputs)
+{
+    size_t done = 0;
+    size_t lanes = count > 1 ? dogecoin_scrypt_lanes() : 1;
+    uint32_t* V;
+
+    if (lanes > count)
+        lanes = count;
+    V = dogecoin_malloc((size_t)SCRYPT_N * SCRYPT_WORDS * sizeof(uint32_t) * (lanes ? lanes : 1));
+
+#ifdef DOGECOIN_SCRYPT_AVX2
+    if (lanes >= 8) {
+        for (; count - done >= 8; done += 8)
+            scrypt_hash_avx2(inputs + done * DOGECOIN_SCRYPT_INPUT_LENGTH, outputs + done * 32, V);
+    }
+#endif
+#ifdef DOGECOIN_SCRYPT_SSE2
+    if (lanes >= 4) {
+        for (; count - done >= 4; done += 4)
+            scrypt_hash_sse2(inputs + done * DOGECOIN_SCRYPT_INPUT_LENGTH, outputs + done * 32, V);
+    }
+#endif
+    for (; done < count; done++)
+        scrypt_hash_scalar(inputs + done * DOGECOIN_SCRYPT_INPUT_LENGTH, outputs + done * 32, V);
+
+    dogecoin_free(V);
+}
@@ -562,3 +562,305 @@ int deser_s64(int64_t* vo, struct const_buffer* buf)
 {
     return deser_u64((uint64_t*)vo, buf);
 }
+
+
+/**
+ * @brief This function initializes a writer which
+ * serializes into a single caller provided buffer.
+ * 
+ * @param w The pointer to the writer to initialize.
+ * @param buf The buffer to write into.
+ * @param len The size of the buffer.
+ * 
+ * @return Nothing.
+ */
+void ser_writer_init_buf(ser_writer* w, void* buf, size_t len)
+{
+    dogecoin_mem_zero(w, sizeof(*w));
+    w->single.base = buf;
+    w->single.len = len;
+    w->iov = &w->single;
+    w->iovcnt = 1;
+}
+
+
+/**
+ * @brief This function initializes a writer which
+ * serializes into a list of caller provided segments,
+ * filling them in order.
+ * 
+ * @param w The pointer to the writer to initialize.
+ * @param iov The segments to write into.
+ * @param iovcnt The number of segments.
+ * 
+ * @return Nothing.
+ */
+void ser_writer_init_iov(ser_writer* w, dogecoin_iovec* iov, size_t iovcnt)
+{
+    dogecoin_mem_zero(w, sizeof(*w));
+    w->iov = iov;
+    w->iovcnt = iovcnt;
+}
+
+
+/**
+ * @brief This function initializes a writer which
+ * only counts the bytes that would be serialized.
+ * 
+ * @param w The pointer to the writer to initialize.
+ * 
+ * @return Nothing.
+ */
+void ser_writer_init_counter(ser_writer* w)
+{
+    dogecoin_mem_zero(w, sizeof(*w));
+    w->counting = true;
+}
+
+
+/**
+ * @brief This function checks whether all writes so
+ * far fit into the writer's memory.
+ * 
+ * @param w The pointer to the writer.
+ * 
+ * @return 1 if no write overflowed, 0 otherwise.
+ */
+dogecoin_bool ser_writer_ok(const ser_writer* w)
+{
+    return !w->overflow;
+}
+
+
+/**
+ * @brief This function walks len bytes through the
+ * segments of a writer starting at pos, copying from
+ * p if given.
+ * 
+ * @param w The pointer to the writer.
+ * @param pos The position to start at, advanced by len on success.
+ * @param p The data to copy or NULL to only advance.
+ * @param len The number of bytes.
+ * 
+ * @return 1 if the segments could hold len bytes, 0 otherwise.
+ */
+static dogecoin_bool ser_writer_walk(const ser_writer* w, ser_writer_pos* pos, const unsigned char* p, size_t len)
+{
+    while (len) {
+        const dogecoin_iovec* seg;
+        size_t avail, n;
+        if (pos->idx >= w->iovcnt) {
+            return false;
+        }
+        seg = &w->iov[pos->idx];
+        avail = seg->len - pos->off;
+        if (!avail) {
+            pos->idx++;
+            pos->off = 0;
+            continue;
+        }
+        n = len < avail ? len : avail;
+        if (p) {
+            memcpy((unsigned char*)seg->base + pos->off, p, n);
+            p += n;
+        }
+        pos->off += n;
+        len -= n;
+    }
+    return true;
+}
+
+
+/**
+ * @brief This function appends raw bytes to a writer.
+ * 
+ * @param w The pointer to the writer.
+ * @param p The bytes to append.
+ * @param len The number of bytes.
+ * 
+ * @return Nothing.
+ */
+void ser_writer_bytes(ser_writer* w, const void* p, size_t len)
+{
+    if (w->overflow) {
+        return;
+    }
+    if (!w->counting && !ser_writer_walk(w, &w->pos, p, len)) {
+        w->overflow = true;
+        return;
+    }
+    w->written += len;
+}
+
+
+/**
+ * @brief This function skips len bytes which will
+ * be written later with ser_writer_fill().
+ * 
+ * @param w The pointer to the writer.
+ * @param len The number of bytes to reserve.
+ * @param pos_out The position of the reserved space.
+ * 
+ * @return 1 if the space was reserved, 0 if it didn't fit.
+ */
+dogecoin_bool ser_writer_reserve(ser_writer* w, size_t len, ser_writer_pos* pos_out)
+{
+    if (pos_out) {
+        *pos_out = w->pos;
+    }
+    if (w->overflow) {
+        return false;
+    }
+    if (!w->counting && !ser_writer_walk(w, &w->pos, NULL, len)) {
+        w->overflow = true;
+        return false;
+    }
+    w->written += len;
+    return true;
+}
+
+
+/**
+ * @brief This function writes into space that has
+ * previously been reserved with ser_writer_reserve().
+ * 
+ * @param w The pointer to the writer.
+ * @param pos The position returned by ser_writer_reserve().
+ * @param p The bytes to write.
+ * @param len The number of bytes.
+ * 
+ * @return 1 if the bytes were written, 0 otherwise.
+ */
+dogecoin_bool ser_writer_fill(ser_writer* w, const ser_writer_pos* pos, const void* p, size_t len)
+{
+    ser_writer_pos fill_pos = *pos;
+    if (w->counting) {
+        return true;
+    }
+    return ser_writer_walk(w, &fill_pos, p, len);
+}
+
+
+/**
+ * @brief This function collects the memory regions
+ * written between pos and the current position.
+ * 
+ * @param w The pointer to the writer.
+ * @param pos The start position.
+ * @param out The array receiving the regions.
+ * @param outcnt The capacity of out.
+ * 
+ * @return The number of regions, which may exceed outcnt.
+ */
+size_t ser_writer_segments(const ser_writer* w, const ser_writer_pos* pos, dogecoin_iovec* out, size_t outcnt)
+{
+    size_t idx, count = 0;
+    if (w->counting) {
+        return 0;
+    }
+    for (idx = pos->idx; idx <= w->pos.idx && idx < w->iovcnt; idx++) {
+        size_t start = (idx == pos->idx) ? pos->off : 0;
+        size_t end = (idx == w->pos.idx) ? w->pos.off : w->iov[idx].len;
+        if (end <= start) {
+            continue;
+        }
+        if (count < outcnt) {
+            out[count].base = (unsigned char*)w->iov[idx].base + start;
+            out[count].len = end - start;
+        }
+        count++;
+    }
+    return count;
+}
+
+
+void ser_writer_u16(ser_writer* w, uint16_t v_)
+{
+    uint16_t v = htole16(v_);
+    ser_writer_bytes(w, &v, sizeof(v));
+}
+
+
+void ser_writer_u32(ser_writer* w, uint32_t v_)
+{
+    uint32_t v = htole32(v_);
+    ser_writer_bytes(w, &v, sizeof(v));
+}
+
+
+void ser_writer_s32(ser_writer* w, int32_t v_)
+{
+    ser_writer_u32(w, (uint32_t)v_);
+}
+
+
+void ser_writer_u64(ser_writer* w, uint64_t v_)
+{
+    uint64_t v = htole64(v_);
+    ser_writer_bytes(w, &v, sizeof(v));
+}
+
+
+void ser_writer_s64(ser_writer* w, int64_t v_)
+{
+    ser_writer_u64(w, (uint64_t)v_);
+}
+
+
+void ser_writer_u256(ser_writer* w, const unsigned char* v_)
+{
+    ser_writer_bytes(w, v_, 32);
+}
+
+
+/**
+ * @brief This function writes a variable length integer
+ * using the minimum number of bytes, like ser_varlen().
+ * 
+ * @param w The pointer to the writer.
+ * @param vlen The value to write.
+ * 
+ * @return Nothing.
+ */
+void ser_writer_varlen(ser_writer* w, uint32_t vlen)
+{
+    unsigned char c[5];
+
+    if (vlen < 253) {
+        c[0] = vlen;
+        ser_writer_bytes(w, c, 1);
+    } else if (vlen < 0x10000) {
+        uint16_t v = htole16((uint16_t)vlen);
+        c[0] = 253;
+        memcpy(&c[1], &v, 2);
+        ser_writer_bytes(w, c, 3);
+    } else {
+        uint32_t v = htole32(vlen);
+        c[0] = 254;
+        memcpy(&c[1], &v, 4);
+        ser_writer_bytes(w, c, 5);
+    }
+
+    /* u64 case intentionally not implemented */
+}
+
+
+void ser_writer_str(ser_writer* w, const char* s_in, size_t maxlen)
+{
+    size_t slen = strnlen(s_in, maxlen);
+
+    ser_writer_varlen(w, slen);
+    ser_writer_bytes(w, s_in, slen);
+}
+
+
+void ser_writer_varstr(ser_writer* w, const cstring* s_in)
+{
+    if (!s_in || !s_in->len) {
+        ser_writer_varlen(w, 0);
+        return;
+    }
+
+    ser_writer_varlen(w, s_in->len);
+    ser_writer_bytes(w, s_in->str, s_in->len);
+}
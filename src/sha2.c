@@ -563,7 +563,13 @@ void sha256_write(sha256_context* context, const sha2_byte* data, size_t len)
     }
     while (len >= SHA256_BLOCK_LENGTH) {
         /* Process as many complete blocks as we can */
-        sha256_transform(context, (const sha2_word32*)data);
+        if (((uintptr_t)data & (sizeof(sha2_word32) - 1)) == 0) {
+            sha256_transform(context, (const sha2_word32*)data);
+        } else {
+            /* unaligned input (e.g. a transaction inside a block) goes through the buffer */
+            MEMCPY_BCOPY(context->buffer, data, SHA256_BLOCK_LENGTH);
+            sha256_transform(context, (sha2_word32*)context->buffer);
+        }
         context->bitcount += SHA256_BLOCK_LENGTH << 3;
         len -= SHA256_BLOCK_LENGTH;
         data += SHA256_BLOCK_LENGTH;
@@ -640,6 +646,163 @@ void sha256_raw(const sha2_byte* data, size_t len, uint8_t digest[SHA256_DIGEST_
     sha256_finalize(&context, digest);
 }
 
+/*** SHA-256d of 64 byte inputs: ****************************************/
+
+/*
+ * Merkle tree nodes are the double SHA-256 of two concatenated hashes.
+ * The input length is fixed, so the padding block of the first hash has
+ * a constant message schedule (K256 + W below) and the second hash is a
+ * single block. Several nodes are hashed side by side: lane l of every
+ * vector holds a word of input l, 4 lanes with GCC vector extensions
+ * (SSE2/NEON) and 8 lanes with AVX2 chosen at runtime.
+ */
+
+static const sha2_word32 sha256d64_padding_kw[64] = {
+    0xc28a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf374,
+    0x649b69c1, 0xf0fe4786, 0x0fe1edc6, 0x240cf254,
+    0x4fe9346f, 0x6cc984be, 0x61b9411e, 0x16f988fa,
+    0xf2c65152, 0xa88e5a6d, 0xb019fc65, 0xb9d99ec7,
+    0x9a1231c3, 0xe70eeaa0, 0xfdb1232b, 0xc7353eb0,
+    0x3069bad5, 0xcb976d5f, 0x5a0f118f, 0xdc1eeefd,
+    0x0a35b689, 0xde0b7a04, 0x58f4ca9d, 0xe15d5b16,
+    0x007f3e86, 0x37088980, 0xa507ea32, 0x6fab9537,
+    0x17406110, 0x0d8cd6f1, 0xcdaa3b6d, 0xc0bbbe37,
+    0x83613bda, 0xdb48a363, 0x0b02e931, 0x6fd15ca7,
+    0x521afaca, 0x31338431, 0x6ed41a95, 0x6d437890,
+    0xc39c91f2, 0x9eccabbd, 0xb5c9a0e6, 0x532fb63c,
+    0xd2c741c6, 0x07237ea3, 0xa4954b68, 0x4c191d76,
+};
+
+#define SHA256D64_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define SHA256D64_ROUND(T, a, b, c, d, e, f, g, h, kw)                                                                               \
+    {                                                                                                                                \
+        T t1_ = (h) + (SHA256D64_ROTR(e, 6) ^ SHA256D64_ROTR(e, 11) ^ SHA256D64_ROTR(e, 25)) + (((e) & (f)) ^ (~(e) & (g))) + (kw); \
+        T t2_ = (SHA256D64_ROTR(a, 2) ^ SHA256D64_ROTR(a, 13) ^ SHA256D64_ROTR(a, 22)) + (((a) & (b)) ^ ((a) & (c)) ^ ((b) & (c))); \
+        (d) += t1_;                                                                                                                  \
+        (h) = t1_ + t2_;                                                                                                             \
+    }
+/* message word j, expanded in place for j >= 16 */
+#define SHA256D64_W(w, j)                                                                                      \
+    ((j) < 16 ? w[j] : (w[(j)&15] += (SHA256D64_ROTR(w[((j) + 14) & 15], 17) ^ SHA256D64_ROTR(w[((j) + 14) & 15], 19) ^ (w[((j) + 14) & 15] >> 10)) + \
+                                      w[((j) + 9) & 15] +                                                       \
+                                      (SHA256D64_ROTR(w[((j) + 1) & 15], 7) ^ SHA256D64_ROTR(w[((j) + 1) & 15], 18) ^ (w[((j) + 1) & 15] >> 3))))
+#define SHA256D64_ROUNDS(T, s, KW)                                            \
+    {                                                                         \
+        T a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7]; \
+        int j;                                                                \
+        for (j = 0; j < 64; j += 8) {                                         \
+            SHA256D64_ROUND(T, a, b, c, d, e, f, g, h, KW(j));                \
+            SHA256D64_ROUND(T, h, a, b, c, d, e, f, g, KW(j + 1));            \
+            SHA256D64_ROUND(T, g, h, a, b, c, d, e, f, KW(j + 2));            \
+            SHA256D64_ROUND(T, f, g, h, a, b, c, d, e, KW(j + 3));            \
+            SHA256D64_ROUND(T, e, f, g, h, a, b, c, d, KW(j + 4));            \
+            SHA256D64_ROUND(T, d, e, f, g, h, a, b, c, KW(j + 5));            \
+            SHA256D64_ROUND(T, c, d, e, f, g, h, a, b, KW(j + 6));            \
+            SHA256D64_ROUND(T, b, c, d, e, f, g, h, a, KW(j + 7));            \
+        }                                                                     \
+        s[0] += a; s[1] += b; s[2] += c; s[3] += d;                           \
+        s[4] += e; s[5] += f; s[6] += g; s[7] += h;                           \
+    }
+
+/* defines NAME(out, in) hashing LANES inputs, LANE(v, l) accesses lane l of a T */
+#define SHA256D64_DEFINE(NAME, ATTR, T, LANES, LANE)                                                \
+    ATTR static void NAME(uint8_t* out, const uint8_t* in)                                          \
+    {                                                                                               \
+        T w[16], s[8], zero;                                                                        \
+        int i, l;                                                                                   \
+        memset(&zero, 0, sizeof(zero));                                                             \
+        for (i = 0; i < 16; i++)                                                                    \
+            for (l = 0; l < LANES; l++)                                                             \
+                LANE(w[i], l) = ((sha2_word32)in[64 * l + 4 * i] << 24) | ((sha2_word32)in[64 * l + 4 * i + 1] << 16) | \
+                                ((sha2_word32)in[64 * l + 4 * i + 2] << 8) | in[64 * l + 4 * i + 3];         \
+        for (i = 0; i < 8; i++)                                                                     \
+            s[i] = zero + sha256_initial_hash_value[i];                                             \
+        /* the input block, then the constant padding block */                                      \
+        SHA256D64_ROUNDS(T, s, NAME##_kw_block)                                                     \
+        SHA256D64_ROUNDS(T, s, NAME##_kw_padding)                                                   \
+        /* the second hash over the 32 byte digest */                                               \
+        for (i = 0; i < 8; i++) {                                                                   \
+            w[i] = s[i];                                                                            \
+            s[i] = zero + sha256_initial_hash_value[i];                                             \
+        }                                                                                           \
+        w[8] = zero + 0x80000000;                                                                   \
+        for (i = 9; i < 15; i++)                                                                    \
+            w[i] = zero;                                                                            \
+        w[15] = zero + 256;                                                                         \
+        SHA256D64_ROUNDS(T, s, NAME##_kw_block)                                                     \
+        for (i = 0; i < 8; i++)                                                                     \
+            for (l = 0; l < LANES; l++) {                                                           \
+                sha2_word32 v = LANE(s[i], l);                                                      \
+                out[32 * l + 4 * i] = (uint8_t)(v >> 24);                                           \
+                out[32 * l + 4 * i + 1] = (uint8_t)(v >> 16);                                       \
+                out[32 * l + 4 * i + 2] = (uint8_t)(v >> 8);                                        \
+                out[32 * l + 4 * i + 3] = (uint8_t)v;                                               \
+            }                                                                                       \
+    }
+
+#define sha256d64_1_kw_block(j) (SHA256D64_W(w, j) + K256[j])
+#define sha256d64_1_kw_padding(j) (sha256d64_padding_kw[j])
+#define SHA256D64_SCALAR_LANE(v, l) (v)
+SHA256D64_DEFINE(sha256d64_1, , sha2_word32, 1, SHA256D64_SCALAR_LANE)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SHA256D64_VECTOR_LANE(v, l) ((v)[l])
+typedef sha2_word32 sha256d64_v4 __attribute__((vector_size(16)));
+#define sha256d64_4_kw_block(j) (SHA256D64_W(w, j) + K256[j])
+#define sha256d64_4_kw_padding(j) (zero + sha256d64_padding_kw[j])
+SHA256D64_DEFINE(sha256d64_4, , sha256d64_v4, 4, SHA256D64_VECTOR_LANE)
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__ >= 5)
+#define SHA256D64_AVX2 1
+typedef sha2_word32 sha256d64_v8 __attribute__((vector_size(32)));
+#define sha256d64_8_kw_block(j) (SHA256D64_W(w, j) + K256[j])
+#define sha256d64_8_kw_padding(j) (zero + sha256d64_padding_kw[j])
+SHA256D64_DEFINE(sha256d64_8, __attribute__((target("avx2"))), sha256d64_v8, 8, SHA256D64_VECTOR_LANE)
+
+static int sha256d64_have_avx2(void)
+{
+    static int have_avx2 = -1;
+    if (have_avx2 < 0) {
+        __builtin_cpu_init();
+        have_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return have_avx2;
+}
+#endif
+#define SHA256D64_VEC4 1
+#endif
+
+/**
+ * @brief This function computes the double SHA-256 of
+ * consecutive 64 byte inputs, as needed for merkle tree
+ * nodes. Outputs may overlap the inputs as long as out
+ * does not run ahead of in (out <= in).
+ *
+ * @param out The resulting hashes, blocks * 32 bytes.
+ * @param in The inputs, blocks * 64 bytes.
+ * @param blocks The number of inputs.
+ *
+ * @return Nothing.
+ */
+void sha256d64(uint8_t* out, const uint8_t* in, size_t blocks)
+{
+#ifdef SHA256D64_AVX2
+    if (blocks >= 8 && sha256d64_have_avx2()) {
+        for (; blocks >= 8; blocks -= 8, in += 8 * 64, out += 8 * 32)
+            sha256d64_8(out, in);
+    }
+#endif
+#ifdef SHA256D64_VEC4
+    for (; blocks >= 4; blocks -= 4, in += 4 * 64, out += 4 * 32)
+        sha256d64_4(out, in);
+#endif
+    for (; blocks > 0; blocks--, in += 64, out += 32)
+        sha256d64_1(out, in);
+}
+
 /*** SHA-512: *********************************************************/
 void sha512_init(sha512_context* context)
 {
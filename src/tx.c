@@ -41,6 +41,25 @@
 #include <dogecoin/tx.h>
 #include <dogecoin/utils.h>
 
+/**
+ * @brief This function frees the script of a transaction
+ * input and clears it, without freeing the input itself.
+ * 
+ * @param tx_in The pointer to the transaction input to be cleared.
+ * 
+ * @return Nothing.
+ */
+static void dogecoin_tx_in_free_contents(dogecoin_tx_in* tx_in)
+{
+    if (tx_in->script_sig) {
+        cstr_free(tx_in->script_sig, true);
+        tx_in->script_sig = NULL;
+    }
+
+    dogecoin_mem_zero(tx_in, sizeof(*tx_in));
+}
+
+
 /**
  * @brief This function frees the memory allocated
  * for a transaction input.
@@ -54,15 +73,7 @@ void dogecoin_tx_in_free(dogecoin_tx_in* tx_in)
     if (!tx_in)
         return;
 
-    dogecoin_mem_zero(&tx_in->prevout.hash, sizeof(tx_in->prevout.hash));
-    tx_in->prevout.n = 0;
-
-    if (tx_in->script_sig) {
-        cstr_free(tx_in->script_sig, true);
-        tx_in->script_sig = NULL;
-    }
-
-    dogecoin_mem_zero(tx_in, sizeof(*tx_in));
+    dogecoin_tx_in_free_contents(tx_in);
     dogecoin_free(tx_in);
 }
 
@@ -87,6 +98,33 @@ void dogecoin_tx_in_free_cb(void* data)
 }
 
 
+/**
+ * @brief This function is the element free callback for the
+ * inputs of a transaction with a contiguous input array. Inputs
+ * inside the array only release their contents, inputs added
+ * individually are freed completely.
+ * 
+ * @param ctx The pointer to the transaction.
+ * @param data The pointer to the transaction input.
+ * 
+ * @return Nothing.
+ */
+static void dogecoin_tx_in_free_owned_cb(void* ctx, void* data)
+{
+    const dogecoin_tx* tx = ctx;
+    if (!data) {
+        return;
+    }
+
+    const uintptr_t start = (uintptr_t)tx->vin_arr;
+    const uintptr_t end = (uintptr_t)(tx->vin_arr + tx->vin_arr_len);
+    if ((uintptr_t)data >= start && (uintptr_t)data < end)
+        dogecoin_tx_in_free_contents(data);
+    else
+        dogecoin_tx_in_free(data);
+}
+
+
 /**
  * @brief This function creates a new dogecoin transaction
  * input object and initializes it to all zeroes.
@@ -103,6 +141,25 @@ dogecoin_tx_in* dogecoin_tx_in_new()
 }
 
 
+/**
+ * @brief This function frees the script of a transaction
+ * output and clears it, without freeing the output itself.
+ * 
+ * @param tx_out The pointer to the transaction output to be cleared.
+ * 
+ * @return Nothing.
+ */
+static void dogecoin_tx_out_free_contents(dogecoin_tx_out* tx_out)
+{
+    if (tx_out->script_pubkey) {
+        cstr_free(tx_out->script_pubkey, true);
+        tx_out->script_pubkey = NULL;
+    }
+
+    dogecoin_mem_zero(tx_out, sizeof(*tx_out));
+}
+
+
 /**
  * @brief This function frees the memory allocated
  * for a transaction output.
@@ -116,14 +173,8 @@ void dogecoin_tx_out_free(dogecoin_tx_out* tx_out)
     if (!tx_out) {
         return;
     }
-    tx_out->value = 0;
-
-    if (tx_out->script_pubkey) {
-        cstr_free(tx_out->script_pubkey, true);
-        tx_out->script_pubkey = NULL;
-    }
 
-    dogecoin_mem_zero(tx_out, sizeof(*tx_out));
+    dogecoin_tx_out_free_contents(tx_out);
     dogecoin_free(tx_out);
 }
 
@@ -148,6 +199,33 @@ void dogecoin_tx_out_free_cb(void* data)
 }
 
 
+/**
+ * @brief This function is the element free callback for the
+ * outputs of a transaction with a contiguous output array.
+ * Outputs inside the array only release their contents,
+ * outputs added individually are freed completely.
+ * 
+ * @param ctx The pointer to the transaction.
+ * @param data The pointer to the transaction output.
+ * 
+ * @return Nothing.
+ */
+static void dogecoin_tx_out_free_owned_cb(void* ctx, void* data)
+{
+    const dogecoin_tx* tx = ctx;
+    if (!data) {
+        return;
+    }
+
+    const uintptr_t start = (uintptr_t)tx->vout_arr;
+    const uintptr_t end = (uintptr_t)(tx->vout_arr + tx->vout_arr_len);
+    if ((uintptr_t)data >= start && (uintptr_t)data < end)
+        dogecoin_tx_out_free_contents(data);
+    else
+        dogecoin_tx_out_free(data);
+}
+
+
 /**
  * @brief This function creates a new dogecoin transaction
  * output object and initializes it to all zeroes.
@@ -164,25 +242,64 @@ dogecoin_tx_out* dogecoin_tx_out_new()
 
 
 /**
- * @brief This function frees the memory allocated
- * for a full transaction.
+ * @brief This function frees the inputs of a transaction
+ * together with its contiguous input array.
  * 
- * @param tx_in The pointer to the transaction to be freed.
+ * @param tx The pointer to the transaction.
  * 
  * @return Nothing.
  */
-void dogecoin_tx_free(dogecoin_tx* tx)
+static void dogecoin_tx_vin_release(dogecoin_tx* tx)
 {
+    /* the vector's free callback tells array elements from added ones */
     if (tx->vin) {
         vector_free(tx->vin, true);
         tx->vin = NULL;
     }
 
+    if (tx->vin_arr) {
+        dogecoin_free(tx->vin_arr);
+        tx->vin_arr = NULL;
+    }
+    tx->vin_arr_len = 0;
+}
+
+
+/**
+ * @brief This function frees the outputs of a transaction
+ * together with its contiguous output array.
+ * 
+ * @param tx The pointer to the transaction.
+ * 
+ * @return Nothing.
+ */
+static void dogecoin_tx_vout_release(dogecoin_tx* tx)
+{
     if (tx->vout) {
         vector_free(tx->vout, true);
         tx->vout = NULL;
     }
 
+    if (tx->vout_arr) {
+        dogecoin_free(tx->vout_arr);
+        tx->vout_arr = NULL;
+    }
+    tx->vout_arr_len = 0;
+}
+
+
+/**
+ * @brief This function frees the memory allocated
+ * for a full transaction.
+ * 
+ * @param tx_in The pointer to the transaction to be freed.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_tx_free(dogecoin_tx* tx)
+{
+    dogecoin_tx_vin_release(tx);
+    dogecoin_tx_vout_release(tx);
     dogecoin_free(tx);
 }
 
@@ -431,12 +548,31 @@ int dogecoin_tx_deserialize(const unsigned char* tx_serialized, size_t inlen, do
         return false;
     }
 
+    /* an input takes at least 41 bytes, reject counts the buffer can't hold */
+    if (vlen > buf.len / 41) {
+        return false;
+    }
+
+    /* inputs of a fresh transaction are stored in one contiguous array */
+    dogecoin_tx_in* vin_arr = NULL;
+    if (vlen && !tx->vin_arr && tx->vin->len == 0) {
+        vin_arr = dogecoin_calloc(vlen, sizeof(*vin_arr));
+        tx->vin_arr = vin_arr;
+        tx->vin_arr_len = vlen;
+        tx->vin->elem_free_ctx_f = dogecoin_tx_in_free_owned_cb;
+        tx->vin->elem_free_ctx = tx;
+    }
+
     unsigned int i;
     for (i = 0; i < vlen; i++) {
-        dogecoin_tx_in* tx_in = dogecoin_tx_in_new();
+        dogecoin_tx_in* tx_in = vin_arr ? &vin_arr[i] : dogecoin_tx_in_new();
 
         if (!dogecoin_tx_in_deserialize(tx_in, &buf)) {
-            dogecoin_tx_in_free(tx_in);
+            if (vin_arr) {
+                dogecoin_tx_in_free_contents(tx_in);
+            } else {
+                dogecoin_tx_in_free(tx_in);
+            }
             return false;
         } else {
             vector_add(tx->vin, tx_in);
@@ -445,11 +581,30 @@ int dogecoin_tx_deserialize(const unsigned char* tx_serialized, size_t inlen, do
 
     if (!deser_varlen(&vlen, &buf))
         return false;
+
+    /* an output takes at least 9 bytes */
+    if (vlen > buf.len / 9) {
+        return false;
+    }
+
+    dogecoin_tx_out* vout_arr = NULL;
+    if (vlen && !tx->vout_arr && tx->vout->len == 0) {
+        vout_arr = dogecoin_calloc(vlen, sizeof(*vout_arr));
+        tx->vout_arr = vout_arr;
+        tx->vout_arr_len = vlen;
+        tx->vout->elem_free_ctx_f = dogecoin_tx_out_free_owned_cb;
+        tx->vout->elem_free_ctx = tx;
+    }
+
     for (i = 0; i < vlen; i++) {
-        dogecoin_tx_out* tx_out = dogecoin_tx_out_new();
+        dogecoin_tx_out* tx_out = vout_arr ? &vout_arr[i] : dogecoin_tx_out_new();
 
         if (!dogecoin_tx_out_deserialize(tx_out, &buf)) {
-            dogecoin_free(tx_out);
+            if (vout_arr) {
+                dogecoin_tx_out_free_contents(tx_out);
+            } else {
+                dogecoin_tx_out_free(tx_out);
+            }
             return false;
         } else {
             vector_add(tx->vout, tx_out);
@@ -467,6 +622,58 @@ int dogecoin_tx_deserialize(const unsigned char* tx_serialized, size_t inlen, do
 }
 
 
+/**
+ * @brief This function advances a buffer past one serialized
+ * transaction without decoding or allocating anything.
+ * 
+ * @param buf The pointer to the buffer positioned at the transaction.
+ * 
+ * @return 1 if a complete transaction was skipped, 0 otherwise.
+ */
+dogecoin_bool dogecoin_tx_skip(struct const_buffer* buf)
+{
+    uint32_t vlen, slen, i;
+
+    if (!deser_skip(buf, 4) || !deser_varlen(&vlen, buf))
+        return false;
+    if (vlen > buf->len / 41)
+        return false;
+    for (i = 0; i < vlen; i++) {
+        if (!deser_skip(buf, 36) || !deser_varlen(&slen, buf) || !deser_skip(buf, slen) || !deser_skip(buf, 4))
+            return false;
+    }
+
+    if (!deser_varlen(&vlen, buf))
+        return false;
+    if (vlen > buf->len / 9)
+        return false;
+    for (i = 0; i < vlen; i++) {
+        if (!deser_skip(buf, 8) || !deser_varlen(&slen, buf) || !deser_skip(buf, slen))
+            return false;
+    }
+
+    return deser_skip(buf, 4);
+}
+
+
+/**
+ * @brief This function serializes a transaction input
+ * into a writer.
+ * 
+ * @param w The pointer to the writer to serialize the data into.
+ * @param tx_in The pointer to the transaction input to serialize.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_tx_in_serialize_writer(ser_writer* w, const dogecoin_tx_in* tx_in)
+{
+    ser_writer_u256(w, tx_in->prevout.hash);
+    ser_writer_u32(w, tx_in->prevout.n);
+    ser_writer_varstr(w, tx_in->script_sig);
+    ser_writer_u32(w, tx_in->sequence);
+}
+
+
 /**
  * @brief This function serializes a transaction input.
  * 
@@ -484,6 +691,22 @@ void dogecoin_tx_in_serialize(cstring* s, const dogecoin_tx_in* tx_in)
 }
 
 
+/**
+ * @brief This function serializes a transaction output
+ * into a writer.
+ * 
+ * @param w The pointer to the writer to serialize the data into.
+ * @param tx_out The pointer to the transaction output to serialize.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_tx_out_serialize_writer(ser_writer* w, const dogecoin_tx_out* tx_out)
+{
+    ser_writer_s64(w, tx_out->value);
+    ser_writer_varstr(w, tx_out->script_pubkey);
+}
+
+
 /**
  * @brief This function serializes a transaction output.
  * 
@@ -500,41 +723,78 @@ void dogecoin_tx_out_serialize(cstring* s, const dogecoin_tx_out* tx_out)
 
 
 /**
- * @brief This function serializes a full transaction.
+ * @brief This function serializes a full transaction
+ * into a writer.
  * 
- * @param s The pointer to the cstring to serialize the data into.
+ * @param w The pointer to the writer to serialize the data into.
  * @param tx The pointer to the transaction to serialize.
  * 
  * @return Nothing.
  */
-void dogecoin_tx_serialize(cstring* s, const dogecoin_tx* tx)
+void dogecoin_tx_serialize_writer(ser_writer* w, const dogecoin_tx* tx)
 {
-    ser_s32(s, tx->version);
+    ser_writer_s32(w, tx->version);
 
-    ser_varlen(s, tx->vin ? tx->vin->len : 0);
+    ser_writer_varlen(w, tx->vin ? tx->vin->len : 0);
 
     unsigned int i;
     if (tx->vin) {
         for (i = 0; i < tx->vin->len; i++) {
-            dogecoin_tx_in* tx_in;
-
-            tx_in = vector_idx(tx->vin, i);
-            dogecoin_tx_in_serialize(s, tx_in);
+            dogecoin_tx_in_serialize_writer(w, vector_idx(tx->vin, i));
         }
     }
 
-    ser_varlen(s, tx->vout ? tx->vout->len : 0);
+    ser_writer_varlen(w, tx->vout ? tx->vout->len : 0);
 
     if (tx->vout) {
         for (i = 0; i < tx->vout->len; i++) {
-            dogecoin_tx_out* tx_out;
-
-            tx_out = vector_idx(tx->vout, i);
-            dogecoin_tx_out_serialize(s, tx_out);
+            dogecoin_tx_out_serialize_writer(w, vector_idx(tx->vout, i));
         }
     }
 
-    ser_u32(s, tx->locktime);
+    ser_writer_u32(w, tx->locktime);
+}
+
+
+/**
+ * @brief This function calculates the size of a
+ * serialized transaction.
+ * 
+ * @param tx The pointer to the transaction.
+ * 
+ * @return The serialized size in bytes.
+ */
+size_t dogecoin_tx_serialized_size(const dogecoin_tx* tx)
+{
+    ser_writer w;
+    ser_writer_init_counter(&w);
+    dogecoin_tx_serialize_writer(&w, tx);
+    return w.written;
+}
+
+
+/**
+ * @brief This function serializes a full transaction.
+ * The cstring is grown once to the exact size needed.
+ * 
+ * @param s The pointer to the cstring to serialize the data into.
+ * @param tx The pointer to the transaction to serialize.
+ * 
+ * @return Nothing.
+ */
+void dogecoin_tx_serialize(cstring* s, const dogecoin_tx* tx)
+{
+    ser_writer w;
+    size_t size = dogecoin_tx_serialized_size(tx);
+
+    if (!cstr_alloc_minsize(s, s->len + size)) {
+        return;
+    }
+
+    ser_writer_init_buf(&w, s->str + s->len, size);
+    dogecoin_tx_serialize_writer(&w, tx);
+    s->len += size;
+    s->str[s->len] = 0;
 }
 
 
@@ -549,11 +809,23 @@ void dogecoin_tx_serialize(cstring* s, const dogecoin_tx* tx)
  */
 void dogecoin_tx_hash(const dogecoin_tx* tx, uint256 hashout)
 {
-    cstring* txser = cstr_new_sz(1024);
-    dogecoin_tx_serialize(txser, tx);
-    sha256_raw((const uint8_t*)txser->str, txser->len, hashout);
+    unsigned char stackbuf[1024];
+    unsigned char* buf = stackbuf;
+    ser_writer w;
+    size_t size = dogecoin_tx_serialized_size(tx);
+
+    if (size > sizeof(stackbuf)) {
+        buf = dogecoin_malloc(size);
+    }
+
+    ser_writer_init_buf(&w, buf, size);
+    dogecoin_tx_serialize_writer(&w, tx);
+    sha256_raw(buf, size, hashout);
     sha256_raw(hashout, DOGECOIN_HASH_LENGTH, hashout);
-    cstr_free(txser, true);
+
+    if (buf != stackbuf) {
+        dogecoin_free(buf);
+    }
 }
 
 
@@ -620,41 +892,44 @@ void dogecoin_tx_copy(dogecoin_tx* dest, const dogecoin_tx* src)
     dest->version = src->version;
     dest->locktime = src->locktime;
 
-    if (!src->vin) {
-        dest->vin = NULL;
-    } else {
+    dogecoin_tx_vin_release(dest);
+    if (src->vin) {
         unsigned int i;
 
-        if (dest->vin != NULL) {
-            vector_free(dest->vin, true);
+        /* the copies are stored in one contiguous array */
+        dest->vin = vector_new(src->vin->len, NULL);
+        dest->vin->elem_free_ctx_f = dogecoin_tx_in_free_owned_cb;
+        dest->vin->elem_free_ctx = dest;
+        if (src->vin->len) {
+            dest->vin_arr = dogecoin_calloc(src->vin->len, sizeof(*dest->vin_arr));
+            dest->vin_arr_len = src->vin->len;
         }
 
-        dest->vin = vector_new(src->vin->len, dogecoin_tx_in_free_cb);
-
         for (i = 0; i < src->vin->len; i++) {
             dogecoin_tx_in *tx_in_old, *tx_in_new;
             tx_in_old = vector_idx(src->vin, i);
-            tx_in_new = dogecoin_malloc(sizeof(*tx_in_new));
+            tx_in_new = &dest->vin_arr[i];
             dogecoin_tx_in_copy(tx_in_new, tx_in_old);
             vector_add(dest->vin, tx_in_new);
         }
     }
 
-    if (!src->vout) {
-        dest->vout = NULL;
-    } else {
+    dogecoin_tx_vout_release(dest);
+    if (src->vout) {
         unsigned int i;
 
-        if (dest->vout)
-            vector_free(dest->vout, true);
-
-        dest->vout = vector_new(src->vout->len,
-                                dogecoin_tx_out_free_cb);
+        dest->vout = vector_new(src->vout->len, NULL);
+        dest->vout->elem_free_ctx_f = dogecoin_tx_out_free_owned_cb;
+        dest->vout->elem_free_ctx = dest;
+        if (src->vout->len) {
+            dest->vout_arr = dogecoin_calloc(src->vout->len, sizeof(*dest->vout_arr));
+            dest->vout_arr_len = src->vout->len;
+        }
 
         for (i = 0; i < src->vout->len; i++) {
             dogecoin_tx_out *tx_out_old, *tx_out_new;
             tx_out_old = vector_idx(src->vout, i);
-            tx_out_new = dogecoin_malloc(sizeof(*tx_out_new));
+            tx_out_new = &dest->vout_arr[i];
             dogecoin_tx_out_copy(tx_out_new, tx_out_old);
             vector_add(dest->vout, tx_out_new);
         }
@@ -853,7 +1128,7 @@ dogecoin_bool dogecoin_tx_add_data_out(dogecoin_tx* tx, const int64_t amount, co
     }
 
     dogecoin_tx_out* tx_out = dogecoin_tx_out_new();
-    tx_out->script_pubkey = cstr_new_sz(1024);
+    tx_out->script_pubkey = cstr_new_sz(datalen + 3);
     dogecoin_script_append_op(tx_out->script_pubkey, OP_RETURN);
     dogecoin_script_append_pushdata(tx_out->script_pubkey, (unsigned char*)data, datalen);
     tx_out->value = amount;
@@ -882,7 +1157,7 @@ dogecoin_bool dogecoin_tx_add_puzzle_out(dogecoin_tx* tx, const int64_t amount,
     }
 
     dogecoin_tx_out* tx_out = dogecoin_tx_out_new();
-    tx_out->script_pubkey = cstr_new_sz(1024);
+    tx_out->script_pubkey = cstr_new_sz(puzzlelen + 3);
     dogecoin_script_append_op(tx_out->script_pubkey, OP_HASH256);
     dogecoin_script_append_pushdata(tx_out->script_pubkey, (unsigned char*)puzzle, puzzlelen);
     dogecoin_script_append_op(tx_out->script_pubkey, OP_EQUAL);
@@ -933,7 +1208,7 @@ dogecoin_bool dogecoin_tx_add_address_out(dogecoin_tx* tx, const dogecoin_chainp
 dogecoin_bool dogecoin_tx_add_p2pkh_hash160_out(dogecoin_tx* tx, int64_t amount, uint160 hash160)
 {
     dogecoin_tx_out* tx_out = dogecoin_tx_out_new();
-    tx_out->script_pubkey = cstr_new_sz(1024);
+    tx_out->script_pubkey = cstr_new_sz(25);
     dogecoin_script_build_p2pkh(tx_out->script_pubkey, hash160);
     tx_out->value = amount;
     vector_add(tx->vout, tx_out);
@@ -954,7 +1229,7 @@ dogecoin_bool dogecoin_tx_add_p2pkh_hash160_out(dogecoin_tx* tx, int64_t amount,
 dogecoin_bool dogecoin_tx_add_p2sh_hash160_out(dogecoin_tx* tx, int64_t amount, uint160 hash160)
 {
     dogecoin_tx_out* tx_out = dogecoin_tx_out_new();
-    tx_out->script_pubkey = cstr_new_sz(1024);
+    tx_out->script_pubkey = cstr_new_sz(23);
     dogecoin_script_build_p2sh(tx_out->script_pubkey, hash160);
     tx_out->value = amount;
     vector_add(tx->vout, tx_out);
@@ -1086,22 +1361,20 @@ enum dogecoin_tx_sign_result dogecoin_tx_sign_input(dogecoin_tx* tx_in_out, cons
 
     cstring* script_sign = cstr_new_cstr(script); //copy the script because we may modify it
     dogecoin_tx_in* tx_in = vector_idx(tx_in_out->vin, inputindex);
-    vector* script_pushes = vector_new(1, free);
+    dogecoin_script_template tmpl;
 
-    enum dogecoin_tx_out_type type = dogecoin_script_classify(script, script_pushes);
-    if (type == DOGECOIN_TX_PUBKEYHASH && script_pushes->len == 1) {
+    enum dogecoin_tx_out_type type = dogecoin_script_classify_buf((const unsigned char*)script->str, script->len, &tmpl);
+    if (type == DOGECOIN_TX_PUBKEYHASH) {
         // check if given private key matches the script
         uint160 hash160;
         dogecoin_pubkey_get_hash160(&pubkey, hash160);
-        uint160* hash160_in_script = vector_idx(script_pushes, 0);
-        if (memcmp(hash160_in_script, hash160, sizeof(hash160)) != 0) {
+        if (memcmp(tmpl.data, hash160, sizeof(hash160)) != 0) {
             res = DOGECOIN_SIGN_NO_KEY_MATCH; //sign anyways
         }
     } else {
         // unknown script, however, still try to create a signature (don't apply though)
         res = DOGECOIN_SIGN_UNKNOWN_SCRIPT_TYPE;
     }
-    vector_free(script_pushes, true);
 
     uint256 sighash;
     dogecoin_mem_zero(sighash, sizeof(sighash));
@@ -0,0 +1,1073 @@
+/*
+
+ The MIT License (MIT)
+
+ Copyright (c) 2022 The Dogecoin Foundation
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+ OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <dogecoin/mem.h>
+#include <dogecoin/script.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/sha2.h>
+#include <dogecoin/utxo.h>
+
+/*
+ * Blocks are copied into a batch which is applied in two parallel phases:
+ *
+ * 1. every worker hashes a contiguous range of the batched transactions
+ *    and sorts their spends and new outputs into per shard lists
+ * 2. every worker owns a subset of the shards and replays the lists of
+ *    its shards in transaction order
+ *
+ * An output and all spends of it share the shard of its txid, so an
+ * output created and spent in the same batch is always seen in order.
+ *
+ * Snapshot layout: magic, version, netmagic, height, block hash, shard
+ * count, per shard (u64 offset, u64 count), then per shard the records
+ * <txid> <u32 vout> <u32 size> <compact output>.
+ */
+
+#define UTXO_FILE_MAGIC "DOGEUTXO"
+#define UTXO_FILE_VERSION 1
+#define UTXO_FILE_HEADER_SIZE (8 + 4 + 4 + 4 + DOGECOIN_HASH_LENGTH + 4 + DOGECOIN_UTXO_SHARDS * 16)
+#define UTXO_RECORD_PREFIX (DOGECOIN_HASH_LENGTH + 4 + 4)
+#define UTXO_BATCH_BYTES (32 << 20)
+
+#define UTXO_INLINE 32
+#define UTXO_SLOT_EMPTY 0
+#define UTXO_SLOT_USED 1
+#define UTXO_SLOT_DELETED 2
+#define UTXO_DATA_INLINE 0
+#define UTXO_DATA_HEAP 1
+#define UTXO_DATA_MAPPED 2
+
+/* compressed script types below this are templates, above it the raw length is stored */
+#define UTXO_SPECIAL_SCRIPTS 6
+
+typedef struct dogecoin_utxo_slot_ {
+    union {
+        uint8_t bytes[UTXO_INLINE];
+        const uint8_t* ptr;
+    } data;
+    uint8_t txid[DOGECOIN_HASH_LENGTH];
+    uint32_t vout;
+    uint32_t len;
+    uint8_t state;
+    uint8_t storage;
+} dogecoin_utxo_slot;
+
+struct dogecoin_utxo_shard_ {
+    dogecoin_utxo_slot* slots;
+    size_t size;  /* power of two */
+    size_t count;
+    size_t used;  /* count and deleted slots */
+};
+
+typedef struct utxo_batch_tx_ {
+    size_t offset;
+    uint32_t len;
+    uint32_t code; /* height * 2 + coinbase */
+} utxo_batch_tx;
+
+/* a spend (output == NULL) or a new output */
+typedef struct utxo_op_ {
+    const uint8_t* txid;
+    const uint8_t* output; /* serialized amount and script */
+    uint32_t vout;
+    uint32_t code;
+} utxo_op;
+
+typedef struct utxo_op_list_ {
+    utxo_op* ops;
+    size_t count;
+    size_t alloc;
+} utxo_op_list;
+
+struct dogecoin_utxo_batch_ {
+    uint8_t* data;
+    size_t data_len;
+    size_t data_alloc;
+    utxo_batch_tx* txs;
+    size_t tx_count;
+    size_t tx_alloc;
+    uint8_t* txids;             /* tx_count * 32 */
+    utxo_op_list* lists;        /* threads * DOGECOIN_UTXO_SHARDS, worker major */
+    int64_t height;
+    uint256 hash;
+};
+
+typedef struct utxo_worker_ {
+    dogecoin_utxo_set* set;
+    unsigned int index;
+    int phase;
+    dogecoin_bool ok;
+} utxo_worker;
+
+static uint32_t utxo_read_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void utxo_write_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint64_t utxo_read_u64(const uint8_t* p)
+{
+    return (uint64_t)utxo_read_u32(p) | ((uint64_t)utxo_read_u32(p + 4) << 32);
+}
+
+static void utxo_write_u64(uint8_t* p, uint64_t v)
+{
+    utxo_write_u32(p, (uint32_t)v);
+    utxo_write_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+
+/**
+ * @brief This function compresses an amount, amounts with
+ * trailing zeros in koinu shrink to a few bytes.
+ *
+ * @param amount The amount in koinu.
+ *
+ * @return The compressed amount.
+ */
+uint64_t dogecoin_utxo_compress_amount(uint64_t amount)
+{
+    int e = 0;
+    if (amount == 0)
+        return 0;
+    while ((amount % 10) == 0 && e < 9) {
+        amount /= 10;
+        e++;
+    }
+    if (e < 9) {
+        int d = (int)(amount % 10);
+        amount /= 10;
+        return 1 + (amount * 9 + d - 1) * 10 + e;
+    }
+    return 1 + (amount - 1) * 10 + 9;
+}
+
+
+uint64_t dogecoin_utxo_decompress_amount(uint64_t x)
+{
+    uint64_t n;
+    int e;
+    if (x == 0)
+        return 0;
+    x--;
+    e = (int)(x % 10);
+    x /= 10;
+    if (e < 9) {
+        int d = (int)(x % 9) + 1;
+        x /= 9;
+        n = x * 10 + d;
+    } else {
+        n = x + 1;
+    }
+    while (e--)
+        n *= 10;
+    return n;
+}
+
+
+/* Core's VARINT, big endian base 128 without redundant encodings */
+static size_t utxo_write_varint(uint8_t* p, uint64_t n)
+{
+    uint8_t tmp[10];
+    size_t len = 0, i;
+    for (;;) {
+        tmp[len] = (uint8_t)((n & 0x7f) | (len ? 0x80 : 0x00));
+        if (n <= 0x7f)
+            break;
+        n = (n >> 7) - 1;
+        len++;
+    }
+    for (i = 0; i <= len; i++)
+        p[i] = tmp[len - i];
+    return len + 1;
+}
+
+static dogecoin_bool utxo_read_varint(const uint8_t** p, const uint8_t* end, uint64_t* n)
+{
+    *n = 0;
+    while (*p < end) {
+        uint8_t ch = *(*p)++;
+        if (*n > (UINT64_MAX >> 7))
+            return false;
+        *n = (*n << 7) | (ch & 0x7f);
+        if (!(ch & 0x80))
+            return true;
+        if (*n == UINT64_MAX)
+            return false;
+        (*n)++;
+    }
+    return false;
+}
+
+
+/**
+ * @brief This function encodes an output the way Core stores
+ * coins: height and coinbase flag, the compressed amount and
+ * the script, pay to pubkey hash, script hash and compressed
+ * pubkey scripts are reduced to their key material.
+ *
+ * @param out The buffer, at least script_len + 32 bytes.
+ * @param amount The amount in koinu.
+ * @param code The height times two plus the coinbase flag.
+ * @param script The output script.
+ * @param script_len The length of the script.
+ *
+ * @return The length of the encoding.
+ */
+static size_t utxo_encode(uint8_t* out, uint64_t amount, uint32_t code, const uint8_t* script, size_t script_len)
+{
+    size_t len = utxo_write_varint(out, code);
+    len += utxo_write_varint(out + len, dogecoin_utxo_compress_amount(amount));
+    if (script_len == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 && script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG) {
+        out[len++] = 0x00;
+        memcpy(out + len, script + 3, 20);
+        return len + 20;
+    }
+    if (script_len == 23 && script[0] == OP_HASH160 && script[1] == 20 && script[22] == OP_EQUAL) {
+        out[len++] = 0x01;
+        memcpy(out + len, script + 2, 20);
+        return len + 20;
+    }
+    if (script_len == 35 && script[0] == 33 && (script[1] == 0x02 || script[1] == 0x03) && script[34] == OP_CHECKSIG) {
+        memcpy(out + len, script + 1, 33);
+        return len + 33;
+    }
+    /* uncompressed pubkeys would need an ec point decompression to restore, they are kept verbatim */
+    len += utxo_write_varint(out + len, script_len + UTXO_SPECIAL_SCRIPTS);
+    memcpy(out + len, script, script_len);
+    return len + script_len;
+}
+
+
+void dogecoin_utxo_serialize(cstring* s, int64_t amount, uint32_t height, dogecoin_bool coinbase, const unsigned char* script, size_t script_len)
+{
+    size_t offset = s->len;
+    cstr_resize(s, offset + script_len + 32);
+    cstr_resize(s, offset + utxo_encode((uint8_t*)s->str + offset, (uint64_t)amount, height * 2 + (coinbase ? 1 : 0), script, script_len));
+}
+
+
+/**
+ * @brief This function decodes a compact output.
+ *
+ * @param data The encoded output.
+ * @param len The length of the encoding.
+ * @param utxo The output, its script is only filled if not NULL.
+ *
+ * @return 1 if the encoding is complete, 0 otherwise.
+ */
+dogecoin_bool dogecoin_utxo_deserialize(const unsigned char* data, size_t len, dogecoin_utxo* utxo)
+{
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    uint64_t code, amount, type;
+
+    if (!utxo_read_varint(&p, end, &code) || code > UINT32_MAX || !utxo_read_varint(&p, end, &amount) || !utxo_read_varint(&p, end, &type))
+        return false;
+    utxo->height = (uint32_t)(code >> 1);
+    utxo->coinbase = (code & 1) != 0;
+    utxo->amount = (int64_t)dogecoin_utxo_decompress_amount(amount);
+    if (type == 0x00 || type == 0x01) {
+        if (end - p != 20)
+            return false;
+    } else if (type == 0x02 || type == 0x03) {
+        if (end - p != 32)
+            return false;
+    } else if (type < UTXO_SPECIAL_SCRIPTS || (uint64_t)(end - p) != type - UTXO_SPECIAL_SCRIPTS) {
+        return false;
+    }
+    if (!utxo->script)
+        return true;
+
+    cstr_resize(utxo->script, 0);
+    switch (type) {
+    case 0x00:
+        cstr_append_buf(utxo->script, "\x76\xa9\x14", 3);
+        cstr_append_buf(utxo->script, p, 20);
+        cstr_append_buf(utxo->script, "\x88\xac", 2);
+        break;
+    case 0x01:
+        cstr_append_buf(utxo->script, "\xa9\x14", 2);
+        cstr_append_buf(utxo->script, p, 20);
+        cstr_append_c(utxo->script, (char)OP_EQUAL);
+        break;
+    case 0x02:
+    case 0x03:
+        cstr_append_c(utxo->script, 33);
+        cstr_append_c(utxo->script, (char)type);
+        cstr_append_buf(utxo->script, p, 32);
+        cstr_append_c(utxo->script, (char)OP_CHECKSIG);
+        break;
+    default:
+        cstr_append_buf(utxo->script, p, (size_t)(end - p));
+    }
+    return true;
+}
+
+
+static size_t utxo_shard_index(const uint8_t* txid)
+{
+    return txid[0] & (DOGECOIN_UTXO_SHARDS - 1);
+}
+
+/* the first txid byte picks the shard, the following ones the slot */
+static size_t utxo_slot_index(const dogecoin_utxo_shard* shard, const uint8_t* txid, uint32_t vout)
+{
+    uint64_t key;
+    memcpy(&key, txid + 8, sizeof(key));
+    key ^= (uint64_t)vout * 0x9e3779b97f4a7c15ULL;
+    return (size_t)(key ^ (key >> 29)) & (shard->size - 1);
+}
+
+static const uint8_t* utxo_slot_data(const dogecoin_utxo_slot* slot)
+{
+    return slot->storage == UTXO_DATA_INLINE ? slot->data.bytes : slot->data.ptr;
+}
+
+static void utxo_slot_release(dogecoin_utxo_slot* slot)
+{
+    if (slot->storage == UTXO_DATA_HEAP)
+        dogecoin_free((void*)slot->data.ptr);
+    slot->storage = UTXO_DATA_INLINE;
+}
+
+static dogecoin_utxo_slot* utxo_shard_find(const dogecoin_utxo_shard* shard, const uint8_t* txid, uint32_t vout)
+{
+    size_t i;
+    if (!shard->size)
+        return NULL;
+    for (i = utxo_slot_index(shard, txid, vout);; i = (i + 1) & (shard->size - 1)) {
+        dogecoin_utxo_slot* slot = &shard->slots[i];
+        if (slot->state == UTXO_SLOT_EMPTY)
+            return NULL;
+        if (slot->state == UTXO_SLOT_USED && slot->vout == vout && memcmp(slot->txid, txid, DOGECOIN_HASH_LENGTH) == 0)
+            return slot;
+    }
+}
+
+
+/**
+ * @brief This function resizes the table of a shard so it
+ * holds at least the given number of outputs, deleted slots
+ * are dropped on the way.
+ *
+ * @param shard The shard.
+ * @param count The number of outputs to make room for.
+ *
+ * @return Nothing.
+ */
+static void utxo_shard_reserve(dogecoin_utxo_shard* shard, size_t count)
+{
+    dogecoin_utxo_slot* old = shard->slots;
+    size_t old_size = shard->size, size = 64, i;
+
+    while (size / 4 * 3 <= count)
+        size *= 2;
+    if (size <= old_size && shard->used < old_size / 4 * 3)
+        return;
+    shard->slots = dogecoin_calloc(size, sizeof(dogecoin_utxo_slot));
+    shard->size = size;
+    shard->used = shard->count;
+    for (i = 0; i < old_size; i++) {
+        size_t j;
+        if (old[i].state != UTXO_SLOT_USED)
+            continue;
+        for (j = utxo_slot_index(shard, old[i].txid, old[i].vout); shard->slots[j].state != UTXO_SLOT_EMPTY; j = (j + 1) & (size - 1))
+            ;
+        shard->slots[j] = old[i];
+    }
+    if (old)
+        dogecoin_free(old);
+}
+
+
+/* inserts or replaces an output, small encodings are kept in the slot */
+static void utxo_shard_put(dogecoin_utxo_shard* shard, const uint8_t* txid, uint32_t vout, const uint8_t* data, size_t len, dogecoin_bool mapped)
+{
+    dogecoin_utxo_slot* slot = utxo_shard_find(shard, txid, vout);
+    if (!slot) {
+        size_t i;
+        if ((shard->used + 1) * 4 > shard->size * 3)
+            utxo_shard_reserve(shard, shard->count * 2 + 1);
+        for (i = utxo_slot_index(shard, txid, vout); shard->slots[i].state == UTXO_SLOT_USED; i = (i + 1) & (shard->size - 1))
+            ;
+        slot = &shard->slots[i];
+        if (slot->state == UTXO_SLOT_EMPTY)
+            shard->used++;
+        shard->count++;
+        memcpy(slot->txid, txid, DOGECOIN_HASH_LENGTH);
+        slot->vout = vout;
+        slot->state = UTXO_SLOT_USED;
+        slot->storage = UTXO_DATA_INLINE;
+    } else {
+        /* duplicate coinbase txids (pre BIP30) overwrite the older output */
+        utxo_slot_release(slot);
+    }
+    slot->len = (uint32_t)len;
+    if (len <= UTXO_INLINE) {
+        memcpy(slot->data.bytes, data, len);
+    } else if (mapped) {
+        slot->storage = UTXO_DATA_MAPPED;
+        slot->data.ptr = data;
+    } else {
+        uint8_t* copy = dogecoin_malloc(len);
+        memcpy(copy, data, len);
+        slot->storage = UTXO_DATA_HEAP;
+        slot->data.ptr = copy;
+    }
+}
+
+
+static dogecoin_bool utxo_shard_spend(dogecoin_utxo_shard* shard, const uint8_t* txid, uint32_t vout)
+{
+    dogecoin_utxo_slot* slot = utxo_shard_find(shard, txid, vout);
+    if (!slot)
+        return false;
+    utxo_slot_release(slot);
+    slot->state = UTXO_SLOT_DELETED;
+    shard->count--;
+    return true;
+}
+
+
+static void utxo_shard_clear(dogecoin_utxo_shard* shard)
+{
+    size_t i;
+    for (i = 0; i < shard->size; i++)
+        utxo_slot_release(&shard->slots[i]);
+    if (shard->slots)
+        dogecoin_free(shard->slots);
+    dogecoin_mem_zero(shard, sizeof(*shard));
+}
+
+
+/**
+ * @brief This function creates an empty output set.
+ *
+ * @param chain The chain the blocks belong to.
+ * @param threads The number of threads applying blocks, 0 for one per online cpu.
+ *
+ * @return A pointer to the new set.
+ */
+dogecoin_utxo_set* dogecoin_utxo_set_new(const dogecoin_chainparams* chain, unsigned int threads)
+{
+    dogecoin_utxo_set* set = dogecoin_calloc(1, sizeof(*set));
+    if (threads == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned int)cpus : 1;
+#else
+        threads = 1;
+#endif
+    }
+    /* every worker needs a shard in the second phase */
+    set->threads = threads > DOGECOIN_UTXO_SHARDS ? DOGECOIN_UTXO_SHARDS : threads;
+    set->chain = chain;
+    set->height = -1;
+    set->shards = dogecoin_calloc(DOGECOIN_UTXO_SHARDS, sizeof(dogecoin_utxo_shard));
+    set->batch = dogecoin_calloc(1, sizeof(dogecoin_utxo_batch));
+    set->batch->lists = dogecoin_calloc((size_t)set->threads * DOGECOIN_UTXO_SHARDS, sizeof(utxo_op_list));
+    set->batch->height = -1;
+    return set;
+}
+
+
+static void utxo_set_unmap(dogecoin_utxo_set* set)
+{
+    if (!set->map)
+        return;
+#ifdef WIN32
+    dogecoin_free((void*)set->map);
+#else
+    munmap((void*)set->map, set->map_len);
+#endif
+    set->map = NULL;
+    set->map_len = 0;
+}
+
+
+void dogecoin_utxo_set_free(dogecoin_utxo_set* set)
+{
+    size_t i;
+    if (!set)
+        return;
+    for (i = 0; i < DOGECOIN_UTXO_SHARDS; i++)
+        utxo_shard_clear(&set->shards[i]);
+    for (i = 0; i < (size_t)set->threads * DOGECOIN_UTXO_SHARDS; i++) {
+        if (set->batch->lists[i].ops)
+            dogecoin_free(set->batch->lists[i].ops);
+    }
+    dogecoin_free(set->batch->lists);
+    if (set->batch->data)
+        dogecoin_free(set->batch->data);
+    if (set->batch->txs)
+        dogecoin_free(set->batch->txs);
+    if (set->batch->txids)
+        dogecoin_free(set->batch->txids);
+    dogecoin_free(set->batch);
+    dogecoin_free(set->shards);
+    utxo_set_unmap(set);
+    dogecoin_free(set);
+}
+
+
+static void utxo_op_list_add(utxo_op_list* list, const uint8_t* txid, const uint8_t* output, uint32_t vout, uint32_t code)
+{
+    if (list->count == list->alloc) {
+        list->alloc = list->alloc ? list->alloc * 2 : 256;
+        list->ops = dogecoin_realloc(list->ops, list->alloc * sizeof(utxo_op));
+    }
+    list->ops[list->count].txid = txid;
+    list->ops[list->count].output = output;
+    list->ops[list->count].vout = vout;
+    list->ops[list->count].code = code;
+    list->count++;
+}
+
+
+/**
+ * @brief This function hashes a range of the batched
+ * transactions and sorts their inputs and outputs into the
+ * lists of the worker, by the shard of the outpoint.
+ *
+ * @param set The set holding the batch.
+ * @param worker The index of the worker.
+ *
+ * @return 1 if all transactions could be parsed, 0 otherwise.
+ */
+static dogecoin_bool utxo_batch_index(dogecoin_utxo_set* set, unsigned int worker)
+{
+    dogecoin_utxo_batch* batch = set->batch;
+    utxo_op_list* lists = &batch->lists[(size_t)worker * DOGECOIN_UTXO_SHARDS];
+    size_t first = batch->tx_count * worker / set->threads;
+    size_t last = batch->tx_count * (worker + 1) / set->threads, i;
+
+    for (i = first; i < last; i++) {
+        const utxo_batch_tx* tx = &batch->txs[i];
+        uint8_t* txid = batch->txids + i * DOGECOIN_HASH_LENGTH;
+        struct const_buffer buf = {batch->data + tx->offset, tx->len};
+        uint32_t count, slen, n;
+
+        sha256_raw(buf.p, buf.len, txid);
+        sha256_raw(txid, SHA256_DIGEST_LENGTH, txid);
+
+        if (!deser_skip(&buf, 4) || !deser_varlen(&count, &buf))
+            return false;
+        for (n = 0; n < count; n++) {
+            const uint8_t* prevout = buf.p;
+            if (!deser_skip(&buf, 36) || !deser_varlen(&slen, &buf) || !deser_skip(&buf, (size_t)slen + 4))
+                return false;
+            if (!(tx->code & 1))
+                utxo_op_list_add(&lists[utxo_shard_index(prevout)], prevout, NULL, utxo_read_u32(prevout + DOGECOIN_HASH_LENGTH), 0);
+        }
+        if (!deser_varlen(&count, &buf))
+            return false;
+        for (n = 0; n < count; n++) {
+            const uint8_t* output = buf.p;
+            const uint8_t* script;
+            if (!deser_skip(&buf, 8) || !deser_varlen(&slen, &buf))
+                return false;
+            script = buf.p;
+            if (!deser_skip(&buf, slen))
+                return false;
+            /* provably unspendable outputs never enter the set */
+            if (slen > MAX_SCRIPT_SIZE || (slen > 0 && script[0] == OP_RETURN))
+                continue;
+            utxo_op_list_add(&lists[utxo_shard_index(txid)], txid, output, n, tx->code);
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief This function replays the operations of the shards
+ * owned by a worker in transaction order.
+ *
+ * @param set The set holding the batch.
+ * @param worker The index of the worker.
+ *
+ * @return 1 if every spent output existed, 0 otherwise.
+ */
+static dogecoin_bool utxo_batch_apply(dogecoin_utxo_set* set, unsigned int worker)
+{
+    dogecoin_utxo_batch* batch = set->batch;
+    uint8_t small[UTXO_INLINE + 64];
+    dogecoin_bool ok = true;
+    size_t s, w, i;
+
+    for (s = worker; s < DOGECOIN_UTXO_SHARDS; s += set->threads) {
+        dogecoin_utxo_shard* shard = &set->shards[s];
+        for (w = 0; w < set->threads; w++) {
+            utxo_op_list* list = &batch->lists[w * DOGECOIN_UTXO_SHARDS + s];
+            for (i = 0; i < list->count; i++) {
+                const utxo_op* op = &list->ops[i];
+                if (!op->output) {
+                    if (!utxo_shard_spend(shard, op->txid, op->vout))
+                        ok = false;
+                } else {
+                    struct const_buffer buf = {op->output + 8, 9};
+                    uint32_t slen = 0;
+                    uint8_t* out = small;
+                    size_t len;
+                    deser_varlen(&slen, &buf);
+                    if ((size_t)slen + 32 > sizeof(small))
+                        out = dogecoin_malloc((size_t)slen + 32);
+                    len = utxo_encode(out, utxo_read_u64(op->output), op->code, buf.p, slen);
+                    utxo_shard_put(shard, op->txid, op->vout, out, len, false);
+                    if (out != small)
+                        dogecoin_free(out);
+                }
+            }
+            list->count = 0;
+        }
+    }
+    return ok;
+}
+
+
+static dogecoin_bool utxo_snapshot_index(dogecoin_utxo_set* set, unsigned int worker);
+
+static void* utxo_worker_run(void* arg)
+{
+    utxo_worker* worker = arg;
+    if (worker->phase == 1)
+        worker->ok = utxo_batch_index(worker->set, worker->index);
+    else if (worker->phase == 2)
+        worker->ok = utxo_batch_apply(worker->set, worker->index);
+    else
+        worker->ok = utxo_snapshot_index(worker->set, worker->index);
+    return NULL;
+}
+
+
+/**
+ * @brief This function runs one phase on all workers, the
+ * calling thread being the first of them.
+ *
+ * @param set The set.
+ * @param phase 1 for indexing and 2 for applying a batch, 3 for indexing a snapshot.
+ *
+ * @return 1 if all workers succeeded, 0 otherwise.
+ */
+static dogecoin_bool utxo_run_workers(dogecoin_utxo_set* set, int phase)
+{
+    utxo_worker* workers = dogecoin_calloc(set->threads, sizeof(utxo_worker));
+    pthread_t* threads = dogecoin_calloc(set->threads, sizeof(pthread_t));
+    dogecoin_bool* started = dogecoin_calloc(set->threads, sizeof(dogecoin_bool));
+    dogecoin_bool ok = true;
+    unsigned int i;
+
+    for (i = 0; i < set->threads; i++) {
+        workers[i].set = set;
+        workers[i].index = i;
+        workers[i].phase = phase;
+    }
+    for (i = 1; i < set->threads; i++)
+        started[i] = pthread_create(&threads[i], NULL, utxo_worker_run, &workers[i]) == 0;
+    utxo_worker_run(&workers[0]);
+    for (i = 1; i < set->threads; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            utxo_worker_run(&workers[i]);
+    }
+    for (i = 0; i < set->threads; i++)
+        ok = ok && workers[i].ok;
+
+    dogecoin_free(started);
+    dogecoin_free(threads);
+    dogecoin_free(workers);
+    return ok;
+}
+
+
+/**
+ * @brief This function applies all batched blocks to the set.
+ *
+ * @param set The set.
+ *
+ * @return 1 if the set is consistent, 0 if a block spent a missing output.
+ */
+dogecoin_bool dogecoin_utxo_set_flush(dogecoin_utxo_set* set)
+{
+    dogecoin_utxo_batch* batch = set->batch;
+    size_t i;
+
+    if (batch->height >= 0) {
+        batch->txids = dogecoin_realloc(batch->txids, (batch->tx_count ? batch->tx_count : 1) * DOGECOIN_HASH_LENGTH);
+        if (!utxo_run_workers(set, 1)) {
+            set->failed = true;
+            for (i = 0; i < (size_t)set->threads * DOGECOIN_UTXO_SHARDS; i++)
+                batch->lists[i].count = 0;
+        } else if (!utxo_run_workers(set, 2)) {
+            set->failed = true;
+        }
+        set->height = batch->height;
+        memcpy(set->hash, batch->hash, DOGECOIN_HASH_LENGTH);
+        batch->height = -1;
+        batch->tx_count = 0;
+        batch->data_len = 0;
+    }
+    return !set->failed;
+}
+
+
+/**
+ * @brief This function queues the next block of the best
+ * chain, its transactions are copied so the view may go away.
+ * The batch is applied once it is large enough.
+ *
+ * @param set The set.
+ * @param view The parsed block.
+ * @param height The height of the block.
+ * @param hash The hash of the block.
+ *
+ * @return 1 if the block was added, 0 if it is out of order, malformed or the set failed.
+ */
+dogecoin_bool dogecoin_utxo_set_add_block(dogecoin_utxo_set* set, dogecoin_block_view* view, uint32_t height, const uint256 hash)
+{
+    dogecoin_utxo_batch* batch = set->batch;
+    int64_t last = batch->height >= 0 ? batch->height : set->height;
+    size_t txs_size;
+    uint32_t i;
+
+    if (set->failed || (int64_t)height != last + 1 || !dogecoin_block_view_index(view, &txs_size))
+        return false;
+
+    /* the genesis coinbase can't be spent */
+    if (height > 0) {
+        if (batch->data_len + txs_size > batch->data_alloc) {
+            batch->data_alloc = (batch->data_len + txs_size) * 2;
+            batch->data = dogecoin_realloc(batch->data, batch->data_alloc);
+        }
+        if (batch->tx_count + view->tx_count > batch->tx_alloc) {
+            batch->tx_alloc = (batch->tx_count + view->tx_count) * 2;
+            batch->txs = dogecoin_realloc(batch->txs, batch->tx_alloc * sizeof(utxo_batch_tx));
+        }
+        memcpy(batch->data + batch->data_len, view->txs.p, txs_size);
+        for (i = 0; i < view->tx_count; i++) {
+            utxo_batch_tx* tx = &batch->txs[batch->tx_count++];
+            tx->offset = batch->data_len + view->tx_offsets[i];
+            tx->len = (uint32_t)(view->tx_offsets[i + 1] - view->tx_offsets[i]);
+            tx->code = height * 2 + (i == 0 ? 1 : 0);
+        }
+        batch->data_len += txs_size;
+    }
+    batch->height = height;
+    memcpy(batch->hash, hash, DOGECOIN_HASH_LENGTH);
+
+    if (batch->tx_count >= DOGECOIN_UTXO_BATCH_TXS || batch->data_len >= UTXO_BATCH_BYTES)
+        return dogecoin_utxo_set_flush(set);
+    return true;
+}
+
+
+dogecoin_bool dogecoin_utxo_set_blockfile_cb(dogecoin_blockfile_block* block, void* ctx)
+{
+    dogecoin_utxo_set* set = ctx;
+    int64_t last = set->batch->height >= 0 ? set->batch->height : set->height;
+    if ((int64_t)block->height <= last)
+        return true;
+    return dogecoin_utxo_set_add_block(set, &block->view, block->height, block->hash);
+}
+
+
+/**
+ * @brief This function looks up an unspent output. Pending
+ * blocks are applied first.
+ *
+ * @param set The set.
+ * @param txid The hash of the transaction.
+ * @param vout The index of the output.
+ * @param utxo The decoded output (may be NULL).
+ *
+ * @return 1 if the output is unspent, 0 otherwise.
+ */
+dogecoin_bool dogecoin_utxo_set_get(dogecoin_utxo_set* set, const uint256 txid, uint32_t vout, dogecoin_utxo* utxo)
+{
+    const dogecoin_utxo_slot* slot;
+    dogecoin_utxo_set_flush(set);
+    slot = utxo_shard_find(&set->shards[utxo_shard_index(txid)], txid, vout);
+    if (!slot)
+        return false;
+    return !utxo || dogecoin_utxo_deserialize(utxo_slot_data(slot), slot->len, utxo);
+}
+
+
+size_t dogecoin_utxo_set_foreach(dogecoin_utxo_set* set, dogecoin_utxo_set_cb cb, void* ctx)
+{
+    dogecoin_utxo utxo;
+    size_t visited = 0, s, i;
+
+    dogecoin_utxo_set_flush(set);
+    utxo.script = cstr_new_sz(64);
+    for (s = 0; s < DOGECOIN_UTXO_SHARDS; s++) {
+        const dogecoin_utxo_shard* shard = &set->shards[s];
+        for (i = 0; i < shard->size; i++) {
+            const dogecoin_utxo_slot* slot = &shard->slots[i];
+            if (slot->state != UTXO_SLOT_USED || !dogecoin_utxo_deserialize(utxo_slot_data(slot), slot->len, &utxo))
+                continue;
+            visited++;
+            if (!cb(slot->txid, slot->vout, &utxo, ctx))
+                goto done;
+        }
+    }
+done:
+    cstr_free(utxo.script, true);
+    return visited;
+}
+
+
+/**
+ * @brief This function counts the unspent outputs and sums
+ * their amounts, like gettxoutsetinfo. The Dogecoin supply
+ * in koinu doesn't fit into an int64_t.
+ *
+ * @param set The set.
+ * @param total_amount The sum of all amounts (may be NULL).
+ *
+ * @return The number of unspent outputs.
+ */
+size_t dogecoin_utxo_set_stats(dogecoin_utxo_set* set, uint64_t* total_amount)
+{
+    dogecoin_utxo utxo;
+    size_t count = 0, s, i;
+    uint64_t total = 0;
+
+    dogecoin_utxo_set_flush(set);
+    utxo.script = NULL;
+    for (s = 0; s < DOGECOIN_UTXO_SHARDS; s++) {
+        const dogecoin_utxo_shard* shard = &set->shards[s];
+        for (i = 0; i < shard->size; i++) {
+            const dogecoin_utxo_slot* slot = &shard->slots[i];
+            if (slot->state == UTXO_SLOT_USED && dogecoin_utxo_deserialize(utxo_slot_data(slot), slot->len, &utxo))
+                total += (uint64_t)utxo.amount;
+        }
+        count += shard->count;
+    }
+    if (total_amount)
+        *total_amount = total;
+    return count;
+}
+
+
+static void utxo_file_header(const dogecoin_utxo_set* set, uint8_t* header)
+{
+    memcpy(header, UTXO_FILE_MAGIC, 8);
+    utxo_write_u32(header + 8, UTXO_FILE_VERSION);
+    memcpy(header + 12, set->chain->netmagic, 4);
+    utxo_write_u32(header + 16, set->height < 0 ? UINT32_MAX : (uint32_t)set->height);
+    memcpy(header + 20, set->hash, DOGECOIN_HASH_LENGTH);
+    utxo_write_u32(header + 52, DOGECOIN_UTXO_SHARDS);
+}
+
+
+/**
+ * @brief This function writes the set to a snapshot file. The
+ * file is written next to path and renamed over it once
+ * complete, so a crash leaves the previous snapshot intact.
+ *
+ * @param set The set, pending blocks are applied first.
+ * @param path The path of the snapshot.
+ *
+ * @return 1 if the snapshot was written, 0 otherwise.
+ */
+dogecoin_bool dogecoin_utxo_set_save(dogecoin_utxo_set* set, const char* path)
+{
+    uint8_t header[UTXO_FILE_HEADER_SIZE];
+    char tmp[1024];
+    uint64_t offset = UTXO_FILE_HEADER_SIZE;
+    size_t s, i;
+    FILE* file;
+    dogecoin_bool ok = true;
+
+    if (!dogecoin_utxo_set_flush(set))
+        return false;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    file = fopen(tmp, "wb");
+    if (!file)
+        return false;
+
+    dogecoin_mem_zero(header, sizeof(header));
+    utxo_file_header(set, header);
+    for (s = 0; s < DOGECOIN_UTXO_SHARDS; s++) {
+        const dogecoin_utxo_shard* shard = &set->shards[s];
+        uint64_t bytes = 0;
+        for (i = 0; i < shard->size; i++) {
+            if (shard->slots[i].state == UTXO_SLOT_USED)
+                bytes += UTXO_RECORD_PREFIX + shard->slots[i].len;
+        }
+        utxo_write_u64(header + 56 + s * 16, offset);
+        utxo_write_u64(header + 56 + s * 16 + 8, shard->count);
+        offset += bytes;
+    }
+    ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+    for (s = 0; s < DOGECOIN_UTXO_SHARDS && ok; s++) {
+        const dogecoin_utxo_shard* shard = &set->shards[s];
+        for (i = 0; i < shard->size && ok; i++) {
+            const dogecoin_utxo_slot* slot = &shard->slots[i];
+            uint8_t prefix[UTXO_RECORD_PREFIX];
+            if (slot->state != UTXO_SLOT_USED)
+                continue;
+            memcpy(prefix, slot->txid, DOGECOIN_HASH_LENGTH);
+            utxo_write_u32(prefix + DOGECOIN_HASH_LENGTH, slot->vout);
+            utxo_write_u32(prefix + DOGECOIN_HASH_LENGTH + 4, slot->len);
+            ok = fwrite(prefix, 1, sizeof(prefix), file) == sizeof(prefix) && fwrite(utxo_slot_data(slot), 1, slot->len, file) == slot->len;
+        }
+    }
+    if (fclose(file) != 0)
+        ok = false;
+    if (ok) {
+#ifdef WIN32
+        remove(path);
+#endif
+        ok = rename(tmp, path) == 0;
+    }
+    if (!ok)
+        remove(tmp);
+    return ok;
+}
+
+
+static dogecoin_bool utxo_snapshot_index(dogecoin_utxo_set* set, unsigned int worker)
+{
+    dogecoin_bool ok = true;
+    size_t s, n;
+
+    for (s = worker; s < DOGECOIN_UTXO_SHARDS && ok; s += set->threads) {
+        dogecoin_utxo_shard* shard = &set->shards[s];
+        const uint8_t* entry = set->map + 56 + s * 16;
+        uint64_t offset = utxo_read_u64(entry), count = utxo_read_u64(entry + 8);
+        uint64_t end = s + 1 < DOGECOIN_UTXO_SHARDS ? utxo_read_u64(entry + 16) : set->map_len;
+
+        if (offset < UTXO_FILE_HEADER_SIZE || offset > end || end > set->map_len || count > (end - offset) / UTXO_RECORD_PREFIX) {
+            ok = false;
+            break;
+        }
+        utxo_shard_reserve(shard, (size_t)count);
+        for (n = 0; n < count; n++) {
+            const uint8_t* record = set->map + offset;
+            uint32_t len;
+            if (end - offset < UTXO_RECORD_PREFIX || utxo_shard_index(record) != s) {
+                ok = false;
+                break;
+            }
+            len = utxo_read_u32(record + DOGECOIN_HASH_LENGTH + 4);
+            if (end - offset - UTXO_RECORD_PREFIX < len) {
+                ok = false;
+                break;
+            }
+            utxo_shard_put(shard, record, utxo_read_u32(record + DOGECOIN_HASH_LENGTH), record + UTXO_RECORD_PREFIX, len, true);
+            offset += UTXO_RECORD_PREFIX + len;
+        }
+        if (offset != end)
+            ok = false;
+    }
+    return ok;
+}
+
+
+/**
+ * @brief This function maps a snapshot into an empty set.
+ * The records are indexed by all threads of the set, one
+ * shard at a time, and used in place from the mapping.
+ *
+ * @param set The empty set.
+ * @param path The path of the snapshot.
+ *
+ * @return 1 if the snapshot was loaded, 0 if it is missing, damaged or of another chain.
+ */
+dogecoin_bool dogecoin_utxo_set_load(dogecoin_utxo_set* set, const char* path)
+{
+    uint8_t header[UTXO_FILE_HEADER_SIZE];
+    size_t s;
+    long size;
+    FILE* file;
+
+    if (set->map || set->height >= 0 || set->batch->height >= 0)
+        return false;
+    file = fopen(path, "rb");
+    if (!file)
+        return false;
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < UTXO_FILE_HEADER_SIZE) {
+        fclose(file);
+        return false;
+    }
+    set->map_len = (size_t)size;
+#ifdef WIN32
+    /* no mmap, read the file instead */
+    set->map = dogecoin_malloc(set->map_len);
+    fseek(file, 0, SEEK_SET);
+    if (fread((void*)set->map, 1, set->map_len, file) != set->map_len) {
+        fclose(file);
+        utxo_set_unmap(set);
+        return false;
+    }
+#else
+    void* p = mmap(NULL, set->map_len, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (p == MAP_FAILED) {
+        fclose(file);
+        set->map_len = 0;
+        return false;
+    }
+    set->map = p;
+#endif
+    fclose(file);
+
+    utxo_file_header(set, header);
+    if (memcmp(set->map, header, 16) != 0 || utxo_read_u32(set->map + 52) != DOGECOIN_UTXO_SHARDS) {
+        utxo_set_unmap(set);
+        return false;
+    }
+
+    if (!utxo_run_workers(set, 3)) {
+        for (s = 0; s < DOGECOIN_UTXO_SHARDS; s++)
+            utxo_shard_clear(&set->shards[s]);
+        utxo_set_unmap(set);
+        return false;
+    }
+    set->height = utxo_read_u32(set->map + 16) == UINT32_MAX ? -1 : (int64_t)utxo_read_u32(set->map + 16);
+    memcpy(set->hash, set->map + 20, DOGECOIN_HASH_LENGTH);
+    return true;
+}
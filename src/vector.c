@@ -60,6 +60,24 @@ vector* vector_new(size_t res, void (*free_f)(void*))
 }
 
 
+/**
+ * @brief This function frees one element with the vector's
+ * free function, if it has one.
+ * 
+ * @param vec The pointer to the vector.
+ * @param elem The element to free.
+ * 
+ * @return Nothing.
+ */
+static void vector_free_elem(vector* vec, void* elem)
+{
+    if (vec->elem_free_ctx_f)
+        vec->elem_free_ctx_f(vec->elem_free_ctx, elem);
+    else if (vec->elem_free_f)
+        vec->elem_free_f(elem);
+}
+
+
 /**
  * @brief This function frees all of a vector's elements,
  * calling the function associated with its free operation
@@ -75,11 +93,11 @@ static void vector_free_data(vector* vec)
     if (!vec->data)
         return;
 
-    if (vec->elem_free_f) {
+    if (vec->elem_free_f || vec->elem_free_ctx_f) {
         unsigned int i;
         for (i = 0; i < vec->len; i++)
             if (vec->data[i]) {
-                vec->elem_free_f(vec->data[i]);
+                vector_free_elem(vec, vec->data[i]);
                 vec->data[i] = NULL;
             }
     }
@@ -209,10 +227,10 @@ void vector_remove_range(vector* vec, size_t pos, size_t len)
         return;
     }
 
-    if (vec->elem_free_f) {
+    if (vec->elem_free_f || vec->elem_free_ctx_f) {
         size_t i, count;
         for (i = pos, count = 0; count < len; i++, count++) {
-            vec->elem_free_f(vec->data[i]);
+            vector_free_elem(vec, vec->data[i]);
         }
     }
 
@@ -282,9 +300,7 @@ dogecoin_bool vector_resize(vector* vec, size_t newsz)
         size_t del_count = vec->len - newsz;
 
         for (i = (vec->len - del_count); i < vec->len; i++) {
-            if (vec->elem_free_f) {
-                vec->elem_free_f(vec->data[i]);
-            }
+            vector_free_elem(vec, vec->data[i]);
             vec->data[i] = NULL;
         }
 
@@ -0,0 +1,227 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <dogecoin/addrindex.h>
+#include <dogecoin/base58.h>
+#include <dogecoin/block.h>
+#include <dogecoin/chainparams.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/tx.h>
+#include <dogecoin/utils.h>
+
+#include "test_util.h"
+#include "utest.h"
+
+static dogecoin_bool addrindex_test_add(dogecoin_block_view* view, uint32_t height, const uint256 hash, void* ctx)
+{
+    return dogecoin_addrindex_add_block((dogecoin_addrindex*)ctx, view, height, hash);
+}
+
+/* builds a block of the given transactions, frees them and adds it to the index */
+static dogecoin_bool addrindex_test_block(dogecoin_addrindex* idx, uint32_t height, dogecoin_tx** txs, size_t count)
+{
+    return test_util_connect_block(height, txs, count, addrindex_test_add, idx);
+}
+
+/* checks the balance, the number of unspent outputs and the history deltas of a script */
+static void addrindex_test_expect(dogecoin_addrindex* idx, const uint256 key, int64_t balance, size_t unspent, const int64_t* deltas, size_t count, dogecoin_bool* ok)
+{
+    vector* items = vector_new(8, dogecoin_free);
+    size_t i;
+    *ok = false;
+    u_assert_int_eq(dogecoin_addrindex_balance(idx, key) == balance, 1);
+    u_assert_int_eq(dogecoin_addrindex_unspent(idx, key, items), unspent);
+    vector_free(items, true);
+    items = vector_new(8, dogecoin_free);
+    u_assert_int_eq(dogecoin_addrindex_history(idx, key, items), count);
+    for (i = 0; i < count; i++) {
+        const dogecoin_addrindex_history_item* item = vector_idx(items, i);
+        u_assert_int_eq(item->delta == deltas[i], 1);
+        if (i > 0)
+            u_assert_int_eq(item->height >= ((const dogecoin_addrindex_history_item*)vector_idx(items, i - 1))->height, 1);
+    }
+    vector_free(items, true);
+    *ok = true;
+}
+
+static void addrindex_test_cleanup(const char* dir)
+{
+    DIR* d = opendir(dir);
+    struct dirent* entry;
+    char path[1024];
+    while (d && (entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        unlink(path);
+    }
+    if (d)
+        closedir(d);
+    rmdir(dir);
+}
+
+void test_addrindex()
+{
+    static const uint8_t op_return[3] = {0x6a, 0x01, 0x00};
+    const dogecoin_chainparams* chain = &dogecoin_chainparams_regtest;
+    uint8_t p2pkh[25] = {0x76, 0xa9, 0x14, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 0x88, 0xac};
+    uint8_t p2sh[23] = {0xa9, 0x14, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 0x87};
+    uint8_t chained_p2sh[23] = {0xa9, 0x14, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 0x87};
+    const int64_t a_deltas[] = {1000000, -400000, 0, 50};
+    const int64_t c_deltas[] = {400000};
+    uint256 key_a, key_c, key_d, key_none, addr_key, cb1, spend, chain_txids[3];
+    vector* items;
+    int64_t amount;
+    size_t i;
+    int pass;
+    char dir[] = "/tmp/dogecoin_addrindexXXXXXX";
+    char address[64];
+    dogecoin_addrindex* idx;
+    dogecoin_tx* txs[3];
+    dogecoin_bool ok = false;
+    uint32_t height;
+
+    u_assert_int_eq(mkdtemp(dir) != NULL, 1);
+    idx = dogecoin_addrindex_open(chain, dir);
+    u_assert_int_eq(idx != NULL, 1);
+    u_assert_int_eq(idx->height, -1);
+    dogecoin_addrindex_script_hash(p2pkh, sizeof(p2pkh), key_a);
+    dogecoin_addrindex_script_hash(p2sh, sizeof(p2sh), key_c);
+    memset(key_none, 0x5a, sizeof(key_none));
+
+    /* addresses map to the hash of their output script */
+    u_assert_int_eq(dogecoin_p2pkh_addr_from_hash160(p2pkh + 3, chain, address, sizeof(address)), true);
+    u_assert_int_eq(dogecoin_addrindex_address_hash(chain, address, addr_key), true);
+    u_assert_mem_eq(addr_key, key_a, DOGECOIN_HASH_LENGTH);
+    u_assert_int_eq(dogecoin_addrindex_address_hash(&dogecoin_chainparams_main, address, addr_key), false);
+    u_assert_int_eq(dogecoin_p2sh_addr_from_hash160(p2sh + 2, chain, address, sizeof(address)), true);
+    u_assert_int_eq(dogecoin_addrindex_address_hash(chain, address, addr_key), true);
+    u_assert_mem_eq(addr_key, key_c, DOGECOIN_HASH_LENGTH);
+    u_assert_int_eq(dogecoin_addrindex_address_hash(chain, "notanaddress", addr_key), false);
+
+    /* the genesis outputs are never indexed */
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 5000, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(addrindex_test_block(idx, 0, txs, 1), true);
+    u_assert_int_eq(dogecoin_addrindex_balance(idx, key_a), 0);
+
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2pkh, sizeof(p2pkh));
+    test_util_add_out(txs[0], 0, op_return, sizeof(op_return));
+    dogecoin_tx_hash(txs[0], cb1);
+    u_assert_int_eq(addrindex_test_block(idx, 1, txs, 1), true);
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(addrindex_test_block(idx, 3, txs, 1), false);
+
+    /* spend the coinbase, change goes back to the same script */
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2sh + 1, sizeof(p2sh) - 1);
+    txs[1] = test_util_tx(cb1, 0);
+    test_util_add_out(txs[1], 600000, p2pkh, sizeof(p2pkh));
+    test_util_add_out(txs[1], 400000, p2sh, sizeof(p2sh));
+    dogecoin_tx_hash(txs[1], spend);
+    u_assert_int_eq(addrindex_test_block(idx, 2, txs, 2), true);
+
+    /* answered from the buffered rows, then from segments */
+    addrindex_test_expect(idx, key_a, 600000, 1, a_deltas, 2, &ok);
+    u_assert_int_eq(ok, true);
+    u_assert_int_eq(dogecoin_addrindex_flush(idx), true);
+    addrindex_test_expect(idx, key_a, 600000, 1, a_deltas, 2, &ok);
+    u_assert_int_eq(ok, true);
+    addrindex_test_expect(idx, key_c, 400000, 1, c_deltas, 1, &ok);
+    u_assert_int_eq(ok, true);
+    addrindex_test_expect(idx, key_none, 0, 0, NULL, 0, &ok);
+    u_assert_int_eq(ok, true);
+
+    /* a self spend, its history entry nets to zero */
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2sh + 1, sizeof(p2sh) - 1);
+    txs[1] = test_util_tx(spend, 0);
+    test_util_add_out(txs[1], 600000, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(addrindex_test_block(idx, 3, txs, 2), true);
+    addrindex_test_expect(idx, key_a, 600000, 1, a_deltas, 3, &ok);
+    u_assert_int_eq(ok, true);
+
+    /* unflushed blocks are lost on reopen, another chain is rejected */
+    dogecoin_addrindex_free(idx);
+    u_assert_int_eq(dogecoin_addrindex_open(&dogecoin_chainparams_main, dir) == NULL, 1);
+    idx = dogecoin_addrindex_open(chain, dir);
+    u_assert_int_eq(idx != NULL, 1);
+    u_assert_int_eq(idx->height, 2);
+    addrindex_test_expect(idx, key_a, 600000, 1, a_deltas, 2, &ok);
+    u_assert_int_eq(ok, true);
+
+    /* one flush per block, the segments are merged as they pile up */
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2sh + 1, sizeof(p2sh) - 1);
+    txs[1] = test_util_tx(spend, 0);
+    test_util_add_out(txs[1], 600000, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(addrindex_test_block(idx, 3, txs, 2), true);
+    u_assert_int_eq(dogecoin_addrindex_flush(idx), true);
+    for (height = 4; height < 40; height++) {
+        txs[0] = test_util_tx(NULL, 0);
+        test_util_add_out(txs[0], 1000000, p2sh + 1, sizeof(p2sh) - 1);
+        if (height == 20)
+            test_util_add_out(txs[0], 50, p2pkh, sizeof(p2pkh));
+        u_assert_int_eq(addrindex_test_block(idx, height, txs, 1), true);
+        u_assert_int_eq(dogecoin_addrindex_flush(idx), true);
+    }
+    addrindex_test_expect(idx, key_a, 600050, 2, a_deltas, 4, &ok);
+    u_assert_int_eq(ok, true);
+    u_assert_int_eq(dogecoin_addrindex_compact(idx), true);
+    addrindex_test_expect(idx, key_a, 600050, 2, a_deltas, 4, &ok);
+    u_assert_int_eq(ok, true);
+    addrindex_test_expect(idx, key_c, 400000, 1, c_deltas, 1, &ok);
+    u_assert_int_eq(ok, true);
+
+    dogecoin_addrindex_free(idx);
+    idx = dogecoin_addrindex_open(chain, dir);
+    u_assert_int_eq(idx->height, 39);
+    addrindex_test_expect(idx, key_a, 600050, 2, a_deltas, 4, &ok);
+    u_assert_int_eq(ok, true);
+
+    /* a chain of spends within one block keeps the block order, even if the txids sort the other way */
+    dogecoin_addrindex_script_hash(chained_p2sh, sizeof(chained_p2sh), key_d);
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000, chained_p2sh, sizeof(chained_p2sh));
+    dogecoin_tx_hash(txs[0], chain_txids[0]);
+    txs[1] = test_util_tx(chain_txids[0], 0);
+    test_util_add_out(txs[1], 900, chained_p2sh, sizeof(chained_p2sh));
+    dogecoin_tx_hash(txs[1], chain_txids[1]);
+    for (amount = 800;; amount--) {
+        txs[2] = test_util_tx(chain_txids[1], 0);
+        test_util_add_out(txs[2], amount, chained_p2sh, sizeof(chained_p2sh));
+        dogecoin_tx_hash(txs[2], chain_txids[2]);
+        if (memcmp(chain_txids[2], chain_txids[1], DOGECOIN_HASH_LENGTH) < 0)
+            break;
+        dogecoin_tx_free(txs[2]);
+    }
+    u_assert_int_eq(addrindex_test_block(idx, 40, txs, 3), true);
+    /* answered from the buffered rows, then from a segment */
+    for (pass = 0; pass < 2; pass++) {
+        items = vector_new(4, dogecoin_free);
+        u_assert_int_eq(dogecoin_addrindex_history(idx, key_d, items), 3);
+        for (i = 0; i < 3; i++) {
+            const dogecoin_addrindex_history_item* item = vector_idx(items, i);
+            u_assert_mem_eq(item->txid, chain_txids[i], DOGECOIN_HASH_LENGTH);
+            u_assert_int_eq(item->height, 40);
+            u_assert_int_eq(item->tx_pos, i);
+        }
+        vector_free(items, true);
+        u_assert_int_eq(dogecoin_addrindex_flush(idx), true);
+    }
+    u_assert_int_eq(dogecoin_addrindex_balance(idx, key_d) == amount, 1);
+    dogecoin_addrindex_free(idx);
+    addrindex_test_cleanup(dir);
+}
@@ -0,0 +1,229 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <event2/util.h>
+
+#include <dogecoin/addrman.h>
+#include <dogecoin/net.h>
+#include <dogecoin/utils.h>
+
+#include "utest.h"
+
+static void addrman_test_sockaddr(struct sockaddr* sa, const char* ipport)
+{
+    int len = (int)sizeof(*sa);
+    memset(sa, 0, sizeof(*sa));
+    evutil_parse_sockaddr_port(ipport, sa, &len);
+}
+
+void test_addrman()
+{
+    const uint64_t now = 1700000000;
+    char path[] = "/tmp/dogecoin_addrmanXXXXXX";
+    struct sockaddr fast, slow, flaky, unknown;
+    dogecoin_addrman_entry entries[8];
+    dogecoin_addrman_entry entry;
+
+    int fd = mkstemp(path);
+    u_assert_int_eq(fd >= 0, 1);
+    close(fd);
+    unlink(path);
+
+    /* ports are the only big endian field of an address */
+    dogecoin_p2p_address p2p_addr;
+    dogecoin_p2p_address_init(&p2p_addr);
+    p2p_addr.port = 22556;
+    cstring* ser = cstr_new_sz(32);
+    dogecoin_p2p_ser_addr(0, &p2p_addr, ser);
+    u_assert_int_eq((unsigned char)ser->str[ser->len - 2], 0x58);
+    u_assert_int_eq((unsigned char)ser->str[ser->len - 1], 0x1c);
+    cstr_free(ser, true);
+
+    dogecoin_addrman* addrman = dogecoin_addrman_new(&dogecoin_chainparams_main);
+    addrman_test_sockaddr(&fast, "10.0.0.1:22556");
+    addrman_test_sockaddr(&slow, "10.0.0.2:22556");
+    addrman_test_sockaddr(&flaky, "10.0.0.3:22556");
+    addrman_test_sockaddr(&unknown, "10.0.0.4:22556");
+    u_assert_int_eq(dogecoin_addrman_add_sockaddr(addrman, &slow, DOGECOIN_NODE_NETWORK, now), true);
+    u_assert_int_eq(dogecoin_addrman_add_sockaddr(addrman, &fast, DOGECOIN_NODE_NETWORK, now), true);
+    u_assert_int_eq(dogecoin_addrman_add_sockaddr(addrman, &flaky, DOGECOIN_NODE_NETWORK, now), true);
+    u_assert_int_eq(dogecoin_addrman_add_sockaddr(addrman, &fast, DOGECOIN_NODE_NETWORK, now + 1), false);
+    dogecoin_p2p_address_init(&p2p_addr);
+    u_assert_int_eq(dogecoin_addrman_add(addrman, &p2p_addr), false);
+    u_assert_int_eq(dogecoin_addrman_size(addrman), 3);
+    u_assert_int_eq(dogecoin_addrman_get(addrman, &fast, &entry), true);
+    u_assert_int_eq(entry.addr.time, now + 1);
+    u_assert_int_eq(dogecoin_addrman_get(addrman, &unknown, &entry), false);
+
+    /* fast answers quickly, slow takes its time, flaky fails twice */
+    dogecoin_addrman_attempt(addrman, &fast, now);
+    dogecoin_addrman_good(addrman, &fast, 40, now);
+    dogecoin_addrman_ping(addrman, &fast, 20);
+    dogecoin_addrman_attempt(addrman, &slow, now);
+    dogecoin_addrman_good(addrman, &slow, 900, now);
+    dogecoin_addrman_ping(addrman, &slow, 400);
+    dogecoin_addrman_ping(addrman, &slow, 800);
+    dogecoin_addrman_attempt(addrman, &flaky, now);
+    dogecoin_addrman_failed(addrman, &flaky);
+    dogecoin_addrman_attempt(addrman, &flaky, now + 60);
+    dogecoin_addrman_failed(addrman, &flaky);
+    dogecoin_addrman_attempt(addrman, &unknown, now);
+
+    u_assert_int_eq(dogecoin_addrman_get(addrman, &slow, &entry), true);
+    u_assert_int_eq(entry.successes, 1);
+    u_assert_int_eq(entry.attempts, 0);
+    u_assert_int_eq(entry.handshake_ms, 900);
+    u_assert_int_eq(entry.ping_ms, 500);
+
+    /* flaky waits two minutes after its second failure */
+    u_assert_int_eq(dogecoin_addrman_select(addrman, now + 61, entries, 8), 2);
+    u_assert_mem_eq(entries[0].addr.ip + 12, &((struct sockaddr_in*)&fast)->sin_addr, 4);
+    u_assert_mem_eq(entries[1].addr.ip + 12, &((struct sockaddr_in*)&slow)->sin_addr, 4);
+    u_assert_int_eq(dogecoin_addrman_select(addrman, now + 180, entries, 8), 3);
+    u_assert_mem_eq(entries[2].addr.ip + 12, &((struct sockaddr_in*)&flaky)->sin_addr, 4);
+    u_assert_int_eq(dogecoin_addrman_select(addrman, now + 180, entries, 1), 1);
+
+    /* a group picks its peers in the same order, flaky's backoff passed long ago */
+    dogecoin_node_group* group = dogecoin_node_group_new(NULL);
+    group->desired_amount_connected_nodes = 1;
+    group->addrman = addrman;
+    u_assert_int_eq(dogecoin_node_group_add_peers_by_ip_or_seed(group, NULL), true);
+    u_assert_int_eq(group->nodes->len, 3);
+    dogecoin_node* node = vector_idx(group->nodes, 0);
+    u_assert_mem_eq(&((struct sockaddr_in*)&node->addr)->sin_addr, &((struct sockaddr_in*)&fast)->sin_addr, 4);
+    u_assert_int_eq(dogecoin_node_group_add_peers_from_addrman(group), 0);
+    dogecoin_node_group_free(group);
+
+    u_assert_int_eq(dogecoin_addrman_load(addrman, path), false);
+    u_assert_int_eq(dogecoin_addrman_save(addrman, path), true);
+    dogecoin_addrman_free(addrman);
+
+    addrman = dogecoin_addrman_new(&dogecoin_chainparams_main);
+    u_assert_int_eq(dogecoin_addrman_load(addrman, path), true);
+    u_assert_int_eq(dogecoin_addrman_size(addrman), 3);
+    u_assert_int_eq(dogecoin_addrman_get(addrman, &flaky, &entry), true);
+    u_assert_int_eq(entry.failures, 2);
+    u_assert_int_eq(entry.attempts, 2);
+    u_assert_int_eq(entry.last_try, now + 60);
+    u_assert_int_eq(dogecoin_addrman_get(addrman, &fast, &entry), true);
+    u_assert_int_eq(entry.handshake_ms, 40);
+    u_assert_int_eq(entry.ping_ms, 20);
+    u_assert_int_eq(entry.addr.port, 22556);
+    dogecoin_addrman_free(addrman);
+
+    /* another chain's file is refused */
+    addrman = dogecoin_addrman_new(&dogecoin_chainparams_test);
+    u_assert_int_eq(dogecoin_addrman_load(addrman, path), false);
+    u_assert_int_eq(dogecoin_addrman_size(addrman), 0);
+    dogecoin_addrman_free(addrman);
+
+    /* as is a damaged one */
+    FILE* file = fopen(path, "r+b");
+    u_assert_int_eq(file != NULL, 1);
+    fseek(file, 20, SEEK_SET);
+    fputc(0x42, file);
+    fclose(file);
+    addrman = dogecoin_addrman_new(&dogecoin_chainparams_main);
+    u_assert_int_eq(dogecoin_addrman_load(addrman, path), false);
+    dogecoin_addrman_free(addrman);
+    unlink(path);
+}
+
+/* feeds an addr message announcing count addresses 10.2.x.y from first on */
+static dogecoin_bool addrman_test_feed_addr(dogecoin_node* node, uint32_t first, uint32_t count, uint32_t time)
+{
+    uint32_t i;
+    cstring* payload = cstr_new_sz(count * 30 + 3);
+    ser_varlen(payload, count);
+    for (i = first; i < first + count; i++) {
+        dogecoin_p2p_address addr;
+        dogecoin_p2p_address_init(&addr);
+        addr.ip[10] = addr.ip[11] = 0xff;
+        addr.ip[12] = 10;
+        addr.ip[13] = 2;
+        addr.ip[14] = (uint8_t)(i >> 8);
+        addr.ip[15] = (uint8_t)i;
+        addr.port = 22556;
+        addr.services = DOGECOIN_NODE_NETWORK;
+        addr.time = time;
+        dogecoin_p2p_ser_addr(DOGECOIN_PROTOCOL_VERSION, &addr, payload);
+    }
+    cstring* msg = dogecoin_p2p_message_new(node->nodegroup->chainparams->netmagic, DOGECOIN_MSG_ADDR, payload->str, payload->len);
+    struct const_buffer buf = {msg->str, msg->len};
+    dogecoin_p2p_msg_hdr hdr;
+    dogecoin_p2p_deser_msghdr(&hdr, &buf);
+    dogecoin_bool ok = dogecoin_node_parse_message(node, &hdr, &buf);
+    cstr_free(msg, true);
+    cstr_free(payload, true);
+    return ok;
+}
+
+void test_addrman_flood()
+{
+    const uint64_t now = time(NULL);
+    struct sockaddr honest, future, known;
+    dogecoin_addrman_entry entries[2];
+    dogecoin_addrman_entry entry;
+    uint32_t i;
+
+    dogecoin_addrman* addrman = dogecoin_addrman_new(&dogecoin_chainparams_main);
+    dogecoin_node_group* group = dogecoin_node_group_new(NULL);
+    group->addrman = addrman;
+    dogecoin_node* node = dogecoin_node_new();
+    u_assert_int_eq(dogecoin_node_set_ipport(node, "10.1.0.1:22556"), true);
+    dogecoin_node_group_add_node(group, node);
+
+    /* a time an hour ahead counts as five days old and sorts last */
+    u_assert_int_eq(addrman_test_feed_addr(node, 1, 1, (uint32_t)now + 3600), true);
+    u_assert_int_eq(addrman_test_feed_addr(node, 2, 1, (uint32_t)now - 60), true);
+    addrman_test_sockaddr(&future, "10.2.0.1:22556");
+    addrman_test_sockaddr(&honest, "10.2.0.2:22556");
+    u_assert_int_eq(dogecoin_addrman_get(addrman, &future, &entry), true);
+    u_assert_int_eq(entry.addr.time <= now - 5 * 24 * 60 * 60, 1);
+    u_assert_int_eq(dogecoin_addrman_select(addrman, now, entries, 2), 2);
+    u_assert_mem_eq(entries[0].addr.ip + 12, &((struct sockaddr_in*)&honest)->sin_addr, 4);
+
+    /* one peer fills no more than its share of the store */
+    for (i = 0; i < 4; i++)
+        u_assert_int_eq(addrman_test_feed_addr(node, 3 + i * DOGECOIN_ADDRMAN_MAX_ADDR_SZ, DOGECOIN_ADDRMAN_MAX_ADDR_SZ, (uint32_t)now), true);
+    u_assert_int_eq(dogecoin_addrman_size(addrman), DOGECOIN_ADDRMAN_MAX_PER_SOURCE);
+
+    /* a full store makes room by evicting untried addresses, not working ones */
+    for (i = 0; dogecoin_addrman_size(addrman) < DOGECOIN_ADDRMAN_MAX_ENTRIES; i++) {
+        dogecoin_p2p_address addr;
+        dogecoin_p2p_address_init(&addr);
+        addr.ip[10] = addr.ip[11] = 0xff;
+        addr.ip[12] = 10;
+        addr.ip[13] = 3;
+        addr.ip[14] = (uint8_t)(i >> 8);
+        addr.ip[15] = (uint8_t)i;
+        addr.port = 22556;
+        addr.time = (uint32_t)now - 3600;
+        dogecoin_addrman_add(addrman, &addr);
+    }
+    addrman_test_sockaddr(&known, "10.3.0.0:22556");
+    dogecoin_addrman_attempt(addrman, &known, now);
+    dogecoin_addrman_good(addrman, &known, 100, now);
+    dogecoin_node* other = dogecoin_node_new();
+    u_assert_int_eq(dogecoin_node_set_ipport(other, "10.1.0.2:22556"), true);
+    dogecoin_node_group_add_node(group, other);
+    u_assert_int_eq(addrman_test_feed_addr(other, 60000, 100, (uint32_t)now), true);
+    u_assert_int_eq(dogecoin_addrman_size(addrman), DOGECOIN_ADDRMAN_MAX_ENTRIES);
+    addrman_test_sockaddr(&honest, "10.2.234.159:22556");
+    u_assert_int_eq(dogecoin_addrman_get(addrman, &honest, &entry), true);
+    u_assert_int_eq(dogecoin_addrman_get(addrman, &known, &entry), true);
+    /* the future dated address was the worst and is gone */
+    u_assert_int_eq(dogecoin_addrman_get(addrman, &future, &entry), false);
+
+    dogecoin_node_group_free(group);
+    dogecoin_addrman_free(addrman);
+}
@@ -12,12 +12,15 @@
 #include <assert.h>
 
 #include <dogecoin/block.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/tx.h>
 
 #include <dogecoin/cstr.h>
 #include <dogecoin/key.h>
 #include <dogecoin/mem.h>
 #include <dogecoin/utils.h>
 
+#include "test_util.h"
 #include "utest.h"
 
 struct blockheadertest {
@@ -156,3 +159,130 @@ void test_block_header()
     dogecoin_block_header_hash(&bheaderprev, (uint8_t *)&checkhash);
     u_assert_str_eq(utils_uint8_to_hex(bheader.prev_block, sizeof(bheader.prev_block)), utils_uint8_to_hex(checkhash, sizeof(checkhash)));
 }
+
+void test_block_auxpow()
+{
+    size_t outlen;
+    uint8_t header_data[80], parent_data[80];
+    uint256 hash, branch_hash;
+    unsigned int i;
+
+    /* 331337 is merge mined, the genesis header stands in for the parent */
+    utils_hex_to_bin(block_header_tests[1].hexheader, header_data, 160, &outlen);
+    utils_hex_to_bin(block_header_tests[0].hexheader, parent_data, 160, &outlen);
+
+    dogecoin_tx* txs[3];
+    for (i = 0; i < 3; i++) {
+        uint160 hash160;
+        memset(hash, (int)i, sizeof(hash));
+        txs[i] = test_util_tx(hash, i);
+        memset(hash160, (int)(i + 1), sizeof(hash160));
+        dogecoin_tx_add_p2pkh_hash160_out(txs[i], 100000000LL * (i + 1), hash160);
+    }
+
+    cstring* coinbase = cstr_new_sz(128);
+    dogecoin_tx_serialize(coinbase, txs[0]);
+
+    cstring* raw = cstr_new_sz(1024);
+    ser_bytes(raw, header_data, 80);
+    ser_bytes(raw, coinbase->str, coinbase->len);
+    memset(hash, 0x11, sizeof(hash));
+    ser_u256(raw, hash);
+    ser_varlen(raw, 2);
+    memset(branch_hash, 0x22, sizeof(branch_hash));
+    ser_u256(raw, branch_hash);
+    memset(branch_hash, 0x33, sizeof(branch_hash));
+    ser_u256(raw, branch_hash);
+    ser_s32(raw, 0);
+    ser_varlen(raw, 0);
+    ser_s32(raw, 0);
+    ser_bytes(raw, parent_data, 80);
+    ser_varlen(raw, 3);
+    for (i = 0; i < 3; i++)
+        dogecoin_tx_serialize(raw, txs[i]);
+
+    /* zero-copy view */
+    dogecoin_block_view view;
+    struct const_buffer buf = {raw->str, raw->len};
+    u_assert_int_eq(dogecoin_block_view_parse(&view, &buf), true);
+    u_assert_int_eq(view.has_auxpow, true);
+    u_assert_int_eq(dogecoin_block_header_chain_id(&view.header), DOGECOIN_AUXPOW_CHAIN_ID);
+    u_assert_int_eq(view.auxpow.coinbase_tx.len, coinbase->len);
+    u_assert_mem_eq(view.auxpow.coinbase_tx.p, coinbase->str, coinbase->len);
+    u_assert_int_eq(view.auxpow.coinbase_branch_len, 2);
+    u_assert_int_eq(view.auxpow.coinbase_branch[32], 0x33);
+    u_assert_int_eq(view.auxpow.chain_branch_len, 0);
+    u_assert_mem_eq(view.auxpow.parent_header, parent_data, 80);
+    u_assert_int_eq(view.tx_count, 3);
+    u_assert_int_eq(view.tx_offsets == NULL, 1);
+
+    for (i = 0; i < 3; i++) {
+        uint256 expected;
+        dogecoin_tx_hash(txs[i], expected);
+        u_assert_int_eq(dogecoin_block_view_tx_hash(&view, i, hash), true);
+        u_assert_mem_eq(hash, expected, sizeof(hash));
+    }
+    size_t txs_size = 0;
+    u_assert_int_eq(dogecoin_block_view_index(&view, &txs_size), true);
+    u_assert_int_eq(txs_size, view.txs.len);
+
+    dogecoin_tx* decoded = dogecoin_tx_new();
+    u_assert_int_eq(dogecoin_block_view_tx(&view, 2, decoded), true);
+    u_assert_int_eq(dogecoin_tx_vin(decoded, 0)->prevout.n, 2);
+    u_assert_int_eq(dogecoin_tx_vout(decoded, 0)->value, 300000000LL);
+    dogecoin_tx_free(decoded);
+    decoded = dogecoin_tx_new();
+    u_assert_int_eq(dogecoin_block_view_tx(&view, 3, decoded), false);
+    dogecoin_tx_free(decoded);
+    dogecoin_block_view_free(&view);
+
+    /* full materialization gives the same result */
+    dogecoin_block* block = dogecoin_block_new();
+    buf.p = raw->str;
+    buf.len = raw->len;
+    u_assert_int_eq(dogecoin_block_deserialize(block, &buf), true);
+    u_assert_int_eq(buf.len, 0);
+    u_assert_int_eq(block->auxpow != NULL, 1);
+    u_assert_int_eq(block->auxpow->coinbase_branch->len, 2);
+    u_assert_int_eq(((uint8_t*)vector_idx(block->auxpow->coinbase_branch, 1))[0], 0x33);
+    u_assert_int_eq(block->auxpow->parent_header.nonce, 99943);
+    u_assert_int_eq(dogecoin_tx_vin(block->auxpow->coinbase_tx, 0)->prevout.n, 0);
+    u_assert_int_eq(block->txs->len, 3);
+    u_assert_int_eq(dogecoin_tx_vout((dogecoin_tx*)vector_idx(block->txs, 1), 0)->value, 200000000LL);
+    dogecoin_block_free(block);
+
+    /* truncated blocks are rejected */
+    for (outlen = 0; outlen < raw->len; outlen += 7) {
+        buf.p = raw->str;
+        buf.len = outlen;
+        if (dogecoin_block_view_parse(&view, &buf)) {
+            u_assert_int_eq(dogecoin_block_view_index(&view, NULL), false);
+            dogecoin_block_view_free(&view);
+        }
+        block = dogecoin_block_new();
+        buf.p = raw->str;
+        buf.len = outlen;
+        u_assert_int_eq(dogecoin_block_deserialize(block, &buf), false);
+        dogecoin_block_free(block);
+    }
+
+    /* a pre-auxpow block: header, count, transactions */
+    cstr_resize(raw, 0);
+    ser_bytes(raw, parent_data, 80);
+    ser_varlen(raw, 1);
+    dogecoin_tx_serialize(raw, txs[1]);
+    buf.p = raw->str;
+    buf.len = raw->len;
+    u_assert_int_eq(dogecoin_block_view_parse(&view, &buf), true);
+    u_assert_int_eq(view.has_auxpow, false);
+    u_assert_int_eq(view.tx_count, 1);
+    struct const_buffer txraw;
+    u_assert_int_eq(dogecoin_block_view_tx_raw(&view, 0, &txraw), true);
+    u_assert_int_eq(txraw.len, raw->len - 81);
+    dogecoin_block_view_free(&view);
+
+    for (i = 0; i < 3; i++)
+        dogecoin_tx_free(txs[i]);
+    cstr_free(coinbase, true);
+    cstr_free(raw, true);
+}
@@ -0,0 +1,173 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <dogecoin/blockfile.h>
+#include <dogecoin/chainparams.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/tx.h>
+#include <dogecoin/utils.h>
+
+#include "test_util.h"
+#include "utest.h"
+
+#define BLOCKFILE_TEST_HEIGHT 6
+
+struct blockfile_test_ctx {
+    uint256 hashes[BLOCKFILE_TEST_HEIGHT];
+    uint32_t next_height;
+    uint32_t stop_at;
+    dogecoin_bool in_order;
+};
+
+static dogecoin_bool blockfile_test_cb(dogecoin_blockfile_block* block, void* ctx)
+{
+    struct blockfile_test_ctx* test = ctx;
+    if (block->height != test->next_height || memcmp(block->hash, test->hashes[block->height], DOGECOIN_HASH_LENGTH) != 0)
+        test->in_order = false;
+    if (block->view.tx_count != 1)
+        test->in_order = false;
+    if (block->block && dogecoin_tx_vin((dogecoin_tx*)vector_idx(block->block->txs, 0), 0)->prevout.n != block->height)
+        test->in_order = false;
+    test->next_height++;
+    return block->height != test->stop_at;
+}
+
+/* appends a record holding a one transaction block to the file */
+static void blockfile_test_write(FILE* file, const dogecoin_chainparams* chain, dogecoin_block_header* header, uint32_t n, uint256 hash_out)
+{
+    static const uint256 prev_hash = {0};
+    dogecoin_tx* tx = test_util_tx(prev_hash, n);
+    uint160 hash160;
+
+    memset(hash160, 0x42, sizeof(hash160));
+    dogecoin_tx_add_p2pkh_hash160_out(tx, 1000, hash160);
+    cstring* block = test_util_block(header, &tx, 1, hash_out);
+
+    cstring* record = cstr_new_sz(block->len + 8);
+    ser_bytes(record, chain->netmagic, 4);
+    ser_u32(record, (uint32_t)block->len);
+    ser_bytes(record, block->str, block->len);
+    fwrite(record->str, 1, record->len, file);
+
+    cstr_free(record, true);
+    cstr_free(block, true);
+}
+
+void test_blockfile_scan()
+{
+    const dogecoin_chainparams* chain = &dogecoin_chainparams_main;
+    struct blockfile_test_ctx ctx;
+    dogecoin_block_header headers[BLOCKFILE_TEST_HEIGHT], fork, orphan, heavy;
+    uint256 fork_hash, orphan_hash;
+    char dir[] = "/tmp/dogecoin_blockfileXXXXXX";
+    char path0[64], path1[64], path2[64];
+    unsigned int i;
+    uint32_t delivered = 0;
+
+    u_assert_int_eq(mkdtemp(dir) != NULL, 1);
+    snprintf(path0, sizeof(path0), "%s/blk00000.dat", dir);
+    snprintf(path1, sizeof(path1), "%s/blk00001.dat", dir);
+    snprintf(path2, sizeof(path2), "%s/blk00002.dat", dir);
+
+    dogecoin_mem_zero(&ctx, sizeof(ctx));
+    dogecoin_mem_zero(headers, sizeof(headers));
+    for (i = 0; i < BLOCKFILE_TEST_HEIGHT; i++) {
+        headers[i].version = 1;
+        headers[i].timestamp = 1386325540 + i * 60;
+        headers[i].bits = 0x1e0ffff0;
+        headers[i].nonce = i;
+        if (i > 0)
+            dogecoin_block_header_hash(&headers[i - 1], headers[i].prev_block);
+    }
+    fork = headers[3];
+    fork.nonce = 1000;
+    orphan = headers[1];
+    memset(orphan.prev_block, 0x77, sizeof(orphan.prev_block));
+
+    /* blocks are stored out of order, with a stale fork, an orphan and padding */
+    FILE* file = fopen(path0, "wb");
+    blockfile_test_write(file, chain, &headers[0], 0, ctx.hashes[0]);
+    blockfile_test_write(file, chain, &headers[2], 2, ctx.hashes[2]);
+    blockfile_test_write(file, chain, &headers[1], 1, ctx.hashes[1]);
+    for (i = 0; i < 100; i++)
+        fputc(0, file);
+    fclose(file);
+    file = fopen(path1, "wb");
+    fputs("garbage", file);
+    blockfile_test_write(file, chain, &headers[4], 4, ctx.hashes[4]);
+    blockfile_test_write(file, chain, &fork, 3, fork_hash);
+    blockfile_test_write(file, chain, &headers[3], 3, ctx.hashes[3]);
+    blockfile_test_write(file, chain, &orphan, 1, orphan_hash);
+    blockfile_test_write(file, chain, &headers[5], 5, ctx.hashes[5]);
+    fclose(file);
+
+    dogecoin_blockfile_scan_params params;
+    dogecoin_blockfile_scan_params_init(&params, chain);
+    params.blocks_dir = dir;
+    params.cb = blockfile_test_cb;
+    params.ctx = &ctx;
+    params.threads = 3;
+    params.window = 2;
+    params.decode_txs = true;
+
+    /* parallel decoding, delivered in chain order */
+    ctx.in_order = true;
+    ctx.stop_at = UINT32_MAX;
+    u_assert_int_eq(dogecoin_blockfile_scan(&params, &delivered), true);
+    u_assert_int_eq(delivered, BLOCKFILE_TEST_HEIGHT);
+    u_assert_int_eq(ctx.next_height, BLOCKFILE_TEST_HEIGHT);
+    u_assert_int_eq(ctx.in_order, true);
+
+    /* single threaded, stopped by the callback */
+    ctx.next_height = 0;
+    ctx.stop_at = 2;
+    params.threads = 1;
+    params.decode_txs = false;
+    u_assert_int_eq(dogecoin_blockfile_scan(&params, &delivered), true);
+    u_assert_int_eq(delivered, 3);
+    u_assert_int_eq(ctx.in_order, true);
+
+    /* stop while workers are decoding ahead */
+    ctx.next_height = 0;
+    ctx.stop_at = 0;
+    params.threads = 4;
+    params.window = 8;
+    u_assert_int_eq(dogecoin_blockfile_scan(&params, &delivered), true);
+    u_assert_int_eq(delivered, 1);
+
+    /* the default directory is derived from the datadir */
+    cstring* path = cstr_new_sz(64);
+    dogecoin_blockfile_default_dir(&dogecoin_chainparams_test, path);
+    u_assert_int_eq(strstr(path->str, "/testnet3/blocks") != NULL, 1);
+    cstr_free(path, true);
+
+    /* a shorter fork with more work becomes the best chain */
+    heavy = headers[3];
+    heavy.bits = 0x1d00ffff;
+    file = fopen(path2, "wb");
+    blockfile_test_write(file, chain, &heavy, 3, ctx.hashes[3]);
+    fclose(file);
+    ctx.next_height = 0;
+    ctx.stop_at = UINT32_MAX;
+    params.threads = 2;
+    u_assert_int_eq(dogecoin_blockfile_scan(&params, &delivered), true);
+    u_assert_int_eq(delivered, 4);
+    u_assert_int_eq(ctx.in_order, true);
+
+    params.blocks_dir = "/nonexistent";
+    u_assert_int_eq(dogecoin_blockfile_scan(&params, &delivered), false);
+
+    unlink(path0);
+    unlink(path1);
+    unlink(path2);
+    rmdir(dir);
+}
@@ -0,0 +1,152 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <string.h>
+
+#include <dogecoin/block.h>
+#include <dogecoin/blockfilter.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/tx.h>
+#include <dogecoin/utils.h>
+
+#include "test_util.h"
+#include "utest.h"
+
+#define BLOCKFILTER_TEST_SCRIPTS 200
+
+/* the output of the spent coinbase is not in the block, the callback knows it */
+static dogecoin_bool blockfilter_test_prevout(const uint256 txid, uint32_t vout, cstring* script, void* ctx)
+{
+    const uint8_t* known = ctx;
+    if (vout != 0 || memcmp(txid, known, DOGECOIN_HASH_LENGTH) != 0)
+        return false;
+    cstr_append_buf(script, "\x51\x52\x53", 3);
+    return true;
+}
+
+void test_blockfilter()
+{
+    static const char* genesis_script = "4104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac";
+    unsigned char data[128], scripts[BLOCKFILTER_TEST_SCRIPTS][8];
+    struct const_buffer elements[BLOCKFILTER_TEST_SCRIPTS + 1], query[4];
+    uint8_t matched[BLOCKFILTER_TEST_SCRIPTS + 1];
+    uint256 block_hash, header, expected, prev_txid, txid;
+    dogecoin_blockfilter* filter = dogecoin_blockfilter_new();
+    dogecoin_blockfilter* copy = dogecoin_blockfilter_new();
+    dogecoin_block_header block_header;
+    dogecoin_block_view view;
+    dogecoin_tx* txs[3];
+    cstring* s;
+    struct const_buffer buf;
+    char hex[256];
+    size_t len, i;
+
+    /* SipHash-2-4 reference vectors, key 00..0f */
+    for (i = 0; i < 15; i++)
+        data[i] = (unsigned char)i;
+    u_assert_int_eq(dogecoin_siphash(0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL, data, 0) == 0x726fdb47dd0e0e31ULL, 1);
+    u_assert_int_eq(dogecoin_siphash(0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL, data, 15) == 0xa129ca6149be45e5ULL, 1);
+
+    /* BIP158 test vector: the genesis block of bitcoin's testnet */
+    utils_uint256_sethex("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943", block_hash);
+    utils_hex_to_bin(genesis_script, data, strlen(genesis_script), &len);
+    elements[0].p = data;
+    elements[0].len = len;
+    u_assert_int_eq(dogecoin_blockfilter_build(filter, block_hash, elements, 1), true);
+    utils_bin_to_hex((unsigned char*)filter->encoded->str, filter->encoded->len, hex);
+    u_assert_str_eq(hex, "019dfca8");
+    dogecoin_mem_zero(header, sizeof(header));
+    dogecoin_blockfilter_header(filter, header, header);
+    utils_uint256_sethex("21584579b7eb08997773e5aeff3a7f932700042d0ed2a6129012b7d7ae81b750", expected);
+    u_assert_mem_eq(header, expected, 32);
+    u_assert_int_eq(dogecoin_blockfilter_match(filter, elements, 1, NULL), 1);
+
+    /* an empty filter is just its element count */
+    u_assert_int_eq(dogecoin_blockfilter_build(filter, block_hash, NULL, 0), true);
+    u_assert_int_eq(filter->encoded->len, 1);
+    u_assert_int_eq(dogecoin_blockfilter_match(filter, elements, 1, NULL), 0);
+
+    /* every other script goes into the filter, duplicates are counted once */
+    for (i = 0; i < BLOCKFILTER_TEST_SCRIPTS; i++) {
+        memset(scripts[i], 0, 8);
+        memcpy(scripts[i], &i, sizeof(uint32_t));
+        scripts[i][7] = 0xab;
+        elements[i].p = scripts[i];
+        elements[i].len = 8;
+    }
+    for (i = 0; i < BLOCKFILTER_TEST_SCRIPTS / 2; i++)
+        elements[i] = elements[2 * i];
+    elements[BLOCKFILTER_TEST_SCRIPTS / 2] = elements[0];
+    u_assert_int_eq(dogecoin_blockfilter_build(filter, block_hash, elements, BLOCKFILTER_TEST_SCRIPTS / 2 + 1), true);
+    u_assert_int_eq(filter->n, BLOCKFILTER_TEST_SCRIPTS / 2);
+    for (i = 0; i < BLOCKFILTER_TEST_SCRIPTS; i++) {
+        elements[i].p = scripts[i];
+        elements[i].len = 8;
+    }
+    u_assert_int_eq(dogecoin_blockfilter_match(filter, elements, BLOCKFILTER_TEST_SCRIPTS, matched), BLOCKFILTER_TEST_SCRIPTS / 2);
+    for (i = 0; i < BLOCKFILTER_TEST_SCRIPTS; i++)
+        u_assert_int_eq(matched[i], i % 2 == 0);
+    u_assert_int_eq(dogecoin_blockfilter_match(filter, elements + 1, 1, NULL), 0);
+
+    /* cfilter round trip and header chaining */
+    s = cstr_new_sz(256);
+    dogecoin_blockfilter_serialize(s, filter);
+    buf.p = s->str;
+    buf.len = s->len;
+    u_assert_int_eq(dogecoin_blockfilter_deserialize(copy, &buf), true);
+    u_assert_int_eq(buf.len, 0);
+    u_assert_int_eq(copy->n, filter->n);
+    u_assert_mem_eq(copy->block_hash, block_hash, 32);
+    u_assert_int_eq(dogecoin_blockfilter_match(copy, elements, BLOCKFILTER_TEST_SCRIPTS, matched), BLOCKFILTER_TEST_SCRIPTS / 2);
+    dogecoin_blockfilter_header(copy, header, expected);
+    u_assert_int_eq(memcmp(expected, header, 32) != 0, 1);
+    buf.p = s->str;
+    buf.len = s->len - 1;
+    u_assert_int_eq(dogecoin_blockfilter_deserialize(copy, &buf), false);
+    cstr_free(s, true);
+
+    /* a block: coinbase, a spend of an outside output and a spend of the coinbase */
+    memset(prev_txid, 0x11, sizeof(prev_txid));
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000, "\x76\x01", 2);
+    dogecoin_tx_hash(txs[0], txid);
+    txs[1] = test_util_tx(prev_txid, 0);
+    test_util_add_out(txs[1], 1000, "\x6a\x01\x02", 3);
+    txs[2] = test_util_tx(txid, 0);
+    test_util_add_out(txs[2], 1000, "\x55", 1);
+    dogecoin_mem_zero(&block_header, sizeof(block_header));
+    block_header.version = 1;
+    s = test_util_block(&block_header, txs, 3, expected);
+    buf.p = s->str;
+    buf.len = s->len;
+    u_assert_int_eq(dogecoin_block_view_parse(&view, &buf), true);
+    u_assert_int_eq(dogecoin_blockfilter_build_basic(filter, &view, block_hash, blockfilter_test_prevout, prev_txid), true);
+    /* the coinbase output counts once though it is also spent, OP_RETURN is left out */
+    u_assert_int_eq(filter->n, 3);
+    query[0].p = (const unsigned char*)"\x76\x01";
+    query[0].len = 2;
+    query[1].p = (const unsigned char*)"\x51\x52\x53";
+    query[1].len = 3;
+    query[2].p = (const unsigned char*)"\x55";
+    query[2].len = 1;
+    query[3].p = (const unsigned char*)"\x6a\x01\x02";
+    query[3].len = 3;
+    u_assert_int_eq(dogecoin_blockfilter_match(filter, query, 4, matched), 3);
+    u_assert_int_eq(matched[3], 0);
+
+    /* outputs only without a callback, unknown outputs fail the build */
+    u_assert_int_eq(dogecoin_blockfilter_build_basic(filter, &view, block_hash, NULL, NULL), true);
+    u_assert_int_eq(filter->n, 2);
+    u_assert_int_eq(dogecoin_blockfilter_match(filter, query + 1, 1, NULL), 0);
+    memset(prev_txid, 0x22, sizeof(prev_txid));
+    u_assert_int_eq(dogecoin_blockfilter_build_basic(filter, &view, block_hash, blockfilter_test_prevout, prev_txid), false);
+    dogecoin_block_view_free(&view);
+    cstr_free(s, true);
+
+    dogecoin_blockfilter_free(filter);
+    dogecoin_blockfilter_free(copy);
+}
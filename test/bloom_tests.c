@@ -0,0 +1,275 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <string.h>
+
+#include <dogecoin/block.h>
+#include <dogecoin/bloom.h>
+#include <dogecoin/key.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/merkle.h>
+#include <dogecoin/script.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/tx.h>
+#include <dogecoin/utils.h>
+
+#include "utest.h"
+
+#define BLOOM_TEST_LEAVES 23
+
+struct murmur_vector {
+    uint32_t expected;
+    uint32_t seed;
+    const char* hex;
+};
+
+static const struct murmur_vector murmur_vectors[] = {
+    {0x00000000, 0x00000000, ""},
+    {0x6a396f08, 0xFBA4C795, ""},
+    {0x81f16f39, 0xffffffff, ""},
+    {0x514e28b7, 0x00000000, "00"},
+    {0xea3f0b17, 0xFBA4C795, "00"},
+    {0xfd6cf10d, 0x00000000, "ff"},
+    {0x16c6b7ab, 0x00000000, "0011"},
+    {0x8eb51c3d, 0x00000000, "001122"},
+    {0xb4471bf8, 0x00000000, "00112233"},
+    {0xe2301fa8, 0x00000000, "0011223344"},
+    {0xfc2e4a15, 0x00000000, "001122334455"},
+    {0xb074502c, 0x00000000, "00112233445566"},
+    {0x8034d2a0, 0x00000000, "0011223344556677"},
+    {0xb4698def, 0x00000000, "001122334455667788"},
+};
+
+static void bloom_test_insert_hex(dogecoin_bloom* filter, const char* hex)
+{
+    unsigned char data[64];
+    size_t len;
+    utils_hex_to_bin(hex, data, strlen(hex), &len);
+    dogecoin_bloom_insert(filter, data, len);
+}
+
+static dogecoin_bool bloom_test_contains_hex(const dogecoin_bloom* filter, const char* hex)
+{
+    unsigned char data[64];
+    size_t len;
+    utils_hex_to_bin(hex, data, strlen(hex), &len);
+    return dogecoin_bloom_contains(filter, data, len);
+}
+
+static void bloom_test_filter(uint32_t tweak, const char* expected)
+{
+    dogecoin_bloom filter, copy;
+    cstring* ser = cstr_new_sz(64);
+    struct const_buffer buf;
+    char hex[64];
+
+    u_assert_int_eq(dogecoin_bloom_init(&filter, 3, 0.01, tweak, DOGECOIN_BLOOM_UPDATE_ALL), true);
+    bloom_test_insert_hex(&filter, "99108ad8ed9bb6274d3980bab5a85c048f0950c8");
+    u_assert_int_eq(bloom_test_contains_hex(&filter, "99108ad8ed9bb6274d3980bab5a85c048f0950c8"), true);
+    u_assert_int_eq(bloom_test_contains_hex(&filter, "19108ad8ed9bb6274d3980bab5a85c048f0950c8"), false);
+    bloom_test_insert_hex(&filter, "b5a2c786d9ef4658287ced5914b37a1b4aa32eee");
+    u_assert_int_eq(bloom_test_contains_hex(&filter, "b5a2c786d9ef4658287ced5914b37a1b4aa32eee"), true);
+    bloom_test_insert_hex(&filter, "b9300670b4c5366e95b2699e8b18bc75e5f729c5");
+    u_assert_int_eq(bloom_test_contains_hex(&filter, "b9300670b4c5366e95b2699e8b18bc75e5f729c5"), true);
+
+    dogecoin_bloom_serialize(ser, &filter);
+    utils_bin_to_hex((unsigned char*)ser->str, ser->len, hex);
+    u_assert_str_eq(hex, expected);
+
+    buf.p = ser->str;
+    buf.len = ser->len;
+    u_assert_int_eq(dogecoin_bloom_deserialize(&copy, &buf), true);
+    u_assert_int_eq(buf.len, 0);
+    u_assert_int_eq(bloom_test_contains_hex(&copy, "99108ad8ed9bb6274d3980bab5a85c048f0950c8"), true);
+    u_assert_int_eq(bloom_test_contains_hex(&copy, "19108ad8ed9bb6274d3980bab5a85c048f0950c8"), false);
+    dogecoin_bloom_cleanup(&copy);
+    dogecoin_bloom_cleanup(&filter);
+    cstr_free(ser, true);
+}
+
+static void bloom_test_tx_match()
+{
+    dogecoin_key key;
+    dogecoin_pubkey pubkey;
+    uint160 hash160;
+    uint256 txid, other_txid;
+    dogecoin_bloom* filter = dogecoin_bloom_new(10, 0.000001, 5, DOGECOIN_BLOOM_UPDATE_ALL);
+    dogecoin_tx* funding = dogecoin_tx_new();
+    dogecoin_tx* spend = dogecoin_tx_new();
+    dogecoin_tx* other = dogecoin_tx_new();
+    dogecoin_tx_out* tx_out = dogecoin_tx_out_new();
+    dogecoin_tx_in* tx_in = dogecoin_tx_in_new();
+
+    dogecoin_privkey_init(&key);
+    u_assert_int_eq(dogecoin_privkey_gen(&key), true);
+    dogecoin_pubkey_init(&pubkey);
+    dogecoin_pubkey_from_key(&key, &pubkey);
+    dogecoin_pubkey_get_hash160(&pubkey, hash160);
+
+    tx_out->value = 1000;
+    tx_out->script_pubkey = cstr_new_sz(25);
+    dogecoin_script_build_p2pkh(tx_out->script_pubkey, hash160);
+    vector_add(funding->vout, tx_out);
+    dogecoin_tx_hash(funding, txid);
+
+    memcpy(tx_in->prevout.hash, txid, DOGECOIN_HASH_LENGTH);
+    tx_in->prevout.n = 0;
+    tx_in->script_sig = cstr_new_buf("\x01\x02", 2);
+    vector_add(spend->vin, tx_in);
+    tx_out = dogecoin_tx_out_new();
+    tx_out->value = 900;
+    tx_out->script_pubkey = cstr_new_buf("\x51", 1);
+    vector_add(spend->vout, tx_out);
+    vector_add(other->vout, dogecoin_tx_out_new());
+    dogecoin_tx_vout(other, 0)->script_pubkey = cstr_new_buf("\x52", 1);
+    dogecoin_tx_hash(other, other_txid);
+
+    /* nothing is inserted yet */
+    u_assert_int_eq(dogecoin_bloom_match_tx(filter, funding, txid), false);
+    dogecoin_bloom_insert_pubkey(filter, &pubkey);
+    u_assert_int_eq(dogecoin_bloom_match_tx(filter, other, other_txid), false);
+
+    /* the spend only matches once the funding output was seen */
+    dogecoin_tx_hash(spend, other_txid);
+    u_assert_int_eq(dogecoin_bloom_match_tx(filter, spend, other_txid), false);
+    u_assert_int_eq(dogecoin_bloom_contains_outpoint(filter, &tx_in->prevout), false);
+    u_assert_int_eq(dogecoin_bloom_match_tx(filter, funding, txid), true);
+    u_assert_int_eq(dogecoin_bloom_contains_outpoint(filter, &tx_in->prevout), true);
+    u_assert_int_eq(dogecoin_bloom_match_tx(filter, spend, other_txid), true);
+
+    dogecoin_tx_free(funding);
+    dogecoin_tx_free(spend);
+    dogecoin_tx_free(other);
+    dogecoin_bloom_free(filter);
+}
+
+static void bloom_test_partial_merkle()
+{
+    uint256 leaves[BLOOM_TEST_LEAVES], root, extracted, matches[BLOOM_TEST_LEAVES];
+    uint32_t indexes[BLOOM_TEST_LEAVES];
+    dogecoin_bool match[BLOOM_TEST_LEAVES];
+    size_t count, pattern, i, n, match_count;
+
+    for (i = 0; i < BLOOM_TEST_LEAVES; i++)
+        sha256_raw((const uint8_t*)&i, sizeof(i), leaves[i]);
+    for (count = 1; count <= BLOOM_TEST_LEAVES; count++) {
+        u_assert_int_eq(dogecoin_merkle_root((const uint256*)leaves, count, root, NULL), true);
+        for (pattern = 0; pattern < 4; pattern++) {
+            cstring* hashes = cstr_new_sz(64);
+            cstring* flags = cstr_new_sz(8);
+            size_t expected = 0;
+            for (i = 0; i < count; i++) {
+                /* none, all, every third, only the last */
+                match[i] = pattern == 1 || (pattern == 2 && i % 3 == 0) || (pattern == 3 && i == count - 1);
+                expected += match[i];
+            }
+            u_assert_int_eq(dogecoin_merkle_partial_build((const uint256*)leaves, count, match, hashes, flags), true);
+            u_assert_int_eq(dogecoin_merkle_partial_extract((uint32_t)count, (const unsigned char*)hashes->str, hashes->len / 32,
+                                (const unsigned char*)flags->str, flags->len, extracted, matches, indexes, &match_count), true);
+            u_assert_mem_eq(extracted, root, 32);
+            u_assert_int_eq(match_count, expected);
+            for (i = 0, n = 0; i < count; i++) {
+                if (!match[i])
+                    continue;
+                u_assert_int_eq(indexes[n], i);
+                u_assert_mem_eq(matches[n], leaves[i], 32);
+                n++;
+            }
+
+            /* a missing hash, a trailing flag byte or a wrong total break the proof */
+            u_assert_int_eq(dogecoin_merkle_partial_extract((uint32_t)count, (const unsigned char*)hashes->str, hashes->len / 32 - 1,
+                                (const unsigned char*)flags->str, flags->len, extracted, NULL, NULL, &match_count), false);
+            cstr_append_c(flags, 0);
+            u_assert_int_eq(dogecoin_merkle_partial_extract((uint32_t)count, (const unsigned char*)hashes->str, hashes->len / 32,
+                                (const unsigned char*)flags->str, flags->len, extracted, NULL, NULL, &match_count), false);
+            cstr_free(hashes, true);
+            cstr_free(flags, true);
+        }
+    }
+}
+
+static void bloom_test_merkleblock()
+{
+    uint256 leaves[5], matches[5], hash;
+    uint32_t indexes[5];
+    dogecoin_bool match[5] = {false, true, false, false, true};
+    dogecoin_block_header header;
+    dogecoin_merkleblock mb;
+    cstring* msg = cstr_new_sz(512);
+    cstring* hashes = cstr_new_sz(256);
+    cstring* flags = cstr_new_sz(8);
+    struct const_buffer buf;
+    size_t i, match_count;
+
+    for (i = 0; i < 5; i++)
+        sha256_raw((const uint8_t*)&i, sizeof(i), leaves[i]);
+    dogecoin_mem_zero(&header, sizeof(header));
+    header.version = 1;
+    dogecoin_merkle_root((const uint256*)leaves, 5, header.merkle_root, NULL);
+    u_assert_int_eq(dogecoin_merkle_partial_build((const uint256*)leaves, 5, match, hashes, flags), true);
+
+    dogecoin_block_header_serialize(msg, &header);
+    ser_u32(msg, 5);
+    ser_varlen(msg, (uint32_t)(hashes->len / 32));
+    ser_bytes(msg, hashes->str, hashes->len);
+    ser_varlen(msg, (uint32_t)flags->len);
+    ser_bytes(msg, flags->str, flags->len);
+
+    buf.p = msg->str;
+    buf.len = msg->len;
+    u_assert_int_eq(dogecoin_merkleblock_parse(&mb, &buf), true);
+    u_assert_int_eq(buf.len, 0);
+    u_assert_int_eq(mb.has_auxpow, false);
+    u_assert_int_eq(mb.total_txs, 5);
+    u_assert_int_eq(dogecoin_merkleblock_verify(&mb, matches, indexes, &match_count), true);
+    u_assert_int_eq(match_count, 2);
+    u_assert_int_eq(indexes[0], 1);
+    u_assert_int_eq(indexes[1], 4);
+    u_assert_mem_eq(matches[1], leaves[4], 32);
+
+    /* a tree that doesn't lead to the header's root */
+    memcpy(hash, mb.header.merkle_root, 32);
+    mb.header.merkle_root[0] ^= 1;
+    u_assert_int_eq(dogecoin_merkleblock_verify(&mb, matches, indexes, &match_count), false);
+    memcpy(mb.header.merkle_root, hash, 32);
+    mb.total_txs = 6;
+    u_assert_int_eq(dogecoin_merkleblock_verify(&mb, NULL, NULL, &match_count), false);
+
+    buf.p = msg->str;
+    buf.len = msg->len - 1;
+    u_assert_int_eq(dogecoin_merkleblock_parse(&mb, &buf), false);
+    cstr_free(msg, true);
+    cstr_free(hashes, true);
+    cstr_free(flags, true);
+}
+
+void test_bloom()
+{
+    uint32_t seeds[DOGECOIN_BLOOM_MAX_HASH_FUNCS], hashes[DOGECOIN_BLOOM_MAX_HASH_FUNCS];
+    unsigned char data[32];
+    size_t i, len;
+
+    for (i = 0; i < sizeof(murmur_vectors) / sizeof(murmur_vectors[0]); i++) {
+        utils_hex_to_bin(murmur_vectors[i].hex, data, strlen(murmur_vectors[i].hex), &len);
+        u_assert_uint32_eq(dogecoin_murmurhash3(murmur_vectors[i].seed, data, len), murmur_vectors[i].expected);
+    }
+    /* all lanes agree with the single seed hash */
+    for (i = 0; i < DOGECOIN_BLOOM_MAX_HASH_FUNCS; i++)
+        seeds[i] = (uint32_t)i * 0xFBA4C795 + 7;
+    for (len = 0; len < 10; len++) {
+        dogecoin_murmurhash3_multi(seeds, DOGECOIN_BLOOM_MAX_HASH_FUNCS, (const unsigned char*)"abcdefghij", len, hashes);
+        for (i = 0; i < DOGECOIN_BLOOM_MAX_HASH_FUNCS; i++)
+            u_assert_uint32_eq(hashes[i], dogecoin_murmurhash3(seeds[i], (const unsigned char*)"abcdefghij", len));
+    }
+
+    bloom_test_filter(0, "03614e9b050000000000000001");
+    bloom_test_filter(2147483649UL, "03ce4299050000000100008001");
+    u_assert_int_eq(dogecoin_bloom_new(0, 0.01, 0, 0) == NULL, 1);
+
+    bloom_test_tx_match();
+    bloom_test_partial_merkle();
+    bloom_test_merkleblock();
+}
@@ -22,6 +22,7 @@ void test_cstr()
     cstring* s3 = cstr_new("bar");
     cstring* s4 = cstr_new("bar1");
     cstring* s = cstr_new("foo");
+    unsigned int i;
     assert(s != NULL);
     assert(s->len == 3);
     assert(strcmp(s->str, "foo") == 0);
@@ -74,6 +75,24 @@ void test_cstr()
     cstr_erase(s4, s4->len, 0);
     cstr_erase(s4, 0, 100);
     assert(strcmp(s4->str, "1") == 0);
+    /* inline buffer spilling over to the heap */
+    s = cstr_new_sz(25);
+    assert(s->alloc == 32);
+    assert(s->str == (char*)(s + 1));
+    for (i = 0; i < 300; i++)
+        cstr_append_c(s, (char)('a' + i % 26));
+    assert(s->len == 300);
+    assert(s->alloc > 300);
+    assert(s->str != (char*)(s + 1));
+    assert(s->str[0] == 'a' && s->str[26] == 'a' && s->str[299] == 'n');
+    assert(s->str[300] == 0);
+    cstr_resize(s, 3);
+    assert(strcmp(s->str, "abc") == 0);
+    cstr_free(s, true);
+    s = cstr_new_sz(1024);
+    assert(s->alloc > 1024);
+    assert(s->str != (char*)(s + 1));
+    cstr_free(s, true);
     cstr_free(s1, true);
     cstr_free(s2, true);
     cstr_free(s3, true);
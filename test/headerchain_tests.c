@@ -0,0 +1,222 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <dogecoin/headerchain.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/pow.h>
+#include <dogecoin/utils.h>
+
+#include "utest.h"
+
+#define HEADERCHAIN_TEST_LEN 5
+
+static void headerchain_test_header(dogecoin_block_header* header, const uint8_t* prev, uint32_t bits, uint32_t nonce)
+{
+    dogecoin_mem_zero(header, sizeof(*header));
+    header->version = 1;
+    memcpy(header->prev_block, prev, DOGECOIN_HASH_LENGTH);
+    header->timestamp = 1386325540 + nonce * 60;
+    header->bits = bits;
+    header->nonce = nonce;
+}
+
+/* connects a chain of count headers on top of prev, the entries go to entries_out */
+static void headerchain_test_extend(dogecoin_headerchain* hc, dogecoin_headerchain_entry* prev, uint32_t bits, uint32_t nonce, size_t count, dogecoin_headerchain_entry** entries_out)
+{
+    dogecoin_block_header header;
+    size_t i;
+    for (i = 0; i < count; i++) {
+        headerchain_test_header(&header, dogecoin_headerchain_entry_hash(prev), bits, nonce + (uint32_t)i);
+        prev = dogecoin_headerchain_connect(hc, &header, NULL);
+        if (entries_out)
+            entries_out[i] = prev;
+    }
+}
+
+/* moves the nonce until the regtest proof of work is valid (or invalid) */
+static void headerchain_test_mine(dogecoin_block_header* header, dogecoin_bool valid)
+{
+    while (dogecoin_block_header_check_pow(header, NULL, &dogecoin_chainparams_regtest) != valid)
+        header->nonce++;
+}
+
+void test_headerchain()
+{
+    const dogecoin_chainparams* chain = &dogecoin_chainparams_regtest;
+    dogecoin_headerchain_entry* a[HEADERCHAIN_TEST_LEN];
+    dogecoin_headerchain_entry* b[2];
+    dogecoin_headerchain_entry* entry;
+    dogecoin_block_header header;
+    dogecoin_bool reorg;
+    char path[] = "/tmp/dogecoin_headersXXXXXX";
+    uint256 tip_hash, tip_work;
+    size_t count;
+
+    int fd = mkstemp(path);
+    u_assert_int_eq(fd >= 0, 1);
+    close(fd);
+    unlink(path);
+
+    dogecoin_headerchain* hc = dogecoin_headerchain_new(chain, 0);
+    u_assert_int_eq(hc != NULL, 1);
+    u_assert_mem_eq(dogecoin_headerchain_entry_hash(hc->root), chain->genesisblockhash, DOGECOIN_HASH_LENGTH);
+    u_assert_int_eq(dogecoin_headerchain_load(hc, path), true);
+
+    headerchain_test_extend(hc, hc->root, 0x207fffff, 1, HEADERCHAIN_TEST_LEN, a);
+    u_assert_int_eq(dogecoin_headerchain_tip(hc) == a[4], 1);
+    u_assert_int_eq(a[4]->height, 5);
+    u_assert_int_eq(dogecoin_headerchain_at_height(hc, 3) == a[2], 1);
+    u_assert_int_eq(dogecoin_headerchain_at_height(hc, 6) == NULL, 1);
+    u_assert_int_eq(dogecoin_headerchain_find(hc, dogecoin_headerchain_entry_hash(a[3])) == a[3], 1);
+    dogecoin_headerchain_entry_header(a[1], &header);
+    u_assert_int_eq(header.nonce, 2);
+    u_assert_int_eq(dogecoin_headerchain_entry_time(a[1]), header.timestamp);
+    u_assert_int_eq(dogecoin_headerchain_entry_bits(a[1]), 0x207fffff);
+
+    /* a known header is not added twice, orphans are rejected */
+    u_assert_int_eq(dogecoin_headerchain_connect(hc, &header, &reorg) == a[1], 1);
+    u_assert_int_eq(reorg, false);
+    headerchain_test_header(&header, dogecoin_headerchain_entry_hash(a[4]), 0x207fffff, 1000);
+    memset(header.prev_block, 0x55, sizeof(header.prev_block));
+    u_assert_int_eq(dogecoin_headerchain_connect(hc, &header, NULL) == NULL, 1);
+
+    /* a shorter fork with more work takes over */
+    headerchain_test_extend(hc, a[1], 0x203fffff, 100, 1, b);
+    u_assert_int_eq(dogecoin_headerchain_tip(hc) == a[4], 1);
+    headerchain_test_header(&header, dogecoin_headerchain_entry_hash(b[0]), 0x203fffff, 101);
+    b[1] = dogecoin_headerchain_connect(hc, &header, &reorg);
+    u_assert_int_eq(reorg, true);
+    u_assert_int_eq(dogecoin_headerchain_tip(hc) == b[1], 1);
+    u_assert_int_eq(b[1]->height, 4);
+    u_assert_int_eq(dogecoin_headerchain_is_best(hc, a[1]), true);
+    u_assert_int_eq(dogecoin_headerchain_is_best(hc, a[2]), false);
+    u_assert_int_eq(dogecoin_headerchain_at_height(hc, 3) == b[0], 1);
+    u_assert_int_eq(dogecoin_headerchain_at_height(hc, 5) == NULL, 1);
+
+    /* extending the old chain is no reorg while it has less work */
+    headerchain_test_extend(hc, a[4], 0x207fffff, 6, 1, &entry);
+    u_assert_int_eq(entry->height, 6);
+    u_assert_int_eq(dogecoin_headerchain_tip(hc) == b[1], 1);
+
+    vector* locators = vector_new(16, dogecoin_free);
+    dogecoin_headerchain_locator(hc, locators);
+    u_assert_int_eq(locators->len, 5);
+    u_assert_mem_eq(vector_idx(locators, 0), dogecoin_headerchain_entry_hash(b[1]), DOGECOIN_HASH_LENGTH);
+    u_assert_mem_eq(vector_idx(locators, 4), chain->genesisblockhash, DOGECOIN_HASH_LENGTH);
+    vector_free(locators, true);
+
+    memcpy(tip_hash, dogecoin_headerchain_entry_hash(b[1]), DOGECOIN_HASH_LENGTH);
+    memcpy(tip_work, b[1]->chainwork, sizeof(tip_work));
+    count = hc->count;
+    dogecoin_headerchain_free(hc);
+
+    /* the reloaded tree is the same, a torn record at the end is dropped */
+    FILE* file = fopen(path, "ab");
+    fwrite("torn", 1, 4, file);
+    fclose(file);
+    hc = dogecoin_headerchain_new(chain, 0);
+    u_assert_int_eq(dogecoin_headerchain_load(hc, path), true);
+    u_assert_int_eq(hc->count, count);
+    u_assert_mem_eq(dogecoin_headerchain_entry_hash(dogecoin_headerchain_tip(hc)), tip_hash, DOGECOIN_HASH_LENGTH);
+    u_assert_mem_eq(dogecoin_headerchain_tip(hc)->chainwork, tip_work, sizeof(tip_work));
+    u_assert_int_eq(dogecoin_headerchain_at_height(hc, 4) != NULL, 1);
+    entry = dogecoin_headerchain_at_height(hc, 4);
+    headerchain_test_extend(hc, entry, 0x1f00ffff, 102, 1, &entry);
+    u_assert_int_eq(entry->height, 5);
+    dogecoin_headerchain_free(hc);
+
+    hc = dogecoin_headerchain_new(chain, 0);
+    u_assert_int_eq(dogecoin_headerchain_load(hc, path), true);
+    u_assert_int_eq(hc->count, count + 1);
+    u_assert_int_eq(dogecoin_headerchain_tip(hc)->height, 5);
+    dogecoin_headerchain_free(hc);
+
+    /* the file belongs to another chain */
+    hc = dogecoin_headerchain_new(&dogecoin_chainparams_main, 0);
+    u_assert_int_eq(dogecoin_headerchain_load(hc, path), false);
+    dogecoin_headerchain_free(hc);
+    unlink(path);
+
+#ifdef __linux__
+    /* a failed write stops appending, the tree keeps working in memory */
+    hc = dogecoin_headerchain_new(chain, 0);
+    u_assert_int_eq(dogecoin_headerchain_load(hc, "/dev/full"), true);
+    headerchain_test_extend(hc, hc->root, 0x207fffff, 1, 1, &entry);
+    u_assert_int_eq(dogecoin_headerchain_flush(hc), false);
+    u_assert_int_eq(hc->file == NULL, 1);
+    headerchain_test_extend(hc, entry, 0x207fffff, 2, 1, &entry);
+    u_assert_int_eq(dogecoin_headerchain_tip(hc) == entry, 1);
+    u_assert_int_eq(dogecoin_headerchain_flush(hc), false);
+    dogecoin_headerchain_free(hc);
+#endif
+
+    /* trees start at checkpoints only */
+    hc = dogecoin_headerchain_new(&dogecoin_chainparams_main, 104679);
+    u_assert_int_eq(hc != NULL, 1);
+    u_assert_int_eq(hc->root->height, 104679);
+    u_assert_int_eq(dogecoin_headerchain_entry_bits(hc->root), 0x1b41676b);
+    dogecoin_headerchain_free(hc);
+    u_assert_int_eq(dogecoin_headerchain_new(&dogecoin_chainparams_main, 5) == NULL, 1);
+
+    /* checkpoints reject conflicting headers and anchor the best chain */
+    dogecoin_checkpoint checkpoints[2] = {{0, "", 0, 0}, {3, "", 0, 0}};
+    hc = dogecoin_headerchain_new(chain, 0);
+    headerchain_test_extend(hc, hc->root, 0x207fffff, 1, HEADERCHAIN_TEST_LEN, a);
+    uint256* checkpoint_hashes = dogecoin_calloc(2, sizeof(uint256));
+    memcpy(checkpoint_hashes[0], chain->genesisblockhash, DOGECOIN_HASH_LENGTH);
+    memcpy(checkpoint_hashes[1], dogecoin_headerchain_entry_hash(a[2]), DOGECOIN_HASH_LENGTH);
+    dogecoin_headerchain_free(hc);
+
+    hc = dogecoin_headerchain_new(chain, 0);
+    hc->checkpoints = checkpoints;
+    hc->checkpoint_hashes = checkpoint_hashes;
+    hc->checkpoint_count = 2;
+    hc->anchor = hc->root;
+    headerchain_test_extend(hc, hc->root, 0x207fffff, 1, 2, a);
+    headerchain_test_header(&header, dogecoin_headerchain_entry_hash(a[1]), 0x1f00ffff, 100);
+    u_assert_int_eq(dogecoin_headerchain_connect(hc, &header, NULL) == NULL, 1);
+    headerchain_test_extend(hc, a[1], 0x207fffff, 3, 3, a + 2);
+    u_assert_int_eq(hc->anchor == a[2], 1);
+    u_assert_int_eq(dogecoin_headerchain_tip(hc) == a[4], 1);
+    /* forks below the checkpoint are final, forks above it are fine */
+    headerchain_test_header(&header, dogecoin_headerchain_entry_hash(a[0]), 0x1f00ffff, 100);
+    u_assert_int_eq(dogecoin_headerchain_connect(hc, &header, NULL) == NULL, 1);
+    headerchain_test_header(&header, dogecoin_headerchain_entry_hash(a[2]), 0x1f00ffff, 100);
+    u_assert_int_eq(dogecoin_headerchain_connect(hc, &header, &reorg) != NULL, 1);
+    u_assert_int_eq(reorg, true);
+    dogecoin_headerchain_free(hc);
+
+    /* a headers message is validated in one call, up to the first invalid header */
+    dogecoin_block_header batch[8];
+    uint256 prev;
+    size_t i;
+    hc = dogecoin_headerchain_new(chain, 0);
+    memcpy(prev, chain->genesisblockhash, sizeof(prev));
+    for (i = 0; i < 8; i++) {
+        headerchain_test_header(&batch[i], prev, 0x207fffff, (uint32_t)i * 1000);
+        headerchain_test_mine(&batch[i], i != 5);
+        dogecoin_block_header_hash(&batch[i], prev);
+    }
+    u_assert_int_eq(dogecoin_headerchain_connect_headers(hc, batch, NULL, 8, &reorg), 5);
+    u_assert_int_eq(dogecoin_headerchain_tip(hc)->height, 5);
+    u_assert_int_eq(reorg, false);
+    /* the auxpow parent header proves the work instead */
+    const dogecoin_block_header* pow_headers[8] = {NULL};
+    pow_headers[5] = &batch[4];
+    u_assert_int_eq(dogecoin_headerchain_connect_headers(hc, batch + 5, pow_headers + 5, 3, NULL), 3);
+    u_assert_int_eq(dogecoin_headerchain_tip(hc)->height, 8);
+    /* timestamps must pass the median time past */
+    headerchain_test_header(&header, prev, 0x207fffff, 0);
+    headerchain_test_mine(&header, true);
+    u_assert_int_eq(dogecoin_headerchain_connect_headers(hc, &header, NULL, 1, NULL), 0);
+    u_assert_int_eq(dogecoin_headerchain_connect_headers(hc, batch, NULL, 0, NULL), 0);
+    dogecoin_headerchain_free(hc);
+}
@@ -54,3 +54,65 @@ void test_memory()
     // switch back to the default memory callback mapper
     dogecoin_mem_set_mapper_default();
 }
+
+void test_memory_instrumented()
+{
+    dogecoin_mem_stats stats;
+    const char* prev_tag;
+    void *a, *b, *c;
+    size_t i, site = 0;
+
+    dogecoin_mem_set_mapper_instrumented();
+    u_assert_int_eq(dogecoin_mem_instrumented(), 1);
+    dogecoin_mem_stats_reset();
+
+    a = dogecoin_malloc(10);
+    prev_tag = dogecoin_mem_set_tag("test_site");
+    u_assert_int_eq((prev_tag == NULL), 1);
+    b = dogecoin_calloc(4, 100);
+    u_assert_int_eq(((uintptr_t)b % sizeof(void*)), 0);
+    u_assert_int_eq(((unsigned char*)b)[399], 0);
+    c = dogecoin_malloc(5000);
+    dogecoin_mem_set_tag(prev_tag);
+
+    dogecoin_mem_stats_snapshot(&stats);
+    u_assert_int_eq(stats.live_bytes, 5410);
+    u_assert_int_eq(stats.peak_bytes, 5410);
+    u_assert_int_eq(stats.live_allocs, 3);
+    u_assert_int_eq(stats.total_allocs, 3);
+    u_assert_int_eq(stats.size_classes[0], 1); /* 10 bytes */
+    u_assert_int_eq(stats.size_classes[5], 1); /* 400 bytes */
+    u_assert_int_eq(stats.size_classes[9], 1); /* 5000 bytes */
+    for (i = 1; i < stats.site_count; i++)
+        if (strcmp(stats.sites[i].tag, "test_site") == 0)
+            site = i;
+    u_assert_int_eq((site != 0), 1);
+    u_assert_int_eq(stats.sites[site].allocs, 2);
+    u_assert_int_eq(stats.sites[site].live_bytes, 5400);
+
+    memset(a, 0xaa, 10);
+    a = dogecoin_realloc(a, 20);
+    u_assert_int_eq(((unsigned char*)a)[9], 0xaa);
+    dogecoin_free(c);
+    dogecoin_free(NULL);
+
+    dogecoin_mem_stats_snapshot(&stats);
+    u_assert_int_eq(stats.live_bytes, 420);
+    u_assert_int_eq(stats.peak_bytes, 5420);
+    u_assert_int_eq(stats.live_allocs, 2);
+    u_assert_int_eq(stats.total_reallocs, 1);
+    u_assert_int_eq(stats.total_frees, 1);
+    u_assert_int_eq(stats.sites[site].frees, 1);
+    u_assert_int_eq(stats.sites[site].live_bytes, 400);
+    u_assert_int_eq(stats.sites[site].peak_bytes, 5400);
+
+    dogecoin_free(a);
+    dogecoin_free(b);
+    dogecoin_mem_stats_snapshot(&stats);
+    u_assert_int_eq(stats.live_bytes, 0);
+    u_assert_int_eq(stats.live_allocs, 0);
+
+    // switch back to the default memory callback mapper
+    dogecoin_mem_set_mapper_default();
+    u_assert_int_eq(dogecoin_mem_instrumented(), 0);
+}
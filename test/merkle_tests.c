@@ -0,0 +1,270 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <string.h>
+
+#include <dogecoin/block.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/merkle.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/sha2.h>
+#include <dogecoin/tx.h>
+#include <dogecoin/utils.h>
+
+#include "utest.h"
+
+#define MERKLE_TEST_LEAVES 37
+
+/* reference root, one sha256_raw pair per node */
+static void merkle_test_naive_root(const uint256* leaves, size_t count, uint256 root)
+{
+    uint8_t level[(MERKLE_TEST_LEAVES + 1) * 32];
+    size_t n = count, i;
+    memcpy(level, leaves, count * 32);
+    while (n > 1) {
+        if (n & 1)
+            memcpy(level + n * 32, level + (n - 1) * 32, 32), n++;
+        for (i = 0; i < n / 2; i++) {
+            sha256_raw(level + i * 64, 64, level + i * 32);
+            sha256_raw(level + i * 32, 32, level + i * 32);
+        }
+        n /= 2;
+    }
+    memcpy(root, level, 32);
+}
+
+void test_merkle()
+{
+    uint256 leaves[MERKLE_TEST_LEAVES], root, expected, branch[DOGECOIN_MERKLE_MAX_DEPTH];
+    uint8_t in[17 * 64], out[17 * 32], ref[32];
+    dogecoin_bool mutated;
+    size_t count, i, len;
+
+    for (i = 0; i < sizeof(in); i++)
+        in[i] = (uint8_t)(i * 7 + 3);
+    for (count = 1; count <= 17; count++) {
+        sha256d64(out, in, count);
+        for (i = 0; i < count; i++) {
+            sha256_raw(in + i * 64, 64, ref);
+            sha256_raw(ref, 32, ref);
+            u_assert_mem_eq(out + i * 32, ref, 32);
+        }
+    }
+
+    for (i = 0; i < MERKLE_TEST_LEAVES; i++)
+        sha256_raw((const uint8_t*)&i, sizeof(i), leaves[i]);
+    u_assert_int_eq(dogecoin_merkle_root((const uint256*)leaves, 0, root, NULL), false);
+    u_assert_int_eq(dogecoin_merkle_root((const uint256*)leaves, 1, root, NULL), true);
+    u_assert_mem_eq(root, leaves[0], 32);
+
+    for (count = 1; count <= MERKLE_TEST_LEAVES; count++) {
+        merkle_test_naive_root((const uint256*)leaves, count, expected);
+        u_assert_int_eq(dogecoin_merkle_root((const uint256*)leaves, count, root, &mutated), true);
+        u_assert_mem_eq(root, expected, 32);
+        u_assert_int_eq(mutated, false);
+        for (i = 0; i < count; i++) {
+            len = dogecoin_merkle_branch((const uint256*)leaves, count, (uint32_t)i, branch);
+            u_assert_int_eq(dogecoin_merkle_verify_branch(leaves[i], (const uint256*)branch, len, (uint32_t)i, root), true);
+            u_assert_int_eq(dogecoin_merkle_verify_branch(leaves[(i + 1) % count], (const uint256*)branch, len, (uint32_t)i, root), count == 1);
+            if ((i ^ 1) < count) /* the odd last leaf is paired with itself */
+                u_assert_int_eq(dogecoin_merkle_verify_branch(leaves[i], (const uint256*)branch, len, (uint32_t)(i ^ 1), root), false);
+        }
+    }
+    u_assert_int_eq(dogecoin_merkle_branch((const uint256*)leaves, 5, 5, branch), 0);
+
+    /* [a b c] and [a b c c] share a root, the longer list is flagged */
+    merkle_test_naive_root((const uint256*)leaves, 3, expected);
+    memcpy(leaves[3], leaves[2], 32);
+    u_assert_int_eq(dogecoin_merkle_root((const uint256*)leaves, 4, root, &mutated), true);
+    u_assert_mem_eq(root, expected, 32);
+    u_assert_int_eq(mutated, true);
+
+    dogecoin_merkle_root_from_branch(leaves[0], NULL, 0, -1, root);
+    memset(expected, 0, 32);
+    u_assert_mem_eq(root, expected, 32);
+}
+
+static uint32_t auxpow_test_expected_index(uint32_t nonce, int32_t chain_id, unsigned int height)
+{
+    uint32_t rand = nonce * 1103515245 + 12345;
+    rand += (uint32_t)chain_id;
+    rand = rand * 1103515245 + 12345;
+    return rand % (1u << height);
+}
+
+struct auxpow_test_params {
+    dogecoin_bool with_header;
+    dogecoin_bool double_header;
+    uint32_t size;
+    uint32_t nonce;
+    int32_t chain_index;
+    int32_t coinbase_index;
+    int32_t parent_chain_id;
+    dogecoin_bool bad_parent_root;
+};
+
+/* serializes a merge mined block with a one transaction body */
+static cstring* auxpow_test_block(const struct auxpow_test_params* p, dogecoin_block_header* header)
+{
+    uint256 chain_branch[2], coinbase_branch[1], chain_root, coinbase_hash, aux_hash;
+    unsigned char script[128];
+    size_t script_len = 0;
+    dogecoin_block_header parent;
+    cstring* coinbase = cstr_new_sz(256);
+    cstring* block = cstr_new_sz(1024);
+    dogecoin_tx* tx = dogecoin_tx_new();
+    dogecoin_tx_in* tx_in = dogecoin_tx_in_new();
+    uint160 hash160;
+    unsigned int i;
+    int k;
+
+    dogecoin_mem_zero(header, sizeof(*header));
+    header->version = 4 | DOGECOIN_BLOCK_VERSION_AUXPOW | (DOGECOIN_AUXPOW_CHAIN_ID * DOGECOIN_BLOCK_VERSION_CHAIN_START);
+    header->timestamp = 1400000000;
+    header->bits = 0x1b0b2efd;
+    dogecoin_block_header_hash(header, aux_hash);
+
+    memset(chain_branch, 0x11, sizeof(chain_branch));
+    chain_branch[1][0] = 0x22;
+    dogecoin_merkle_root_from_branch(aux_hash, (const uint256*)chain_branch, 2, p->chain_index, chain_root);
+
+    /* height, merged mining header, big endian root, tree size, nonce */
+    script[script_len++] = 0x03;
+    script[script_len++] = 0x01;
+    script[script_len++] = 0x02;
+    script[script_len++] = 0x03;
+    for (i = 0; i < (p->double_header ? 2u : 1u) && p->with_header; i++) {
+        memcpy(script + script_len, "\xfa\xbe" "mm", 4);
+        script_len += 4;
+    }
+    for (k = 31; k >= 0; k--)
+        script[script_len++] = chain_root[k];
+    for (k = 0; k < 4; k++)
+        script[script_len++] = (unsigned char)(p->size >> (8 * k));
+    for (k = 0; k < 4; k++)
+        script[script_len++] = (unsigned char)(p->nonce >> (8 * k));
+
+    memset(tx_in->prevout.hash, 0, sizeof(tx_in->prevout.hash));
+    tx_in->prevout.n = UINT32_MAX;
+    tx_in->script_sig = cstr_new_buf(script, script_len);
+    vector_add(tx->vin, tx_in);
+    memset(hash160, 0x42, sizeof(hash160));
+    dogecoin_tx_add_p2pkh_hash160_out(tx, 5000000000LL, hash160);
+    dogecoin_tx_serialize(coinbase, tx);
+    dogecoin_tx_hash(tx, coinbase_hash);
+
+    memset(coinbase_branch, 0x33, sizeof(coinbase_branch));
+    dogecoin_mem_zero(&parent, sizeof(parent));
+    parent.version = 2 | (p->parent_chain_id * DOGECOIN_BLOCK_VERSION_CHAIN_START);
+    parent.timestamp = 1400000001;
+    parent.bits = 0x1b0b2efd;
+    dogecoin_merkle_root_from_branch(coinbase_hash, (const uint256*)coinbase_branch, 1, 0, parent.merkle_root);
+    if (p->bad_parent_root)
+        parent.merkle_root[5] ^= 1;
+
+    dogecoin_block_header_serialize(block, header);
+    ser_bytes(block, coinbase->str, coinbase->len);
+    ser_u256(block, parent.prev_block);
+    ser_varlen(block, 1);
+    ser_u256(block, coinbase_branch[0]);
+    ser_s32(block, p->coinbase_index);
+    ser_varlen(block, 2);
+    ser_u256(block, chain_branch[0]);
+    ser_u256(block, chain_branch[1]);
+    ser_s32(block, p->chain_index);
+    dogecoin_block_header_serialize(block, &parent);
+    ser_varlen(block, 1);
+    dogecoin_tx_serialize(block, tx);
+
+    cstr_free(coinbase, true);
+    dogecoin_tx_free(tx);
+    return block;
+}
+
+/* checks the block through the view and the decoded auxpow, both must agree */
+static void auxpow_test_check(const struct auxpow_test_params* p, dogecoin_bool* ok)
+{
+    dogecoin_block_header header;
+    cstring* raw = auxpow_test_block(p, &header);
+    struct const_buffer buf = {raw->str, raw->len};
+    dogecoin_block_view view;
+    dogecoin_block* block = dogecoin_block_new();
+    uint256 hash, root, view_root;
+    dogecoin_bool mutated, ok_view, ok_block;
+
+    dogecoin_block_header_hash(&header, hash);
+    u_assert_int_eq(dogecoin_block_view_parse(&view, &buf), true);
+    ok_view = dogecoin_auxpow_view_check(&view.auxpow, hash, DOGECOIN_AUXPOW_CHAIN_ID);
+    u_assert_int_eq(dogecoin_block_view_merkle_root(&view, view_root, &mutated), true);
+    u_assert_int_eq(mutated, false);
+
+    buf.p = raw->str;
+    buf.len = raw->len;
+    u_assert_int_eq(dogecoin_block_deserialize(block, &buf), true);
+    ok_block = dogecoin_auxpow_check(block->auxpow, hash, DOGECOIN_AUXPOW_CHAIN_ID);
+    u_assert_int_eq(dogecoin_block_merkle_root(block, root, NULL), true);
+    u_assert_mem_eq(root, view_root, 32);
+    u_assert_int_eq(ok_view, ok_block);
+    *ok = ok_view;
+
+    dogecoin_block_free(block);
+    dogecoin_block_view_free(&view);
+    cstr_free(raw, true);
+}
+
+void test_auxpow_check()
+{
+    struct auxpow_test_params valid, p;
+    dogecoin_bool ok = false;
+    valid.with_header = true;
+    valid.double_header = false;
+    valid.size = 4;
+    valid.nonce = 7;
+    valid.chain_index = (int32_t)auxpow_test_expected_index(7, DOGECOIN_AUXPOW_CHAIN_ID, 2);
+    valid.coinbase_index = 0;
+    valid.parent_chain_id = 0;
+    valid.bad_parent_root = false;
+    auxpow_test_check(&valid, &ok);
+    u_assert_int_eq(ok, true);
+
+    /* legacy commitment without the merged mining header */
+    p = valid;
+    p.with_header = false;
+    auxpow_test_check(&p, &ok);
+    u_assert_int_eq(ok, true);
+
+    p = valid;
+    p.double_header = true;
+    auxpow_test_check(&p, &ok);
+    u_assert_int_eq(ok, false);
+    p = valid;
+    p.size = 8;
+    auxpow_test_check(&p, &ok);
+    u_assert_int_eq(ok, false);
+    p = valid;
+    p.chain_index = (valid.chain_index + 1) % 4;
+    auxpow_test_check(&p, &ok);
+    u_assert_int_eq(ok, false);
+    p = valid;
+    p.coinbase_index = 1;
+    auxpow_test_check(&p, &ok);
+    u_assert_int_eq(ok, false);
+    p = valid;
+    p.parent_chain_id = DOGECOIN_AUXPOW_CHAIN_ID;
+    auxpow_test_check(&p, &ok);
+    u_assert_int_eq(ok, false);
+    p = valid;
+    p.bad_parent_root = true;
+    auxpow_test_check(&p, &ok);
+    u_assert_int_eq(ok, false);
+
+    /* a nonce selecting another slot, the root commits to the old one */
+    p = valid;
+    for (p.nonce = 8; auxpow_test_expected_index(p.nonce, DOGECOIN_AUXPOW_CHAIN_ID, 2) == (uint32_t)valid.chain_index; p.nonce++)
+        ;
+    auxpow_test_check(&p, &ok);
+    u_assert_int_eq(ok, false);
+}
@@ -5,9 +5,21 @@
  * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
  **********************************************************************/
 
+#include "test_util.h"
 #include "utest.h"
 
+#include <pthread.h>
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/dns.h>
+#include <event2/dns_struct.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+
 #include <dogecoin/block.h>
+#include <dogecoin/broadcaster.h>
+#include <dogecoin/hash.h>
 #include <dogecoin/net.h>
 #include <dogecoin/utils.h>
 #include <dogecoin/serialize.h>
@@ -193,6 +205,758 @@ void handshake_done(struct dogecoin_node_ *node)
     cstr_free(p2p_msg, true);
 }
 
+static int dispatched = 0;
+
+static dogecoin_bool count_handler(struct dogecoin_node_ *node, dogecoin_p2p_msg_hdr *hdr, struct const_buffer *buf)
+{
+    (void)(node);
+    (void)(hdr);
+    dispatched++;
+    /* an empty payload counts as a bad message */
+    return buf->len > 0;
+}
+
+void test_net_dispatch()
+{
+    dogecoin_node_group* group = dogecoin_node_group_new(NULL);
+    dogecoin_node *node = dogecoin_node_new();
+    u_assert_int_eq(dogecoin_node_set_ipport(node, "127.0.0.1:22556"), true);
+    dogecoin_node_group_add_node(group, node);
+
+    /* built-in commands are registered, unknown and invalid ones are not */
+    char command[12] = "ping";
+    u_assert_int_eq(dogecoin_node_group_get_handler(group, command) != NULL, 1);
+    memcpy(command, "pingpong", 8);
+    u_assert_int_eq(dogecoin_node_group_get_handler(group, command) == NULL, 1);
+    u_assert_int_eq(dogecoin_node_group_register_handler(group, "thirteenchars", count_handler), false);
+    u_assert_int_eq(dogecoin_node_group_register_handler(group, "", count_handler), false);
+    u_assert_int_eq(dogecoin_node_group_register_handler(group, "custom", count_handler), true);
+
+    unsigned char payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    cstring *msg = dogecoin_p2p_message_new(group->chainparams->netmagic, "custom", payload, sizeof(payload));
+    struct const_buffer buf = {msg->str, msg->len};
+    dogecoin_p2p_msg_hdr hdr;
+    dogecoin_p2p_deser_msghdr(&hdr, &buf);
+    u_assert_int_eq(dogecoin_node_parse_message(node, &hdr, &buf), true);
+    u_assert_int_eq(dispatched, 1);
+
+    /* a corrupted payload fails the checksum before any handler runs */
+    payload[0] ^= 1;
+    buf.p = payload;
+    buf.len = sizeof(payload);
+    u_assert_int_eq(dogecoin_node_parse_message(node, &hdr, &buf), false);
+    u_assert_int_eq(dispatched, 1);
+    u_assert_int_eq((node->state & NODE_MISSBEHAVED) == NODE_MISSBEHAVED, 1);
+
+    /* unless the group trusts loopback peers */
+    node->state = 0;
+    group->trust_local_peers = true;
+    u_assert_int_eq(dogecoin_node_parse_message(node, &hdr, &buf), true);
+    u_assert_int_eq(dispatched, 2);
+    u_assert_int_eq(node->state, 0);
+
+    /* IPv6 peers are only trusted on the loopback address */
+    u_assert_int_eq(dogecoin_node_set_ipport(node, "[2001:db8::1]:22556"), true);
+    u_assert_int_eq(dogecoin_node_parse_message(node, &hdr, &buf), false);
+    u_assert_int_eq(dispatched, 2);
+    node->state = 0;
+    u_assert_int_eq(dogecoin_node_set_ipport(node, "[::1]:22556"), true);
+    u_assert_int_eq(dogecoin_node_parse_message(node, &hdr, &buf), true);
+    u_assert_int_eq(dispatched, 3);
+    u_assert_int_eq(dogecoin_node_set_ipport(node, "127.0.0.1:22556"), true);
+    cstr_free(msg, true);
+
+    /* a handler rejecting the payload marks the peer */
+    msg = dogecoin_p2p_message_new(group->chainparams->netmagic, "custom", NULL, 0);
+    buf.p = msg->str;
+    buf.len = msg->len;
+    dogecoin_p2p_deser_msghdr(&hdr, &buf);
+    u_assert_int_eq(dogecoin_node_parse_message(node, &hdr, &buf), false);
+    u_assert_int_eq(dispatched, 4);
+    node->state = 0;
+
+    /* replaced and removed handlers */
+    u_assert_int_eq(dogecoin_node_group_register_handler(group, "custom", NULL), true);
+    u_assert_int_eq(dogecoin_node_parse_message(node, &hdr, &buf), true);
+    u_assert_int_eq(dispatched, 4);
+    u_assert_int_eq(dogecoin_node_group_register_handler(group, "verack", count_handler), true);
+    cstr_free(msg, true);
+    msg = dogecoin_p2p_message_new(group->chainparams->netmagic, "verack", payload, sizeof(payload));
+    buf.p = msg->str;
+    buf.len = msg->len;
+    dogecoin_p2p_deser_msghdr(&hdr, &buf);
+    u_assert_int_eq(dogecoin_node_parse_message(node, &hdr, &buf), true);
+    u_assert_int_eq(dispatched, 5);
+    u_assert_int_eq(node->version_handshake, false);
+    cstr_free(msg, true);
+
+    /* the table holds a fixed number of commands */
+    int i, registered = 0;
+    for (i = 0; i < DOGECOIN_NODE_MAX_HANDLERS; i++) {
+        char name[12];
+        sprintf(name, "cmd%d", i);
+        registered += dogecoin_node_group_register_handler(group, name, count_handler);
+    }
+    u_assert_int_eq(registered < DOGECOIN_NODE_MAX_HANDLERS, 1);
+    u_assert_int_eq(dogecoin_node_group_register_handler(group, "cmd0", NULL), true);
+
+    dogecoin_node_group_free(group);
+}
+
+/* a local peer that completes the handshake, answers pings and echoes "echo" messages.
+ * Like a relaying node, its even connections fetch announced transactions
+ * and it announces every transaction it received on its odd connections. */
+#define TEST_PEER_MAX_CONNS 16
+
+typedef struct test_peer_ {
+    struct event_base* base;
+    struct evconnlistener* listener;
+    const dogecoin_chainparams* chain;
+    pthread_t thread;
+    struct bufferevent* conns[TEST_PEER_MAX_CONNS];
+    int conn_count;
+    cstring* txids;
+    cstring* commands; /* every command received, 12 bytes each */
+} test_peer;
+
+static void test_peer_send(struct bufferevent* bev, const dogecoin_chainparams* chain, const char* command, const void* data, uint32_t len)
+{
+    cstring* msg = dogecoin_p2p_message_new(chain->netmagic, command, data, len);
+    bufferevent_write(bev, msg->str, msg->len);
+    cstr_free(msg, true);
+}
+
+static void test_peer_send_txids(struct bufferevent* bev, const dogecoin_chainparams* chain, const cstring* txids)
+{
+    cstring* inv = cstr_new_sz(256);
+    size_t i;
+    ser_varlen(inv, (uint32_t)(txids->len / DOGECOIN_HASH_LENGTH));
+    for (i = 0; i < txids->len; i += DOGECOIN_HASH_LENGTH) {
+        dogecoin_p2p_inv_msg inv_msg;
+        dogecoin_p2p_msg_inv_init(&inv_msg, DOGECOIN_INV_TYPE_TX, (uint8_t*)txids->str + i);
+        dogecoin_p2p_msg_inv_ser(&inv_msg, inv);
+    }
+    test_peer_send(bev, chain, "inv", inv->str, inv->len);
+    cstr_free(inv, true);
+}
+
+static int test_peer_conn_index(test_peer* peer, struct bufferevent* bev)
+{
+    int i;
+    for (i = 0; i < peer->conn_count; i++)
+        if (peer->conns[i] == bev)
+            return i;
+    return -1;
+}
+
+static void test_peer_read(struct bufferevent* bev, void* ctx)
+{
+    test_peer* peer = ctx;
+    struct evbuffer* input = bufferevent_get_input(bev);
+    int index = test_peer_conn_index(peer, bev);
+    while (evbuffer_get_length(input) >= DOGECOIN_P2P_HDRSZ) {
+        struct const_buffer buf = {evbuffer_pullup(input, DOGECOIN_P2P_HDRSZ), DOGECOIN_P2P_HDRSZ};
+        dogecoin_p2p_msg_hdr hdr;
+        dogecoin_p2p_deser_msghdr(&hdr, &buf);
+        if (evbuffer_get_length(input) < DOGECOIN_P2P_HDRSZ + hdr.data_len)
+            break;
+        unsigned char* raw = evbuffer_pullup(input, DOGECOIN_P2P_HDRSZ + hdr.data_len);
+        cstr_append_buf(peer->commands, hdr.command, sizeof(hdr.command));
+        if (strcmp(hdr.command, "version") == 0) {
+            dogecoin_p2p_address addr;
+            dogecoin_p2p_version_msg version;
+            cstring* payload = cstr_new_sz(256);
+            dogecoin_p2p_address_init(&addr);
+            dogecoin_p2p_msg_version_init(&version, &addr, &addr, "test peer", true);
+            version.services = DOGECOIN_NODE_NETWORK;
+            dogecoin_p2p_msg_version_ser(&version, payload);
+            test_peer_send(bev, peer->chain, "version", payload->str, payload->len);
+            test_peer_send(bev, peer->chain, "verack", NULL, 0);
+            cstr_free(payload, true);
+        } else if (strcmp(hdr.command, "verack") == 0) {
+            if (index % 2 == 1 && peer->txids->len > 0)
+                test_peer_send_txids(bev, peer->chain, peer->txids);
+        } else if (strcmp(hdr.command, "echo") == 0) {
+            test_peer_send(bev, peer->chain, "echo", raw + DOGECOIN_P2P_HDRSZ, hdr.data_len);
+        } else if (strcmp(hdr.command, "ping") == 0) {
+            test_peer_send(bev, peer->chain, "pong", raw + DOGECOIN_P2P_HDRSZ, hdr.data_len);
+        } else if (strcmp(hdr.command, "inv") == 0) {
+            if (index % 2 == 0)
+                test_peer_send(bev, peer->chain, "getdata", raw + DOGECOIN_P2P_HDRSZ, hdr.data_len);
+        } else if (strcmp(hdr.command, "tx") == 0) {
+            uint256 txid;
+            dogecoin_dblhash(raw + DOGECOIN_P2P_HDRSZ, hdr.data_len, txid);
+            cstr_append_buf(peer->txids, txid, DOGECOIN_HASH_LENGTH);
+            cstring* single = cstr_new_buf(txid, DOGECOIN_HASH_LENGTH);
+            int i;
+            for (i = 1; i < peer->conn_count; i += 2)
+                if (peer->conns[i])
+                    test_peer_send_txids(peer->conns[i], peer->chain, single);
+            cstr_free(single, true);
+        }
+        evbuffer_drain(input, DOGECOIN_P2P_HDRSZ + hdr.data_len);
+    }
+}
+
+static void test_peer_event(struct bufferevent* bev, short what, void* ctx)
+{
+    test_peer* peer = ctx;
+    if (what & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+        int index = test_peer_conn_index(peer, bev);
+        if (index >= 0)
+            peer->conns[index] = NULL;
+        bufferevent_free(bev);
+    }
+}
+
+static void test_peer_accept(struct evconnlistener* listener, evutil_socket_t fd, struct sockaddr* addr, int len, void* ctx)
+{
+    (void)(listener);
+    (void)(addr);
+    (void)(len);
+    test_peer* peer = ctx;
+    struct bufferevent* bev = bufferevent_socket_new(peer->base, fd, BEV_OPT_CLOSE_ON_FREE);
+    if (peer->conn_count < TEST_PEER_MAX_CONNS)
+        peer->conns[peer->conn_count++] = bev;
+    bufferevent_setcb(bev, test_peer_read, NULL, test_peer_event, peer);
+    bufferevent_enable(bev, EV_READ | EV_WRITE);
+}
+
+static void* test_peer_run(void* ctx)
+{
+    test_peer* peer = ctx;
+    event_base_loop(peer->base, EVLOOP_NO_EXIT_ON_EMPTY);
+    return NULL;
+}
+
+/* listens on an ephemeral port of 127.0.0.1 and returns it, 0 on failure */
+static int test_peer_start(test_peer* peer, const dogecoin_chainparams* chain)
+{
+    struct sockaddr_in sin;
+    memset(peer, 0, sizeof(*peer));
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(0x7f000001);
+    peer->chain = chain;
+    peer->txids = cstr_new_sz(256);
+    peer->commands = cstr_new_sz(256);
+    peer->base = event_base_new();
+    peer->listener = evconnlistener_new_bind(peer->base, test_peer_accept, peer, LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1, (struct sockaddr*)&sin, sizeof(sin));
+    if (!peer->listener)
+        return 0;
+    socklen_t sin_len = sizeof(sin);
+    getsockname(evconnlistener_get_fd(peer->listener), (struct sockaddr*)&sin, &sin_len);
+    if (pthread_create(&peer->thread, NULL, test_peer_run, peer) != 0)
+        return 0;
+    return ntohs(sin.sin_port);
+}
+
+static void test_peer_stop(test_peer* peer)
+{
+    event_base_loopbreak(peer->base);
+    pthread_join(peer->thread, NULL);
+    int i;
+    for (i = 0; i < peer->conn_count; i++)
+        if (peer->conns[i])
+            bufferevent_free(peer->conns[i]);
+    evconnlistener_free(peer->listener);
+    event_base_free(peer->base);
+    cstr_free(peer->txids, true);
+    cstr_free(peer->commands, true);
+}
+
+#define THREADS_TEST_NODES 8
+
+static pthread_mutex_t threads_test_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t threads_test_main;
+static int threads_test_handshakes = 0;
+static int threads_test_echoes = 0;
+static int threads_test_on_main = 0;
+
+static void threads_test_handshake_done(struct dogecoin_node_ *node)
+{
+    pthread_mutex_lock(&threads_test_lock);
+    threads_test_handshakes++;
+    pthread_mutex_unlock(&threads_test_lock);
+    cstring *msg = dogecoin_p2p_message_new(node->nodegroup->chainparams->netmagic, "echo", &node->nodeid, sizeof(node->nodeid));
+    dogecoin_node_send(node, msg);
+    cstr_free(msg, true);
+}
+
+static dogecoin_bool threads_test_echo(struct dogecoin_node_ *node, dogecoin_p2p_msg_hdr *hdr, struct const_buffer *buf)
+{
+    (void)(hdr);
+    int nodeid = 0;
+    if (buf->len != sizeof(nodeid))
+        return false;
+    memcpy(&nodeid, buf->p, sizeof(nodeid));
+    pthread_mutex_lock(&threads_test_lock);
+    threads_test_echoes += nodeid == node->nodeid;
+    threads_test_on_main += pthread_equal(pthread_self(), threads_test_main) != 0;
+    dogecoin_bool done = threads_test_echoes == THREADS_TEST_NODES;
+    pthread_mutex_unlock(&threads_test_lock);
+    /* disconnecting from a worker is handed over to the nodes' event threads */
+    if (done)
+        dogecoin_node_group_shutdown(node->nodegroup);
+    return true;
+}
+
+void test_net_threads()
+{
+    dogecoin_node_group* group = dogecoin_node_group_new(NULL);
+    u_assert_int_eq(dogecoin_node_group_set_threads(group, 0, 2), false);
+    u_assert_int_eq(dogecoin_node_group_set_threads(group, 3, 2), true);
+    u_assert_int_eq(dogecoin_node_group_set_threads(group, 3, 2), false);
+
+    test_peer peer;
+    int port = test_peer_start(&peer, group->chainparams);
+    u_assert_int_eq(port != 0, 1);
+
+    char ipport[32];
+    sprintf(ipport, "127.0.0.1:%d", port);
+    int i;
+    for (i = 0; i < THREADS_TEST_NODES; i++) {
+        dogecoin_node *node = dogecoin_node_new();
+        u_assert_int_eq(dogecoin_node_set_ipport(node, ipport), true);
+        dogecoin_node_group_add_node(group, node);
+    }
+    group->desired_amount_connected_nodes = THREADS_TEST_NODES;
+    group->periodic_timer_cb = timer_cb;
+    group->handshake_done_cb = threads_test_handshake_done;
+    u_assert_int_eq(dogecoin_node_group_register_handler(group, "echo", threads_test_echo), true);
+
+    threads_test_main = pthread_self();
+    dogecoin_node_group_connect_next_nodes(group);
+    dogecoin_node_group_event_loop(group);
+
+    u_assert_int_eq(threads_test_handshakes, THREADS_TEST_NODES);
+    u_assert_int_eq(threads_test_echoes, THREADS_TEST_NODES);
+    u_assert_int_eq(threads_test_on_main, 0);
+    u_assert_int_eq(dogecoin_node_group_amount_of_connected_nodes(group, NODE_CONNECTED), 0);
+    dogecoin_node *first = vector_idx(group->nodes, 0);
+    dogecoin_node *second = vector_idx(group->nodes, 1);
+    u_assert_int_eq(first->shard != NULL && first->shard != second->shard, 1);
+
+    test_peer_stop(&peer);
+    dogecoin_node_group_free(group);
+}
+
+static int stats_test_reports = 0;
+static dogecoin_node_group_stats stats_test_group;
+
+static const dogecoin_node_cmd_stats *stats_test_cmd(const dogecoin_node_stats *stats, const char *command)
+{
+    size_t i;
+    for (i = 0; i < stats->cmd_count; i++)
+        if (strncmp(stats->cmds[i].command, command, sizeof(stats->cmds[i].command)) == 0)
+            return &stats->cmds[i];
+    return NULL;
+}
+
+/* reports once every node's ping has been answered and disconnects */
+static void stats_test_report(dogecoin_node_group *group, const dogecoin_node_group_stats *stats)
+{
+    size_t i;
+    for (i = 0; i < group->nodes->len; i++) {
+        dogecoin_node_stats node_stats;
+        dogecoin_node_get_stats(vector_idx(group->nodes, i), &node_stats);
+        if (node_stats.pongs == 0)
+            return;
+    }
+    if (stats_test_reports++ == 0) {
+        stats_test_group = *stats;
+        dogecoin_node_group_shutdown(group);
+    }
+}
+
+void test_net_stats()
+{
+    dogecoin_node_group* group = dogecoin_node_group_new(NULL);
+    u_assert_int_eq(dogecoin_node_group_set_threads(group, 2, 1), true);
+    test_peer peer;
+    int port = test_peer_start(&peer, group->chainparams);
+    u_assert_int_eq(port != 0, 1);
+
+    char ipport[32];
+    sprintf(ipport, "127.0.0.1:%d", port);
+    int i;
+    for (i = 0; i < 2; i++) {
+        dogecoin_node *node = dogecoin_node_new();
+        u_assert_int_eq(dogecoin_node_set_ipport(node, ipport), true);
+        dogecoin_node_group_add_node(group, node);
+    }
+    group->desired_amount_connected_nodes = 2;
+    group->handshake_done_cb = dogecoin_node_send_ping;
+    group->stats_interval_s = 1;
+    group->stats_cb = stats_test_report;
+
+    dogecoin_node_group_connect_next_nodes(group);
+    dogecoin_node_group_event_loop(group);
+
+    u_assert_int_eq(stats_test_reports, 1);
+    u_assert_int_eq(stats_test_group.connected, 2);
+    u_assert_int_eq(stats_test_group.worker_queue, 0);
+    uint64_t msgs_in = 0;
+    for (i = 0; i < 2; i++) {
+        dogecoin_node_stats stats;
+        dogecoin_node_get_stats(vector_idx(group->nodes, i), &stats);
+        u_assert_int_eq(stats.nodeid, i + 1);
+        u_assert_int_eq(stats.pongs, 1);
+        u_assert_int_eq(stats.ping_ms, stats.ping_min_ms);
+        u_assert_int_eq(stats.handshake_ms < 10000, 1);
+        u_assert_int_eq(stats.send_queue, 0);
+        /* version, verack and pong in; version, verack and ping out */
+        u_assert_int_eq(stats.msgs_in, 3);
+        u_assert_int_eq(stats.msgs_out, 3);
+        const dogecoin_node_cmd_stats *cmd = stats_test_cmd(&stats, "pong");
+        u_assert_int_eq(cmd != NULL, 1);
+        u_assert_int_eq(cmd->msgs_in, 1);
+        u_assert_int_eq(cmd->bytes_in, DOGECOIN_P2P_HDRSZ + 8);
+        cmd = stats_test_cmd(&stats, "ping");
+        u_assert_int_eq(cmd->msgs_out, 1);
+        u_assert_int_eq(cmd->bytes_out, DOGECOIN_P2P_HDRSZ + 8);
+        cmd = stats_test_cmd(&stats, "verack");
+        u_assert_int_eq(cmd->msgs_in + cmd->msgs_out, 2);
+        u_assert_int_eq(cmd->bytes_in, DOGECOIN_P2P_HDRSZ);
+        cmd = stats_test_cmd(&stats, "version");
+        u_assert_int_eq(stats.bytes_in, cmd->bytes_in + 2 * DOGECOIN_P2P_HDRSZ + 8);
+        msgs_in += stats.msgs_in;
+    }
+    u_assert_int_eq(stats_test_group.msgs_in, msgs_in);
+
+    test_peer_stop(&peer);
+    dogecoin_node_group_free(group);
+}
+
+/* messages of 20 KB against a 32 KB high and 8 KB low watermark and a 64 KB limit */
+#define SEND_TEST_BULK_SZ 20000
+
+static dogecoin_bool send_test_accepted[4];
+static dogecoin_bool send_test_paused = false;
+static dogecoin_node_stats send_test_stats;
+static int send_test_resumed = 0;
+
+static void send_test_message(dogecoin_node *node, const char *command, dogecoin_bool *accepted)
+{
+    static unsigned char payload[SEND_TEST_BULK_SZ];
+    dogecoin_bool bulk = strcmp(command, "block") == 0;
+    cstring *msg = dogecoin_p2p_message_new(node->nodegroup->chainparams->netmagic, command, payload, bulk ? SEND_TEST_BULK_SZ : 8);
+    dogecoin_bool sent = dogecoin_node_send(node, msg);
+    if (accepted)
+        *accepted = sent;
+    cstr_free(msg, true);
+}
+
+/* nothing is written to the socket before the callback returns */
+static void send_test_burst(struct dogecoin_node_ *node)
+{
+    send_test_message(node, "block", &send_test_accepted[0]);
+    send_test_message(node, "block", &send_test_accepted[1]);
+    send_test_message(node, "ping", NULL);
+    send_test_message(node, "block", &send_test_accepted[2]);
+    send_test_message(node, "block", &send_test_accepted[3]);
+    send_test_paused = dogecoin_node_send_paused(node);
+    dogecoin_node_get_stats(node, &send_test_stats);
+}
+
+/* the echo returns once the peer read everything sent before it */
+static void send_test_resumed_cb(struct dogecoin_node_ *node)
+{
+    send_test_resumed++;
+    send_test_message(node, "echo", NULL);
+}
+
+static dogecoin_bool send_test_echo(struct dogecoin_node_ *node, dogecoin_p2p_msg_hdr *hdr, struct const_buffer *buf)
+{
+    (void)(hdr);
+    (void)(buf);
+    dogecoin_node_group_shutdown(node->nodegroup);
+    return true;
+}
+
+void test_net_send_queue()
+{
+    dogecoin_node_group* group = dogecoin_node_group_new(NULL);
+    test_peer peer;
+    int port = test_peer_start(&peer, group->chainparams);
+    u_assert_int_eq(port != 0, 1);
+
+    char ipport[32];
+    sprintf(ipport, "127.0.0.1:%d", port);
+    dogecoin_node *node = dogecoin_node_new();
+    u_assert_int_eq(dogecoin_node_set_ipport(node, ipport), true);
+    dogecoin_node_group_add_node(group, node);
+    group->desired_amount_connected_nodes = 1;
+    group->send_limit = 64 * 1024;
+    group->send_high_watermark = 32 * 1024;
+    group->send_low_watermark = 8 * 1024;
+    group->handshake_done_cb = send_test_burst;
+    group->send_resumed_cb = send_test_resumed_cb;
+    u_assert_int_eq(dogecoin_node_group_register_handler(group, "echo", send_test_echo), true);
+
+    dogecoin_node_group_connect_next_nodes(group);
+    dogecoin_node_group_event_loop(group);
+
+    /* the second block waits, the ping overtakes it and the fourth block would pass the limit */
+    u_assert_int_eq(send_test_accepted[0], true);
+    u_assert_int_eq(send_test_accepted[1], true);
+    u_assert_int_eq(send_test_accepted[2], true);
+    u_assert_int_eq(send_test_accepted[3], false);
+    u_assert_int_eq(send_test_paused, true);
+    u_assert_int_eq(send_test_stats.send_queue >= 3 * (DOGECOIN_P2P_HDRSZ + SEND_TEST_BULK_SZ), 1);
+    u_assert_int_eq(send_test_resumed, 1);
+    u_assert_int_eq(dogecoin_node_send_paused(node), false);
+
+    const char *expected[] = {"version", "verack", "block", "ping", "block", "block", "echo"};
+    size_t i;
+    u_assert_int_eq(peer.commands->len, sizeof(expected) / sizeof(expected[0]) * 12);
+    for (i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+        u_assert_str_eq(peer.commands->str + i * 12, expected[i]);
+
+    test_peer_stop(&peer);
+    dogecoin_node_group_free(group);
+}
+
+#define BROADCASTER_TEST_TXS 5
+
+static pthread_mutex_t broadcaster_test_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t broadcaster_test_cond = PTHREAD_COND_INITIALIZER;
+static int broadcaster_test_seen = 0;
+static int broadcaster_test_expired = 0;
+
+static void broadcaster_test_status(dogecoin_broadcaster *broadcaster, const dogecoin_broadcast_status *status)
+{
+    (void)(broadcaster);
+    pthread_mutex_lock(&broadcaster_test_lock);
+    broadcaster_test_seen += status->state == DOGECOIN_BROADCAST_SEEN;
+    broadcaster_test_expired += status->state == DOGECOIN_BROADCAST_EXPIRED;
+    pthread_cond_broadcast(&broadcaster_test_cond);
+    pthread_mutex_unlock(&broadcaster_test_lock);
+}
+
+/* waits up to 10 seconds for a status counter to reach the target */
+static int broadcaster_test_wait(const int *counter, int target)
+{
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += 10;
+    pthread_mutex_lock(&broadcaster_test_lock);
+    while (*counter < target && pthread_cond_timedwait(&broadcaster_test_cond, &broadcaster_test_lock, &until) == 0);
+    int value = *counter;
+    pthread_mutex_unlock(&broadcaster_test_lock);
+    return value;
+}
+
+void test_net_broadcaster()
+{
+    test_peer peer;
+    int port = test_peer_start(&peer, &dogecoin_chainparams_main);
+    u_assert_int_eq(port != 0, 1);
+
+    /* the peer fetches transactions on its first connection and announces them on its second */
+    char ips[64];
+    sprintf(ips, "127.0.0.1:%d,127.0.0.1:%d", port, port);
+    dogecoin_broadcaster *broadcaster = dogecoin_broadcaster_new(&dogecoin_chainparams_main, ips, 2);
+    u_assert_int_eq(broadcaster != NULL, 1);
+    broadcaster->inv_interval_ms = 20;
+    broadcaster->status_cb = broadcaster_test_status;
+
+    uint256 txids[BROADCASTER_TEST_TXS];
+    dogecoin_broadcast_status status;
+    unsigned char garbage[4] = {0x01, 0x00, 0x00, 0x00};
+    u_assert_int_eq(dogecoin_broadcaster_add_raw(broadcaster, garbage, sizeof(garbage), NULL), false);
+
+    int i;
+    for (i = 0; i < BROADCASTER_TEST_TXS; i++) {
+        dogecoin_tx *tx = test_util_tx(NULLHASH, i);
+        test_util_add_out(tx, 100000000, "\x51", 1);
+        if (i == 0) {
+            cstring *raw = cstr_new_sz(256);
+            dogecoin_tx_serialize(raw, tx);
+            u_assert_int_eq(dogecoin_broadcaster_add_raw(broadcaster, (unsigned char *)raw->str, raw->len, txids[i]), true);
+            cstr_free(raw, true);
+        } else {
+            u_assert_int_eq(dogecoin_broadcaster_add_tx(broadcaster, tx, txids[i]), true);
+        }
+        uint256 hash;
+        dogecoin_tx_hash(tx, hash);
+        u_assert_mem_eq(hash, txids[i], sizeof(hash));
+        u_assert_int_eq(dogecoin_broadcaster_add_tx(broadcaster, tx, NULL), false);
+        dogecoin_tx_free(tx);
+    }
+    u_assert_int_eq(dogecoin_broadcaster_get_status(broadcaster, txids[0], &status), true);
+    u_assert_int_eq(status.state, DOGECOIN_BROADCAST_QUEUED);
+    /* nothing is announced without peers */
+    u_assert_int_eq(dogecoin_broadcaster_flush(broadcaster), 0);
+
+    u_assert_int_eq(dogecoin_broadcaster_start(broadcaster), true);
+    u_assert_int_eq(dogecoin_broadcaster_start(broadcaster), false);
+    u_assert_int_eq(broadcaster_test_wait(&broadcaster_test_seen, BROADCASTER_TEST_TXS), BROADCASTER_TEST_TXS);
+    dogecoin_broadcaster_stop(broadcaster);
+
+    for (i = 0; i < BROADCASTER_TEST_TXS; i++) {
+        u_assert_int_eq(dogecoin_broadcaster_get_status(broadcaster, txids[i], &status), true);
+        u_assert_int_eq(status.state, DOGECOIN_BROADCAST_SEEN);
+        u_assert_int_eq(status.requested, 1);
+        u_assert_int_eq(status.seen, 1);
+        u_assert_int_eq(status.announced >= 1, 1);
+    }
+    u_assert_int_eq(dogecoin_broadcaster_get_status(broadcaster, NULLHASH, &status), false);
+
+    /* without the peer the next flush expires everything, only the unseen transaction is reported */
+    test_peer_stop(&peer);
+    dogecoin_tx *tx = test_util_tx(NULLHASH, BROADCASTER_TEST_TXS);
+    test_util_add_out(tx, 100000000, "\x51", 1);
+    u_assert_int_eq(dogecoin_broadcaster_add_tx(broadcaster, tx, NULL), true);
+    dogecoin_tx_free(tx);
+    broadcaster->expiry_s = 0;
+    u_assert_int_eq(dogecoin_broadcaster_start(broadcaster), true);
+    u_assert_int_eq(broadcaster_test_wait(&broadcaster_test_expired, 1), 1);
+    u_assert_int_eq(dogecoin_broadcaster_get_status(broadcaster, txids[0], &status), false);
+
+    dogecoin_broadcaster_free(broadcaster);
+}
+
+/* a local dns server for the seeds: fast.seed.test is 127.0.0.1 and ::1, slow.seed.test never answers */
+typedef struct dns_test_server_ {
+    struct event_base* base;
+    struct evdns_server_port* port;
+    evutil_socket_t fd;
+    pthread_t thread;
+} dns_test_server;
+
+static void dns_test_answer(struct evdns_server_request* req, void* ctx)
+{
+    (void)(ctx);
+    int i;
+    for (i = 0; i < req->nquestions; i++) {
+        const struct evdns_server_question* question = req->questions[i];
+        /* resolvers randomize the case of the names they ask for */
+        if (evutil_ascii_strcasecmp(question->name, "fast.seed.test") != 0) {
+            evdns_server_request_drop(req);
+            return;
+        }
+        if (question->type == EVDNS_TYPE_A) {
+            uint32_t ipv4 = htonl(0x7f000001);
+            evdns_server_request_add_a_reply(req, question->name, 1, &ipv4, 60);
+        } else if (question->type == EVDNS_TYPE_AAAA) {
+            struct in6_addr ipv6 = IN6ADDR_LOOPBACK_INIT;
+            evdns_server_request_add_aaaa_reply(req, question->name, 1, &ipv6, 60);
+        }
+    }
+    evdns_server_request_respond(req, 0);
+}
+
+static void* dns_test_run(void* ctx)
+{
+    dns_test_server* server = ctx;
+    event_base_loop(server->base, EVLOOP_NO_EXIT_ON_EMPTY);
+    return NULL;
+}
+
+/* serves on an ephemeral udp port of 127.0.0.1 and returns it, 0 on failure */
+static int dns_test_start(dns_test_server* server)
+{
+    struct sockaddr_in sin;
+    memset(server, 0, sizeof(*server));
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(0x7f000001);
+    server->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (server->fd < 0 || bind(server->fd, (struct sockaddr*)&sin, sizeof(sin)) != 0)
+        return 0;
+    evutil_make_socket_nonblocking(server->fd);
+    socklen_t sin_len = sizeof(sin);
+    getsockname(server->fd, (struct sockaddr*)&sin, &sin_len);
+    server->base = event_base_new();
+    server->port = evdns_add_server_port_with_base(server->base, server->fd, 0, dns_test_answer, server);
+    if (!server->port || pthread_create(&server->thread, NULL, dns_test_run, server) != 0)
+        return 0;
+    return ntohs(sin.sin_port);
+}
+
+static void dns_test_stop(dns_test_server* server)
+{
+    event_base_loopbreak(server->base);
+    pthread_join(server->thread, NULL);
+    evdns_close_server_port(server->port);
+    event_base_free(server->base);
+    evutil_closesocket(server->fd);
+}
+
+static uint64_t dns_test_start_ms = 0;
+static uint64_t dns_test_handshake_ms = 0;
+static int dns_test_handshakes = 0;
+
+static uint64_t dns_test_now_ms(void)
+{
+    struct timeval tv;
+    evutil_gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void dns_test_handshake_done(struct dogecoin_node_ *node)
+{
+    if (dns_test_handshakes++ == 0)
+        dns_test_handshake_ms = dns_test_now_ms() - dns_test_start_ms;
+    dogecoin_node_disconnect(node);
+}
+
+void test_net_dns_seeds()
+{
+    dogecoin_chainparams chain;
+    memcpy(&chain, &dogecoin_chainparams_main, sizeof(chain));
+    memset(chain.dnsseeds, 0, sizeof(chain.dnsseeds));
+    strcpy(chain.dnsseeds[0].domain, "slow.seed.test");
+    strcpy(chain.dnsseeds[1].domain, "fast.seed.test");
+
+    test_peer peer;
+    chain.default_port = test_peer_start(&peer, &chain);
+    u_assert_int_eq(chain.default_port != 0, 1);
+    dns_test_server server;
+    int dns_port = dns_test_start(&server);
+    u_assert_int_eq(dns_port != 0, 1);
+
+    char nameserver[32];
+    sprintf(nameserver, "127.0.0.1:%d", dns_port);
+    dogecoin_addrman* addrman = dogecoin_addrman_new(&chain);
+    dogecoin_node_group* group = dogecoin_node_group_new(&chain);
+    group->dns_nameserver = nameserver;
+    group->addrman = addrman;
+    group->desired_amount_connected_nodes = 2;
+    group->handshake_done_cb = dns_test_handshake_done;
+
+    /* nothing is resolved before the loop runs */
+    dns_test_start_ms = dns_test_now_ms();
+    u_assert_int_eq(dogecoin_node_group_seed_async(group, 1), true);
+    u_assert_int_eq(dogecoin_node_group_seed_async(group, 1), false);
+    u_assert_int_eq(group->nodes->len, 0);
+    u_assert_int_eq(dogecoin_node_group_set_threads(group, 1, 0), false);
+    dogecoin_node_group_connect_next_nodes(group);
+    dogecoin_node_group_event_loop(group);
+    uint64_t elapsed_ms = dns_test_now_ms() - dns_test_start_ms;
+
+    /* the fast seed was connected to while the slow one was still timing out */
+    u_assert_int_eq(dns_test_handshakes, 1);
+    u_assert_int_eq(dns_test_handshake_ms < 1000, 1);
+    u_assert_int_eq(elapsed_ms >= 900, 1);
+    u_assert_int_eq(group->nodes->len, 2);
+    u_assert_int_eq(dogecoin_addrman_size(addrman), 2);
+    int families = 0;
+    size_t i;
+    for (i = 0; i < group->nodes->len; i++) {
+        dogecoin_node *node = vector_idx(group->nodes, i);
+        families |= node->addr.ss_family == AF_INET ? 1 : node->addr.ss_family == AF_INET6 ? 2 : 0;
+        u_assert_int_eq(ntohs(((struct sockaddr_in*)&node->addr)->sin_port), chain.default_port);
+    }
+    u_assert_int_eq(families, 3);
+
+    dogecoin_node_group_free(group);
+    dogecoin_addrman_free(addrman);
+    dns_test_stop(&server);
+    test_peer_stop(&peer);
+}
+
 void test_net_basics_plus_download_block()
 {
 
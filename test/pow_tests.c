@@ -0,0 +1,235 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dogecoin/block.h>
+#include <dogecoin/chainparams.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/pow.h>
+#include <dogecoin/scrypt.h>
+#include <dogecoin/utils.h>
+
+#include "utest.h"
+
+/* genesis and 331337, scrypt hashes in byte order */
+static const char* pow_test_headers[2] = {
+    "010000000000000000000000000000000000000000000000000000000000000000000000696ad20e2dd4365c7459b4a4a5af743d5e92c6da3229e6532cd605f6533f2a5b24a6a152f0ff0f1e67860100",
+    "020162000d6f03470d329026cd1fc720c0609cd378ca8691a117bd1aa46f01fb09b1a8468a15bf6f0b0e83f2e5036684169eafb9406468d4f075c999fb5b2a78fbb827ee41fb11548441361b00000000"};
+static const char* pow_test_hashes[2] = {
+    "48b41053487d4159cfaacf3adad783cf2f2dedea1413250cca74783f6f020000",
+    "4691c32f2a5dafa1619a3eb63d80c5100fb7630cddf7fb258425a034feda8624"};
+
+void test_scrypt()
+{
+    uint8_t inputs[11 * 80], outputs[11 * 32], expected[32];
+    size_t outlen;
+    unsigned int i;
+
+    for (i = 0; i < 2; i++) {
+        utils_hex_to_bin(pow_test_headers[i], inputs, 160, &outlen);
+        utils_hex_to_bin(pow_test_hashes[i], expected, 64, &outlen);
+        dogecoin_scrypt_1024_1_1_256(inputs, outputs);
+        u_assert_mem_eq(outputs, expected, 32);
+    }
+
+    /* the batch lanes agree with the single hash, 4 runs the 4-way path,
+     * 11 the widest one plus the remainder */
+    for (i = 0; i < 11; i++) {
+        utils_hex_to_bin(pow_test_headers[i % 2], inputs + i * 80, 160, &outlen);
+        inputs[i * 80 + 76] ^= (uint8_t)i;
+    }
+    dogecoin_scrypt_1024_1_1_256_batch(inputs, 4, outputs);
+    for (i = 0; i < 4; i++) {
+        dogecoin_scrypt_1024_1_1_256(inputs + i * 80, expected);
+        u_assert_mem_eq(outputs + i * 32, expected, 32);
+    }
+    dogecoin_scrypt_1024_1_1_256_batch(inputs, 11, outputs);
+    for (i = 0; i < 11; i++) {
+        dogecoin_scrypt_1024_1_1_256(inputs + i * 80, expected);
+        u_assert_mem_eq(outputs + i * 32, expected, 32);
+    }
+    u_assert_int_eq(dogecoin_scrypt_lanes() >= 1, 1);
+}
+
+void test_pow()
+{
+    uint256 target;
+    uint8_t data[80];
+    size_t outlen;
+    dogecoin_block_header genesis, other;
+    struct const_buffer buf = {data, 80};
+
+    u_assert_int_eq(dogecoin_pow_compact_to_target(0x1e0ffff0, target), true);
+    u_assert_int_eq(target[29], 0x0f);
+    u_assert_int_eq(target[28], 0xff);
+    u_assert_int_eq(target[27], 0xf0);
+    u_assert_int_eq(target[26], 0x00);
+    u_assert_int_eq(dogecoin_pow_compact_to_target(0x01003456, target), false); /* zero */
+    u_assert_int_eq(dogecoin_pow_compact_to_target(0x04923456, target), false); /* negative */
+    u_assert_int_eq(dogecoin_pow_compact_to_target(0xff123456, target), false); /* overflow */
+    u_assert_int_eq(dogecoin_pow_compact_to_target(0x02123456, target), true);
+    u_assert_int_eq(target[0], 0x34);
+    u_assert_int_eq(target[1], 0x12);
+
+    /* work is 2^256 / (target + 1) */
+    uint256 work, sum;
+    u_assert_int_eq(dogecoin_pow_block_work(0x1d00ffff, work), true);
+    u_assert_int_eq(work[0], 0x01);
+    u_assert_int_eq(work[1], 0x00);
+    u_assert_int_eq(work[2], 0x01);
+    u_assert_int_eq(work[4], 0x01);
+    u_assert_int_eq(work[5], 0x00);
+    u_assert_int_eq(dogecoin_pow_block_work(0x207fffff, work), true);
+    u_assert_int_eq(work[0], 0x02);
+    u_assert_int_eq(work[1], 0x00);
+    memset(sum, 0xff, 8);
+    memset(sum + 8, 0, sizeof(sum) - 8);
+    dogecoin_pow_work_add(sum, work);
+    u_assert_int_eq(sum[0], 0x01);
+    u_assert_int_eq(sum[8], 0x01);
+    u_assert_int_eq(dogecoin_pow_work_cmp(sum, work), 1);
+    u_assert_int_eq(dogecoin_pow_work_cmp(work, sum), -1);
+    u_assert_int_eq(dogecoin_pow_work_cmp(work, work), 0);
+    u_assert_int_eq(dogecoin_pow_block_work(0x01003456, work), false);
+
+    utils_hex_to_bin(pow_test_headers[0], data, 160, &outlen);
+    dogecoin_block_header_deserialize(&genesis, &buf);
+    u_assert_int_eq(dogecoin_block_header_check_pow(&genesis, NULL, &dogecoin_chainparams_main), true);
+
+    other = genesis;
+    other.nonce++;
+    u_assert_int_eq(dogecoin_block_header_check_pow(&other, NULL, &dogecoin_chainparams_main), false);
+    /* the genesis header proves work for another header with the same target */
+    u_assert_int_eq(dogecoin_block_header_check_pow(&other, &genesis, &dogecoin_chainparams_main), true);
+
+    /* a target easier than the limit is rejected on mainnet but fine on regtest */
+    other.bits = 0x207fffff;
+    uint256 hash;
+    dogecoin_block_header_pow_hash(&genesis, hash);
+    u_assert_int_eq(dogecoin_pow_check(hash, other.bits, &dogecoin_chainparams_main), false);
+    u_assert_int_eq(dogecoin_pow_check(hash, other.bits, &dogecoin_chainparams_regtest), true);
+
+    const dogecoin_block_header* headers[5] = {&genesis, &genesis, &other, &genesis, &genesis};
+    uint32_t bits[5] = {genesis.bits, genesis.bits, genesis.bits, genesis.bits, 0x1d00ffff};
+    dogecoin_bool valid[5];
+    other.bits = genesis.bits;
+    u_assert_int_eq(dogecoin_block_headers_check_pow(headers, bits, 5, &dogecoin_chainparams_main, valid), false);
+    u_assert_int_eq(valid[0], true);
+    u_assert_int_eq(valid[1], true);
+    u_assert_int_eq(valid[2], false);
+    u_assert_int_eq(valid[3], true);
+    u_assert_int_eq(valid[4], false);
+    u_assert_int_eq(dogecoin_block_headers_check_pow(headers, bits, 2, &dogecoin_chainparams_main, NULL), true);
+}
+
+void test_pow_retarget()
+{
+    const dogecoin_chainparams* main = &dogecoin_chainparams_main;
+    const dogecoin_chainparams* test = &dogecoin_chainparams_test;
+    dogecoin_pow_context ctx;
+    dogecoin_block_header header;
+    uint256 target, hash;
+    uint32_t bits, i, t0 = 1500000000;
+
+    /* compact round trips, the sign bit moves into the exponent */
+    u_assert_int_eq(dogecoin_pow_compact_to_target(0x1b0404cb, target), true);
+    u_assert_int_eq(dogecoin_pow_target_to_compact(target), 0x1b0404cb);
+    u_assert_int_eq(dogecoin_pow_compact_to_target(0x207fffff, target), true);
+    u_assert_int_eq(dogecoin_pow_target_to_compact(target), 0x207fffff);
+    memset(target, 0, sizeof(target));
+    target[0] = 0x80;
+    u_assert_int_eq(dogecoin_pow_target_to_compact(target), 0x02008000);
+
+    /* digishield: damped by 1/8 and clamped to -25%/+50% of a minute */
+    u_assert_int_eq(dogecoin_pow_calculate_next_bits(0x1b0404cb, 200000, 60, main), 0x1b0404cb);
+    u_assert_int_eq(dogecoin_pow_calculate_next_bits(0x1e0ffff0, 200000, 0, main), 0x1e0e2214);
+    u_assert_int_eq(dogecoin_pow_calculate_next_bits(0x1b0404cb, 200000, 1000, main), 0x1b060730);
+    u_assert_int_eq(dogecoin_pow_calculate_next_bits(0x1e0ffff0, 200000, 1000, main), main->pow_limit);
+    /* before digishield: four hour periods, clamped harder in the early chain */
+    u_assert_int_eq(dogecoin_pow_calculate_next_bits(0x1b0404cb, 5280, 28800, main), 0x1b080996);
+    u_assert_int_eq(dogecoin_pow_calculate_next_bits(0x1c0404cb, 480, 1, main), 0x1b404cb0);
+
+    /* an incrementally advanced context on mainnet */
+    dogecoin_pow_context_init(&ctx, main);
+    for (i = 0; i < 11; i++) {
+        memset(hash, (int)i, sizeof(hash));
+        dogecoin_pow_context_add(&ctx, hash, 199990 + i, 0x1b0404cb, t0 + 60 * i);
+    }
+    u_assert_int_eq(dogecoin_pow_context_median_time_past(&ctx), t0 + 300);
+    u_assert_int_eq(dogecoin_pow_context_next_bits(&ctx, t0 + 660, &bits), true);
+    u_assert_int_eq(bits, 0x1b0404cb);
+
+    dogecoin_mem_zero(&header, sizeof(header));
+    memcpy(header.prev_block, ctx.hash, sizeof(header.prev_block));
+    header.timestamp = t0 + 660;
+    header.bits = 0x1b0404cb;
+    memset(hash, 0x42, sizeof(hash));
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), true);
+    header.bits = 0x1b0404cc;
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), false);
+    header.bits = 0x1b0404cb;
+    header.timestamp = t0 + 300;
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), false);
+    header.timestamp = t0 + 301;
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), true);
+    ctx.max_time = t0;
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), false);
+    ctx.max_time = 0;
+    header.prev_block[0] ^= 1;
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), false);
+
+    /* checkpoints must match, the difficulty is unknown without history */
+    dogecoin_pow_context_init(&ctx, main);
+    dogecoin_pow_context_add(&ctx, hash, 371336, 0x1b364184, t0);
+    u_assert_int_eq(dogecoin_pow_context_next_bits(&ctx, t0 + 60, &bits), false);
+    memcpy(header.prev_block, ctx.hash, sizeof(header.prev_block));
+    header.timestamp = t0 + 60;
+    header.bits = 0x1b364184;
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), false);
+    utils_uint256_sethex("60323982f9c5ff1b5a954eac9dc1269352835f47c2c5222691d80f0d50dcf053", hash);
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), true);
+    /* but must stay within one retarget of the anchor's bits */
+    header.bits = 0x1b516246; /* the easiest a digishield retarget allows */
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), true);
+    header.bits = 0x1b516247;
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), false);
+    header.bits = main->pow_limit;
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), false);
+    header.bits = 0x1b0404cb;
+    u_assert_int_eq(dogecoin_pow_context_check(&ctx, &header, hash), false);
+
+    /* testnet allows late blocks at minimum difficulty */
+    dogecoin_pow_context_init(&ctx, test);
+    dogecoin_pow_context_add(&ctx, hash, 199999, 0x1d00ffff, t0);
+    dogecoin_pow_context_add(&ctx, hash, 200000, 0x1d00ffff, t0 + 60);
+    u_assert_int_eq(dogecoin_pow_context_next_bits(&ctx, t0 + 181, &bits), true);
+    u_assert_int_eq(bits, test->pow_limit);
+    u_assert_int_eq(dogecoin_pow_context_next_bits(&ctx, t0 + 120, &bits), true);
+    u_assert_int_eq(bits, 0x1d00ffff);
+    /* under digishield only blocks after 157500 may use it */
+    dogecoin_pow_context_init(&ctx, test);
+    dogecoin_pow_context_add(&ctx, hash, 157498, 0x1d00ffff, t0);
+    dogecoin_pow_context_add(&ctx, hash, 157499, 0x1d00ffff, t0 + 60);
+    u_assert_int_eq(dogecoin_pow_context_next_bits(&ctx, t0 + 181, &bits), true);
+    u_assert_int_eq(bits != test->pow_limit, 1);
+    dogecoin_pow_context_add(&ctx, hash, 157500, 0x1d00ffff, t0 + 120);
+    u_assert_int_eq(dogecoin_pow_context_next_bits(&ctx, t0 + 241, &bits), true);
+    u_assert_int_eq(bits, test->pow_limit);
+    /* before digishield a normal block returns to the last regular difficulty */
+    dogecoin_pow_context_init(&ctx, test);
+    dogecoin_pow_context_add(&ctx, hash, 1000, 0x1d00ffff, t0);
+    dogecoin_pow_context_add(&ctx, hash, 1001, test->pow_limit, t0 + 600);
+    u_assert_int_eq(dogecoin_pow_context_next_bits(&ctx, t0 + 660, &bits), true);
+    u_assert_int_eq(bits, 0x1d00ffff);
+
+    /* regtest doesn't retarget */
+    dogecoin_pow_context_init(&ctx, &dogecoin_chainparams_regtest);
+    dogecoin_pow_context_add(&ctx, hash, 100, 0x207fffff, t0);
+    u_assert_int_eq(dogecoin_pow_context_next_bits(&ctx, t0 + 60, &bits), false);
+}
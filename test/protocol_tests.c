@@ -96,6 +96,35 @@ void test_protocol()
     u_assert_str_eq(v_msg_check.useragent, "client");
     u_assert_int_eq(v_msg_check.start_height, 0);
 
+    /* same message through a writer over uneven segments, header filled in afterwards */
+    unsigned char seg_a[10], seg_b[30], seg_c[256];
+    dogecoin_iovec iov[3] = {{seg_a, sizeof(seg_a)}, {seg_b, sizeof(seg_b)}, {seg_c, sizeof(seg_c)}};
+    unsigned char flat[10 + 30 + 256];
+    ser_writer w;
+    ser_writer_pos hdr_pos;
+    ser_writer_init_iov(&w, iov, 3);
+    u_assert_int_eq(dogecoin_p2p_message_begin(&w, &hdr_pos), true);
+    dogecoin_p2p_msg_version_ser_writer(&version_msg, &w);
+    u_assert_int_eq(dogecoin_p2p_message_finish(&w, &hdr_pos, (unsigned const char *)&dogecoin_chainparams_main.netmagic, DOGECOIN_MSG_VERSION), true);
+    u_assert_int_eq(w.written, p2p_msg->len);
+    memcpy(flat, seg_a, sizeof(seg_a));
+    memcpy(flat + sizeof(seg_a), seg_b, sizeof(seg_b));
+    memcpy(flat + sizeof(seg_a) + sizeof(seg_b), seg_c, sizeof(seg_c));
+    u_assert_mem_eq(flat, p2p_msg->str, p2p_msg->len);
+
+    /* and serialized in place into a single cstring */
+    dogecoin_p2p_msg_writer mw;
+    dogecoin_p2p_msg_writer_init(&mw, version_msg_cstr->len);
+    dogecoin_p2p_msg_version_ser_writer(&version_msg, &mw.w);
+    cstring *p2p_msg_inplace = dogecoin_p2p_msg_writer_finish(&mw, (unsigned const char *)&dogecoin_chainparams_main.netmagic, DOGECOIN_MSG_VERSION);
+    u_assert_int_eq(cstr_equal(p2p_msg_inplace, p2p_msg), true);
+    cstr_free(p2p_msg_inplace, true);
+
+    /* a payload exceeding the reserved size is rejected */
+    dogecoin_p2p_msg_writer_init(&mw, 4);
+    dogecoin_p2p_msg_version_ser_writer(&version_msg, &mw.w);
+    u_assert_is_null(dogecoin_p2p_msg_writer_finish(&mw, (unsigned const char *)&dogecoin_chainparams_main.netmagic, DOGECOIN_MSG_VERSION));
+
     cstr_free(p2p_msg, true);
     cstr_free(version_msg_cstr, true);
 
@@ -14,6 +14,7 @@
 
 #include "utest.h"
 
+#include <dogecoin/mem.h>
 #include <dogecoin/random.h>
 #include <dogecoin/utils.h>
 
@@ -44,3 +45,31 @@ void test_random()
     // switch back to the default random callback mapper
     dogecoin_rnd_set_mapper_default();
 }
+
+void test_random_drbg()
+{
+    unsigned char r_buf[32], r_buf2[32], zero[32];
+    unsigned char* big = dogecoin_malloc(5000);
+    dogecoin_mem_zero(zero, sizeof(zero));
+
+    dogecoin_rnd_set_mapper_drbg();
+    dogecoin_random_init();
+    u_assert_int_eq(dogecoin_random_bytes(r_buf, 32, 0), true);
+    u_assert_int_eq(dogecoin_random_bytes(r_buf2, 32, 0), true);
+    u_assert_int_eq(memcmp(r_buf, zero, 32) != 0, 1);
+    u_assert_int_eq(memcmp(r_buf, r_buf2, 32) != 0, 1);
+
+    // requests spanning several internal buffers and forced reseeds
+    u_assert_int_eq(dogecoin_random_bytes(big, 5000, 0), true);
+    u_assert_int_eq(memcmp(big + 4968, zero, 32) != 0, 1);
+    u_assert_int_eq(dogecoin_random_bytes(r_buf, 32, 1), true);
+    u_assert_int_eq(memcmp(r_buf, r_buf2, 32) != 0, 1);
+
+    // run past the reseed interval
+    for (int i = 0; i < 250; i++)
+        u_assert_int_eq(dogecoin_random_bytes(big, 5000, 0), true);
+    u_assert_int_eq(memcmp(big, zero, 32) != 0, 1);
+
+    dogecoin_free(big);
+    dogecoin_rnd_set_mapper_default();
+}
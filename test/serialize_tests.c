@@ -88,4 +88,54 @@ void test_serialize()
     assert(deser_u32(&u32, &buf3) == false);
     assert(deser_u64(&u64, &buf3) == false);
     assert(deser_s32(&i32, &buf3) == false);
+
+    /* writer over a single buffer, compared against the cstring serializers */
+    unsigned char wbuf[64];
+    ser_writer w;
+    ser_writer_pos pos;
+    cstring* s4 = cstr_new_sz(64);
+    ser_u16(s4, 0x1234);
+    ser_u32(s4, 0xdeadbeef);
+    ser_varlen(s4, 300);
+    ser_varlen(s4, 70000);
+    ser_str(s4, "foo", 10);
+    ser_s64(s4, -2);
+    ser_writer_init_buf(&w, wbuf, sizeof(wbuf));
+    ser_writer_u16(&w, 0x1234);
+    ser_writer_u32(&w, 0xdeadbeef);
+    ser_writer_varlen(&w, 300);
+    ser_writer_varlen(&w, 70000);
+    ser_writer_str(&w, "foo", 10);
+    ser_writer_s64(&w, -2);
+    assert(ser_writer_ok(&w));
+    assert(w.written == s4->len);
+    assert(memcmp(wbuf, s4->str, s4->len) == 0);
+
+    /* counting writer */
+    ser_writer_init_counter(&w);
+    ser_writer_varstr(&w, s4);
+    assert(w.written == s4->len + 1);
+
+    /* reserve then fill across segment boundaries */
+    unsigned char seg1[3], seg2[1], seg3[8];
+    dogecoin_iovec iov[3] = {{seg1, sizeof(seg1)}, {seg2, sizeof(seg2)}, {seg3, sizeof(seg3)}};
+    dogecoin_iovec out[3];
+    ser_writer_init_iov(&w, iov, 3);
+    ser_writer_bytes(&w, "a", 1);
+    assert(ser_writer_reserve(&w, 4, &pos));
+    ser_writer_u32(&w, 0x04030201);
+    assert(ser_writer_fill(&w, &pos, "wxyz", 4));
+    assert(ser_writer_ok(&w));
+    assert(memcmp(seg1, "awx", 3) == 0 && seg2[0] == 'y');
+    assert(memcmp(seg3, "z\x01\x02\x03\x04", 5) == 0);
+    assert(ser_writer_segments(&w, &pos, out, 3) == 3);
+    assert(out[0].base == seg1 + 1 && out[0].len == 2);
+    assert(out[2].base == seg3 && out[2].len == 5);
+
+    /* overflow is sticky */
+    ser_writer_bytes(&w, "0123", 4);
+    assert(!ser_writer_ok(&w));
+    ser_writer_bytes(&w, "0", 1);
+    assert(w.written == 9);
+    cstr_free(s4, true);
 }
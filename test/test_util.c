@@ -0,0 +1,67 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <string.h>
+
+#include <dogecoin/mem.h>
+#include <dogecoin/serialize.h>
+
+#include "test_util.h"
+
+dogecoin_tx* test_util_tx(const uint8_t* prev_hash, uint32_t prev_n)
+{
+    dogecoin_tx* tx = dogecoin_tx_new();
+    dogecoin_tx_in* tx_in = dogecoin_tx_in_new();
+    if (prev_hash)
+        memcpy(tx_in->prevout.hash, prev_hash, DOGECOIN_HASH_LENGTH);
+    tx_in->prevout.n = prev_hash ? prev_n : UINT32_MAX;
+    tx_in->script_sig = cstr_new_buf("\x01\x02", 2);
+    vector_add(tx->vin, tx_in);
+    return tx;
+}
+
+void test_util_add_out(dogecoin_tx* tx, int64_t amount, const void* script, size_t len)
+{
+    dogecoin_tx_out* tx_out = dogecoin_tx_out_new();
+    tx_out->value = amount;
+    tx_out->script_pubkey = cstr_new_buf(script, len);
+    vector_add(tx->vout, tx_out);
+}
+
+cstring* test_util_block(const dogecoin_block_header* header, dogecoin_tx** txs, size_t count, uint256 hash_out)
+{
+    cstring* block = cstr_new_sz(1024);
+    size_t i;
+
+    dogecoin_block_header_hash((dogecoin_block_header*)header, hash_out);
+    dogecoin_block_header_serialize(block, header);
+    ser_varlen(block, (uint32_t)count);
+    for (i = 0; i < count; i++) {
+        dogecoin_tx_serialize(block, txs[i]);
+        dogecoin_tx_free(txs[i]);
+    }
+    return block;
+}
+
+dogecoin_bool test_util_connect_block(uint32_t height, dogecoin_tx** txs, size_t count, test_util_block_cb cb, void* ctx)
+{
+    dogecoin_block_header header;
+    dogecoin_block_view view;
+    struct const_buffer buf;
+    uint256 hash;
+    dogecoin_bool ok;
+
+    dogecoin_mem_zero(&header, sizeof(header));
+    header.version = 1;
+    header.nonce = height;
+    cstring* block = test_util_block(&header, txs, count, hash);
+    buf.p = block->str;
+    buf.len = block->len;
+    ok = dogecoin_block_view_parse(&view, &buf) && cb(&view, height, hash, ctx);
+    dogecoin_block_view_free(&view);
+    cstr_free(block, true);
+    return ok;
+}
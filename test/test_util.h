@@ -0,0 +1,25 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#ifndef _TEST_UTIL_H_
+#define _TEST_UTIL_H_
+
+#include <dogecoin/block.h>
+#include <dogecoin/cstr.h>
+#include <dogecoin/tx.h>
+
+/* a transaction with one input spending prev_hash:prev_n, a null prevout if prev_hash is NULL, and no outputs */
+dogecoin_tx* test_util_tx(const uint8_t* prev_hash, uint32_t prev_n);
+/* appends an output paying amount to script */
+void test_util_add_out(dogecoin_tx* tx, int64_t amount, const void* script, size_t len);
+/* serializes header and the transactions into a block, frees the transactions and returns the block's hash in hash_out */
+cstring* test_util_block(const dogecoin_block_header* header, dogecoin_tx** txs, size_t count, uint256 hash_out);
+
+typedef dogecoin_bool (*test_util_block_cb)(dogecoin_block_view* view, uint32_t height, const uint256 hash, void* ctx);
+/* builds a version 1 block of the transactions with height as its nonce, frees them and hands the parsed block to cb */
+dogecoin_bool test_util_connect_block(uint32_t height, dogecoin_tx** txs, size_t count, test_util_block_cb cb, void* ctx);
+
+#endif
@@ -911,6 +911,76 @@ void test_tx_negative_version()
 }
 
 
+void test_tx_contiguous()
+{
+    char txhex[] = "0100000002746007aed61e8531faba1af6610f10a5422c70a2a7eb6ffb51cb7a7b7b5e45b4010000006b48304502210090bddac300243d16dca5e38ab6c80d5848e0d710d77702223bacd6682654f6fe02201b5c2e8b1143d8a807d604dc18068b4278facce561c302b0c66a4f2a5a4aa66f0121031dc1e49cfa6ae15edd6fa871a91b1f768e6f6cab06bf7a87ac0d8beb9229075bffffffffe216461c60c629333ac6b40d29b5b0b6d0ce241aea5903cf4329fc65dc3b1142010000006a47304402200e19c2a66846109aaae4d29376040fc4f7af1a519156fe8da543dc6f03bb50a102203a27495aba9eead2f154e44c25b52ccbbedef084f0caf1deedaca87efd77e4e70121031dc1e49cfa6ae15edd6fa871a91b1f768e6f6cab06bf7a87ac0d8beb9229075bffffffff020065cd1d000000001976a9144da2f8202789567d402f7f717c01d98837e4325488ac30b4b529000000001976a914d8c43e6f68ca4ea1e9b93da2d1e3a95118fa4a7c88ac00000000";
+    uint8_t tx_data[sizeof(txhex) / 2];
+    size_t outlen;
+    utils_hex_to_bin(txhex, tx_data, strlen(txhex), &outlen);
+
+    dogecoin_tx* tx = dogecoin_tx_new();
+    u_assert_int_eq(dogecoin_tx_deserialize(tx_data, outlen, tx, NULL), true);
+    u_assert_int_eq(tx->vin->len, 2);
+    u_assert_int_eq(tx->vin_arr_len, 2);
+    u_assert_int_eq(tx->vout_arr_len, 2);
+    u_assert_int_eq((dogecoin_tx_vin(tx, 0) == &tx->vin_arr[0]), 1);
+    u_assert_int_eq((dogecoin_tx_vin(tx, 1) == &tx->vin_arr[1]), 1);
+    u_assert_int_eq((dogecoin_tx_vout(tx, 1) == &tx->vout_arr[1]), 1);
+    u_assert_int_eq(dogecoin_tx_vout(tx, 0)->value, 500000000);
+
+    /* added outputs are allocated individually, the array stays in place */
+    uint160 hash160;
+    memset(hash160, 0x11, sizeof(hash160));
+    dogecoin_tx_add_p2pkh_hash160_out(tx, 1000, hash160);
+    u_assert_int_eq(tx->vout->len, 3);
+    u_assert_int_eq(tx->vout_arr_len, 2);
+    u_assert_int_eq((dogecoin_tx_vout(tx, 0) == &tx->vout_arr[0]), 1);
+    u_assert_int_eq(dogecoin_tx_vout(tx, 2)->script_pubkey->len, 25);
+
+    dogecoin_tx* tx_copy = dogecoin_tx_new();
+    dogecoin_tx_copy(tx_copy, tx);
+    u_assert_int_eq(tx_copy->vout_arr_len, 3);
+    u_assert_int_eq((dogecoin_tx_vout(tx_copy, 2) == &tx_copy->vout_arr[2]), 1);
+
+    cstring* ser = cstr_new_sz(1024);
+    cstring* ser_copy = cstr_new_sz(1024);
+    dogecoin_tx_serialize(ser, tx);
+    dogecoin_tx_serialize(ser_copy, tx_copy);
+    u_assert_int_eq(ser->len, outlen + 34);
+    u_assert_int_eq(cstr_equal(ser, ser_copy), 1);
+    u_assert_mem_eq(ser->str, tx_data, outlen - 4 - 2 * 34 - 1);
+
+    /* removing array elements only releases their contents */
+    vector_remove_idx(tx_copy->vout, 0);
+    vector_remove_idx(tx_copy->vin, 1);
+    u_assert_int_eq(tx_copy->vout->len, 2);
+    u_assert_int_eq(dogecoin_tx_vout(tx_copy, 1)->value, 1000);
+
+    /* added elements are freed completely, also after a vector_add of the caller's own */
+    vector_remove_idx(tx->vout, 2);
+    vector_remove_idx(tx->vout, 0);
+    u_assert_int_eq(tx->vout->len, 1);
+    dogecoin_tx_in* tx_in = dogecoin_tx_in_new();
+    tx_in->script_sig = cstr_new_sz(16);
+    vector_add(tx->vin, tx_in);
+    vector_remove_idx(tx->vin, 2);
+    u_assert_int_eq(tx->vin->len, 2);
+    tx_in = dogecoin_tx_in_new();
+    vector_add(tx->vin, tx_in);
+
+    cstr_free(ser, true);
+    cstr_free(ser_copy, true);
+    dogecoin_tx_free(tx_copy);
+    dogecoin_tx_free(tx);
+
+    /* counts exceeding the available data are rejected before allocating */
+    char txhex_count[] = "01000000feffffff0f00";
+    utils_hex_to_bin(txhex_count, tx_data, strlen(txhex_count), &outlen);
+    tx = dogecoin_tx_new();
+    u_assert_int_eq(dogecoin_tx_deserialize(tx_data, outlen, tx, NULL), false);
+    dogecoin_tx_free(tx);
+}
+
 struct script_test {
     char script[32];
     uint8_t expected[16];
@@ -1300,3 +1370,95 @@ void test_scripts()
     cstr_free(script_data_p2pkh, true);
     vector_free(vec, true);
 }
+
+void test_script_classify_buf()
+{
+    /* 1-of-2 multisig with two compressed keys */
+    const char* script_ms = "512102b4632d08485ff1df2db55b9dafd23347d1c47a457072a1e87be26896549a87372103c4f38e8c4e7cae5f9e0ed7e19b3a2c2b1eee3d4b9d3a0dcd2d78a5bc2b9c1ad252ae";
+    const char* script_p2sh = "a914b10c9df5f7edf436c697f02f1efdba4cf399615187";
+    const char* script_p2pkh = "76a91481edb497b5ba6eb9e67b7ed50fb220395f76f95088ac";
+    unsigned char script[256];
+    size_t outlen;
+    dogecoin_script_template tmpl;
+
+    utils_hex_to_bin(script_p2pkh, script, strlen(script_p2pkh), &outlen);
+    u_assert_int_eq(dogecoin_script_classify_buf(script, outlen, &tmpl), DOGECOIN_TX_PUBKEYHASH);
+    u_assert_int_eq(tmpl.type, DOGECOIN_TX_PUBKEYHASH);
+    u_assert_int_eq(tmpl.datalen, 20);
+    u_assert_int_eq(tmpl.data == script + 3, 1);
+    /* a truncated p2pkh is not standard */
+    u_assert_int_eq(dogecoin_script_classify_buf(script, outlen - 1, NULL), DOGECOIN_TX_NONSTANDARD);
+
+    utils_hex_to_bin(script_p2sh, script, strlen(script_p2sh), &outlen);
+    u_assert_int_eq(dogecoin_script_classify_buf(script, outlen, &tmpl), DOGECOIN_TX_SCRIPTHASH);
+    u_assert_int_eq(tmpl.data == script + 2, 1);
+
+    utils_hex_to_bin(script_ms, script, strlen(script_ms), &outlen);
+    u_assert_int_eq(dogecoin_script_classify_buf(script, outlen, &tmpl), DOGECOIN_TX_MULTISIG);
+    u_assert_int_eq(tmpl.required_sigs, 1);
+    u_assert_int_eq(tmpl.pubkey_count, 2);
+    u_assert_int_eq(tmpl.pubkey_lens[0], 33);
+    u_assert_int_eq(tmpl.pubkeys[1] == script + 36, 1);
+    u_assert_int_eq(tmpl.data == NULL, 1);
+    /* a non-pubkey push breaks the template */
+    script[35] = 0x4c;
+    u_assert_int_eq(dogecoin_script_classify_buf(script, outlen, NULL), DOGECOIN_TX_NONSTANDARD);
+
+    u_assert_int_eq(dogecoin_script_classify_buf(NULL, 0, &tmpl), DOGECOIN_TX_NONSTANDARD);
+}
+
+void test_script_iter()
+{
+    /* OP_RETURN <"doge"> OP_0 OP_PUSHDATA1 <2 bytes> OP_CODESEPARATOR */
+    const char* script_hex = "6a04646f6765004c02beefab";
+    unsigned char script[32];
+    size_t outlen, datalen;
+    const unsigned char* data;
+    enum opcodetype op;
+    dogecoin_script_iter iter;
+
+    utils_hex_to_bin(script_hex, script, strlen(script_hex), &outlen);
+    dogecoin_script_iter_init(&iter, script, outlen);
+    u_assert_int_eq(dogecoin_script_iter_next(&iter, &op, &data, &datalen), true);
+    u_assert_int_eq(op, OP_RETURN);
+    u_assert_int_eq(data == NULL, 1);
+    u_assert_int_eq(dogecoin_script_iter_next(&iter, &op, &data, &datalen), true);
+    u_assert_int_eq(datalen, 4);
+    u_assert_mem_eq(data, "doge", 4);
+    u_assert_int_eq(data == script + 2, 1);
+    u_assert_int_eq(dogecoin_script_iter_next(&iter, &op, &data, &datalen), true);
+    u_assert_int_eq(op, OP_0);
+    u_assert_int_eq(datalen, 0);
+    u_assert_int_eq(dogecoin_script_iter_next(&iter, &op, &data, &datalen), true);
+    u_assert_int_eq(op, OP_PUSHDATA1);
+    u_assert_int_eq(datalen, 2);
+    u_assert_int_eq(data[0], 0xbe);
+    u_assert_int_eq(dogecoin_script_iter_next(&iter, &op, NULL, NULL), true);
+    u_assert_int_eq(op, OP_CODESEPARATOR);
+    u_assert_int_eq(dogecoin_script_iter_next(&iter, &op, &data, &datalen), false);
+    u_assert_int_eq(iter.error, false);
+
+    /* a push running past the end of the script is an error */
+    dogecoin_script_iter_init(&iter, script, 5);
+    u_assert_int_eq(dogecoin_script_iter_next(&iter, &op, &data, &datalen), true);
+    u_assert_int_eq(dogecoin_script_iter_next(&iter, &op, &data, &datalen), false);
+    u_assert_int_eq(iter.error, true);
+    u_assert_int_eq(dogecoin_script_iter_next(&iter, &op, &data, &datalen), false);
+
+    /* the vector api matches the iterator, codeseparators can be stripped */
+    cstring* cscript = cstr_new_buf(script, outlen);
+    vector* ops = vector_new(4, dogecoin_script_op_free_cb);
+    u_assert_int_eq(dogecoin_script_get_ops(cscript, ops), true);
+    u_assert_int_eq(ops->len, 5);
+    dogecoin_script_op* sop = vector_idx(ops, 1);
+    u_assert_int_eq(sop->datalen, 4);
+    u_assert_mem_eq(sop->data, "doge", 4);
+    vector_free(ops, true);
+
+    cstring* stripped = cstr_new_sz(outlen);
+    u_assert_int_eq(dogecoin_script_copy_without_op_codeseperator(cscript, stripped), true);
+    u_assert_int_eq(stripped->len, outlen - 1);
+    u_assert_mem_eq(stripped->str, script, outlen - 1);
+    cstr_free(stripped, true);
+    cstr_free(cscript, true);
+}
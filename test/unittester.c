@@ -36,19 +36,32 @@
     } while (0)
 
 extern void test_address();
+extern void test_addrindex();
 extern void test_aes();
 extern void test_base58();
 extern void test_bip32();
 extern void test_block_header();
+extern void test_block_auxpow();
+extern void test_blockfile_scan();
+extern void test_blockfilter();
+extern void test_bloom();
+extern void test_scrypt();
+extern void test_pow();
+extern void test_pow_retarget();
 extern void test_buffer();
 extern void test_cstr();
 extern void test_ecc();
 extern void test_hash();
+extern void test_headerchain();
 extern void test_key();
 extern void test_koinu();
 extern void test_memory();
+extern void test_memory_instrumented();
+extern void test_merkle();
+extern void test_auxpow_check();
 extern void test_op_return();
 extern void test_random();
+extern void test_random_drbg();
 extern void test_rmd160();
 extern void test_serialize();
 extern void test_sha_256();
@@ -59,12 +72,16 @@ extern void test_tx_serialization();
 extern void test_tx_sighash();
 extern void test_tx_sighash_ext();
 extern void test_tx_negative_version();
+extern void test_tx_contiguous();
 extern void test_script_parse();
 extern void test_script_op_codeseperator();
 extern void test_invalid_tx_deser();
 extern void test_tx_sign();
 extern void test_scripts();
+extern void test_script_classify_buf();
+extern void test_script_iter();
 extern void test_utils();
+extern void test_utxo();
 extern void test_vector();
 
 #ifdef WITH_TOOLS
@@ -72,7 +89,15 @@ extern void test_tool();
 #endif
 
 #ifdef WITH_NET
+extern void test_addrman();
+extern void test_addrman_flood();
 extern void test_net_basics_plus_download_block();
+extern void test_net_dispatch();
+extern void test_net_threads();
+extern void test_net_stats();
+extern void test_net_send_queue();
+extern void test_net_broadcaster();
+extern void test_net_dns_seeds();
 extern void test_protocol();
 #endif
 
@@ -87,19 +112,32 @@ int main()
     dogecoin_ecc_start();
 
     u_run_test(test_address);
+    u_run_test(test_addrindex);
     u_run_test(test_aes);
     u_run_test(test_base58);
     u_run_test(test_bip32);
     u_run_test(test_block_header);
+    u_run_test(test_block_auxpow);
+    u_run_test(test_blockfile_scan);
+    u_run_test(test_blockfilter);
+    u_run_test(test_bloom);
+    u_run_test(test_scrypt);
+    u_run_test(test_pow);
+    u_run_test(test_pow_retarget);
     u_run_test(test_buffer);
     u_run_test(test_cstr);
     u_run_test(test_ecc);
     u_run_test(test_hash);
+    u_run_test(test_headerchain);
     u_run_test(test_key);
     u_run_test(test_koinu);
     u_run_test(test_memory);
+    u_run_test(test_memory_instrumented);
+    u_run_test(test_merkle);
+    u_run_test(test_auxpow_check);
     u_run_test(test_op_return);
     u_run_test(test_random);
+    u_run_test(test_random_drbg);
     u_run_test(test_rmd160);
     u_run_test(test_serialize);
     u_run_test(test_sha_256);
@@ -112,10 +150,14 @@ int main()
     u_run_test(test_tx_sighash);
     u_run_test(test_tx_sighash_ext);
     u_run_test(test_tx_negative_version);
+    u_run_test(test_tx_contiguous);
     u_run_test(test_scripts);
+    u_run_test(test_script_classify_buf);
+    u_run_test(test_script_iter);
     u_run_test(test_script_parse);
     u_run_test(test_script_op_codeseperator);
     u_run_test(test_utils);
+    u_run_test(test_utxo);
     u_run_test(test_vector);
 
 #ifdef WITH_TOOLS
@@ -123,7 +165,15 @@ int main()
 #endif
 
 #ifdef WITH_NET
+    u_run_test(test_addrman);
+    u_run_test(test_addrman_flood);
     u_run_test(test_net_basics_plus_download_block);
+    u_run_test(test_net_dispatch);
+    u_run_test(test_net_threads);
+    u_run_test(test_net_stats);
+    u_run_test(test_net_send_queue);
+    u_run_test(test_net_broadcaster);
+    u_run_test(test_net_dns_seeds);
     u_run_test(test_protocol);
 #endif
 
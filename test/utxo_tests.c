@@ -0,0 +1,193 @@
+/**********************************************************************
+ * Copyright (c) 2022 The Dogecoin Foundation                         *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <dogecoin/block.h>
+#include <dogecoin/chainparams.h>
+#include <dogecoin/mem.h>
+#include <dogecoin/serialize.h>
+#include <dogecoin/tx.h>
+#include <dogecoin/utils.h>
+#include <dogecoin/utxo.h>
+
+#include "test_util.h"
+#include "utest.h"
+
+static dogecoin_bool utxo_test_add(dogecoin_block_view* view, uint32_t height, const uint256 hash, void* ctx)
+{
+    return dogecoin_utxo_set_add_block((dogecoin_utxo_set*)ctx, view, height, hash);
+}
+
+/* builds a block of the given transactions, frees them and adds it to the set */
+static dogecoin_bool utxo_test_block(dogecoin_utxo_set* set, uint32_t height, dogecoin_tx** txs, size_t count)
+{
+    return test_util_connect_block(height, txs, count, utxo_test_add, set);
+}
+
+void test_utxo()
+{
+    static const uint8_t p2pkh[25] = {0x76, 0xa9, 0x14, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 0x88, 0xac};
+    static const uint8_t p2sh[23] = {0xa9, 0x14, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 0x87};
+    static const uint64_t amounts[] = {0, 1, 9, 10, 100000000, 5000000000ULL, 123456789, 1000000000000000000ULL, 999999999999ULL};
+    const dogecoin_chainparams* chain = &dogecoin_chainparams_regtest;
+    uint8_t p2pk[35], multisig[105], op_return[3] = {0x6a, 0x01, 0x00};
+    uint256 cb1, cb2, spend, chained;
+    dogecoin_tx* txs[3];
+    dogecoin_utxo utxo;
+    dogecoin_utxo_set *set, *loaded;
+    cstring* enc = cstr_new_sz(128);
+    char path[] = "/tmp/dogecoin_utxoXXXXXX";
+    uint64_t total = 0, loaded_total = 0;
+    size_t i;
+    int fd;
+
+    for (i = 0; i < sizeof(amounts) / sizeof(amounts[0]); i++)
+        u_assert_uint32_eq(dogecoin_utxo_decompress_amount(dogecoin_utxo_compress_amount(amounts[i])) == amounts[i], 1);
+
+    p2pk[0] = 33;
+    p2pk[1] = 0x03;
+    memset(p2pk + 2, 0x55, 32);
+    p2pk[34] = 0xac;
+    memset(multisig, 0x51, sizeof(multisig));
+    utxo.script = cstr_new_sz(64);
+
+    /* templates shrink to their key material, other scripts are kept */
+    dogecoin_utxo_serialize(enc, 5000000000LL, 77, true, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(enc->len < 30, 1);
+    u_assert_int_eq(dogecoin_utxo_deserialize((const unsigned char*)enc->str, enc->len, &utxo), true);
+    u_assert_int_eq(utxo.amount == 5000000000LL, 1);
+    u_assert_int_eq(utxo.height, 77);
+    u_assert_int_eq(utxo.coinbase, true);
+    u_assert_mem_eq(utxo.script->str, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(dogecoin_utxo_deserialize((const unsigned char*)enc->str, enc->len - 1, &utxo), false);
+    cstr_resize(enc, 0);
+    dogecoin_utxo_serialize(enc, 1, 1, false, p2sh, sizeof(p2sh));
+    u_assert_int_eq(dogecoin_utxo_deserialize((const unsigned char*)enc->str, enc->len, &utxo), true);
+    u_assert_mem_eq(utxo.script->str, p2sh, sizeof(p2sh));
+    cstr_resize(enc, 0);
+    dogecoin_utxo_serialize(enc, 1, 1, false, p2pk, sizeof(p2pk));
+    u_assert_int_eq(dogecoin_utxo_deserialize((const unsigned char*)enc->str, enc->len, &utxo), true);
+    u_assert_mem_eq(utxo.script->str, p2pk, sizeof(p2pk));
+    cstr_resize(enc, 0);
+    dogecoin_utxo_serialize(enc, 1, 1, false, multisig, sizeof(multisig));
+    u_assert_int_eq(dogecoin_utxo_deserialize((const unsigned char*)enc->str, enc->len, &utxo), true);
+    u_assert_int_eq(utxo.script->len, sizeof(multisig));
+    cstr_free(enc, true);
+
+    set = dogecoin_utxo_set_new(chain, 3);
+
+    /* the genesis outputs are never added */
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 5000, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(utxo_test_block(set, 0, txs, 1), true);
+
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2pkh, sizeof(p2pkh));
+    test_util_add_out(txs[0], 0, op_return, sizeof(op_return));
+    dogecoin_tx_hash(txs[0], cb1);
+    u_assert_int_eq(utxo_test_block(set, 1, txs, 1), true);
+    /* heights must follow each other */
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(utxo_test_block(set, 3, txs, 1), false);
+
+    /* spend the first coinbase and the new output within the same block */
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2pk, sizeof(p2pk));
+    dogecoin_tx_hash(txs[0], cb2);
+    txs[1] = test_util_tx(cb1, 0);
+    test_util_add_out(txs[1], 600000, p2sh, sizeof(p2sh));
+    test_util_add_out(txs[1], 400000, multisig, sizeof(multisig));
+    dogecoin_tx_hash(txs[1], spend);
+    txs[2] = test_util_tx(spend, 0);
+    test_util_add_out(txs[2], 590000, p2pkh, sizeof(p2pkh));
+    dogecoin_tx_hash(txs[2], chained);
+    u_assert_int_eq(utxo_test_block(set, 2, txs, 3), true);
+
+    /* nothing is applied until the batch is flushed */
+    u_assert_int_eq(set->height, -1);
+    u_assert_int_eq(dogecoin_utxo_set_flush(set), true);
+    u_assert_int_eq(set->height, 2);
+
+    u_assert_int_eq(dogecoin_utxo_set_get(set, cb1, 0, NULL), false);
+    u_assert_int_eq(dogecoin_utxo_set_get(set, cb1, 1, NULL), false);
+    u_assert_int_eq(dogecoin_utxo_set_get(set, spend, 0, NULL), false);
+    u_assert_int_eq(dogecoin_utxo_set_get(set, spend, 1, &utxo), true);
+    u_assert_int_eq(utxo.amount, 400000);
+    u_assert_int_eq(utxo.height, 2);
+    u_assert_int_eq(utxo.coinbase, false);
+    u_assert_mem_eq(utxo.script->str, multisig, sizeof(multisig));
+    u_assert_int_eq(dogecoin_utxo_set_get(set, cb2, 0, &utxo), true);
+    u_assert_int_eq(utxo.coinbase, true);
+    u_assert_mem_eq(utxo.script->str, p2pk, sizeof(p2pk));
+    u_assert_int_eq(dogecoin_utxo_set_get(set, chained, 0, NULL), true);
+    u_assert_int_eq(dogecoin_utxo_set_stats(set, &total), 3);
+    u_assert_int_eq(total, 1000000 + 400000 + 590000);
+
+    /* snapshot and resume */
+    fd = mkstemp(path);
+    u_assert_int_eq(fd >= 0, 1);
+    close(fd);
+    u_assert_int_eq(dogecoin_utxo_set_save(set, path), true);
+    loaded = dogecoin_utxo_set_new(chain, 2);
+    u_assert_int_eq(dogecoin_utxo_set_load(loaded, path), true);
+    u_assert_int_eq(dogecoin_utxo_set_load(loaded, path), false);
+    u_assert_int_eq(loaded->height, 2);
+    u_assert_mem_eq(loaded->hash, set->hash, DOGECOIN_HASH_LENGTH);
+    u_assert_int_eq(dogecoin_utxo_set_stats(loaded, &loaded_total), 3);
+    u_assert_int_eq(loaded_total, total);
+    u_assert_int_eq(dogecoin_utxo_set_get(loaded, spend, 1, &utxo), true);
+    u_assert_mem_eq(utxo.script->str, multisig, sizeof(multisig));
+
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2pkh, sizeof(p2pkh));
+    txs[1] = test_util_tx(spend, 1);
+    test_util_add_out(txs[1], 390000, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(utxo_test_block(loaded, 3, txs, 2), true);
+    u_assert_int_eq(dogecoin_utxo_set_get(loaded, spend, 1, NULL), false);
+    u_assert_int_eq(dogecoin_utxo_set_stats(loaded, NULL), 4);
+    /* saving over the mapped snapshot keeps the loaded outputs readable */
+    u_assert_int_eq(dogecoin_utxo_set_save(loaded, path), true);
+    u_assert_int_eq(dogecoin_utxo_set_get(loaded, cb2, 0, &utxo), true);
+    u_assert_int_eq(utxo.amount, 1000000);
+
+    /* a snapshot of another chain is rejected */
+    dogecoin_utxo_set_free(set);
+    set = dogecoin_utxo_set_new(&dogecoin_chainparams_main, 1);
+    u_assert_int_eq(dogecoin_utxo_set_load(set, path), false);
+
+    /* spending a missing output fails the set */
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2pkh, sizeof(p2pkh));
+    txs[1] = test_util_tx(cb1, 0);
+    test_util_add_out(txs[1], 1000, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(utxo_test_block(loaded, 4, txs, 2), true);
+    u_assert_int_eq(dogecoin_utxo_set_flush(loaded), false);
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 1000000, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(utxo_test_block(loaded, 5, txs, 1), false);
+
+    /* the total may exceed INT64_MAX */
+    dogecoin_utxo_set_free(set);
+    set = dogecoin_utxo_set_new(chain, 1);
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 5000, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(utxo_test_block(set, 0, txs, 1), true);
+    txs[0] = test_util_tx(NULL, 0);
+    test_util_add_out(txs[0], 6000000000000000000LL, p2pkh, sizeof(p2pkh));
+    test_util_add_out(txs[0], 6000000000000000000LL, p2pkh, sizeof(p2pkh));
+    u_assert_int_eq(utxo_test_block(set, 1, txs, 1), true);
+    u_assert_int_eq(dogecoin_utxo_set_stats(set, &total), 2);
+    u_assert_int_eq(total == 12000000000000000000ULL, 1);
+
+    cstr_free(utxo.script, true);
+    dogecoin_utxo_set_free(set);
+    dogecoin_utxo_set_free(loaded);
+    unlink(path);
+}